@@ -0,0 +1,23 @@
+#pragma once
+
+#include <esp_timer.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Iterations from the first argument, so ctest can run a benchmark briefly.
+static inline int bench_iterations(int argc, char **argv, int fallback) {
+  return argc > 1 ? atoi(argv[1]) : fallback;
+}
+
+// Runs body iterations times and prints the average, returns it in ns.
+template <typename Body>
+static double bench_run(const char *name, int iterations, Body body) {
+  int64_t start_us = esp_timer_get_time();
+  for (int i = 0; i < iterations; ++i) {
+    body(i);
+  }
+  double ns = (esp_timer_get_time() - start_us) * 1000.0 / iterations;
+  printf("%-40s %10.0f ns/op  (%d iterations)\n", name, ns, iterations);
+  return ns;
+}
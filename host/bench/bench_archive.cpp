@@ -0,0 +1,51 @@
+// Archive throughput: appending samples in the sampler's one minute batches,
+// segment opens included, then mounting a ring holding three days of them
+// with the replay into history. Mount prints the bytes it read, the figure
+// that matters on flash.
+#include "archive.hpp"
+#include "bench.hpp"
+#include "fixtures.hpp"
+#include "partition_fake.hpp"
+#include <memory>
+
+#define SEGMENTS 8
+#define SAMPLES (3 * 24 * 3600 / HISTORY_RAW_PERIOD_S)
+
+int main(int argc, char **argv) {
+  int iterations = bench_iterations(argc, argv, 20);
+  partition_fake_add("spiffs", ESP_PARTITION_TYPE_DATA,
+                     ESP_PARTITION_SUBTYPE_DATA_SPIFFS,
+                     SEGMENTS * ARCHIVE_SEGMENT_SIZE, nullptr);
+  time_t now = fixture_now();
+  time_t start = now - SAMPLES * HISTORY_RAW_PERIOD_S;
+  std::unique_ptr<Archive> archive(new Archive());
+  archive->mount(nullptr);
+
+  int appends = iterations * 1000;
+  bench_run("append sample", appends, [&](int i) {
+    int16_t values[HistoryMetricMax] = {(int16_t)(i % 40), 215, 480};
+    archive->append_sample(start - appends * HISTORY_RAW_PERIOD_S +
+                               i * HISTORY_RAW_PERIOD_S,
+                           values);
+    if (i % 6 == 5) {
+      archive->flush();
+    }
+  });
+  for (int i = 0; i < SAMPLES; ++i) {
+    int16_t values[HistoryMetricMax] = {(int16_t)(i % 40), 215, 480};
+    archive->append_sample(start + i * HISTORY_RAW_PERIOD_S, values);
+  }
+  archive->flush();
+  ArchiveStats stats = archive->stats();
+  printf("%u appended, %u flushes, %u bytes written, %u erases\n",
+         stats.appended, stats.flushes, stats.bytes_written, stats.erases);
+
+  std::unique_ptr<HistoryStore> history(new HistoryStore());
+  bench_run("mount and replay 3 days", iterations, [&](int) {
+    archive.reset(new Archive());
+    archive->mount(history.get());
+  });
+  printf("mount read %u of %u bytes\n", archive->stats().bytes_read,
+         SEGMENTS * ARCHIVE_SEGMENT_SIZE);
+  return 0;
+}
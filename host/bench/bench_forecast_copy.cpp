@@ -0,0 +1,133 @@
+// Taking every value out of 2, 7 and 16 day responses: the element copy
+// Weather used to do, a branch on the variable then values()->Get(i) one by
+// one, against resolving a ForecastView and copying its spans in bulk. Both
+// should grow linearly with the days, the cost per value stays flat.
+#include "bench.hpp"
+#include "fixtures.hpp"
+#include "forecast_view.hpp"
+#include "open_meteo_fixture.hpp"
+#include <flatbuffers/flatbuffers.h>
+#include <string.h>
+#include <vector>
+
+using namespace openmeteo_sdk;
+
+typedef struct Columns {
+  std::vector<float> hourly[HourlyMax];
+  std::vector<float> daily[DailyMax];
+  std::vector<int64_t> daily_int64[DailyMax];
+} Columns;
+
+static void element_copy(const WeatherApiResponse *response,
+                         Columns *columns) {
+  auto hourly = response->hourly()->variables();
+  for (unsigned i = 0; i < hourly->size(); ++i) {
+    const VariableWithValues *data = hourly->Get(i);
+    HourlyVariable variable;
+    if (data->variable() == Variable_temperature) {
+      variable = HourlyTemperature;
+    } else if (data->variable() == Variable_precipitation_probability) {
+      variable = HourlyPrecipitationProbability;
+    } else if (data->variable() == Variable_weather_code) {
+      variable = HourlyWeatherCode;
+    } else if (data->variable() == Variable_uv_index) {
+      variable = HourlyUvIndex;
+    } else {
+      continue;
+    }
+    std::vector<float> &out = columns->hourly[variable];
+    for (unsigned v = 0; v < data->values()->size(); ++v) {
+      out[v] = data->values()->Get(v);
+    }
+  }
+  auto daily = response->daily()->variables();
+  bool has_scan_one = false;
+  for (unsigned i = 0; i < daily->size(); ++i) {
+    const VariableWithValues *data = daily->Get(i);
+    DailyVariable variable;
+    if (data->variable() == Variable_sunrise ||
+        data->variable() == Variable_sunset) {
+      variable =
+          data->variable() == Variable_sunrise ? DailySunrise : DailySunset;
+      std::vector<int64_t> &out = columns->daily_int64[variable];
+      for (unsigned v = 0; v < data->values_int64()->size(); ++v) {
+        out[v] = data->values_int64()->Get(v);
+      }
+      continue;
+    }
+    if (data->variable() == Variable_weather_code) {
+      variable = DailyWeatherCode;
+    } else if (data->variable() == Variable_temperature) {
+      variable = has_scan_one ? DailyTemperatureMin : DailyTemperatureMax;
+      has_scan_one = true;
+    } else if (data->variable() == Variable_precipitation_probability) {
+      variable = DailyPrecipitationProbabilityMax;
+    } else if (data->variable() == Variable_uv_index) {
+      variable = DailyUvIndexMax;
+    } else {
+      continue;
+    }
+    std::vector<float> &out = columns->daily[variable];
+    for (unsigned v = 0; v < data->values()->size(); ++v) {
+      out[v] = data->values()->Get(v);
+    }
+  }
+}
+
+template <typename T>
+static void bulk_copy(Span<T> span, std::vector<T> *out) {
+  memcpy(out->data(), span.data, span.size * sizeof(T));
+}
+
+static void view_copy(const WeatherApiResponse *response, Columns *columns) {
+  ForecastView view(response);
+  for (int variable = 0; variable < HourlyMax; ++variable) {
+    bulk_copy(view.hourly(static_cast<HourlyVariable>(variable)),
+              &columns->hourly[variable]);
+  }
+  for (int variable = 0; variable < DailyMax; ++variable) {
+    DailyVariable daily = static_cast<DailyVariable>(variable);
+    if (variable == DailySunrise || variable == DailySunset) {
+      bulk_copy(view.daily_int64(daily), &columns->daily_int64[variable]);
+    } else {
+      bulk_copy(view.daily(daily), &columns->daily[variable]);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  int iterations = bench_iterations(argc, argv, 20000);
+  time_t now = fixture_now();
+  time_t midnight = now - now % 86400;
+  static const int days[] = {2, 7, 16};
+  for (int count : days) {
+    std::vector<uint8_t> body =
+        fixture_forecast_response(midnight, 24 * count, count);
+    const WeatherApiResponse *response =
+        GetSizePrefixedWeatherApiResponse(body.data());
+    Columns columns;
+    for (std::vector<float> &column : columns.hourly) {
+      column.resize(24 * count);
+    }
+    for (std::vector<float> &column : columns.daily) {
+      column.resize(count);
+    }
+    for (std::vector<int64_t> &column : columns.daily_int64) {
+      column.resize(count);
+    }
+    size_t values = (HourlyMax * 24 + DailyMax) * count;
+    printf("%d days: %u bytes, %u values\n", count, (unsigned)body.size(),
+           (unsigned)values);
+
+    char name[64];
+    snprintf(name, sizeof(name), "element copy, %d days", count);
+    double element = bench_run(name, iterations,
+                               [&](int) { element_copy(response, &columns); });
+    snprintf(name, sizeof(name), "view and bulk copy, %d days", count);
+    double view = bench_run(name, iterations,
+                            [&](int) { view_copy(response, &columns); });
+    printf("  %.2f ns per value element by element, %.2f through the view\n",
+           element / values, view / values);
+  }
+  return 0;
+}
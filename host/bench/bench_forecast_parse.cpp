@@ -0,0 +1,46 @@
+// Cost of taking in the 16 day forecast: verifying the flatbuffer, resolving
+// the variables into a ForecastView, and the whole Weather::refresh on a
+// recorded response, which also packs the snapshot and saves it to NVS.
+#include "bench.hpp"
+#include "fixtures.hpp"
+#include "forecast_view.hpp"
+#include "http_fake.hpp"
+#include "open_meteo_fixture.hpp"
+#include "weather.hpp"
+#include <flatbuffers/flatbuffers.h>
+
+int main(int argc, char **argv) {
+  int iterations = bench_iterations(argc, argv, 5000);
+  time_t now = fixture_now();
+  time_t midnight = now - now % 86400;
+  std::vector<uint8_t> body = fixture_forecast_response(
+      midnight - 24 * 3600, 24 + HOURLY_FORECAST_HOURS, HOURLY_FORECAST_DAYS);
+  printf("response: %u bytes\n", (unsigned)body.size());
+  http_fake_respond("https://api.open-meteo.com/", 200, body.data(),
+                    body.size());
+
+  bench_run("verify", iterations, [&](int) {
+    flatbuffers::Verifier verifier(body.data(), body.size());
+    if (!openmeteo_sdk::VerifySizePrefixedWeatherApiResponseBuffer(verifier)) {
+      abort();
+    }
+  });
+  const openmeteo_sdk::WeatherApiResponse *response =
+      openmeteo_sdk::GetSizePrefixedWeatherApiResponse(body.data());
+  bench_run("forecast view", iterations, [&](int) {
+    ForecastView view(response);
+    if (view.hourly(HourlyTemperature).empty()) {
+      abort();
+    }
+  });
+
+  WeatherSnapshot seed;
+  Weather weather(&seed);
+  weather.start(nullptr, nullptr, nullptr);
+  bench_run("refresh from recorded response", iterations, [&](int) {
+    if (!weather.refresh(48.85f, 2.35f)) {
+      abort();
+    }
+  });
+  return 0;
+}
@@ -0,0 +1,48 @@
+// Cost of feeding the history one sample of every metric, and of the range
+// queries the history page makes, over a store filled with a month.
+#include "bench.hpp"
+#include "fixtures.hpp"
+#include "history.hpp"
+#include <algorithm>
+#include <memory>
+
+#define COLUMNS 240
+
+int main(int argc, char **argv) {
+  int iterations = bench_iterations(argc, argv, 100000);
+  time_t now = fixture_now();
+  std::unique_ptr<HistoryStore> history(new HistoryStore());
+  fixture_history(history.get(), now, HISTORY_HOUR_SLOTS);
+  printf("store: %u bytes\n", (unsigned)sizeof(HistoryStore));
+
+  // Carries on from the fixture, one sample period at a time
+  time_t next = now - now % HISTORY_RAW_PERIOD_S;
+  bench_run("insert", iterations, [&](int i) {
+    float values[HistoryMetricMax] = {8.0f + i % 7, 21.5f, 48.0f};
+    next += HISTORY_RAW_PERIOD_S;
+    history->insert(next, values);
+  });
+
+  static const struct {
+    const char *name;
+    HistoryTier tier;
+    time_t span;
+  } ranges[] = {
+      {"query raw hour", HistoryRaw, 3600},
+      {"query minute day", HistoryMinute, 86400},
+      {"query hour month", HistoryHour, 30 * 86400},
+  };
+  HistoryPoint out[COLUMNS];
+  size_t filled = 0;
+  for (const auto &range : ranges) {
+    filled = 0;
+    bench_run(range.name, iterations / 10, [&](int i) {
+      HistoryMetric metric = (HistoryMetric)(i % HistoryMetricMax);
+      filled += history->query(range.tier, metric, next - range.span, next,
+                               out, COLUMNS);
+    });
+    printf("  %u of %u columns filled\n",
+           (unsigned)(filled / std::max(1, iterations / 10)), COLUMNS);
+  }
+  return 0;
+}
@@ -0,0 +1,75 @@
+// The 16 day hourly forecast in its partition, here a memory-mapped image
+// file as on the device: writing one refresh, mounting, and the reads a day
+// page makes straight from the mapping, one day of every column.
+#include "bench.hpp"
+#include "fixtures.hpp"
+#include "hourly_forecast.hpp"
+#include "partition_fake.hpp"
+#include <algorithm>
+#include <math.h>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#define PARTITION_SIZE (64 * 1024)
+
+int main(int argc, char **argv) {
+  int iterations = bench_iterations(argc, argv, 100000);
+  std::string path = HOST_OUTPUT_DIR "/bench_hourly_forecast.img";
+  unlink(path.c_str());
+  partition_fake_add("hourly", ESP_PARTITION_TYPE_DATA,
+                     HOURLY_FORECAST_SUBTYPE, PARTITION_SIZE, path.c_str());
+  time_t now = fixture_now();
+  time_t start = now - now % 86400;
+  std::vector<float> temperature, rain, uv, code;
+  for (int h = 0; h < HOURLY_FORECAST_HOURS; ++h) {
+    temperature.push_back(19 + 7 * sinf((h % 24 - 9) * (float)M_PI / 12));
+    rain.push_back(h % 24 >= 18 ? 70 : 5);
+    uv.push_back(h % 24 >= 6 && h % 24 <= 20 ? 7 - abs(h % 24 - 13) * 0.9f
+                                             : 0);
+    code.push_back(h % 24 >= 18 ? 80 : 2);
+  }
+  HourlyColumns columns = {
+      .temperature_2m = {temperature.data(), temperature.size()},
+      .precipitation_probability = {rain.data(), rain.size()},
+      .uv_index = {uv.data(), uv.size()},
+      .weather_code = {code.data(), code.size()},
+  };
+
+  std::unique_ptr<HourlyForecast> hourly(new HourlyForecast());
+  int writes = std::max(1, iterations / 100);
+  partition_fake_reset_stats();
+  bench_run("write a refresh", writes,
+            [&](int i) { hourly->write(start + i * 3600, columns); });
+  PartitionFakeStats stats = partition_fake_stats();
+  printf("  %u bytes written and %u erased per refresh\n",
+         (unsigned)(stats.bytes_written / writes),
+         (unsigned)(stats.bytes_erased / writes));
+
+  bench_run("mount", writes, [&](int) {
+    hourly.reset(new HourlyForecast());
+    if (hourly->forecast() == nullptr) {
+      abort();
+    }
+  });
+
+  // A day page: the hours of one of the 16 days, every column decoded
+  float sum = 0;
+  bench_run("read a day", iterations, [&](int i) {
+    const HourlyForecastSlot *forecast = hourly->forecast();
+    int first = forecast->hour_index(forecast->header.start +
+                                     (i % HOURLY_FORECAST_DAYS) * 86400);
+    for (int h = first; h < first + 24; ++h) {
+      sum += forecast->hours.temperature(h) + forecast->hours.precipitation(h) +
+             forecast->hours.uv(h) + forecast->hours.code(h);
+    }
+  });
+  printf("  %u bytes mapped per slot, none of it copied (%.0f)\n",
+         (unsigned)sizeof(HourlyForecastSlot), sum);
+
+  hourly.reset();
+  partition_fake_remove_all();
+  unlink(path.c_str());
+  return 0;
+}
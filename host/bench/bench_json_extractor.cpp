@@ -0,0 +1,38 @@
+// The geolocation response scanned the way the HTTP client hands it over, in
+// 128 byte chunks, through the fields Geolocation::update_geoloc extracts.
+#include "bench.hpp"
+#include "json_extractor.hpp"
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#define CHUNK_SIZE 128
+
+int main(int argc, char **argv) {
+  int iterations = bench_iterations(argc, argv, 20000);
+  std::ifstream file(HOST_DATA_DIR "/geolocation/full.json", std::ios::binary);
+  std::stringstream content;
+  content << file.rdbuf();
+  std::string document = content.str();
+
+  char city[86], country[57], tz[31], latitude[16], longitude[16];
+  size_t found = 0;
+  double ns = bench_run("scan geolocation response", iterations, [&](int) {
+    JsonField fields[] = {
+        {.path = "city", .value = city, .size = sizeof(city)},
+        {.path = "country_name", .value = country, .size = sizeof(country)},
+        {.path = "time_zone.name", .value = tz, .size = sizeof(tz)},
+        {.path = "latitude", .value = latitude, .size = sizeof(latitude)},
+        {.path = "longitude", .value = longitude, .size = sizeof(longitude)},
+    };
+    JsonExtractor extractor(fields, sizeof(fields) / sizeof(fields[0]));
+    for (size_t pos = 0; pos < document.size(); pos += CHUNK_SIZE) {
+      extractor.feed(document.data() + pos,
+                     std::min((size_t)CHUNK_SIZE, document.size() - pos));
+    }
+    found = extractor.found();
+  });
+  printf("%zu bytes at %.1f MB/s, %zu fields found (%s, %s)\n",
+         document.size(), document.size() * 1000.0 / ns, found, city, tz);
+  return 0;
+}
@@ -0,0 +1,56 @@
+// What each extra place costs: the one request for all of them, decoded
+// from recorded responses for 1 to LOCATIONS_MAX places, and the memory the
+// list, the double-buffered table and the response take per place. On the
+// host the time is building the request and decoding, the network part
+// grows with the response bytes per place.
+#include "bench.hpp"
+#include "fixtures.hpp"
+#include "http_fake.hpp"
+#include "locations.hpp"
+#include "nvs_fake.hpp"
+#include "open_meteo_fixture.hpp"
+#include <stdio.h>
+
+int main(int argc, char **argv) {
+  int iterations = bench_iterations(argc, argv, 5000);
+  time_t now = fixture_now();
+  std::vector<uint8_t> place =
+      fixture_forecast_response(now - now % 3600, 1, 1);
+  Location all[LOCATIONS_MAX];
+  for (int i = 0; i < LOCATIONS_MAX; ++i) {
+    snprintf(all[i].name, sizeof(all[i].name), "Place %d", i + 1);
+    all[i].latitude = 40 + i;
+    all[i].longitude = 2 + i;
+  }
+
+  double previous_ns = 0;
+  for (size_t count = 1; count <= LOCATIONS_MAX; ++count) {
+    nvs_fake_reset();
+    http_fake_reset();
+    std::vector<uint8_t> body;
+    for (size_t i = 0; i < count; ++i) {
+      body.insert(body.end(), place.begin(), place.end());
+    }
+    http_fake_respond("https://api.open-meteo.com/", 200, body.data(),
+                      body.size());
+    Locations locations;
+    locations.set(all, count);
+    locations.start();
+    char name[64];
+    snprintf(name, sizeof(name), "refresh %u places", (unsigned)count);
+    double ns = bench_run(name, iterations, [&](int) {
+      if (!locations.refresh()) {
+        abort();
+      }
+    });
+    printf("  %u response bytes, %+.0f ns for the last place\n",
+           (unsigned)body.size(), count > 1 ? ns - previous_ns : ns);
+    previous_ns = ns;
+  }
+  printf("memory per place: %u bytes of list, %u of forecast table, %u of "
+         "response (%u reserved)\n",
+         (unsigned)sizeof(Location), (unsigned)(2 * sizeof(LocationForecast)),
+         (unsigned)place.size(), 1024u);
+  // 1024 is RESPONSE_SIZE in locations.cpp over LOCATIONS_MAX
+  return 0;
+}
@@ -0,0 +1,40 @@
+// Time to compose every page: a full redraw after a page change, then the
+// retained frame of the next update where only changed fields go out. The
+// host figures are relative, for before and after comparisons.
+#include "bench.hpp"
+#include "fixtures.hpp"
+#include "pages.hpp"
+#include <memory>
+
+int main(int argc, char **argv) {
+  int iterations = bench_iterations(argc, argv, 2000);
+  lgfx::LovyanGFX display(320, 240);
+  Screen screen(&display);
+  std::unique_ptr<HistoryStore> history(new HistoryStore());
+  WeatherSnapshot weather;
+  fixture_weather(&weather);
+  time_t now = fixture_now();
+  fixture_history(history.get(), now, 24);
+  PageContext ctx = {};
+  ctx.screen = &screen;
+  ctx.weather = &weather;
+  ctx.history = history.get();
+  ctx.now = now;
+  ctx.online = true;
+
+  for (int page = 0; page < page_count(); ++page) {
+    char name[64];
+    snprintf(name, sizeof(name), "page %d full redraw", page);
+    bench_run(name, iterations, [&](int i) {
+      ctx.page = page;
+      screen.invalidate();
+      page_render(&ctx);
+    });
+    snprintf(name, sizeof(name), "page %d unchanged", page);
+    bench_run(name, iterations, [&](int i) { page_render(&ctx); });
+  }
+  const ScreenStats &stats = screen.stats();
+  printf("%u frames, %llu pixels pushed\n", stats.frames,
+         (unsigned long long)stats.pixels_pushed);
+  return 0;
+}
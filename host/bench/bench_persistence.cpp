@@ -0,0 +1,65 @@
+// What a weather refresh costs in NVS: saving a snapshot that changed, one
+// where only the fetch time moved, one that did not change at all, and the
+// restore at boot. The host times are for comparisons, the NVS operation
+// counts carry over to the device.
+#include "bench.hpp"
+#include "fixtures.hpp"
+#include "nvs_fake.hpp"
+#include "persistence.hpp"
+
+static void print_nvs(const char *name, int iterations) {
+  NvsFakeStats stats = nvs_fake_stats();
+  printf("  %s: %.2f writes %.0f bytes %.2f commits per op\n", name,
+         (double)stats.writes / iterations,
+         (double)stats.bytes_written / iterations,
+         (double)stats.commits / iterations);
+}
+
+int main(int argc, char **argv) {
+  int iterations = bench_iterations(argc, argv, 20000);
+  WeatherSnapshot snapshot;
+  fixture_weather(&snapshot);
+  PersistentRecord record("Weather", 1, sizeof(time_t));
+
+  nvs_fake_reset();
+  bench_run("save changed snapshot", iterations, [&](int i) {
+    snapshot.forecast24.temperature_2m[0] = i;
+    snapshot.fetched_at = i;
+    record.save(&snapshot, sizeof(snapshot));
+  });
+  print_nvs("changed", iterations);
+
+  nvs_fake_reset();
+  bench_run("save new fetch time", iterations, [&](int i) {
+    snapshot.fetched_at = 1000000 + i;
+    record.save(&snapshot, sizeof(snapshot));
+  });
+  print_nvs("fetch time", iterations);
+
+  nvs_fake_reset();
+  PersistentRecord unchanged("Weather", 1, sizeof(time_t));
+  unchanged.save(&snapshot, sizeof(snapshot));
+  bench_run("save unchanged", iterations,
+            [&](int) { unchanged.save(&snapshot, sizeof(snapshot)); });
+  print_nvs("unchanged", iterations);
+
+  WeatherSnapshot loaded;
+  bench_run("restore snapshot", iterations, [&](int) {
+    PersistentRecord restore("Weather", 1, sizeof(time_t));
+    restore.load(&loaded, sizeof(loaded));
+  });
+
+  nvs_fake_reset();
+  bench_run("save in a batch of 4 namespaces", iterations, [&](int i) {
+    static const char *names[] = {"Weather", "GEO", "Places", "PlacesWx"};
+    PersistentRecord records[] = {{names[0], 1}, {names[1], 1},
+                                  {names[2], 1}, {names[3], 1}};
+    PersistenceBatch batch;
+    for (PersistentRecord &batched : records) {
+      snapshot.fetched_at = i;
+      batched.save(&snapshot, sizeof(snapshot));
+    }
+  });
+  print_nvs("batch", iterations);
+  return 0;
+}
@@ -0,0 +1,153 @@
+// Looking up the POSIX string of a zone: the binary search of the generated
+// index against scanning zones.json for the key, and against the cJSON parse
+// and lookup the index replaced. cJSON allocates through counting hooks, so
+// its heap is measured; it is left out when the build finds no cJSON.
+#include "bench.hpp"
+#include "json_extractor.hpp"
+#include "tz_index.h"
+#include <algorithm>
+#include <fstream>
+#include <malloc.h>
+#include <sstream>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#ifdef HAVE_CJSON
+#include <cJSON.h>
+#endif
+
+#ifdef HAVE_CJSON
+// sizeof(cJSON) with 32 bit pointers: three links, type, two strings,
+// valueint and valuedouble
+#define CJSON_NODE_SIZE 40
+
+typedef struct CjsonHeap {
+  size_t live;
+  size_t peak;
+  size_t allocations;
+  size_t nodes;
+} CjsonHeap;
+
+static CjsonHeap cjson_heap;
+
+// Each block starts with its requested size, so the counts are what cJSON
+// asked for rather than what the host allocator rounded it up to
+static void *cjson_malloc(size_t size) {
+  max_align_t *block =
+      static_cast<max_align_t *>(malloc(sizeof(max_align_t) + size));
+  if (block == nullptr) {
+    return nullptr;
+  }
+  *reinterpret_cast<size_t *>(block) = size;
+  cjson_heap.live += size;
+  cjson_heap.peak = std::max(cjson_heap.peak, cjson_heap.live);
+  cjson_heap.allocations++;
+  cjson_heap.nodes += size == sizeof(cJSON);
+  return block + 1;
+}
+
+static void cjson_free(void *pointer) {
+  if (pointer == nullptr) {
+    return;
+  }
+  max_align_t *block = static_cast<max_align_t *>(pointer) - 1;
+  cjson_heap.live -= *reinterpret_cast<size_t *>(block);
+  free(block);
+}
+
+// What Geolocation did before the index: parse the embedded document, take
+// the zone's string, free the tree
+static bool cjson_lookup(const std::string &document, const char *name,
+                         char *posix, size_t size) {
+  cJSON *root = cJSON_ParseWithLength(document.data(), document.size());
+  const cJSON *zone = cJSON_GetObjectItemCaseSensitive(root, name);
+  bool found = cJSON_IsString(zone);
+  if (found) {
+    snprintf(posix, size, "%s", zone->valuestring);
+  }
+  cJSON_Delete(root);
+  return found;
+}
+#endif
+
+int main(int argc, char **argv) {
+  int iterations = bench_iterations(argc, argv, 200000);
+  std::ifstream file(HOST_DATA_DIR "/tz/zones.json", std::ios::binary);
+  std::stringstream content;
+  content << file.rdbuf();
+  std::string document = content.str();
+
+  std::vector<const char *> names;
+  for (size_t i = 0; i < tz_index_count; ++i) {
+    names.push_back(tz_index_pool + tz_index_entries[i].name);
+  }
+
+  // Outside the timed runs, their printf allocates the stdout buffer
+  size_t failures = 0;
+  size_t heap_before = mallinfo2().uordblks;
+  for (const char *name : names) {
+    failures += tz_index_lookup(name) == nullptr;
+  }
+  size_t heap_after = mallinfo2().uordblks;
+
+  bench_run("tz_index_lookup", iterations, [&](int i) {
+    failures += tz_index_lookup(names[i % names.size()]) == nullptr;
+  });
+  bench_run("tz_index_lookup, unknown zone", iterations, [&](int) {
+    failures += tz_index_lookup("Mars/Olympus") != nullptr;
+  });
+
+  char posix[64];
+  int scans = std::max(1, iterations / 100);
+  bench_run("scan zones.json for the key", scans, [&](int i) {
+    JsonField field = {.path = names[i % names.size()],
+                       .value = posix,
+                       .size = sizeof(posix)};
+    JsonExtractor extractor(&field, 1);
+    extractor.feed(document.data(), document.size());
+    failures += !field.found;
+  });
+#ifdef HAVE_CJSON
+  cJSON_Hooks hooks = {.malloc_fn = cjson_malloc, .free_fn = cjson_free};
+  cJSON_InitHooks(&hooks);
+  bench_run("cJSON parse and lookup", scans, [&](int i) {
+    failures += !cjson_lookup(document, names[i % names.size()], posix,
+                              sizeof(posix));
+  });
+  if (cjson_heap.live) {
+    printf("cJSON leaked %zu bytes\n", cjson_heap.live);
+    return 1;
+  }
+#endif
+  if (failures) {
+    printf("%zu lookups failed\n", failures);
+    return 1;
+  }
+
+  size_t pool = 0;
+  for (size_t i = 0; i < tz_index_count; ++i) {
+    const TzIndexEntry *entry = &tz_index_entries[i];
+    pool = std::max(pool, entry->name + strlen(tz_index_pool + entry->name));
+    pool = std::max(pool, entry->posix + strlen(tz_index_pool + entry->posix));
+  }
+  pool += 1;
+  printf("flash: %zu bytes of index (%zu pool, %zu table), %zu of zones.json\n",
+         pool + tz_index_count * sizeof(TzIndexEntry), pool,
+         tz_index_count * sizeof(TzIndexEntry), document.size());
+  printf("heap: %zu bytes for the index lookups\n", heap_after - heap_before);
+#ifdef HAVE_CJSON
+  // Every parse allocates the same, the counts of the last one
+  size_t allocations = cjson_heap.allocations / scans;
+  size_t nodes = cjson_heap.nodes / scans;
+  printf("heap: %zu bytes at the peak of a cJSON parse, %zu allocations, "
+         "%zu nodes of %zu bytes; %zu with the ESP32's %d byte nodes\n",
+         cjson_heap.peak, allocations, nodes, sizeof(cJSON),
+         cjson_heap.peak - nodes * (sizeof(cJSON) - CJSON_NODE_SIZE),
+         CJSON_NODE_SIZE);
+#else
+  printf("heap: cJSON not built, its parse is not measured\n");
+#endif
+  return 0;
+}
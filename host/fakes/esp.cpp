@@ -0,0 +1,139 @@
+// Host implementations of the small ESP-IDF services: logs, the timer, the
+// ROM CRCs, the heap gauges and address parsing.
+#include <arpa/inet.h>
+#include <chrono>
+#include <esp_err.h>
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+#include <esp_netif.h>
+#include <esp_rom_crc.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HOST_HEAP_SIZE (300 * 1024)
+
+static esp_log_level_t log_level() {
+  static esp_log_level_t level = [] {
+    const char *env = getenv("CLOCK_HOST_LOG");
+    return env ? (esp_log_level_t)atoi(env) : ESP_LOG_ERROR;
+  }();
+  return level;
+}
+
+void host_log(esp_log_level_t level, const char *tag, const char *format,
+              ...) {
+  if (level > log_level()) {
+    return;
+  }
+  static const char letters[] = "NEWIDV";
+  fprintf(stderr, "%c (%lld) %s: ", letters[level],
+          (long long)(esp_timer_get_time() / 1000), tag);
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+int64_t esp_timer_get_time(void) {
+  static const auto start = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+  switch (code) {
+  case ESP_OK:
+    return "ESP_OK";
+  case ESP_FAIL:
+    return "ESP_FAIL";
+  case ESP_ERR_NO_MEM:
+    return "ESP_ERR_NO_MEM";
+  case ESP_ERR_INVALID_ARG:
+    return "ESP_ERR_INVALID_ARG";
+  case ESP_ERR_INVALID_STATE:
+    return "ESP_ERR_INVALID_STATE";
+  case ESP_ERR_INVALID_SIZE:
+    return "ESP_ERR_INVALID_SIZE";
+  case ESP_ERR_NOT_FOUND:
+    return "ESP_ERR_NOT_FOUND";
+  case ESP_ERR_TIMEOUT:
+    return "ESP_ERR_TIMEOUT";
+  case ESP_ERR_NVS_NOT_FOUND:
+    return "ESP_ERR_NVS_NOT_FOUND";
+  case ESP_ERR_NVS_INVALID_LENGTH:
+    return "ESP_ERR_NVS_INVALID_LENGTH";
+  }
+  return "UNKNOWN ERROR";
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+  crc = ~crc;
+  for (uint32_t i = 0; i < len; ++i) {
+    crc ^= buf[i];
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
+
+uint16_t esp_rom_crc16_le(uint16_t crc, const uint8_t *buf, uint32_t len) {
+  crc = ~crc;
+  for (uint32_t i = 0; i < len; ++i) {
+    crc ^= buf[i];
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ (0x8408 & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+  (void)caps;
+  return HOST_HEAP_SIZE / 2;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+  (void)caps;
+  return HOST_HEAP_SIZE;
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps) {
+  (void)caps;
+  return malloc(size);
+}
+
+uint32_t esp_get_free_heap_size(void) { return HOST_HEAP_SIZE; }
+
+uint32_t esp_get_minimum_free_heap_size(void) { return HOST_HEAP_SIZE; }
+
+BaseType_t xPortGetCoreID(void) { return 0; }
+
+esp_err_t esp_netif_str_to_ip6(const char *src, esp_ip6_addr_t *dest) {
+  uint32_t addr[4];
+  if (inet_pton(AF_INET6, src, addr) != 1) {
+    return ESP_FAIL;
+  }
+  memcpy(dest->addr, addr, sizeof(addr));
+  dest->zone = 0;
+  return ESP_OK;
+}
+
+#if defined(__GLIBC__) && __GLIBC__ == 2 && __GLIBC_MINOR__ < 38
+size_t strlcpy(char *dst, const char *src, size_t size) {
+  size_t length = strlen(src);
+  if (size) {
+    size_t copied = length < size ? length : size - 1;
+    memcpy(dst, src, copied);
+    dst[copied] = '\0';
+  }
+  return length;
+}
+#endif
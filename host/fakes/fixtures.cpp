@@ -0,0 +1,56 @@
+#include "fixtures.hpp"
+#include <math.h>
+#include <stdlib.h>
+
+time_t fixture_now(void) {
+  setenv("TZ", "UTC0", 1);
+  tzset();
+  return time(nullptr);
+}
+
+void fixture_weather(WeatherSnapshot *snapshot) {
+  static const uint8_t codes[] = {0, 1, 2, 3, 61, 80, 95};
+  *snapshot = WeatherSnapshot();
+  Forecast24 *f24 = &snapshot->forecast24;
+  for (int h = 0; h < 24; ++h) {
+    float celsius = 19 + 7 * sinf((h - 9) * (float)M_PI / 12);
+    f24->temperature_2m[h] = forecast_encode_temperature(celsius);
+    f24->precipitation_probability[h] =
+        forecast_encode_percent(h >= 18 ? 70 : 5);
+    f24->uv_index[h] =
+        forecast_encode_uv(h >= 6 && h <= 20 ? 7 - abs(h - 13) * 0.9f : 0);
+    f24->weather_code[h] = h >= 18 ? 80 : h >= 12 ? 2 : 1;
+  }
+  Forecast7 *f7 = &snapshot->forecast7;
+  for (int day = 0; day < 7; ++day) {
+    f7->temperature_2m_max[day] = forecast_encode_temperature(26 - day);
+    f7->temperature_2m_min[day] = forecast_encode_temperature(14 - day / 2);
+    f7->sunrise[day] = 5 * 60 + 47 + day / 3;
+    f7->sunset[day] = 21 * 60 + 55 + day / 3;
+    f7->precipitation_probability_max[day] =
+        forecast_encode_percent(day * 13 % 100);
+    f7->uv_index_max[day] = forecast_encode_uv(8 - day * 0.5f);
+    f7->weather_code[day] = codes[day];
+  }
+  for (int h = 0; h < 2; ++h) {
+    snapshot->forecast_tmr.temperature_2m[h] = forecast_encode_temperature(17);
+    snapshot->forecast_tmr.precipitation_probability[h] =
+        forecast_encode_percent(20);
+    snapshot->forecast_tmr.uv_index[h] = forecast_encode_uv(0);
+    snapshot->forecast_tmr.weather_code[h] = 3;
+  }
+  snapshot->fetched_at = fixture_now() - 600;
+}
+
+void fixture_history(HistoryStore *history, time_t now, int hours) {
+  time_t start = now - hours * 3600;
+  start -= start % HISTORY_RAW_PERIOD_S;
+  for (time_t t = start; t <= now; t += HISTORY_RAW_PERIOD_S) {
+    float hour = (t % 86400) / 3600.0f;
+    float values[HistoryMetricMax];
+    values[HistoryPm25] = 8 + 6 * sinf(hour * (float)M_PI / 6);
+    values[HistoryTemperature] = 22 + 2 * sinf((hour - 9) * (float)M_PI / 12);
+    values[HistoryHumidity] = 50 - 10 * sinf((hour - 9) * (float)M_PI / 12);
+    history->insert(t, values);
+  }
+}
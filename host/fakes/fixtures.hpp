@@ -0,0 +1,16 @@
+#pragma once
+
+#include "forecast.hpp"
+#include "history.hpp"
+#include <time.h>
+
+// The same plausible data on every run, for the page tests and benchmarks.
+//
+// The wall clock with TZ set to UTC: HistoryStore::latest only reports
+// readings younger than a few periods of it.
+time_t fixture_now(void);
+// A summer day: warm afternoon, showers in the evening, a week of mixed
+// weather after it.
+void fixture_weather(WeatherSnapshot *snapshot);
+// One reading every HISTORY_RAW_PERIOD_S over the hours before now.
+void fixture_history(HistoryStore *history, time_t now, int hours);
@@ -0,0 +1,119 @@
+// The LovyanGFX stand-in of M5Unified.h and its PNG dump.
+#include <M5Unified.h>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+
+namespace lgfx {
+
+static uint16_t swap(uint16_t value) {
+  return (uint16_t)(value << 8 | value >> 8);
+}
+
+LovyanGFX::LovyanGFX(int32_t width, int32_t height) {
+  resize(width, height);
+}
+
+void LovyanGFX::resize(int32_t width, int32_t height) {
+  _width = width;
+  _height = height;
+  _pixels.assign((size_t)width * height, 0);
+}
+
+void LovyanGFX::fillRect(int32_t x, int32_t y, int32_t w, int32_t h,
+                         uint16_t color) {
+  int32_t left = std::max(x, 0), top = std::max(y, 0);
+  int32_t right = std::min(x + w, _width), bottom = std::min(y + h, _height);
+  for (int32_t row = top; row < bottom; ++row) {
+    std::fill(&_pixels[(size_t)row * _width + left],
+              &_pixels[(size_t)row * _width + std::max(left, right)],
+              swap(color));
+  }
+  if (right > left && bottom > top) {
+    _stats.pixels_filled += (uint64_t)(right - left) * (bottom - top);
+  }
+}
+
+void LovyanGFX::pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h,
+                             const swap565_t *data) {
+  for (int32_t row = 0; row < h; ++row) {
+    if (y + row < 0 || y + row >= _height) {
+      continue;
+    }
+    for (int32_t col = 0; col < w; ++col) {
+      if (x + col >= 0 && x + col < _width) {
+        _pixels[(size_t)(y + row) * _width + x + col] =
+            data[(size_t)row * w + col].raw;
+      }
+    }
+  }
+  _stats.pushes++;
+  _stats.pixels_pushed += (uint64_t)w * h;
+}
+
+uint16_t LovyanGFX::readPixel(int32_t x, int32_t y) const {
+  return swap(_pixels[(size_t)y * _width + x]);
+}
+
+static void chunk(FILE *file, const char *type, const uint8_t *data,
+                  uint32_t length) {
+  uint8_t header[8] = {
+      (uint8_t)(length >> 24), (uint8_t)(length >> 16),
+      (uint8_t)(length >> 8),  (uint8_t)length,
+  };
+  memcpy(header + 4, type, 4);
+  uLong crc = crc32(crc32(0, header + 4, 4), data, length);
+  uint8_t trailer[4] = {
+      (uint8_t)(crc >> 24),
+      (uint8_t)(crc >> 16),
+      (uint8_t)(crc >> 8),
+      (uint8_t)crc,
+  };
+  fwrite(header, 1, sizeof(header), file);
+  fwrite(data, 1, length, file);
+  fwrite(trailer, 1, sizeof(trailer), file);
+}
+
+bool LovyanGFX::writePng(const char *path) const {
+  // Each row is a filter byte, 0 for none, then RGB888
+  std::vector<uint8_t> raw;
+  raw.reserve((size_t)_height * (_width * 3 + 1));
+  for (int32_t y = 0; y < _height; ++y) {
+    raw.push_back(0);
+    for (int32_t x = 0; x < _width; ++x) {
+      uint16_t color = readPixel(x, y);
+      raw.push_back((color >> 11) * 255 / 31);
+      raw.push_back(((color >> 5) & 0x3f) * 255 / 63);
+      raw.push_back((color & 0x1f) * 255 / 31);
+    }
+  }
+  uLongf packed_length = compressBound(raw.size());
+  std::vector<uint8_t> packed(packed_length);
+  if (compress(packed.data(), &packed_length, raw.data(), raw.size()) !=
+      Z_OK) {
+    return false;
+  }
+  FILE *file = fopen(path, "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  static const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a,
+                                      '\n'};
+  uint8_t ihdr[13] = {
+      (uint8_t)(_width >> 24),  (uint8_t)(_width >> 16),
+      (uint8_t)(_width >> 8),   (uint8_t)_width,
+      (uint8_t)(_height >> 24), (uint8_t)(_height >> 16),
+      (uint8_t)(_height >> 8),  (uint8_t)_height,
+      8, // bits per channel
+      2, // RGB
+      0,  0, 0,
+  };
+  fwrite(signature, 1, sizeof(signature), file);
+  chunk(file, "IHDR", ihdr, sizeof(ihdr));
+  chunk(file, "IDAT", packed.data(), packed_length);
+  chunk(file, "IEND", reinterpret_cast<const uint8_t *>(""), 0);
+  return fclose(file) == 0;
+}
+
+} // namespace lgfx
@@ -0,0 +1,115 @@
+// Semaphores and tasks of freertos/ on the standard library.
+#include <chrono>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <mutex>
+#include <thread>
+
+// Interrupts off on both cores, as far as the host threads can tell
+static std::recursive_mutex critical;
+
+void vPortEnterCritical(portMUX_TYPE *) { critical.lock(); }
+
+void vPortExitCritical(portMUX_TYPE *) { critical.unlock(); }
+
+static SemaphoreHandle_t create(StaticSemaphore_t *buffer, UBaseType_t count) {
+  buffer->count = count;
+  buffer->max = 1;
+  return buffer;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer) {
+  return create(buffer, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+  return create(new HostSemaphore(), 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+  return create(new HostSemaphore(), 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer) {
+  return create(buffer, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(semaphore->mutex);
+  auto available = [semaphore] { return semaphore->count > 0; };
+  if (ticks == portMAX_DELAY) {
+    semaphore->available.wait(lock, available);
+  } else if (!semaphore->available.wait_for(
+                 lock, std::chrono::milliseconds(ticks), available)) {
+    return pdFALSE;
+  }
+  semaphore->count--;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  std::lock_guard<std::mutex> lock(semaphore->mutex);
+  if (semaphore->count >= semaphore->max) {
+    return pdFALSE;
+  }
+  semaphore->count++;
+  semaphore->available.notify_one();
+  return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) { delete semaphore; }
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *name,
+                                   uint32_t stack_depth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core) {
+  (void)name, (void)stack_depth, (void)priority, (void)core;
+  std::thread(task, arg).detach();
+  if (handle) {
+    *handle = nullptr;
+  }
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char *name,
+                       uint32_t stack_depth, void *arg, UBaseType_t priority,
+                       TaskHandle_t *handle) {
+  return xTaskCreatePinnedToCore(task, name, stack_depth, arg, priority,
+                                 handle, tskNO_AFFINITY);
+}
+
+TickType_t xTaskGetTickCount(void) {
+  static const auto start = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t period) {
+  *previous_wake += period;
+  TickType_t now = xTaskGetTickCount();
+  if ((int32_t)(*previous_wake - now) > 0) {
+    vTaskDelay(*previous_wake - now);
+  }
+}
+
+TaskHandle_t xTaskGetHandle(const char *name) {
+  (void)name;
+  return nullptr;
+}
+
+// Any address unique to the thread tells the tasks apart
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+  static thread_local char self;
+  return reinterpret_cast<TaskHandle_t>(&self);
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  (void)task;
+  return 0;
+}
@@ -0,0 +1,111 @@
+#include "http_fake.hpp"
+#include <algorithm>
+#include <esp_timer.h>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <string.h>
+#include <vector>
+
+typedef struct Recorded {
+  int status;
+  std::vector<uint8_t> body;
+} Recorded;
+
+static std::map<std::string, Recorded> responses;
+static std::string last_url;
+static HttpClientStats stats = {};
+
+void http_fake_respond(const char *url_prefix, int status, const void *body,
+                       size_t length) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(body);
+  responses[url_prefix] = {status, std::vector<uint8_t>(bytes, bytes + length)};
+}
+
+bool http_fake_respond_file(const char *url_prefix, int status,
+                            const char *path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  std::vector<uint8_t> body((std::istreambuf_iterator<char>(file)),
+                            std::istreambuf_iterator<char>());
+  http_fake_respond(url_prefix, status, body.data(), body.size());
+  return true;
+}
+
+void http_fake_reset(void) {
+  responses.clear();
+  last_url.clear();
+  stats = {};
+}
+
+size_t http_fake_requests(void) { return stats.requests; }
+
+const char *http_fake_last_url(void) { return last_url.c_str(); }
+
+static const Recorded *match(const char *url) {
+  const Recorded *best = nullptr;
+  size_t best_length = 0;
+  for (const auto &entry : responses) {
+    const std::string &prefix = entry.first;
+    if (prefix.size() >= best_length &&
+        strncmp(url, prefix.c_str(), prefix.size()) == 0) {
+      best = &entry.second;
+      best_length = prefix.size();
+    }
+  }
+  return best;
+}
+
+static esp_err_t get(const char *url, uint8_t *buffer, size_t size,
+                     HttpBodyCb body_cb, void *arg, HttpResponse *response) {
+  int64_t start_us = esp_timer_get_time();
+  *response = {};
+  last_url = url;
+  stats.requests++;
+  const Recorded *recorded = match(url);
+  if (recorded == nullptr) {
+    stats.errors++;
+    return ESP_FAIL;
+  }
+  const std::vector<uint8_t> &body = recorded->body;
+  size_t offset = 0;
+  if (body_cb == nullptr) {
+    offset = std::min(size, body.size());
+    memcpy(buffer, body.data(), offset);
+  } else {
+    while (offset < body.size()) {
+      size_t chunk = std::min(size, body.size() - offset);
+      memcpy(buffer, body.data() + offset, chunk);
+      offset += chunk;
+      if (!body_cb(buffer, chunk, arg)) {
+        break;
+      }
+    }
+  }
+  response->status = recorded->status;
+  response->length = offset;
+  response->truncated = offset < body.size();
+  response->timing.total_us = esp_timer_get_time() - start_us;
+  response->timing.body_us = response->timing.total_us;
+  response->timing.reused = stats.requests > 1;
+  stats.truncated += response->truncated;
+  return ESP_OK;
+}
+
+esp_err_t http_client_get(const char *url, uint8_t *buffer, size_t size,
+                          HttpResponse *response) {
+  return get(url, buffer, size, nullptr, nullptr, response);
+}
+
+esp_err_t http_client_stream(const char *url, uint8_t *buffer, size_t size,
+                             HttpBodyCb body_cb, void *arg,
+                             HttpResponse *response) {
+  return get(url, buffer, size, body_cb, arg, response);
+}
+
+HttpClientStats http_client_stats(void) { return stats; }
+
+void http_client_log_stats(void) {}
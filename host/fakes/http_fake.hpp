@@ -0,0 +1,18 @@
+#pragma once
+
+#include "http_client.hpp"
+#include <stddef.h>
+#include <stdint.h>
+
+// Recorded-payload responder behind http_client.hpp: a request gets the
+// response registered for the longest prefix of its URL, a URL nothing
+// matches fails like an unreachable host. Responses stay until reset.
+void http_fake_respond(const char *url_prefix, int status, const void *body,
+                       size_t length);
+// Same with the body read from a file, false if it cannot be read.
+bool http_fake_respond_file(const char *url_prefix, int status,
+                            const char *path);
+void http_fake_reset(void);
+size_t http_fake_requests(void);
+// URL of the last request, "" before the first.
+const char *http_fake_last_url(void);
@@ -0,0 +1,156 @@
+#include "nvs_fake.hpp"
+#include <map>
+#include <mutex>
+#include <nvs_flash.h>
+#include <string>
+#include <string.h>
+#include <vector>
+
+typedef std::map<std::string, std::vector<uint8_t>> Namespace;
+
+typedef struct Handle {
+  std::string name_space;
+  bool writable;
+} Handle;
+
+static std::mutex lock;
+static std::map<std::string, Namespace> namespaces;
+static std::map<nvs_handle_t, Handle> handles;
+static nvs_handle_t next_handle = 1;
+static NvsFakeStats stats = {};
+static esp_err_t commit_error = ESP_OK;
+
+void nvs_fake_reset(void) {
+  std::lock_guard<std::mutex> guard(lock);
+  namespaces.clear();
+  handles.clear();
+  stats = {};
+  commit_error = ESP_OK;
+}
+
+void nvs_fake_put(const char *name_space, const char *key, const void *value,
+                  size_t length) {
+  std::lock_guard<std::mutex> guard(lock);
+  const uint8_t *bytes = static_cast<const uint8_t *>(value);
+  namespaces[name_space][key].assign(bytes, bytes + length);
+}
+
+bool nvs_fake_has(const char *name_space, const char *key) {
+  std::lock_guard<std::mutex> guard(lock);
+  auto found = namespaces.find(name_space);
+  return found != namespaces.end() && found->second.count(key) != 0;
+}
+
+void nvs_fake_fail_commits(esp_err_t err) {
+  std::lock_guard<std::mutex> guard(lock);
+  commit_error = err;
+}
+
+NvsFakeStats nvs_fake_stats(void) {
+  std::lock_guard<std::mutex> guard(lock);
+  return stats;
+}
+
+esp_err_t nvs_open(const char *name_space, nvs_open_mode_t mode,
+                   nvs_handle_t *handle) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (strlen(name_space) > 15) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (mode == NVS_READONLY && namespaces.count(name_space) == 0) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  namespaces[name_space];
+  *handle = next_handle++;
+  handles[*handle] = {name_space, mode == NVS_READWRITE};
+  stats.opens++;
+  return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+  std::lock_guard<std::mutex> guard(lock);
+  handles.erase(handle);
+}
+
+static Handle *find(nvs_handle_t handle) {
+  auto found = handles.find(handle);
+  return found == handles.end() ? nullptr : &found->second;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out,
+                       size_t *length) {
+  std::lock_guard<std::mutex> guard(lock);
+  Handle *open = find(handle);
+  if (open == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  stats.reads++;
+  Namespace &blobs = namespaces[open->name_space];
+  auto found = blobs.find(key);
+  if (found == blobs.end()) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  const std::vector<uint8_t> &blob = found->second;
+  if (out == nullptr) {
+    *length = blob.size();
+    return ESP_OK;
+  }
+  if (*length < blob.size()) {
+    return ESP_ERR_NVS_INVALID_LENGTH;
+  }
+  memcpy(out, blob.data(), blob.size());
+  *length = blob.size();
+  return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key,
+                       const void *value, size_t length) {
+  std::lock_guard<std::mutex> guard(lock);
+  Handle *open = find(handle);
+  if (open == nullptr || !open->writable) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  const uint8_t *bytes = static_cast<const uint8_t *>(value);
+  namespaces[open->name_space][key].assign(bytes, bytes + length);
+  stats.writes++;
+  stats.bytes_written += length;
+  return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+  std::lock_guard<std::mutex> guard(lock);
+  Handle *open = find(handle);
+  if (open == nullptr || !open->writable) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  stats.erases++;
+  return namespaces[open->name_space].erase(key) ? ESP_OK
+                                                 : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+  std::lock_guard<std::mutex> guard(lock);
+  Handle *open = find(handle);
+  if (open == nullptr || !open->writable) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  stats.erases++;
+  namespaces[open->name_space].clear();
+  return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (find(handle) == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  stats.commits++;
+  return commit_error;
+}
+
+esp_err_t nvs_flash_init(void) { return ESP_OK; }
+
+esp_err_t nvs_flash_erase(void) {
+  nvs_fake_reset();
+  return ESP_OK;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <nvs.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// What the app asked of NVS since the last reset. A set or an erase is a
+// flash write on the device, a commit is cheap.
+typedef struct NvsFakeStats {
+  uint32_t opens;
+  uint32_t reads;
+  uint32_t writes;
+  uint32_t erases;
+  uint32_t commits;
+  size_t bytes_written;
+} NvsFakeStats;
+
+// In-memory NVS: namespaces of blobs, kept until nvs_fake_reset(). Handles
+// opened read-only cannot write, reading a missing namespace fails like on
+// the device.
+void nvs_fake_reset(void);
+// Writes a blob behind the app's back, as an older firmware would have.
+void nvs_fake_put(const char *name_space, const char *key, const void *value,
+                  size_t length);
+bool nvs_fake_has(const char *name_space, const char *key);
+// Makes every commit fail with err, ESP_OK to stop. Cleared by a reset.
+void nvs_fake_fail_commits(esp_err_t err);
+NvsFakeStats nvs_fake_stats(void);
@@ -0,0 +1,98 @@
+#include "open_meteo_fixture.hpp"
+#include "weather_api_generated.h"
+#include <flatbuffers/flatbuffers.h>
+#include <math.h>
+
+using namespace openmeteo_sdk;
+
+typedef flatbuffers::Offset<VariableWithValues> VariableOffset;
+
+static VariableOffset floats(flatbuffers::FlatBufferBuilder &fbb,
+                             Variable variable,
+                             const std::vector<float> &values,
+                             bool aggregated = false,
+                             Aggregation aggregation = Aggregation_maximum) {
+  auto data = fbb.CreateVector(values);
+  VariableWithValuesBuilder builder(fbb);
+  builder.add_variable(variable);
+  if (aggregated) {
+    builder.add_aggregation(aggregation);
+  }
+  builder.add_values(data);
+  return builder.Finish();
+}
+
+static VariableOffset times(flatbuffers::FlatBufferBuilder &fbb,
+                            Variable variable,
+                            const std::vector<int64_t> &values) {
+  auto data = fbb.CreateVector(values);
+  VariableWithValuesBuilder builder(fbb);
+  builder.add_variable(variable);
+  builder.add_values_int64(data);
+  return builder.Finish();
+}
+
+std::vector<uint8_t> fixture_forecast_response(time_t start, int hours,
+                                               int days) {
+  flatbuffers::FlatBufferBuilder fbb(16 * 1024);
+  std::vector<float> temperature, rain, code, uv;
+  for (int h = 0; h < hours; ++h) {
+    int hour = h % 24;
+    temperature.push_back(19 + 7 * sinf((hour - 9) * (float)M_PI / 12));
+    rain.push_back(hour >= 18 ? 70 : 5);
+    code.push_back(hour >= 18 ? 80 : 2);
+    uv.push_back(hour >= 6 && hour <= 20 ? 7 - abs(hour - 13) * 0.9f : 0);
+  }
+  std::vector<VariableOffset> hourly_variables = {
+      floats(fbb, Variable_temperature, temperature),
+      floats(fbb, Variable_precipitation_probability, rain),
+      floats(fbb, Variable_weather_code, code),
+      floats(fbb, Variable_uv_index, uv),
+  };
+  auto hourly_vector = fbb.CreateVector(hourly_variables);
+  VariablesWithTimeBuilder hourly(fbb);
+  hourly.add_time(start);
+  hourly.add_time_end(start + (int64_t)hours * 3600);
+  hourly.add_interval(3600);
+  hourly.add_variables(hourly_vector);
+  auto hourly_offset = hourly.Finish();
+
+  std::vector<float> daily_code, high, low, rain_max, uv_max;
+  std::vector<int64_t> sunrise, sunset;
+  for (int day = 0; day < days; ++day) {
+    int64_t midnight = start + 24 * 3600 + (int64_t)day * 86400;
+    daily_code.push_back(day % 4 == 3 ? 61 : day % 3);
+    high.push_back(26 - day % 7);
+    low.push_back(14 - day % 5);
+    rain_max.push_back(day * 13 % 100);
+    uv_max.push_back(8 - day % 7 * 0.5f);
+    sunrise.push_back(midnight + 5 * 3600 + 47 * 60);
+    sunset.push_back(midnight + 21 * 3600 + 55 * 60);
+  }
+  std::vector<VariableOffset> daily_variables = {
+      floats(fbb, Variable_weather_code, daily_code),
+      floats(fbb, Variable_temperature, high, true, Aggregation_maximum),
+      floats(fbb, Variable_temperature, low, true, Aggregation_minimum),
+      floats(fbb, Variable_precipitation_probability, rain_max, true,
+             Aggregation_maximum),
+      floats(fbb, Variable_uv_index, uv_max, true, Aggregation_maximum),
+      times(fbb, Variable_sunrise, sunrise),
+      times(fbb, Variable_sunset, sunset),
+  };
+  auto daily_vector = fbb.CreateVector(daily_variables);
+  VariablesWithTimeBuilder daily(fbb);
+  daily.add_time(start + 24 * 3600);
+  daily.add_time_end(start + 24 * 3600 + (int64_t)days * 86400);
+  daily.add_interval(86400);
+  daily.add_variables(daily_vector);
+  auto daily_offset = daily.Finish();
+
+  WeatherApiResponseBuilder response(fbb);
+  response.add_latitude(48.85f);
+  response.add_longitude(2.35f);
+  response.add_hourly(hourly_offset);
+  response.add_daily(daily_offset);
+  fbb.FinishSizePrefixed(response.Finish());
+  return std::vector<uint8_t>(fbb.GetBufferPointer(),
+                              fbb.GetBufferPointer() + fbb.GetSize());
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+
+// A size prefixed WeatherApiResponse shaped like the one Open-Meteo sends
+// the weather refresh: the four hourly variables from start, one value an
+// hour, and the seven daily ones. Needs the esp32-open-meteo library.
+std::vector<uint8_t> fixture_forecast_response(time_t start, int hours,
+                                               int days);
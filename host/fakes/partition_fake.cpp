@@ -0,0 +1,170 @@
+#include "partition_fake.hpp"
+#include <algorithm>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#define ERASED 0xFF
+
+typedef struct Image {
+  esp_partition_t partition;
+  uint8_t *data;
+  size_t size;
+} Image;
+
+static std::vector<Image *> images;
+static size_t power_budget = SIZE_MAX;
+static PartitionFakeStats stats = {};
+
+const esp_partition_t *partition_fake_add(const char *label,
+                                          esp_partition_type_t type,
+                                          esp_partition_subtype_t subtype,
+                                          size_t size, const char *path) {
+  void *data = MAP_FAILED;
+  if (path) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+      return nullptr;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    if ((size_t)st.st_size < size) {
+      // New bytes read as erased flash
+      std::vector<uint8_t> erased(size - st.st_size, ERASED);
+      pwrite(fd, erased.data(), erased.size(), st.st_size);
+    }
+    data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+  } else {
+    data = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data != MAP_FAILED) {
+      memset(data, ERASED, size);
+    }
+  }
+  if (data == MAP_FAILED) {
+    return nullptr;
+  }
+  Image *image = new Image();
+  image->partition.type = type;
+  image->partition.subtype = subtype;
+  image->partition.size = size;
+  image->partition.erase_size = SPI_FLASH_SEC_SIZE;
+  strncpy(image->partition.label, label, sizeof(image->partition.label) - 1);
+  image->data = static_cast<uint8_t *>(data);
+  image->size = size;
+  images.push_back(image);
+  return &image->partition;
+}
+
+void partition_fake_remove_all(void) {
+  for (Image *image : images) {
+    munmap(image->data, image->size);
+    delete image;
+  }
+  images.clear();
+  power_budget = SIZE_MAX;
+}
+
+void partition_fake_cut_power_after(size_t bytes) { power_budget = bytes; }
+
+PartitionFakeStats partition_fake_stats(void) { return stats; }
+
+void partition_fake_reset_stats(void) { stats = {}; }
+
+static Image *find(const esp_partition_t *partition) {
+  for (Image *image : images) {
+    if (&image->partition == partition) {
+      return image;
+    }
+  }
+  return nullptr;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type,
+                                                esp_partition_subtype_t subtype,
+                                                const char *label) {
+  for (Image *image : images) {
+    if ((type == ESP_PARTITION_TYPE_ANY || image->partition.type == type) &&
+        (subtype == ESP_PARTITION_SUBTYPE_ANY ||
+         image->partition.subtype == subtype) &&
+        (label == nullptr || strcmp(image->partition.label, label) == 0)) {
+      return &image->partition;
+    }
+  }
+  return nullptr;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition,
+                             size_t src_offset, void *dst, size_t size) {
+  Image *image = find(partition);
+  if (image == nullptr || src_offset + size > image->size) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  memcpy(dst, image->data + src_offset, size);
+  stats.reads++;
+  stats.bytes_read += size;
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition,
+                              size_t dst_offset, const void *src,
+                              size_t size) {
+  Image *image = find(partition);
+  if (image == nullptr || dst_offset + size > image->size) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  if (power_budget == 0) {
+    return ESP_FAIL;
+  }
+  size_t landed = std::min(size, power_budget);
+  if (power_budget != SIZE_MAX) {
+    power_budget -= landed;
+  }
+  const uint8_t *bytes = static_cast<const uint8_t *>(src);
+  for (size_t i = 0; i < landed; ++i) {
+    image->data[dst_offset + i] &= bytes[i];
+  }
+  stats.writes++;
+  stats.bytes_written += landed;
+  return landed == size ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition,
+                                    size_t offset, size_t size) {
+  Image *image = find(partition);
+  if (image == nullptr || offset + size > image->size) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  if (offset % SPI_FLASH_SEC_SIZE || size % SPI_FLASH_SEC_SIZE) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (power_budget == 0) {
+    return ESP_FAIL;
+  }
+  memset(image->data + offset, ERASED, size);
+  stats.erases++;
+  stats.bytes_erased += size;
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset,
+                             size_t size, esp_partition_mmap_memory_t memory,
+                             const void **out_ptr,
+                             esp_partition_mmap_handle_t *out_handle) {
+  (void)memory;
+  Image *image = find(partition);
+  if (image == nullptr || offset + size > image->size) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  *out_ptr = image->data + offset;
+  *out_handle = 1;
+  return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle) {
+  (void)handle;
+}
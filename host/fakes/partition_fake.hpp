@@ -0,0 +1,30 @@
+#pragma once
+
+#include <esp_partition.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct PartitionFakeStats {
+  uint32_t reads;
+  uint32_t writes;
+  uint32_t erases;
+  uint64_t bytes_read;
+  uint64_t bytes_written;
+  uint64_t bytes_erased;
+} PartitionFakeStats;
+
+// Adds a partition backed by an image file, mapped in memory so the
+// esp_partition_mmap view follows the writes. A missing or short image is
+// created erased. Without a path the image only lives in memory.
+const esp_partition_t *partition_fake_add(const char *label,
+                                          esp_partition_type_t type,
+                                          esp_partition_subtype_t subtype,
+                                          size_t size, const char *path);
+// Unmaps every image, the files stay.
+void partition_fake_remove_all(void);
+// Power cut: after bytes more bytes have been written, the write in flight
+// stops halfway and every write or erase after it fails. SIZE_MAX restores
+// the power.
+void partition_fake_cut_power_after(size_t bytes);
+PartitionFakeStats partition_fake_stats(void);
+void partition_fake_reset_stats(void);
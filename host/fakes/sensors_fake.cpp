@@ -0,0 +1,42 @@
+#include "sensors_fake.hpp"
+#include <math.h>
+#include <vector>
+
+static std::vector<SensorReading> script;
+static size_t reads = 0;
+
+void sensors_fake_script(const SensorReading *readings, size_t count) {
+  script.assign(readings, readings + count);
+  reads = 0;
+}
+
+size_t sensors_fake_reads(void) { return reads; }
+
+static const SensorReading *current() {
+  return script.empty() || reads == 0
+             ? nullptr
+             : &script[(reads - 1) % script.size()];
+}
+
+bool PM25::get(PMSAQIdata *data) {
+  reads++;
+  const SensorReading *reading = current();
+  if (reading == nullptr || isnan(reading->pm25)) {
+    return false;
+  }
+  *data = {};
+  data->pm25_standard = (uint16_t)reading->pm25;
+  return true;
+}
+
+esp_err_t sht3x_get_humiture(sht3x_handle_t sensor, float *temperature,
+                             float *humidity) {
+  (void)sensor;
+  const SensorReading *reading = current();
+  if (reading == nullptr || isnan(reading->temperature)) {
+    return ESP_FAIL;
+  }
+  *temperature = reading->temperature;
+  *humidity = reading->humidity;
+  return ESP_OK;
+}
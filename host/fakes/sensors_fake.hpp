@@ -0,0 +1,17 @@
+#pragma once
+
+#include <pm25.hpp>
+#include <sht3x.h>
+#include <stddef.h>
+
+// One scripted reading, NAN for a sensor that does not answer.
+typedef struct SensorReading {
+  float pm25;
+  float temperature;
+  float humidity;
+} SensorReading;
+
+// The readings PM25::get and sht3x_get_humiture return, in a loop. Each
+// PM25::get moves to the next reading, the SHT3x reads the same one.
+void sensors_fake_script(const SensorReading *readings, size_t count);
+size_t sensors_fake_reads(void);
@@ -0,0 +1,100 @@
+#include "sntp_fake.hpp"
+#include <mutex>
+#include <sys/time.h>
+
+// The link wraps these three for every unit, see CMakeLists.txt
+extern "C" int __real_gettimeofday(struct timeval *tv, void *tz);
+
+static std::mutex mutex;
+static SntpFakeStats stats;
+static int64_t reply_offset_us = 0;
+static sntp_sync_status_t sync_status = SNTP_SYNC_STATUS_RESET;
+
+static int64_t app_now_us() {
+  struct timeval host;
+  __real_gettimeofday(&host, nullptr);
+  std::lock_guard<std::mutex> guard(mutex);
+  return (int64_t)host.tv_sec * 1000000 + host.tv_usec + stats.shift_us;
+}
+
+void sntp_fake_reply(int64_t offset_us) {
+  std::lock_guard<std::mutex> guard(mutex);
+  reply_offset_us = offset_us;
+}
+
+void sntp_fake_advance(int64_t elapsed_us) {
+  std::lock_guard<std::mutex> guard(mutex);
+  stats.shift_us += elapsed_us;
+}
+
+SntpFakeStats sntp_fake_stats(void) {
+  std::lock_guard<std::mutex> guard(mutex);
+  return stats;
+}
+
+void sntp_fake_reset(void) {
+  std::lock_guard<std::mutex> guard(mutex);
+  stats = {};
+  reply_offset_us = 0;
+  sync_status = SNTP_SYNC_STATUS_RESET;
+}
+
+extern "C" int __wrap_gettimeofday(struct timeval *tv, void *tz) {
+  (void)tz;
+  int64_t now_us = app_now_us();
+  tv->tv_sec = (time_t)(now_us / 1000000);
+  tv->tv_usec = (suseconds_t)(now_us % 1000000);
+  return 0;
+}
+
+extern "C" int __wrap_settimeofday(const struct timeval *tv,
+                                   const void *tz) {
+  (void)tz;
+  int64_t target_us = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+  int64_t now_us = app_now_us();
+  std::lock_guard<std::mutex> guard(mutex);
+  stats.shift_us += target_us - now_us;
+  stats.steps++;
+  return 0;
+}
+
+// Slews complete at once: the next read already has the whole delta
+extern "C" int __wrap_adjtime(const struct timeval *delta,
+                              struct timeval *olddelta) {
+  std::lock_guard<std::mutex> guard(mutex);
+  stats.shift_us += (int64_t)delta->tv_sec * 1000000 + delta->tv_usec;
+  stats.slews++;
+  if (olddelta) {
+    *olddelta = {};
+  }
+  return 0;
+}
+
+esp_err_t esp_netif_sntp_init(const esp_sntp_config_t *config) {
+  (void)config;
+  int64_t offset_us;
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    stats.requests++;
+    offset_us = reply_offset_us;
+  }
+  int64_t ntp_us = app_now_us() + offset_us;
+  struct timeval tv = {
+      .tv_sec = (time_t)(ntp_us / 1000000),
+      .tv_usec = (suseconds_t)(ntp_us % 1000000),
+  };
+  sntp_sync_time(&tv);
+  return ESP_OK;
+}
+
+void esp_netif_sntp_deinit(void) {}
+
+void sntp_set_sync_status(sntp_sync_status_t status) {
+  std::lock_guard<std::mutex> guard(mutex);
+  sync_status = status;
+}
+
+sntp_sync_status_t sntp_get_sync_status(void) {
+  std::lock_guard<std::mutex> guard(mutex);
+  return sync_status;
+}
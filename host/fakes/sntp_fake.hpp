@@ -0,0 +1,24 @@
+#pragma once
+
+#include <esp_netif_sntp.h>
+#include <esp_sntp.h>
+#include <stdint.h>
+
+// NTP server and system clock behind esp_netif_sntp and sys/time.h. The app
+// reads and corrects its own clock, the host clock shifted by what it stepped
+// and slewed; the host clock itself is never set. A sync answers at once,
+// from inside esp_netif_sntp_init, with the app clock off by the offset.
+void sntp_fake_reply(int64_t offset_us);
+// Moves the app clock on, as if elapsed_us passed between two syncs.
+void sntp_fake_advance(int64_t elapsed_us);
+
+typedef struct SntpFakeStats {
+  uint32_t requests;
+  uint32_t steps;
+  uint32_t slews;
+  // Shift of the app clock from the host clock.
+  int64_t shift_us;
+} SntpFakeStats;
+
+SntpFakeStats sntp_fake_stats(void);
+void sntp_fake_reset(void);
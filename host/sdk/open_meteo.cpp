@@ -0,0 +1,67 @@
+#include "open_meteo.hpp"
+
+namespace OM_SDK {
+
+const char *EnumNamesWeatherCode(WeatherCode code) {
+  switch (code) {
+  case clear_sky:
+    return "Clear sky";
+  case mainly_clear:
+    return "Mainly clear";
+  case partly_cloudy:
+    return "Partly cloudy";
+  case overcast:
+    return "Overcast";
+  case fog:
+    return "Fog";
+  case depositing_rime_fog:
+    return "Depositing rime fog";
+  case drizzle_light:
+    return "Light drizzle";
+  case drizzle_moderate:
+    return "Moderate drizzle";
+  case drizzle_dense:
+    return "Dense drizzle";
+  case freezing_drizzle_light:
+    return "Light freezing drizzle";
+  case freezing_drizzle_dense:
+    return "Dense freezing drizzle";
+  case rain_slight:
+    return "Slight rain";
+  case rain_moderate:
+    return "Moderate rain";
+  case rain_heavy:
+    return "Heavy rain";
+  case freezing_rain_light:
+    return "Light freezing rain";
+  case freezing_rain_heavy:
+    return "Heavy freezing rain";
+  case snow_fall_slight:
+    return "Slight snow fall";
+  case snow_fall_moderate:
+    return "Moderate snow fall";
+  case snow_fall_heavy:
+    return "Heavy snow fall";
+  case snow_grains:
+    return "Snow grains";
+  case rain_showers_slight:
+    return "Slight rain showers";
+  case rain_showers_moderate:
+    return "Moderate rain showers";
+  case rain_showers_violent:
+    return "Violent rain showers";
+  case snow_showers_slight:
+    return "Slight snow showers";
+  case snow_showers_heavy:
+    return "Heavy snow showers";
+  case thunderstorm:
+    return "Thunderstorm";
+  case thunderstorm_slight_hail:
+    return "Thunderstorm with slight hail";
+  case thunderstorm_heavy_hail:
+    return "Thunderstorm with heavy hail";
+  }
+  return "Unknown";
+}
+
+} // namespace OM_SDK
@@ -0,0 +1,44 @@
+#pragma once
+
+// Host stand-in for the weather codes of esp32-open-meteo, used when the
+// library is not found. Enough for the packed forecast and the pages; the
+// decoding of responses needs the real library and flatbuffers.
+
+#include <stdint.h>
+
+namespace OM_SDK {
+
+enum WeatherCode : uint8_t {
+  clear_sky = 0,
+  mainly_clear = 1,
+  partly_cloudy = 2,
+  overcast = 3,
+  fog = 45,
+  depositing_rime_fog = 48,
+  drizzle_light = 51,
+  drizzle_moderate = 53,
+  drizzle_dense = 55,
+  freezing_drizzle_light = 56,
+  freezing_drizzle_dense = 57,
+  rain_slight = 61,
+  rain_moderate = 63,
+  rain_heavy = 65,
+  freezing_rain_light = 66,
+  freezing_rain_heavy = 67,
+  snow_fall_slight = 71,
+  snow_fall_moderate = 73,
+  snow_fall_heavy = 75,
+  snow_grains = 77,
+  rain_showers_slight = 80,
+  rain_showers_moderate = 81,
+  rain_showers_violent = 82,
+  snow_showers_slight = 85,
+  snow_showers_heavy = 86,
+  thunderstorm = 95,
+  thunderstorm_slight_hail = 96,
+  thunderstorm_heavy_hail = 99,
+};
+
+const char *EnumNamesWeatherCode(WeatherCode code);
+
+} // namespace OM_SDK
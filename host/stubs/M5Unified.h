@@ -0,0 +1,74 @@
+#pragma once
+
+// Host stand-in for the LovyanGFX surface the Screen draws on: an RGB565
+// framebuffer in the byte order of the M5Canvas buffers, with a PNG dump.
+// Only what the Screen uses: text comes from the glyph atlas, as on the
+// device.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#define BLACK 0x0000
+#define DARKGREY 0x7BEF
+#define WHITE 0xFFFF
+
+namespace lgfx {
+
+// RGB565 with the two bytes swapped, as it goes out on the SPI bus
+typedef struct swap565_t {
+  uint16_t raw;
+} swap565_t;
+
+typedef struct FramebufferStats {
+  uint64_t pixels_filled;
+  uint64_t pixels_pushed;
+  uint32_t pushes;
+} FramebufferStats;
+
+class LovyanGFX {
+public:
+  LovyanGFX(int32_t width, int32_t height);
+  virtual ~LovyanGFX() = default;
+  int32_t width() const { return _width; }
+  int32_t height() const { return _height; }
+  void startWrite() { _writing++; }
+  void endWrite() { _writing--; }
+  void fillScreen(uint16_t color) { fillRect(0, 0, _width, _height, color); }
+  void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color);
+  void pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h,
+                    const swap565_t *data);
+  void waitDMA() {}
+  // RGB565 at x, y.
+  uint16_t readPixel(int32_t x, int32_t y) const;
+  // Writes the framebuffer as an 8 bit RGB PNG, false on error.
+  bool writePng(const char *path) const;
+  const FramebufferStats &stats() const { return _stats; }
+
+protected:
+  int32_t _width;
+  int32_t _height;
+  std::vector<uint16_t> _pixels;
+
+  void resize(int32_t width, int32_t height);
+
+private:
+  int _writing = 0;
+  FramebufferStats _stats = {};
+};
+
+} // namespace lgfx
+
+class M5Canvas : public lgfx::LovyanGFX {
+public:
+  explicit M5Canvas(lgfx::LovyanGFX *parent) : LovyanGFX(0, 0) {
+    (void)parent;
+  }
+  void setColorDepth(int bits) { (void)bits; }
+  void *createSprite(int32_t width, int32_t height) {
+    resize(width, height);
+    return _pixels.data();
+  }
+  void fillSprite(uint16_t color) { fillScreen(color); }
+  void *getBuffer() { return _pixels.data(); }
+};
@@ -0,0 +1,8 @@
+#pragma once
+
+// Host stand-in, there are no memory regions to place things in.
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
@@ -0,0 +1,24 @@
+#pragma once
+
+// Host stand-in: a heap of fixed size, the numbers only feed gauges.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+size_t heap_caps_get_free_size(uint32_t caps);
+void *heap_caps_malloc(size_t size, uint32_t caps);
+
+#ifdef __cplusplus
+}
+#endif
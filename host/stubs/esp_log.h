@@ -0,0 +1,32 @@
+#pragma once
+
+// Host stand-in: logs go to stderr at or below host_log_level, errors only
+// by default so the benchmarks stay quiet. CLOCK_HOST_LOG=4 shows them all.
+
+#include <stdint.h>
+
+typedef enum esp_log_level_t {
+  ESP_LOG_NONE,
+  ESP_LOG_ERROR,
+  ESP_LOG_WARN,
+  ESP_LOG_INFO,
+  ESP_LOG_DEBUG,
+  ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void host_log(esp_log_level_t level, const char *tag, const char *format,
+              ...);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define ESP_LOGE(tag, ...) host_log(ESP_LOG_ERROR, tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) host_log(ESP_LOG_WARN, tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) host_log(ESP_LOG_INFO, tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) host_log(ESP_LOG_DEBUG, tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) host_log(ESP_LOG_VERBOSE, tag, __VA_ARGS__)
@@ -0,0 +1,21 @@
+#pragma once
+
+// Host stand-in for the address helpers of esp_netif.
+
+#include "esp_err.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct esp_ip6_addr {
+  uint32_t addr[4];
+  uint8_t zone;
+} esp_ip6_addr_t;
+
+esp_err_t esp_netif_str_to_ip6(const char *src, esp_ip6_addr_t *dest);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+
+// Host stand-in for esp_netif_sntp, answered by fakes/sntp_fake.hpp.
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct esp_sntp_config {
+  const char *servers[1];
+} esp_sntp_config_t;
+
+#define ESP_NETIF_SNTP_DEFAULT_CONFIG(server)                                  \
+  {                                                                            \
+    .servers = { server }                                                      \
+  }
+
+esp_err_t esp_netif_sntp_init(const esp_sntp_config_t *config);
+void esp_netif_sntp_deinit(void);
+
+#ifdef __cplusplus
+}
+#endif
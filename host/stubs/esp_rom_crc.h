@@ -0,0 +1,18 @@
+#pragma once
+
+// Host stand-in with the same results as the ROM functions: reflected
+// polynomials, the running value inverted on the way in and out so calls
+// chain.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+uint16_t esp_rom_crc16_le(uint16_t crc, const uint8_t *buf, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
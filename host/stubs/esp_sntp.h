@@ -0,0 +1,24 @@
+#pragma once
+
+// Host stand-in for the lwIP SNTP hooks the app touches, answered by
+// fakes/sntp_fake.hpp.
+
+#include <sys/time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  SNTP_SYNC_STATUS_RESET,
+  SNTP_SYNC_STATUS_COMPLETED,
+  SNTP_SYNC_STATUS_IN_PROGRESS,
+} sntp_sync_status_t;
+
+void sntp_set_sync_status(sntp_sync_status_t sync_status);
+sntp_sync_status_t sntp_get_sync_status(void);
+void sntp_sync_time(struct timeval *tv);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+// Host stand-in for the few FreeRTOS pieces the app modules use: semaphores
+// on a mutex and condition variable, tasks on detached threads, critical
+// sections on one process wide lock, one tick per millisecond.
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portNUM_PROCESSORS 2
+#define portTICK_PERIOD_MS 1
+#define configTICK_RATE_HZ 1000
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define tskNO_AFFINITY 0x7fffffff
+
+typedef struct portMUX_TYPE {
+  int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux) vPortExitCritical(mux)
+
+BaseType_t xPortGetCoreID(void);
+void vPortEnterCritical(portMUX_TYPE *mux);
+void vPortExitCritical(portMUX_TYPE *mux);
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct HostQueue *QueueHandle_t;
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "FreeRTOS.h"
+#include <condition_variable>
+#include <mutex>
+
+typedef struct HostSemaphore {
+  std::mutex mutex;
+  std::condition_variable available;
+  UBaseType_t count = 0;
+  UBaseType_t max = 1;
+} HostSemaphore;
+
+typedef HostSemaphore StaticSemaphore_t;
+typedef HostSemaphore *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer);
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
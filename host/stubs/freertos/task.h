@@ -0,0 +1,20 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct HostTask *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *arg);
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *name,
+                                   uint32_t stack_depth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core);
+BaseType_t xTaskCreate(TaskFunction_t task, const char *name,
+                       uint32_t stack_depth, void *arg, UBaseType_t priority,
+                       TaskHandle_t *handle);
+TickType_t xTaskGetTickCount(void);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t period);
+TaskHandle_t xTaskGetHandle(const char *name);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
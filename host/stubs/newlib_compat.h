@@ -0,0 +1,18 @@
+#pragma once
+
+// What newlib has and glibc lacks before 2.38, included in every unit.
+
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__GLIBC__) && __GLIBC__ == 2 && __GLIBC_MINOR__ < 38
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+size_t strlcpy(char *dst, const char *src, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
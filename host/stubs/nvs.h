@@ -0,0 +1,34 @@
+#pragma once
+
+// Host stand-in for the NVS blob API, backed by the in-memory store of
+// fakes/nvs_fake.hpp.
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum nvs_open_mode_t {
+  NVS_READONLY,
+  NVS_READWRITE,
+} nvs_open_mode_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t nvs_open(const char *name_space, nvs_open_mode_t mode,
+                   nvs_handle_t *handle);
+void nvs_close(nvs_handle_t handle);
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out,
+                       size_t *length);
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key,
+                       const void *value, size_t length);
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key);
+esp_err_t nvs_erase_all(nvs_handle_t handle);
+esp_err_t nvs_commit(nvs_handle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
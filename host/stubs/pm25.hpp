@@ -0,0 +1,17 @@
+#pragma once
+
+// Host stand-in for the PMSA003 driver, reads come from the script of
+// fakes/sensors_fake.hpp.
+
+#include <stdint.h>
+
+typedef struct PMSAQIdata {
+  uint16_t pm10_standard;
+  uint16_t pm25_standard;
+  uint16_t pm100_standard;
+} PMSAQIdata;
+
+class PM25 {
+public:
+  bool get(PMSAQIdata *data);
+};
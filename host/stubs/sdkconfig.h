@@ -0,0 +1,8 @@
+#pragma once
+
+// Host stand-in for the generated configuration, included in every unit
+// like the IDF build does through its headers.
+
+#define CONFIG_CLOCK_LOCATIONS "Paris:48.85,2.35;Tokyo:35.68,139.69"
+#define CONFIG_CLOCK_BRIGHTNESS_DEFAULT_VALUE 128
+#define CONFIG_CLOCK_IPGEOLOCATION_API_KEY "host"
@@ -0,0 +1,19 @@
+#pragma once
+
+// Host stand-in for the SHT3x driver, reads come from the script of
+// fakes/sensors_fake.hpp.
+
+#include "esp_err.h"
+
+typedef void *sht3x_handle_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t sht3x_get_humiture(sht3x_handle_t sensor, float *temperature,
+                             float *humidity);
+
+#ifdef __cplusplus
+}
+#endif
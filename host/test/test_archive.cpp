@@ -0,0 +1,201 @@
+#include "archive.hpp"
+#include "fixtures.hpp"
+#include "partition_fake.hpp"
+#include <gtest/gtest.h>
+#include <memory>
+#include <set>
+#include <string>
+#include <unistd.h>
+
+// Sample records take 16 bytes: 254 fit the first sector of a segment, after
+// the header, and 256 every other one.
+#define SAMPLES_PER_SEGMENT (254 + 15 * 256)
+
+class ArchiveTest : public ::testing::Test {
+protected:
+  std::string path;
+  std::unique_ptr<Archive> archive;
+
+  void SetUp() override {
+    path = std::string(HOST_OUTPUT_DIR "/") +
+           ::testing::UnitTest::GetInstance()->current_test_info()->name() +
+           ".img";
+    unlink(path.c_str());
+  }
+
+  void TearDown() override {
+    archive.reset();
+    partition_fake_remove_all();
+    unlink(path.c_str());
+  }
+
+  // Power cycle: the image is mapped again from its file.
+  void reboot(size_t segments, HistoryStore *history) {
+    archive.reset();
+    partition_fake_remove_all();
+    partition_fake_add("spiffs", ESP_PARTITION_TYPE_DATA,
+                       ESP_PARTITION_SUBTYPE_DATA_SPIFFS,
+                       segments * ARCHIVE_SEGMENT_SIZE, path.c_str());
+    partition_fake_reset_stats();
+    archive.reset(new Archive());
+    ASSERT_TRUE(archive->mount(history));
+  }
+
+  // One sample every HISTORY_RAW_PERIOD_S from start, flushed every minute
+  // like the sampler's batches.
+  void append_samples(time_t start, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      int16_t values[HistoryMetricMax] = {(int16_t)(10 + i % 7),
+                                          (int16_t)(200 + i % 50), 500};
+      archive->append_sample(start + i * HISTORY_RAW_PERIOD_S, values);
+      if (i % 6 == 5) {
+        archive->flush();
+      }
+    }
+    archive->flush();
+  }
+
+  size_t count(ArchiveRecordType type) {
+    return archive->scan(
+        type, 0, INT32_MAX, [](const ArchiveRecord *, void *) {}, nullptr);
+  }
+};
+
+static std::set<time_t> hours_of(time_t start, size_t count) {
+  std::set<time_t> hours;
+  for (size_t i = 0; i < count; ++i) {
+    time_t time = start + i * HISTORY_RAW_PERIOD_S;
+    hours.insert(time - time % 3600);
+  }
+  return hours;
+}
+
+TEST_F(ArchiveTest, MountReadsTheHeadAndWhatHistoryHolds) {
+  const size_t segments = 8;
+  const size_t samples = 3 * 24 * 3600 / HISTORY_RAW_PERIOD_S;
+  time_t now = fixture_now();
+  time_t start = now - samples * HISTORY_RAW_PERIOD_S;
+  reboot(segments, nullptr);
+  append_samples(start, samples);
+
+  std::unique_ptr<HistoryStore> history(new HistoryStore());
+  reboot(segments, history.get());
+  ArchiveStats stats = archive->stats();
+  // The headers, the prefix of each segment, the two segments within the
+  // day before the head and the head, out of a ring almost full.
+  EXPECT_LT(stats.bytes_read, 4u * ARCHIVE_SEGMENT_SIZE);
+  EXPECT_EQ(partition_fake_stats().bytes_read, stats.bytes_read);
+
+  // Hours from the aggregates of the segments past, minutes from samples
+  HistoryPoint point;
+  EXPECT_EQ(history->query(HistoryHour, HistoryTemperature,
+                           start + 3600 - start % 3600,
+                           start + 7200 - start % 3600, &point, 1),
+            1u);
+  EXPECT_EQ(history->query(HistoryHour, HistoryTemperature, now - 50 * 3600,
+                           now - 49 * 3600, &point, 1),
+            1u);
+  EXPECT_EQ(history->query(HistoryMinute, HistoryTemperature, now - 7200,
+                           now - 7140, &point, 1),
+            1u);
+}
+
+TEST_F(ArchiveTest, SegmentsOpenWithTheHoursOfThePreviousOne) {
+  time_t start = fixture_now() - 2 * SAMPLES_PER_SEGMENT * HISTORY_RAW_PERIOD_S;
+  reboot(4, nullptr);
+  append_samples(start, SAMPLES_PER_SEGMENT + 1);
+  EXPECT_EQ(count(ArchiveHour), hours_of(start, SAMPLES_PER_SEGMENT).size());
+  EXPECT_EQ(count(ArchiveSample), SAMPLES_PER_SEGMENT + 1u);
+}
+
+TEST_F(ArchiveTest, HoursAreCarriedAroundTheRing) {
+  const size_t laps = 2;
+  const size_t samples = laps * 3 * SAMPLES_PER_SEGMENT;
+  time_t start = fixture_now() - samples * HISTORY_RAW_PERIOD_S;
+  reboot(3, nullptr);
+  append_samples(start, samples);
+
+  std::set<time_t> hours;
+  archive->scan(
+      ArchiveHour, 0, INT32_MAX,
+      [](const ArchiveRecord *record, void *arg) {
+        static_cast<std::set<time_t> *>(arg)->insert(record->time);
+      },
+      &hours);
+  ASSERT_FALSE(hours.empty());
+  EXPECT_EQ(*hours.begin(), start - start % 3600);
+  EXPECT_GT(archive->stats().compactions, 0u);
+}
+
+TEST_F(ArchiveTest, PowerCutDuringFlushKeepsTheRecordsBefore) {
+  time_t start = fixture_now() - 3600;
+  reboot(4, nullptr);
+  append_samples(start, 120);
+  for (int i = 0; i < 20; ++i) {
+    int16_t values[HistoryMetricMax] = {1, 2, 3};
+    archive->append_sample(start + (120 + i) * HISTORY_RAW_PERIOD_S, values);
+  }
+  // Six records and a torn one land
+  partition_fake_cut_power_after(6 * 16 + 4);
+  EXPECT_NE(archive->flush(), ESP_OK);
+
+  reboot(4, nullptr);
+  EXPECT_EQ(archive->stats().corrupted, 1u);
+  EXPECT_EQ(count(ArchiveSample), 126u);
+  append_samples(start + 140 * HISTORY_RAW_PERIOD_S, 1);
+  EXPECT_EQ(count(ArchiveSample), 127u);
+}
+
+TEST_F(ArchiveTest, PowerCutWhileOpeningASegmentIsRedoneAtMount) {
+  time_t start = fixture_now() - 2 * SAMPLES_PER_SEGMENT * HISTORY_RAW_PERIOD_S;
+  reboot(3, nullptr);
+  append_samples(start, SAMPLES_PER_SEGMENT);
+  // The next header lands, the hours after it do not
+  partition_fake_cut_power_after(20 + 4);
+  append_samples(start + SAMPLES_PER_SEGMENT * HISTORY_RAW_PERIOD_S, 1);
+
+  reboot(3, nullptr);
+  size_t hours = hours_of(start, SAMPLES_PER_SEGMENT).size();
+  EXPECT_EQ(count(ArchiveHour), hours);
+  EXPECT_EQ(count(ArchiveSample), (size_t)SAMPLES_PER_SEGMENT);
+
+  // Marked done, the next mount leaves it
+  reboot(3, nullptr);
+  EXPECT_EQ(count(ArchiveHour), hours);
+}
+
+// The hour the head opened in is split: its first part aggregated in the
+// head's prefix, the rest samples in the head. Whether or not the samples
+// of the previous segment are replayed too, the hour counts each sample
+// once.
+TEST_F(ArchiveTest, HourSplitAcrossTheHeadIsWholeAfterAMount) {
+  for (time_t back : {20 * 3600, 40 * 3600}) {
+    time_t start = fixture_now() - back;
+    start -= start % 3600;
+    unlink(path.c_str());
+    reboot(4, nullptr);
+    // 20 degrees up to the head, 30 in it
+    const size_t samples = SAMPLES_PER_SEGMENT + 60;
+    for (size_t i = 0; i < samples; ++i) {
+      int16_t values[HistoryMetricMax] = {
+          10, (int16_t)(i < SAMPLES_PER_SEGMENT ? 200 : 300), 500};
+      archive->append_sample(start + i * HISTORY_RAW_PERIOD_S, values);
+    }
+    archive->flush();
+
+    time_t split = start + SAMPLES_PER_SEGMENT * HISTORY_RAW_PERIOD_S;
+    split -= split % 3600;
+    int32_t before = SAMPLES_PER_SEGMENT - (split - start) / 10;
+    float expected = (200.0f * before + 300 * 60) / (before + 60);
+    std::unique_ptr<HistoryStore> history(new HistoryStore());
+    reboot(4, history.get());
+    HistoryPoint point;
+    ASSERT_EQ(history->query(HistoryHour, HistoryTemperature, split,
+                             split + 3600, &point, 1),
+              1u)
+        << back;
+    EXPECT_NEAR(point.avg, expected, 1) << back;
+    EXPECT_EQ(point.min, 200) << back;
+    EXPECT_EQ(point.max, 300) << back;
+  }
+}
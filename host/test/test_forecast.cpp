@@ -0,0 +1,84 @@
+#include "fixtures.hpp"
+#include "forecast.hpp"
+#include <gtest/gtest.h>
+#include <math.h>
+
+TEST(ForecastCodec, TemperatureRoundTripsInTenths) {
+  for (float celsius : {-40.0f, -0.1f, 0.0f, 0.04f, 21.5f, 45.3f}) {
+    EXPECT_NEAR(forecast_decode_temperature(
+                    forecast_encode_temperature(celsius)),
+                celsius, 0.05f)
+        << celsius;
+  }
+  EXPECT_EQ(forecast_encode_temperature(21.46f), 215);
+  EXPECT_EQ(forecast_encode_temperature(-21.46f), -215);
+}
+
+TEST(ForecastCodec, TemperatureClampsAboveTheSentinel) {
+  EXPECT_EQ(forecast_encode_temperature(1e6f), INT16_MAX);
+  EXPECT_EQ(forecast_encode_temperature(INFINITY), INT16_MAX);
+  EXPECT_EQ(forecast_encode_temperature(-1e6f), FORECAST_NO_TEMPERATURE + 1);
+  EXPECT_EQ(forecast_encode_temperature(-INFINITY),
+            FORECAST_NO_TEMPERATURE + 1);
+  EXPECT_FALSE(isnan(forecast_decode_temperature(INT16_MAX)));
+  EXPECT_FALSE(isnan(forecast_decode_temperature(FORECAST_NO_TEMPERATURE + 1)));
+}
+
+TEST(ForecastCodec, TemperatureNanIsTheSentinel) {
+  EXPECT_EQ(forecast_encode_temperature(NAN), FORECAST_NO_TEMPERATURE);
+  EXPECT_TRUE(isnan(forecast_decode_temperature(FORECAST_NO_TEMPERATURE)));
+}
+
+TEST(ForecastCodec, PercentRoundTripsAndClamps) {
+  for (int percent = 0; percent <= 100; ++percent) {
+    EXPECT_EQ(forecast_decode_percent(forecast_encode_percent(percent)),
+              percent);
+  }
+  EXPECT_EQ(forecast_encode_percent(49.6f), 50);
+  EXPECT_EQ(forecast_encode_percent(-5), 0);
+  EXPECT_EQ(forecast_encode_percent(-INFINITY), 0);
+  EXPECT_EQ(forecast_encode_percent(250), 100);
+  EXPECT_EQ(forecast_encode_percent(INFINITY), 100);
+  EXPECT_EQ(forecast_encode_percent(NAN), FORECAST_NO_VALUE);
+  EXPECT_TRUE(isnan(forecast_decode_percent(FORECAST_NO_VALUE)));
+}
+
+TEST(ForecastCodec, UvRoundTripsInTenthsAndClamps) {
+  for (float uv : {0.0f, 0.1f, 3.5f, 11.0f, 25.4f}) {
+    EXPECT_NEAR(forecast_decode_uv(forecast_encode_uv(uv)), uv, 0.05f) << uv;
+  }
+  EXPECT_EQ(forecast_encode_uv(-1), 0);
+  EXPECT_EQ(forecast_encode_uv(30), FORECAST_NO_VALUE - 1);
+  EXPECT_EQ(forecast_encode_uv(INFINITY), FORECAST_NO_VALUE - 1);
+  EXPECT_EQ(forecast_encode_uv(NAN), FORECAST_NO_VALUE);
+  EXPECT_TRUE(isnan(forecast_decode_uv(FORECAST_NO_VALUE)));
+}
+
+TEST(ForecastCodec, WeatherCodeKeepsWmoCodes) {
+  Forecast24 forecast;
+  for (int code : {0, 3, 45, 61, 95, 99}) {
+    forecast.weather_code[0] = forecast_encode_code(code);
+    EXPECT_EQ((int)forecast.code(0), code);
+  }
+  EXPECT_EQ(forecast_encode_code(NAN), 0);
+  EXPECT_EQ(forecast_encode_code(-1), 0);
+  EXPECT_EQ(forecast_encode_code(FORECAST_NO_VALUE), 0);
+}
+
+TEST(ForecastCodec, MinutesAfterLocalMidnight) {
+  time_t midnight = fixture_now();
+  midnight -= midnight % 86400;
+  EXPECT_EQ(forecast_encode_minutes(midnight), 0);
+  EXPECT_EQ(forecast_encode_minutes(midnight + 6 * 3600 + 42 * 60 + 59),
+            6 * 60 + 42);
+  EXPECT_EQ(forecast_encode_minutes(midnight - 60), 23 * 60 + 59);
+  EXPECT_EQ(forecast_encode_minutes(0), FORECAST_NO_MINUTES);
+}
+
+TEST(ForecastCodec, EmptySnapshotHasNoValues) {
+  WeatherSnapshot snapshot;
+  for (int day = 0; day < 7; ++day) {
+    EXPECT_EQ(snapshot.forecast7.sunrise[day], FORECAST_NO_MINUTES);
+    EXPECT_EQ(snapshot.forecast7.sunset[day], FORECAST_NO_MINUTES);
+  }
+}
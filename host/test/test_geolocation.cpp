@@ -0,0 +1,87 @@
+#include "geolocation.hpp"
+#include "http_fake.hpp"
+#include "nvs_fake.hpp"
+#include <gtest/gtest.h>
+#include <memory>
+#include <string.h>
+
+#define IP_URL "http://myexternalip.com/raw"
+#define LOOKUP_URL "https://api.ipgeolocation.io/ipgeo"
+
+class GeolocationTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    nvs_fake_reset();
+    http_fake_reset();
+    public_ip("2a01:cb00:85a:f700:4c1e:d3c9:21ab:7f02");
+  }
+
+  void public_ip(const char *ip) {
+    http_fake_respond(IP_URL, 200, ip, strlen(ip));
+  }
+
+  void lookup(int status, const char *name) {
+    ASSERT_TRUE(http_fake_respond_file(
+        LOOKUP_URL, status,
+        (std::string(HOST_DATA_DIR "/geolocation/") + name).c_str()));
+  }
+
+  bool looked_up() {
+    return strncmp(http_fake_last_url(), LOOKUP_URL, strlen(LOOKUP_URL)) == 0;
+  }
+};
+
+TEST_F(GeolocationTest, LocatesAndStoresTheIp) {
+  lookup(200, "paris.json");
+  Geolocation geo;
+  ASSERT_EQ(geo.update_geoloc(), 200);
+  EXPECT_STREQ(geo.city(), "Paris");
+  EXPECT_STREQ(geo.tz(), "Europe/Paris");
+  EXPECT_NEAR(geo.latitude(), 48.857f, 0.001f);
+
+  // Same ip after a reboot: no lookup
+  Geolocation rebooted;
+  EXPECT_STREQ(rebooted.city(), "Paris");
+  ASSERT_EQ(rebooted.update_geoloc(), 200);
+  EXPECT_FALSE(looked_up());
+
+  public_ip("2804:14c:5b71:8a3c::1");
+  lookup(200, "sao_paulo.json");
+  ASSERT_EQ(rebooted.update_geoloc(), 200);
+  EXPECT_TRUE(looked_up());
+  EXPECT_STREQ(rebooted.tz(), "America/Sao_Paulo");
+}
+
+TEST_F(GeolocationTest, FailedLookupIsRetriedOnTheSameIp) {
+  lookup(401, "invalid_key.json");
+  Geolocation geo;
+  EXPECT_EQ(geo.update_geoloc(), 401);
+  EXPECT_STREQ(geo.tz(), "");
+
+  // The retry on the unchanged ip still asks for the location
+  lookup(200, "paris.json");
+  ASSERT_EQ(geo.update_geoloc(), 200);
+  EXPECT_TRUE(looked_up());
+  EXPECT_STREQ(geo.tz(), "Europe/Paris");
+}
+
+TEST_F(GeolocationTest, IncompleteResponseIsRetried) {
+  lookup(200, "array_root.json");
+  Geolocation geo;
+  EXPECT_EQ(geo.update_geoloc(), -1);
+  lookup(200, "paris.json");
+  ASSERT_EQ(geo.update_geoloc(), 200);
+  EXPECT_TRUE(looked_up());
+}
+
+TEST_F(GeolocationTest, UnknownIpStillLocates) {
+  public_ip("not an address");
+  lookup(200, "paris.json");
+  Geolocation geo;
+  ASSERT_EQ(geo.update_geoloc(), 200);
+  EXPECT_STREQ(geo.city(), "Paris");
+  // Nothing to compare the next ip with
+  public_ip("2a01:cb00:85a:f700:4c1e:d3c9:21ab:7f02");
+  ASSERT_EQ(geo.update_geoloc(), 200);
+  EXPECT_TRUE(looked_up());
+}
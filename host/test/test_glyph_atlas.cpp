@@ -0,0 +1,119 @@
+#include "glyph_atlas.h"
+#include "screen.hpp"
+#include <gtest/gtest.h>
+#include <string.h>
+
+static void expect_in_cells(const AtlasFace *face) {
+  for (uint8_t i = 0; i < face->count; ++i) {
+    const AtlasGlyph *glyph = &face->glyphs[i];
+    EXPECT_LE(glyph->x + glyph->width, face->cell_width) << (int)i;
+    EXPECT_LE(glyph->y + glyph->height, face->cell_height) << (int)i;
+  }
+}
+
+TEST(GlyphAtlas, GlyphsStayInTheirCells) {
+  for (size_t f = 0; f < atlas_face_count; ++f) {
+    expect_in_cells(&atlas_text_faces[f]);
+    expect_in_cells(&atlas_icon_faces[f]);
+    EXPECT_EQ(atlas_icon_faces[f].count, WeatherIconMax);
+  }
+  expect_in_cells(&atlas_clock_face);
+}
+
+TEST(GlyphAtlas, PrintableAsciiOnly) {
+  const AtlasFace *face = &atlas_text_faces[0];
+  EXPECT_NE(atlas_glyph(face, ' '), nullptr);
+  EXPECT_NE(atlas_glyph(face, '~'), nullptr);
+  EXPECT_EQ(atlas_glyph(face, ' ')->width, 0);
+  EXPECT_GT(atlas_glyph(face, 'W')->width, 0);
+  EXPECT_EQ(atlas_glyph(face, '\n'), nullptr);
+  EXPECT_EQ(atlas_glyph(face, '\x7f'), nullptr);
+  EXPECT_EQ(atlas_glyph(face, '\xc3'), nullptr);
+  EXPECT_NE(atlas_glyph(&atlas_clock_face, ':'), nullptr);
+  EXPECT_EQ(atlas_glyph(&atlas_clock_face, 'a'), nullptr);
+}
+
+TEST(GlyphAtlas, FaceOfALineHeight) {
+  EXPECT_EQ(atlas_text_faces[atlas_face_index(20)].cell_height, 20);
+  // 2.6 times the 8 px line
+  EXPECT_EQ(atlas_text_faces[atlas_face_index(20.8)].cell_height, 20);
+  EXPECT_EQ(atlas_text_faces[atlas_face_index(23)].cell_height, 20);
+  EXPECT_EQ(atlas_text_faces[atlas_face_index(100)].cell_height, 24);
+  EXPECT_EQ(atlas_face_index(0), 0u);
+}
+
+TEST(GlyphAtlas, WeatherCodesHaveIcons) {
+  EXPECT_EQ(atlas_weather_icon(0), WeatherIconClear);
+  EXPECT_EQ(atlas_weather_icon(2), WeatherIconPartlyCloudy);
+  EXPECT_EQ(atlas_weather_icon(48), WeatherIconFog);
+  EXPECT_EQ(atlas_weather_icon(55), WeatherIconDrizzle);
+  EXPECT_EQ(atlas_weather_icon(81), WeatherIconRain);
+  EXPECT_EQ(atlas_weather_icon(86), WeatherIconSnow);
+  EXPECT_EQ(atlas_weather_icon(99), WeatherIconThunder);
+  EXPECT_EQ(atlas_weather_icon(4), WeatherIconMax);
+}
+
+class AtlasScreenTest : public ::testing::Test {
+protected:
+  lgfx::LovyanGFX display{320, 240};
+  Screen screen{&display};
+
+  // Lit pixels in columns [left, right) of rows [top, bottom)
+  size_t lit(int32_t left, int32_t right, int32_t top, int32_t bottom) {
+    size_t count = 0;
+    for (int32_t y = top; y < bottom; ++y) {
+      for (int32_t x = left; x < right; ++x) {
+        count += display.readPixel(x, y) != BLACK;
+      }
+    }
+    return count;
+  }
+};
+
+TEST_F(AtlasScreenTest, TextIsAntiAliased) {
+  screen.begin_frame(0);
+  screen.text(2.5, "Today: 21.5C");
+  screen.end_frame();
+  bool grey = false;
+  for (int32_t x = 0; x < 320 && !grey; ++x) {
+    for (int32_t y = 0; y < 20 && !grey; ++y) {
+      uint16_t color = display.readPixel(x, y);
+      grey = color != BLACK && color != WHITE;
+    }
+  }
+  EXPECT_TRUE(grey);
+  EXPECT_GT(lit(0, 15, 0, 20), 0u);
+  EXPECT_EQ(lit(12 * 15, 320, 0, 240), 0u);
+}
+
+TEST_F(AtlasScreenTest, WeatherLineEndsWithTheIcon) {
+  screen.begin_frame(0);
+  screen.weather(2.5, 61, "Rain");
+  screen.text(2.5, "Rain");
+  screen.end_frame();
+  EXPECT_GT(lit(300, 320, 0, 20), 0u);
+  EXPECT_EQ(lit(300, 320, 20, 40), 0u);
+  // The same text without the icon
+  EXPECT_EQ(lit(0, 60, 0, 20), lit(0, 60, 20, 40));
+}
+
+TEST_F(AtlasScreenTest, LongLinesShrinkToASmallerFace) {
+  const char *text = "Thunderstorm with slight hail";
+  screen.begin_frame(0);
+  screen.text(2.5, text);
+  screen.end_frame();
+  // 29 cells of the 20 and 16 px faces would not fit, the 12 px one is 9
+  // wide, centered in the line
+  EXPECT_GT(lit(9 * 28, 9 * 29, 4, 16), 0u);
+  EXPECT_EQ(lit(9 * 29, 320, 0, 20), 0u);
+  EXPECT_EQ(lit(0, 320, 0, 4) + lit(0, 320, 16, 20), 0u);
+}
+
+TEST_F(AtlasScreenTest, MessageLinesStack) {
+  screen.message("Ap Started\nSSID:\n clock");
+  EXPECT_GT(lit(0, 320, 0, 12), 0u);
+  EXPECT_GT(lit(0, 320, 12, 24), 0u);
+  EXPECT_GT(lit(0, 320, 24, 36), 0u);
+  EXPECT_EQ(lit(0, 320, 36, 240), 0u);
+  EXPECT_EQ(lit(0, 9, 24, 36), 0u);
+}
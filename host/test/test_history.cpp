@@ -0,0 +1,245 @@
+#include "fixtures.hpp"
+#include "history.hpp"
+#include <gtest/gtest.h>
+#include <math.h>
+#include <memory>
+
+// Midnight, on every tier's slot boundary
+#define BASE ((time_t)1700006400)
+
+class HistoryTest : public ::testing::Test {
+protected:
+  std::unique_ptr<HistoryStore> history{new HistoryStore()};
+
+  void insert(time_t time, float pm25, float temperature = NAN,
+              float humidity = NAN) {
+    float values[HistoryMetricMax] = {pm25, temperature, humidity};
+    history->insert(time, values);
+  }
+
+  // One column per slot of the tier over [from, from + count periods)
+  std::vector<HistoryPoint> slots(HistoryTier tier, HistoryMetric metric,
+                                  time_t from, size_t count) {
+    static const time_t periods[HistoryTierMax] = {
+        HISTORY_RAW_PERIOD_S, HISTORY_MINUTE_PERIOD_S, HISTORY_HOUR_PERIOD_S};
+    std::vector<HistoryPoint> out(count);
+    history->query(tier, metric, from, from + periods[tier] * count,
+                   out.data(), count);
+    return out;
+  }
+};
+
+TEST(HistoryEncoding, FixedPointRoundTrips) {
+  EXPECT_EQ(history_encode(HistoryPm25, 12.4f), 12);
+  EXPECT_EQ(history_encode(HistoryTemperature, -3.25f), -33);
+  EXPECT_EQ(history_encode(HistoryHumidity, 47.56f), 476);
+  EXPECT_FLOAT_EQ(history_decode(HistoryTemperature, 215), 21.5f);
+  // Saturates short of the missing value
+  EXPECT_EQ(history_encode(HistoryTemperature, -1e6f), INT16_MIN + 1);
+  EXPECT_EQ(history_encode(HistoryPm25, 1e6f), INT16_MAX);
+}
+
+TEST_F(HistoryTest, EmptyStoreHasNoData) {
+  HistoryPoint out[4];
+  for (int tier = 0; tier < HistoryTierMax; ++tier) {
+    EXPECT_EQ(history->query((HistoryTier)tier, HistoryPm25, BASE,
+                             BASE + 86400, out, 4),
+              0u);
+    EXPECT_EQ(out[0].avg, HISTORY_NO_VALUE);
+  }
+  float value;
+  EXPECT_FALSE(history->latest(HistoryPm25, &value));
+}
+
+TEST_F(HistoryTest, RawTierKeepsEverySampleAndItsGaps) {
+  insert(BASE, 10, 21.5f, 40);
+  insert(BASE + 10, 11, NAN, 41);
+  insert(BASE + 30, 13, 21.7f, 43);
+
+  std::vector<HistoryPoint> pm25 = slots(HistoryRaw, HistoryPm25, BASE, 4);
+  EXPECT_EQ(pm25[0].avg, 10);
+  EXPECT_EQ(pm25[1].avg, 11);
+  EXPECT_EQ(pm25[2].avg, HISTORY_NO_VALUE);
+  EXPECT_EQ(pm25[3].avg, 13);
+  // Raw samples have no spread
+  EXPECT_EQ(pm25[3].min, 13);
+  EXPECT_EQ(pm25[3].max, 13);
+
+  std::vector<HistoryPoint> temperature =
+      slots(HistoryRaw, HistoryTemperature, BASE, 4);
+  EXPECT_EQ(temperature[0].avg, 215);
+  EXPECT_EQ(temperature[1].avg, HISTORY_NO_VALUE);
+  EXPECT_EQ(temperature[3].avg, 217);
+}
+
+TEST_F(HistoryTest, MinuteTierAggregatesItsSamples) {
+  static const float pm25[] = {10, 14, 12, 20, 8, 11};
+  for (int i = 0; i < 6; ++i) {
+    insert(BASE + i * HISTORY_RAW_PERIOD_S, pm25[i]);
+  }
+  insert(BASE + 60, 30);
+
+  std::vector<HistoryPoint> minutes =
+      slots(HistoryMinute, HistoryPm25, BASE, 3);
+  EXPECT_EQ(minutes[0].min, 8);
+  EXPECT_EQ(minutes[0].avg, 13);
+  EXPECT_EQ(minutes[0].max, 20);
+  EXPECT_EQ(minutes[1].min, 30);
+  EXPECT_EQ(minutes[1].avg, 30);
+  EXPECT_EQ(minutes[2].avg, HISTORY_NO_VALUE);
+}
+
+TEST_F(HistoryTest, HourTierAggregatesItsSamples) {
+  for (time_t t = BASE; t < BASE + 2 * 3600; t += HISTORY_RAW_PERIOD_S) {
+    // 0 to 35 over the first hour, then 100
+    insert(t, t < BASE + 3600 ? (t - BASE) / 100 : 100);
+  }
+  std::vector<HistoryPoint> hours = slots(HistoryHour, HistoryPm25, BASE, 2);
+  EXPECT_EQ(hours[0].min, 0);
+  EXPECT_EQ(hours[0].avg, 18);
+  EXPECT_EQ(hours[0].max, 35);
+  EXPECT_EQ(hours[1].min, 100);
+  EXPECT_EQ(hours[1].max, 100);
+}
+
+TEST_F(HistoryTest, SpreadSaturatesAtAByteFromTheAverage) {
+  insert(BASE, -500);
+  insert(BASE + 10, 500);
+  std::vector<HistoryPoint> minutes =
+      slots(HistoryMinute, HistoryPm25, BASE, 1);
+  EXPECT_EQ(minutes[0].avg, 0);
+  EXPECT_EQ(minutes[0].min, -255);
+  EXPECT_EQ(minutes[0].max, 255);
+}
+
+TEST_F(HistoryTest, EachTierForgetsPastItsSpan) {
+  time_t end = BASE + 2 * 3600;
+  for (time_t t = BASE; t < end; t += HISTORY_RAW_PERIOD_S) {
+    insert(t, 1 + (t - BASE) / 3600);
+  }
+  // The raw hour ends at the last sample, the first hour is gone from it
+  std::vector<HistoryPoint> raw =
+      slots(HistoryRaw, HistoryPm25, BASE, HISTORY_RAW_SLOTS);
+  for (const HistoryPoint &point : raw) {
+    EXPECT_EQ(point.avg, HISTORY_NO_VALUE);
+  }
+  raw = slots(HistoryRaw, HistoryPm25, end - 3600, HISTORY_RAW_SLOTS);
+  EXPECT_EQ(raw[0].avg, 2);
+  EXPECT_EQ(raw[HISTORY_RAW_SLOTS - 1].avg, 2);
+  // The minute tier still has both hours
+  std::vector<HistoryPoint> minutes =
+      slots(HistoryMinute, HistoryPm25, BASE, 120);
+  EXPECT_EQ(minutes[0].avg, 1);
+  EXPECT_EQ(minutes[119].avg, 2);
+
+  // A late sample is dropped from the raw ring it is older than, and does
+  // not restart an aggregate that is already complete
+  insert(BASE, 50);
+  EXPECT_EQ(slots(HistoryMinute, HistoryPm25, BASE, 1)[0].avg, 1);
+  EXPECT_EQ(slots(HistoryRaw, HistoryPm25, BASE, 1)[0].avg, HISTORY_NO_VALUE);
+}
+
+TEST_F(HistoryTest, ClockJumpLargerThanATierRestartsIt) {
+  insert(BASE, 5);
+  time_t later = BASE + 2 * 86400;
+  insert(later, 9);
+  EXPECT_EQ(history->stats().resets, 2u);
+  EXPECT_EQ(slots(HistoryRaw, HistoryPm25, later, 1)[0].avg, 9);
+  EXPECT_EQ(slots(HistoryMinute, HistoryPm25, BASE, 1)[0].avg,
+            HISTORY_NO_VALUE);
+  // Two days fit in the month of the hour tier
+  EXPECT_EQ(slots(HistoryHour, HistoryPm25, BASE, 1)[0].avg, 5);
+  EXPECT_EQ(slots(HistoryHour, HistoryPm25, later, 1)[0].avg, 9);
+}
+
+TEST_F(HistoryTest, QueryBucketsSlotsIntoColumns) {
+  for (int i = 0; i < 60; ++i) {
+    insert(BASE + i * 60, i);
+  }
+  HistoryPoint out[6];
+  EXPECT_EQ(history->query(HistoryMinute, HistoryPm25, BASE, BASE + 3600,
+                           out, 6),
+            6u);
+  EXPECT_EQ(out[0].min, 0);
+  EXPECT_EQ(out[0].avg, 5);
+  EXPECT_EQ(out[0].max, 9);
+  EXPECT_EQ(out[5].min, 50);
+  EXPECT_EQ(out[5].max, 59);
+  // Half the range is before the first sample, columns of 20 minutes
+  EXPECT_EQ(history->query(HistoryMinute, HistoryPm25, BASE - 3600,
+                           BASE + 3600, out, 6),
+            3u);
+  EXPECT_EQ(out[2].avg, HISTORY_NO_VALUE);
+  EXPECT_EQ(out[3].min, 0);
+  EXPECT_EQ(out[3].avg, 10);
+  EXPECT_EQ(out[3].max, 19);
+}
+
+TEST_F(HistoryTest, RestoredHoursMergeWithWhatIsThere) {
+  HistoryPoint points[HistoryMetricMax] = {
+      {10, 20, 30},
+      {HISTORY_NO_VALUE, HISTORY_NO_VALUE, HISTORY_NO_VALUE},
+      {400, 450, 500},
+  };
+  uint16_t counts[HistoryMetricMax] = {90, 0, 90};
+  history->insert_hour(BASE + 1800, points, counts);
+  std::vector<HistoryPoint> hour = slots(HistoryHour, HistoryPm25, BASE, 1);
+  EXPECT_EQ(hour[0].min, 10);
+  EXPECT_EQ(hour[0].avg, 20);
+  EXPECT_EQ(hour[0].max, 30);
+  EXPECT_EQ(slots(HistoryHour, HistoryTemperature, BASE, 1)[0].avg,
+            HISTORY_NO_VALUE);
+
+  // The other part of an hour split across two archive segments, three
+  // times longer
+  points[HistoryPm25] = {5, 40, 45};
+  counts[HistoryPm25] = 270;
+  history->insert_hour(BASE, points, counts);
+  hour = slots(HistoryHour, HistoryPm25, BASE, 1);
+  EXPECT_EQ(hour[0].min, 5);
+  EXPECT_EQ(hour[0].avg, 35);
+  EXPECT_EQ(hour[0].max, 45);
+}
+
+TEST_F(HistoryTest, SampledHourGoesOnFromItsRestoredPart) {
+  // The first 40 minutes, archived before a reboot
+  HistoryPoint points[HistoryMetricMax] = {
+      {10, 10, 10},
+      {HISTORY_NO_VALUE, HISTORY_NO_VALUE, HISTORY_NO_VALUE},
+      {HISTORY_NO_VALUE, HISTORY_NO_VALUE, HISTORY_NO_VALUE},
+  };
+  uint16_t counts[HistoryMetricMax] = {240, 0, 0};
+  history->insert_hour(BASE, points, counts);
+  // The last 20 sampled since
+  for (time_t t = BASE + 2400; t < BASE + 3600; t += HISTORY_RAW_PERIOD_S) {
+    insert(t, 40);
+  }
+  std::vector<HistoryPoint> hour = slots(HistoryHour, HistoryPm25, BASE, 1);
+  EXPECT_EQ(hour[0].min, 10);
+  EXPECT_EQ(hour[0].avg, 20);
+  EXPECT_EQ(hour[0].max, 40);
+
+  // Samples an archived hour covers stay out of the hour tier
+  float values[HistoryMetricMax] = {100, NAN, NAN};
+  history->insert(BASE + 3600, values, false);
+  EXPECT_EQ(slots(HistoryHour, HistoryPm25, BASE + 3600, 1)[0].avg,
+            HISTORY_NO_VALUE);
+  EXPECT_EQ(slots(HistoryMinute, HistoryPm25, BASE + 3600, 1)[0].avg, 100);
+}
+
+TEST_F(HistoryTest, LatestIsTheNewestFreshSample) {
+  time_t now = fixture_now();
+  insert(now - 10, 7, 21.5f);
+  insert(now - 20, 9, 19);
+  float value;
+  ASSERT_TRUE(history->latest(HistoryPm25, &value));
+  EXPECT_FLOAT_EQ(value, 7);
+  ASSERT_TRUE(history->latest(HistoryTemperature, &value));
+  EXPECT_FLOAT_EQ(value, 21.5f);
+  EXPECT_FALSE(history->latest(HistoryHumidity, &value));
+
+  std::unique_ptr<HistoryStore> stale(new HistoryStore());
+  float values[HistoryMetricMax] = {7, 21.5f, 40};
+  stale->insert(now - 4 * HISTORY_RAW_PERIOD_S, values);
+  EXPECT_FALSE(stale->latest(HistoryPm25, &value));
+}
@@ -0,0 +1,179 @@
+#include "fixtures.hpp"
+#include "hourly_forecast.hpp"
+#include "partition_fake.hpp"
+#include <gtest/gtest.h>
+#include <math.h>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#define PARTITION_SIZE (64 * 1024)
+#define SLOTS (PARTITION_SIZE / HOURLY_FORECAST_SLOT_SIZE)
+
+class HourlyForecastTest : public ::testing::Test {
+protected:
+  std::string path;
+  std::unique_ptr<HourlyForecast> hourly;
+  std::vector<float> temperature, rain, uv, code;
+  time_t start = fixture_now() / 86400 * 86400;
+
+  void SetUp() override {
+    path = std::string(HOST_OUTPUT_DIR "/") +
+           ::testing::UnitTest::GetInstance()->current_test_info()->name() +
+           ".img";
+    unlink(path.c_str());
+    series(HOURLY_FORECAST_HOURS, 0);
+    reboot();
+  }
+
+  void TearDown() override {
+    hourly.reset();
+    partition_fake_remove_all();
+    unlink(path.c_str());
+  }
+
+  // Power cycle: the image is mapped again from its file.
+  void reboot() {
+    hourly.reset();
+    partition_fake_remove_all();
+    partition_fake_add("hourly", ESP_PARTITION_TYPE_DATA,
+                       HOURLY_FORECAST_SUBTYPE, PARTITION_SIZE, path.c_str());
+    partition_fake_reset_stats();
+    hourly.reset(new HourlyForecast());
+  }
+
+  // hours values, shifted by offset degrees so forecasts tell apart
+  void series(size_t hours, float offset) {
+    temperature.clear();
+    rain.clear();
+    uv.clear();
+    code.clear();
+    for (size_t h = 0; h < hours; ++h) {
+      temperature.push_back(offset + 10 + (h % 24) * 0.5f);
+      rain.push_back(h % 100);
+      uv.push_back((h % 24) / 2.0f);
+      code.push_back(h % 24 >= 18 ? 80 : 2);
+    }
+  }
+
+  bool write(time_t first_hour) {
+    HourlyColumns columns = {
+        .temperature_2m = {temperature.data(), temperature.size()},
+        .precipitation_probability = {rain.data(), rain.size()},
+        .uv_index = {uv.data(), uv.size()},
+        .weather_code = {code.data(), code.size()},
+    };
+    return hourly->write(first_hour, columns);
+  }
+};
+
+TEST_F(HourlyForecastTest, NothingBeforeTheFirstWrite) {
+  EXPECT_EQ(hourly->forecast(), nullptr);
+}
+
+TEST_F(HourlyForecastTest, NoPartitionNoForecast) {
+  hourly.reset();
+  partition_fake_remove_all();
+  hourly.reset(new HourlyForecast());
+  EXPECT_FALSE(write(start));
+  EXPECT_EQ(hourly->forecast(), nullptr);
+}
+
+TEST_F(HourlyForecastTest, WrittenHoursReadBackFromTheMapping) {
+  ASSERT_TRUE(write(start));
+  const HourlyForecastSlot *forecast = hourly->forecast();
+  ASSERT_NE(forecast, nullptr);
+  EXPECT_EQ((time_t)forecast->header.start, start);
+  for (int h = 0; h < HOURLY_FORECAST_HOURS; ++h) {
+    EXPECT_EQ(forecast->hours.temperature_2m[h],
+              forecast_encode_temperature(temperature[h]))
+        << h;
+    EXPECT_EQ(forecast->hours.precipitation_probability[h],
+              forecast_encode_percent(rain[h]))
+        << h;
+    EXPECT_EQ(forecast->hours.uv_index[h], forecast_encode_uv(uv[h])) << h;
+    EXPECT_EQ(forecast->hours.weather_code[h], forecast_encode_code(code[h]))
+        << h;
+  }
+  EXPECT_FLOAT_EQ(forecast->hours.temperature(13), 16.5f);
+  EXPECT_EQ(forecast->hour_index(start - 1), -1);
+  EXPECT_EQ(forecast->hour_index(start + 3599), 0);
+  EXPECT_EQ(forecast->hour_index(start + 5 * 86400 + 7200), 5 * 24 + 2);
+  EXPECT_EQ(forecast->hour_index(start + HOURLY_FORECAST_HOURS * 3600), -1);
+
+  // One sector erased, nothing of it held in RAM
+  EXPECT_EQ(partition_fake_stats().erases, 1u);
+  EXPECT_EQ(partition_fake_stats().bytes_erased,
+            (uint64_t)HOURLY_FORECAST_SLOT_SIZE);
+}
+
+TEST_F(HourlyForecastTest, ShortSeriesArePaddedWithMissingHours) {
+  series(30, 0);
+  ASSERT_TRUE(write(start));
+  const HourlyForecastSlot *forecast = hourly->forecast();
+  ASSERT_NE(forecast, nullptr);
+  EXPECT_EQ(forecast->hours.temperature_2m[29],
+            forecast_encode_temperature(temperature[29]));
+  for (int h = 30; h < HOURLY_FORECAST_HOURS; ++h) {
+    EXPECT_EQ(forecast->hours.temperature_2m[h], FORECAST_NO_TEMPERATURE);
+    EXPECT_EQ(forecast->hours.precipitation_probability[h],
+              forecast_encode_percent(NAN));
+    EXPECT_EQ(forecast->hours.weather_code[h], forecast_encode_code(NAN));
+  }
+}
+
+TEST_F(HourlyForecastTest, NewestForecastSurvivesAReboot) {
+  ASSERT_TRUE(write(start));
+  series(HOURLY_FORECAST_HOURS, 5);
+  ASSERT_TRUE(write(start + 86400));
+  reboot();
+  const HourlyForecastSlot *forecast = hourly->forecast();
+  ASSERT_NE(forecast, nullptr);
+  EXPECT_EQ((time_t)forecast->header.start, start + 86400);
+  EXPECT_EQ(forecast->header.sequence, 2u);
+  EXPECT_EQ(forecast->hours.temperature_2m[0],
+            forecast_encode_temperature(15));
+  EXPECT_EQ(partition_fake_stats().writes, 0u);
+}
+
+TEST_F(HourlyForecastTest, WritesGoRoundTheSectors) {
+  std::vector<const uint8_t *> slots;
+  for (int i = 0; i < SLOTS + 1; ++i) {
+    ASSERT_TRUE(write(start + i * 3600));
+    slots.push_back(reinterpret_cast<const uint8_t *>(hourly->forecast()));
+  }
+  // The first write goes after sector 0, each one to the sector after the
+  // published one, wrapping at the end
+  const uint8_t *mapped = slots[0] - HOURLY_FORECAST_SLOT_SIZE;
+  for (int i = 0; i < SLOTS + 1; ++i) {
+    EXPECT_EQ((slots[i] - mapped) / HOURLY_FORECAST_SLOT_SIZE,
+              (i + 1) % SLOTS)
+        << i;
+  }
+  EXPECT_EQ(partition_fake_stats().erases, (uint32_t)SLOTS + 1);
+  reboot();
+  EXPECT_EQ(hourly->forecast()->header.sequence, (uint32_t)SLOTS + 1);
+  EXPECT_EQ((time_t)hourly->forecast()->header.start, start + SLOTS * 3600);
+}
+
+TEST_F(HourlyForecastTest, TornWriteKeepsThePreviousForecast) {
+  ASSERT_TRUE(write(start));
+  const HourlyForecastSlot *previous = hourly->forecast();
+  // Halfway through the columns, before the header
+  partition_fake_cut_power_after(HOURLY_FORECAST_HOURS * 2);
+  series(HOURLY_FORECAST_HOURS, 5);
+  EXPECT_FALSE(write(start + 86400));
+  EXPECT_EQ(hourly->forecast(), previous);
+  EXPECT_EQ(hourly->stats().failures, 1u);
+
+  partition_fake_cut_power_after(SIZE_MAX);
+  reboot();
+  ASSERT_NE(hourly->forecast(), nullptr);
+  EXPECT_EQ((time_t)hourly->forecast()->header.start, start);
+  EXPECT_EQ(hourly->forecast()->hours.temperature_2m[0],
+            forecast_encode_temperature(10));
+  // The torn slot is the one written next
+  ASSERT_TRUE(write(start + 86400));
+  EXPECT_EQ(hourly->forecast()->header.sequence, 2u);
+}
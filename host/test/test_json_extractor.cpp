@@ -0,0 +1,196 @@
+#include "json_extractor.hpp"
+#include <fstream>
+#include <gtest/gtest.h>
+#include <random>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+// The fields and sizes Geolocation::update_geoloc reads the response with.
+typedef struct Extracted {
+  char city[86];
+  char country[57];
+  char tz[31];
+  char latitude[16];
+  char longitude[16];
+  bool ok;
+  bool done;
+  size_t found;
+
+  bool operator==(const Extracted &other) const {
+    return !strcmp(city, other.city) && !strcmp(country, other.country) &&
+           !strcmp(tz, other.tz) && !strcmp(latitude, other.latitude) &&
+           !strcmp(longitude, other.longitude) && ok == other.ok &&
+           done == other.done && found == other.found;
+  }
+} Extracted;
+
+static std::string corpus(const char *name) {
+  std::ifstream file(std::string(HOST_DATA_DIR "/geolocation/") + name,
+                     std::ios::binary);
+  std::stringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+// Feeds the document in chunks of the sizes chunk returns, like the HTTP
+// client hands over the body.
+template <typename Chunk>
+static Extracted extract(const std::string &document, Chunk chunk) {
+  Extracted out = {};
+  JsonField fields[] = {
+      {.path = "city", .value = out.city, .size = sizeof(out.city)},
+      {.path = "country_name",
+       .value = out.country,
+       .size = sizeof(out.country)},
+      {.path = "time_zone.name", .value = out.tz, .size = sizeof(out.tz)},
+      {.path = "latitude",
+       .value = out.latitude,
+       .size = sizeof(out.latitude)},
+      {.path = "longitude",
+       .value = out.longitude,
+       .size = sizeof(out.longitude)},
+  };
+  JsonExtractor extractor(fields, sizeof(fields) / sizeof(fields[0]));
+  out.ok = true;
+  for (size_t pos = 0; pos < document.size() && out.ok;) {
+    size_t length = std::min(chunk(), document.size() - pos);
+    out.ok = extractor.feed(document.data() + pos, length);
+    pos += length;
+  }
+  out.done = extractor.done();
+  out.found = extractor.found();
+  return out;
+}
+
+static Extracted extract(const std::string &document) {
+  return extract(document, [&]() { return document.size(); });
+}
+
+typedef struct Recorded {
+  const char *file;
+  const char *city;
+  const char *country;
+  const char *tz;
+  const char *latitude;
+  const char *longitude;
+  size_t found;
+} Recorded;
+
+static const Recorded recorded[] = {
+    {"paris.json", "Paris", "France", "Europe/Paris", "48.85717", "2.34140",
+     5},
+    {"sao_paulo.json", "S\xc3\xa3o Paulo", "Brazil", "America/Sao_Paulo",
+     "-23.54750", "-46.63611", 5},
+    // The neighbours array holds cities too, nothing below an array matches
+    {"full.json", "Shinjuku-ku", "Japan", "Asia/Tokyo", "35.69384",
+     "139.70355", 5},
+    {"invalid_key.json", "", "", "", "", "", 0},
+    // Cut to the buffer sizes
+    {"long_names.json",
+     "Llanfairpwllgwyngyllgogerychwyrndrobwllllantysiliogogogoch, Isle of "
+     "Anglesey, Wales",
+     "United Kingdom of Great Britain and Northern Ireland, as",
+     "Europe/London", "53.22333", "-4.19833", 5},
+    {"array_root.json", "", "", "", "", "", 0},
+};
+
+TEST(JsonExtractor, RecordedResponsesInEveryChunkSize) {
+  for (const Recorded &expected : recorded) {
+    std::string document = corpus(expected.file);
+    ASSERT_FALSE(document.empty()) << expected.file;
+    Extracted whole = extract(document);
+    EXPECT_TRUE(whole.ok) << expected.file;
+    EXPECT_TRUE(whole.done) << expected.file;
+    EXPECT_EQ(whole.found, expected.found) << expected.file;
+    EXPECT_STREQ(whole.city, std::string(expected.city).substr(0, 85).c_str())
+        << expected.file;
+    EXPECT_STREQ(whole.country, expected.country) << expected.file;
+    EXPECT_STREQ(whole.tz, expected.tz) << expected.file;
+    EXPECT_STREQ(whole.latitude, expected.latitude) << expected.file;
+    EXPECT_STREQ(whole.longitude, expected.longitude) << expected.file;
+    for (size_t size = 1; size <= 128; ++size) {
+      EXPECT_TRUE(extract(document, [&]() { return size; }) == whole)
+          << expected.file << " in chunks of " << size;
+    }
+  }
+}
+
+TEST(JsonExtractor, TruncatedResponseIsNeverDone) {
+  std::string document = corpus("paris.json");
+  while (!document.empty() && document.back() != '}') {
+    document.pop_back();
+  }
+  for (size_t length = 0; length + 1 < document.size(); ++length) {
+    Extracted out = extract(document.substr(0, length));
+    EXPECT_TRUE(out.ok) << length;
+    EXPECT_FALSE(out.done) << length;
+  }
+}
+
+TEST(JsonExtractor, MalformedInputIsRejected) {
+  static const char *const malformed[] = {
+      "}",
+      "{\"city\" \"Paris\"}",
+      "{\"city\":}",
+      "{\"city\":\"Pa\x01ris\"}",
+      "{\"city\":\"\\q\"}",
+      "{\"city\":\"\\u00G9\"}",
+      "{city:\"Paris\"}",
+      "[1 2]",
+      "{\"a\":[[[[[[[[[1]]]]]]]]]}",
+  };
+  for (const char *document : malformed) {
+    Extracted out = extract(document);
+    EXPECT_FALSE(out.ok) << document;
+    EXPECT_FALSE(out.done) << document;
+  }
+}
+
+// Mutations of the recorded responses: whatever comes in, values stay NUL
+// terminated within their buffers and the chunking does not change a thing.
+// CLOCK_FUZZ_ITERATIONS runs it longer.
+TEST(JsonExtractor, FuzzedResponses) {
+  const char *env = getenv("CLOCK_FUZZ_ITERATIONS");
+  int iterations = env ? atoi(env) : 2000;
+  std::mt19937 random(12345);
+  static const char tokens[] = "{}[]\":,\\u0e\t ";
+  for (const Recorded &seed : recorded) {
+    std::string original = corpus(seed.file);
+    for (int i = 0; i < iterations; ++i) {
+      std::string document = original;
+      int mutations = 1 + random() % 8;
+      for (int m = 0; m < mutations && !document.empty(); ++m) {
+        size_t pos = random() % document.size();
+        switch (random() % 4) {
+        case 0:
+          document[pos] = random() % 256;
+          break;
+        case 1:
+          document[pos] = tokens[random() % (sizeof(tokens) - 1)];
+          break;
+        case 2:
+          document.erase(pos, 1 + random() % 16);
+          break;
+        case 3:
+          document.insert(pos, document, random() % document.size(),
+                          random() % 32);
+          break;
+        }
+      }
+      Extracted whole = extract(document);
+      ASSERT_NE(memchr(whole.city, '\0', sizeof(whole.city)), nullptr);
+      ASSERT_NE(memchr(whole.country, '\0', sizeof(whole.country)), nullptr);
+      ASSERT_NE(memchr(whole.tz, '\0', sizeof(whole.tz)), nullptr);
+      ASSERT_NE(memchr(whole.latitude, '\0', sizeof(whole.latitude)), nullptr);
+      ASSERT_NE(memchr(whole.longitude, '\0', sizeof(whole.longitude)),
+                nullptr);
+      size_t seed_chunk = 1 + random() % 64;
+      Extracted chunked = extract(document, [&]() {
+        return 1 + (seed_chunk = seed_chunk * 1103515245 + 12345) % 64;
+      });
+      ASSERT_TRUE(chunked == whole) << seed.file << " mutation " << i;
+    }
+  }
+}
@@ -0,0 +1,113 @@
+#include "fixtures.hpp"
+#include "http_fake.hpp"
+#include "locations.hpp"
+#include "nvs_fake.hpp"
+#include "open_meteo_fixture.hpp"
+#include <gtest/gtest.h>
+#include <string.h>
+
+// The layout of Locations::LocationsRecord, to store one from another seed
+typedef struct StoredList {
+  Location locations[LOCATIONS_MAX];
+  uint32_t seed;
+  uint8_t count;
+  uint8_t reserved[3];
+} StoredList;
+
+class LocationsTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    nvs_fake_reset();
+    http_fake_reset();
+  }
+
+  // Both places of the host sdkconfig answer with the same forecast
+  void respond() {
+    time_t now = fixture_now();
+    body = fixture_forecast_response(now - now % 3600, 1, 1);
+    std::vector<uint8_t> second = body;
+    body.insert(body.end(), second.begin(), second.end());
+    http_fake_respond("https://api.open-meteo.com/", 200, body.data(),
+                      body.size());
+  }
+
+  std::vector<uint8_t> body;
+};
+
+TEST_F(LocationsTest, SeedsFromTheConfig) {
+  Locations locations;
+  ASSERT_EQ(locations.count(), 2u);
+  EXPECT_STREQ(locations.location(0).name, "Paris");
+  EXPECT_FLOAT_EQ(locations.location(1).longitude, 139.69f);
+  EXPECT_EQ(locations.snapshot()->fetched_at, 0);
+
+  // Kept in NVS, the next boot does not write it again
+  size_t writes = nvs_fake_stats().writes;
+  Locations again;
+  EXPECT_EQ(again.count(), 2u);
+  EXPECT_EQ(nvs_fake_stats().writes, writes);
+}
+
+TEST_F(LocationsTest, ConfigChangeSeedsAgain) {
+  StoredList stored = {};
+  strlcpy(stored.locations[0].name, "Old", LOCATION_NAME_MAX);
+  stored.count = 1;
+  stored.seed = 0;
+  PersistentRecord record("Places", 3);
+  ASSERT_EQ(record.save(&stored, sizeof(stored)), ESP_OK);
+
+  Locations locations;
+  ASSERT_EQ(locations.count(), 2u);
+  EXPECT_STREQ(locations.location(0).name, "Paris");
+}
+
+TEST_F(LocationsTest, ForecastsOfAnotherListAreDropped) {
+  { Locations seeded; }
+  LocationsSnapshot stale = {};
+  stale.forecasts[0].temperature_2m = 215;
+  stale.places = 1;
+  stale.fetched_at = fixture_now();
+  PersistentRecord record("PlacesWx", 3, sizeof(time_t));
+  ASSERT_EQ(record.save(&stale, sizeof(stale)), ESP_OK);
+
+  Locations locations;
+  EXPECT_EQ(locations.snapshot()->fetched_at, 0);
+  EXPECT_EQ(locations.snapshot()->forecasts[0].temperature_2m, 0);
+}
+
+TEST_F(LocationsTest, SetReplacesTheListAndItsForecasts) {
+  respond();
+  Locations locations;
+  locations.start();
+  ASSERT_TRUE(locations.refresh());
+  ASSERT_NE(locations.snapshot()->fetched_at, 0);
+
+  Location office = {"Office", 45.76f, 4.84f};
+  EXPECT_FALSE(locations.set(&office, LOCATIONS_MAX + 1));
+  ASSERT_TRUE(locations.set(&office, 1));
+  EXPECT_EQ(locations.count(), 1u);
+  EXPECT_EQ(locations.snapshot()->fetched_at, 0);
+
+  // The forecasts saved for the old list do not come back at boot either
+  Locations rebooted;
+  ASSERT_EQ(rebooted.count(), 1u);
+  EXPECT_STREQ(rebooted.location(0).name, "Office");
+  EXPECT_EQ(rebooted.snapshot()->fetched_at, 0);
+}
+
+TEST_F(LocationsTest, ForecastsOfTheSameListSurviveABoot) {
+  respond();
+  time_t fetched_at;
+  {
+    Locations locations;
+    locations.start();
+    ASSERT_TRUE(locations.refresh());
+    EXPECT_NE(strstr(http_fake_last_url(), "latitude=48.8500,35.6800"),
+              nullptr);
+    fetched_at = locations.snapshot()->fetched_at;
+  }
+  Locations rebooted;
+  EXPECT_EQ(rebooted.snapshot()->fetched_at, fetched_at);
+  EXPECT_NE(rebooted.snapshot()->forecasts[1].temperature_2m,
+            FORECAST_NO_TEMPERATURE);
+}
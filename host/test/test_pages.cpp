@@ -0,0 +1,79 @@
+#include "fixtures.hpp"
+#include "pages.hpp"
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdio.h>
+
+class PagesTest : public ::testing::Test {
+protected:
+  lgfx::LovyanGFX display{320, 240};
+  Screen screen{&display};
+  std::unique_ptr<HistoryStore> history{new HistoryStore()};
+  WeatherSnapshot weather;
+  PageContext ctx = {};
+
+  void SetUp() override {
+    time_t now = fixture_now();
+    fixture_weather(&weather);
+    fixture_history(history.get(), now, 24);
+    ctx.screen = &screen;
+    ctx.weather = &weather;
+    ctx.history = history.get();
+    ctx.now = now;
+    ctx.online = true;
+  }
+
+  size_t lit_pixels() const {
+    size_t lit = 0;
+    for (int32_t y = 0; y < display.height(); ++y) {
+      for (int32_t x = 0; x < display.width(); ++x) {
+        lit += display.readPixel(x, y) != BLACK;
+      }
+    }
+    return lit;
+  }
+};
+
+TEST_F(PagesTest, EveryPageDrawsAndDumps) {
+  for (int page = 0; page < page_count(); ++page) {
+    ctx.page = page;
+    page_render(&ctx);
+    EXPECT_GT(lit_pixels(), 0u) << "page " << page;
+    char path[256];
+    snprintf(path, sizeof(path), "%s/page_%d.png", HOST_OUTPUT_DIR, page);
+    EXPECT_TRUE(display.writePng(path)) << path;
+  }
+  EXPECT_EQ(screen.stats().frames, (unsigned)page_count());
+}
+
+TEST_F(PagesTest, UnchangedFrameSendsNothing) {
+  ctx.page = 0;
+  page_render(&ctx);
+  unsigned drawn = screen.stats().fields_drawn;
+  EXPECT_GT(screen.stats().last_frame_pixels, 0u);
+  page_render(&ctx);
+  EXPECT_EQ(screen.stats().fields_drawn, drawn);
+  EXPECT_EQ(screen.stats().last_frame_pixels, 0u);
+}
+
+TEST_F(PagesTest, NewMinuteOnlySendsTheClock) {
+  ctx.page = 0;
+  page_render(&ctx);
+  unsigned drawn = screen.stats().fields_drawn;
+  ctx.now += 60;
+  page_render(&ctx);
+  EXPECT_EQ(screen.stats().fields_drawn, drawn + 1);
+  EXPECT_EQ(screen.stats().last_frame_pixels, 320u * 48);
+}
+
+TEST_F(PagesTest, OfflineLeavesTheWeatherOut) {
+  ctx.page = 0;
+  page_render(&ctx);
+  unsigned online_fields = screen.stats().fields_drawn;
+  lgfx::LovyanGFX offline_display(320, 240);
+  Screen offline_screen(&offline_display);
+  ctx.screen = &offline_screen;
+  ctx.online = false;
+  page_render(&ctx);
+  EXPECT_LT(offline_screen.stats().fields_drawn, online_fields);
+}
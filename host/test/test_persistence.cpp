@@ -0,0 +1,131 @@
+#include "nvs_fake.hpp"
+#include "persistence.hpp"
+#include <gtest/gtest.h>
+#include <thread>
+
+#define NAMESPACE "Test"
+
+typedef struct TestState {
+  int32_t value;
+  uint32_t count;
+  time_t fetched_at;
+} TestState;
+
+class PersistenceTest : public ::testing::Test {
+protected:
+  void SetUp() override { nvs_fake_reset(); }
+};
+
+TEST_F(PersistenceTest, RoundTripsTheRecordAndItsStamp) {
+  PersistentRecord writer(NAMESPACE, 1, sizeof(time_t));
+  TestState state = {42, 7, 1700000000};
+  ASSERT_EQ(writer.save(&state, sizeof(state)), ESP_OK);
+
+  PersistentRecord reader(NAMESPACE, 1, sizeof(time_t));
+  TestState loaded = {};
+  ASSERT_TRUE(reader.load(&loaded, sizeof(loaded)));
+  EXPECT_EQ(loaded.value, 42);
+  EXPECT_EQ(loaded.count, 7u);
+  EXPECT_EQ(loaded.fetched_at, 1700000000);
+}
+
+TEST_F(PersistenceTest, NewStampOnlyRewritesTheStamp) {
+  PersistentRecord record(NAMESPACE, 1, sizeof(time_t));
+  TestState state = {42, 7, 1700000000};
+  ASSERT_EQ(record.save(&state, sizeof(state)), ESP_OK);
+  NvsFakeStats before = nvs_fake_stats();
+
+  state.fetched_at += 3600;
+  ASSERT_EQ(record.save(&state, sizeof(state)), ESP_OK);
+  NvsFakeStats after = nvs_fake_stats();
+  EXPECT_EQ(after.writes - before.writes, 1u);
+  EXPECT_EQ(after.bytes_written - before.bytes_written, sizeof(time_t));
+
+  ASSERT_EQ(record.save(&state, sizeof(state)), ESP_OK);
+  EXPECT_EQ(nvs_fake_stats().writes, after.writes);
+
+  PersistentRecord reader(NAMESPACE, 1, sizeof(time_t));
+  TestState loaded = {};
+  ASSERT_TRUE(reader.load(&loaded, sizeof(loaded)));
+  EXPECT_EQ(loaded.fetched_at, 1700003600);
+}
+
+TEST_F(PersistenceTest, SavingWithoutLoadingKeepsTheNamespace) {
+  nvs_fake_put(NAMESPACE, "other", "x", 1);
+  PersistentRecord record(NAMESPACE, 1);
+  TestState state = {1, 2, 3};
+  ASSERT_EQ(record.save(&state, sizeof(state)), ESP_OK);
+  EXPECT_EQ(nvs_fake_stats().erases, 0u);
+  EXPECT_TRUE(nvs_fake_has(NAMESPACE, "other"));
+}
+
+TEST_F(PersistenceTest, LegacyKeysAreErasedOnTheFirstSave) {
+  nvs_fake_put(NAMESPACE, "forecast24", "x", 1);
+  PersistentRecord record(NAMESPACE, 1);
+  TestState state = {};
+  EXPECT_FALSE(record.load(&state, sizeof(state)));
+  ASSERT_EQ(record.save(&state, sizeof(state)), ESP_OK);
+  EXPECT_EQ(nvs_fake_stats().erases, 1u);
+  EXPECT_FALSE(nvs_fake_has(NAMESPACE, "forecast24"));
+}
+
+TEST_F(PersistenceTest, AnotherVersionLoadsNothingAndIsReplaced) {
+  TestState state = {42, 7, 0};
+  PersistentRecord old_layout(NAMESPACE, 1);
+  ASSERT_EQ(old_layout.save(&state, sizeof(state)), ESP_OK);
+
+  PersistentRecord record(NAMESPACE, 2);
+  TestState loaded = {};
+  EXPECT_FALSE(record.load(&loaded, sizeof(loaded)));
+  ASSERT_EQ(record.save(&state, sizeof(state)), ESP_OK);
+  EXPECT_EQ(nvs_fake_stats().erases, 1u);
+  PersistentRecord reader(NAMESPACE, 2);
+  EXPECT_TRUE(reader.load(&loaded, sizeof(loaded)));
+}
+
+TEST_F(PersistenceTest, BatchCommitsEachNamespaceOnce) {
+  PersistentRecord first("First", 1, sizeof(time_t));
+  PersistentRecord second("Second", 1);
+  TestState state = {1, 2, 3};
+  {
+    PersistenceBatch batch;
+    ASSERT_EQ(first.save(&state, sizeof(state)), ESP_OK);
+    state.fetched_at++;
+    ASSERT_EQ(first.save(&state, sizeof(state)), ESP_OK);
+    ASSERT_EQ(second.save(&state, sizeof(state)), ESP_OK);
+    EXPECT_EQ(nvs_fake_stats().commits, 0u);
+    EXPECT_EQ(nvs_fake_stats().opens, 2u);
+
+    // Another task commits on its own
+    std::thread([&]() {
+      PersistentRecord third("Third", 1);
+      ASSERT_EQ(third.save(&state, sizeof(state)), ESP_OK);
+    }).join();
+    EXPECT_EQ(nvs_fake_stats().commits, 1u);
+  }
+  EXPECT_EQ(nvs_fake_stats().commits, 3u);
+}
+
+TEST_F(PersistenceTest, FailedBatchCommitIsWrittenAgain) {
+  PersistentRecord first("First", 1, sizeof(time_t));
+  PersistentRecord second("Second", 1);
+  TestState state = {1, 2, 3};
+  unsigned errors = persistence_stats().errors;
+  {
+    PersistenceBatch batch;
+    ASSERT_EQ(first.save(&state, sizeof(state)), ESP_OK);
+    ASSERT_EQ(second.save(&state, sizeof(state)), ESP_OK);
+    nvs_fake_fail_commits(ESP_FAIL);
+  }
+  nvs_fake_fail_commits(ESP_OK);
+  EXPECT_EQ(persistence_stats().errors - errors, 2u);
+
+  // Neither counts as stored, the same state is written again
+  uint32_t writes = nvs_fake_stats().writes;
+  ASSERT_EQ(first.save(&state, sizeof(state)), ESP_OK);
+  ASSERT_EQ(second.save(&state, sizeof(state)), ESP_OK);
+  EXPECT_EQ(nvs_fake_stats().writes - writes, 3u);
+  // Then it is
+  ASSERT_EQ(first.save(&state, sizeof(state)), ESP_OK);
+  EXPECT_EQ(nvs_fake_stats().writes - writes, 3u);
+}
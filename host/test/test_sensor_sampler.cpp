@@ -0,0 +1,70 @@
+#include "fixtures.hpp"
+#include "partition_fake.hpp"
+#include "sensor_sampler.hpp"
+#include "sensors_fake.hpp"
+#include <gtest/gtest.h>
+#include <math.h>
+#include <memory>
+
+class SensorSamplerTest : public ::testing::Test {
+protected:
+  std::unique_ptr<HistoryStore> history{new HistoryStore()};
+  std::unique_ptr<Archive> archive;
+  PM25 pm25;
+  int sht3x;
+
+  void SetUp() override {
+    partition_fake_add("spiffs", ESP_PARTITION_TYPE_DATA,
+                       ESP_PARTITION_SUBTYPE_DATA_SPIFFS, 4 * 64 * 1024,
+                       nullptr);
+    archive.reset(new Archive());
+    ASSERT_TRUE(archive->mount(nullptr));
+  }
+
+  void TearDown() override {
+    archive.reset();
+    partition_fake_remove_all();
+  }
+};
+
+TEST_F(SensorSamplerTest, ScriptedReadingsReachHistoryAndArchive) {
+  static const SensorReading script[] = {
+      {12, 21.5f, 48.0f},
+      {NAN, 21.7f, 47.5f},
+      {15, NAN, NAN},
+  };
+  sensors_fake_script(script, 3);
+  SensorSampler sampler(history.get(), archive.get(), &pm25, &sht3x);
+  time_t now = fixture_now() - 2 * HISTORY_RAW_PERIOD_S;
+  float value;
+
+  sampler.sample(now);
+  ASSERT_TRUE(history->latest(HistoryPm25, &value));
+  EXPECT_FLOAT_EQ(value, 12);
+  ASSERT_TRUE(history->latest(HistoryTemperature, &value));
+  EXPECT_NEAR(value, 21.5f, 0.05f);
+
+  sampler.sample(now + HISTORY_RAW_PERIOD_S);
+  ASSERT_TRUE(history->latest(HistoryHumidity, &value));
+  EXPECT_NEAR(value, 47.5f, 0.05f);
+
+  sampler.sample(now + 2 * HISTORY_RAW_PERIOD_S);
+  ASSERT_TRUE(history->latest(HistoryPm25, &value));
+  EXPECT_FLOAT_EQ(value, 15);
+  EXPECT_EQ(sensors_fake_reads(), 3u);
+
+  size_t samples = archive->scan(
+      ArchiveSample, 0, INT32_MAX,
+      [](const ArchiveRecord *, void *) {}, nullptr);
+  EXPECT_EQ(samples, 3u);
+}
+
+TEST_F(SensorSamplerTest, WaitsForTheClock) {
+  static const SensorReading script[] = {{12, 21.5f, 48.0f}};
+  sensors_fake_script(script, 1);
+  SensorSampler sampler(history.get(), archive.get(), &pm25, &sht3x);
+  float value;
+  sampler.sample(3600);
+  EXPECT_FALSE(history->latest(HistoryPm25, &value));
+  EXPECT_EQ(sensors_fake_reads(), 0u);
+}
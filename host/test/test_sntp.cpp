@@ -0,0 +1,69 @@
+#include "sntp.h"
+#include "sntp_fake.hpp"
+#include <gtest/gtest.h>
+
+// Each test runs in its own process, the RTC state starts out empty
+
+// Within a few ms of what was asked for, the sync itself takes time
+#define SLACK_US 5000
+
+TEST(Sntp, SmallOffsetIsSlewed) {
+  sntp_fake_reply(200000);
+  ASSERT_TRUE(sync_ntp_time());
+  SntpFakeStats stats = sntp_fake_stats();
+  EXPECT_EQ(stats.requests, 1u);
+  EXPECT_EQ(stats.slews, 1u);
+  EXPECT_EQ(stats.steps, 0u);
+  EXPECT_NEAR(stats.shift_us, 200000, SLACK_US);
+  EXPECT_EQ(sntp_get_sync_status(), SNTP_SYNC_STATUS_COMPLETED);
+
+  NtpStatus status = ntp_status();
+  EXPECT_NEAR(status.offset_us, 200000, SLACK_US);
+  EXPECT_EQ(status.syncs, 1u);
+  EXPECT_EQ(status.steps, 0u);
+  EXPECT_EQ(status.age_s, 0);
+}
+
+TEST(Sntp, LargeOffsetIsStepped) {
+  sntp_fake_reply(-5000000);
+  ASSERT_TRUE(sync_ntp_time());
+  SntpFakeStats stats = sntp_fake_stats();
+  EXPECT_EQ(stats.steps, 1u);
+  EXPECT_EQ(stats.slews, 0u);
+  EXPECT_NEAR(stats.shift_us, -5000000, SLACK_US);
+  EXPECT_EQ(ntp_status().steps, 1u);
+}
+
+TEST(Sntp, DriftNeedsAWideEnoughWindow) {
+  EXPECT_EQ(ntp_status().age_s, -1);
+  sntp_fake_reply(0);
+  ASSERT_TRUE(sync_ntp_time());
+  EXPECT_EQ(ntp_next_interval_s(), 3600u);
+
+  // 10 minutes of jitter, not drift
+  sntp_fake_advance(600 * 1000000LL);
+  sntp_fake_reply(30000);
+  ASSERT_TRUE(sync_ntp_time());
+  EXPECT_FALSE(ntp_status().drift_valid);
+  EXPECT_EQ(ntp_next_interval_s(), 3600u);
+
+  // 36 ms in an hour is 10 ppm, a second of drift in 100000 s
+  sntp_fake_advance(3600 * 1000000LL);
+  sntp_fake_reply(36000);
+  ASSERT_TRUE(sync_ntp_time());
+  NtpStatus status = ntp_status();
+  ASSERT_TRUE(status.drift_valid);
+  EXPECT_NEAR(status.drift_ppm, 10, 1.5);
+  EXPECT_NEAR(ntp_next_interval_s(), 100000, 15000);
+  EXPECT_EQ(status.syncs, 3u);
+}
+
+TEST(Sntp, IntervalIsClampedToTwoDays) {
+  sntp_fake_reply(0);
+  ASSERT_TRUE(sync_ntp_time());
+  // Under a ppm
+  sntp_fake_advance(86400 * 1000000LL);
+  sntp_fake_reply(20000);
+  ASSERT_TRUE(sync_ntp_time());
+  EXPECT_EQ(ntp_next_interval_s(), 48u * 3600);
+}
@@ -0,0 +1,38 @@
+#include "tz_index.h"
+#include <gtest/gtest.h>
+#include <string.h>
+
+TEST(TzIndex, EntriesAreSortedByName) {
+  ASSERT_GT(tz_index_count, 0u);
+  for (size_t i = 1; i < tz_index_count; ++i) {
+    EXPECT_LT(strcmp(tz_index_pool + tz_index_entries[i - 1].name,
+                     tz_index_pool + tz_index_entries[i].name),
+              0)
+        << i;
+  }
+}
+
+TEST(TzIndex, EveryZoneIsFound) {
+  for (size_t i = 0; i < tz_index_count; ++i) {
+    const TzIndexEntry *entry = &tz_index_entries[i];
+    EXPECT_EQ(tz_index_lookup(tz_index_pool + entry->name),
+              tz_index_pool + entry->posix)
+        << tz_index_pool + entry->name;
+  }
+}
+
+TEST(TzIndex, KnownZones) {
+  EXPECT_STREQ(tz_index_lookup("Europe/Paris"), "CET-1CEST,M3.5.0,M10.5.0/3");
+  EXPECT_STREQ(tz_index_lookup("America/New_York"), "EST5EDT,M3.2.0,M11.1.0");
+  EXPECT_STREQ(tz_index_lookup("Asia/Tokyo"), "JST-9");
+  // Zones sharing a rule share its string in the pool
+  EXPECT_EQ(tz_index_lookup("Europe/Paris"), tz_index_lookup("Europe/Berlin"));
+}
+
+TEST(TzIndex, UnknownZones) {
+  EXPECT_EQ(tz_index_lookup(nullptr), nullptr);
+  EXPECT_EQ(tz_index_lookup(""), nullptr);
+  EXPECT_EQ(tz_index_lookup("Europe/Pari"), nullptr);
+  EXPECT_EQ(tz_index_lookup("Europe/Parisx"), nullptr);
+  EXPECT_EQ(tz_index_lookup("europe/paris"), nullptr);
+}
@@ -0,0 +1,80 @@
+#include "action_queue.hpp"
+#include "metrics.hpp"
+#include <esp_log.h>
+#include <esp_timer.h>
+
+static const char *TAG = "ActionQueue";
+
+ActionQueue::ActionQueue() {
+  _queue = xQueueCreateStatic(ACTION_QUEUE_LENGTH, sizeof(Action), _storage,
+                              &_queue_buffer);
+}
+
+bool ActionQueue::send(Action action, TickType_t ticks_to_wait) {
+  ActionEnum type = action.action();
+  if (type == UpdateScreen && _update_pending.exchange(true)) {
+    _coalesced[type]++;
+    return true;
+  }
+  if (action.enqueued_us() == 0) {
+    action.set_enqueued_us(esp_timer_get_time());
+  }
+  if (xQueueSend(_queue, &action, ticks_to_wait) != pdTRUE) {
+    if (type == UpdateScreen) {
+      _update_pending.store(false);
+    }
+    _dropped[type]++;
+    ESP_LOGW(TAG, "Queue full, dropping action %d", type);
+    return false;
+  }
+  _sent[type]++;
+  return true;
+}
+
+bool ActionQueue::receive(Action *action, TickType_t ticks_to_wait) {
+  if (xQueueReceive(_queue, action, ticks_to_wait) != pdTRUE) {
+    return false;
+  }
+  ActionEnum type = action->action();
+  if (type == UpdateScreen) {
+    // Requests arriving while this one is handled need a new frame
+    _update_pending.store(false);
+  }
+  int64_t latency_us = esp_timer_get_time() - action->enqueued_us();
+  metrics_observe(MetricActionWait, latency_us);
+  _received[type]++;
+  _total_latency_us[type] += latency_us;
+  if (latency_us > _max_latency_us[type]) {
+    _max_latency_us[type] = latency_us;
+  }
+  return true;
+}
+
+ActionStats ActionQueue::stats() const {
+  ActionStats stats;
+  for (int i = 0; i < ActionMax; ++i) {
+    stats.sent[i] = _sent[i];
+    stats.dropped[i] = _dropped[i];
+    stats.coalesced[i] = _coalesced[i];
+    stats.received[i] = _received[i];
+    stats.total_latency_us[i] = _total_latency_us[i];
+    stats.max_latency_us[i] = _max_latency_us[i];
+  }
+  return stats;
+}
+
+void ActionQueue::log_stats() const {
+  ActionStats s = stats();
+  for (int i = 0; i < ActionMax; ++i) {
+    if (s.sent[i] == 0 && s.dropped[i] == 0) {
+      continue;
+    }
+    ESP_LOGI(TAG,
+             "action %d: sent %lu dropped %lu coalesced %lu, latency avg %lld "
+             "us max %lld us",
+             i, (unsigned long)s.sent[i], (unsigned long)s.dropped[i],
+             (unsigned long)s.coalesced[i],
+             s.received[i] ? s.total_latency_us[i] / s.received[i] : 0,
+             s.max_latency_us[i]);
+  }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "http_manager.h"
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <type_traits>
+
+#define ACTION_QUEUE_LENGTH 16
+
+static_assert(std::is_trivially_copyable<Action>::value,
+              "Action is copied by value through the queue");
+
+typedef struct ActionStats {
+  uint32_t sent[ActionMax];
+  uint32_t dropped[ActionMax];
+  uint32_t coalesced[ActionMax];
+  uint32_t received[ActionMax];
+  int64_t total_latency_us[ActionMax];
+  int64_t max_latency_us[ActionMax];
+} ActionStats;
+
+// Fixed capacity queue of Action values backed by static storage. Repeated
+// UpdateScreen requests collapse into one pending event.
+class ActionQueue {
+public:
+  ActionQueue();
+  bool send(Action action, TickType_t ticks_to_wait = 0);
+  bool receive(Action *action, TickType_t ticks_to_wait);
+  ActionStats stats() const;
+  void log_stats() const;
+
+private:
+  StaticQueue_t _queue_buffer;
+  uint8_t _storage[ACTION_QUEUE_LENGTH * sizeof(Action)];
+  QueueHandle_t _queue;
+  std::atomic<bool> _update_pending{false};
+  std::atomic<uint32_t> _sent[ActionMax] = {};
+  std::atomic<uint32_t> _dropped[ActionMax] = {};
+  std::atomic<uint32_t> _coalesced[ActionMax] = {};
+  uint32_t _received[ActionMax] = {};
+  int64_t _total_latency_us[ActionMax] = {};
+  int64_t _max_latency_us[ActionMax] = {};
+};
@@ -0,0 +1,149 @@
+#include "ambient_light.hpp"
+#include "cores.hpp"
+#include <M5Unified.h>
+#include <algorithm>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <math.h>
+
+#define AMBIENT_SAMPLE_MS 250
+#define AMBIENT_MEASURE_MS 24
+#define AMBIENT_FADE_STEP_MS 15
+#define AMBIENT_MEDIAN_OF 5
+#define AMBIENT_EMA_ALPHA 0.3f
+#define AMBIENT_LUX_MAX 5000.0f
+#define AMBIENT_GAMMA 2.2f
+#define AMBIENT_MIN_BRIGHTNESS 1
+
+static const char *TAG = "AmbientLight";
+
+AmbientLight::AmbientLight(bh1750_handle_t sensor) : _sensor(sensor) {
+  // The eye sees light on a log scale and the backlight PWM is linear in
+  // luminance: the table spans log2(1 + lux) and applies the display gamma.
+  for (int i = 0; i < AMBIENT_LUT_SIZE; ++i) {
+    float p = (float)i / (AMBIENT_LUT_SIZE - 1);
+    float level = AMBIENT_MIN_BRIGHTNESS +
+                  (255 - AMBIENT_MIN_BRIGHTNESS) * powf(p, AMBIENT_GAMMA);
+    _lut[i] = (uint8_t)lroundf(level);
+  }
+}
+
+void AmbientLight::start(uint8_t brightness) {
+  _brightness = brightness;
+  _target.store(brightness, std::memory_order_relaxed);
+  xTaskCreatePinnedToCore(&task, "ambient_task", 3072, this, 3, &_task,
+                          CORE_NETWORK);
+}
+
+void AmbientLight::set_active(bool active) {
+  if (_active.exchange(active) != active && _task) {
+    xTaskNotifyGive(_task);
+  }
+}
+
+AmbientStats AmbientLight::stats() const {
+  return {
+      .samples = _samples.load(),
+      .errors = _errors.load(),
+      .fade_steps = _fade_steps.load(),
+  };
+}
+
+void AmbientLight::task(void *arg) { static_cast<AmbientLight *>(arg)->run(); }
+
+void AmbientLight::run() {
+  wake_sensor();
+  int64_t next_sample_us = 0;
+  for (;;) {
+    if (!_active.load()) {
+      bh1750_power_down(_sensor);
+      while (!_active.load()) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      }
+      wake_sensor();
+      next_sample_us = 0;
+    }
+    int64_t now_us = esp_timer_get_time();
+    if (now_us >= next_sample_us) {
+      sample();
+      next_sample_us = now_us + AMBIENT_SAMPLE_MS * 1000;
+    }
+    TickType_t wait;
+    if (fade_step()) {
+      wait = pdMS_TO_TICKS(AMBIENT_FADE_STEP_MS);
+    } else {
+      wait = pdMS_TO_TICKS((next_sample_us - now_us) / 1000);
+    }
+    ulTaskNotifyTake(pdTRUE, std::max<TickType_t>(wait, 1));
+  }
+}
+
+void AmbientLight::wake_sensor() {
+  bh1750_power_on(_sensor);
+  bh1750_set_measure_mode(_sensor, BH1750_CONTINUE_4LX_RES);
+  // First conversion, later reads return the latest completed one
+  vTaskDelay(pdMS_TO_TICKS(AMBIENT_MEASURE_MS));
+}
+
+void AmbientLight::sample() {
+  float lux = 0;
+  if (bh1750_get_data(_sensor, &lux) != ESP_OK) {
+    if (_errors.fetch_add(1) == 0) {
+      ESP_LOGE(TAG, "No ack, sensor not connected...");
+    }
+    return;
+  }
+  _samples.fetch_add(1, std::memory_order_relaxed);
+  _ring[_ring_head] = lux;
+  _ring_head = (_ring_head + 1) % AMBIENT_RING_SIZE;
+  if (_ring_count < AMBIENT_RING_SIZE) {
+    _ring_count++;
+  }
+  // The median rejects flicker and shadows, the average smooths the rest
+  float filtered = median();
+  if (_ema < 0) {
+    _ema = filtered;
+  } else {
+    _ema += AMBIENT_EMA_ALPHA * (filtered - _ema);
+  }
+  _lux.store(_ema, std::memory_order_relaxed);
+  _target.store(lux_to_brightness(_ema), std::memory_order_relaxed);
+}
+
+float AmbientLight::median() const {
+  float window[AMBIENT_MEDIAN_OF];
+  int count = std::min<int>(_ring_count, AMBIENT_MEDIAN_OF);
+  for (int i = 0; i < count; ++i) {
+    int index = (_ring_head + AMBIENT_RING_SIZE - 1 - i) % AMBIENT_RING_SIZE;
+    window[i] = _ring[index];
+  }
+  std::nth_element(window, window + count / 2, window + count);
+  return window[count / 2];
+}
+
+uint8_t AmbientLight::lux_to_brightness(float lux) const {
+  lux = std::min(std::max(lux, 0.0f), AMBIENT_LUX_MAX);
+  float position =
+      log2f(1 + lux) / log2f(1 + AMBIENT_LUX_MAX) * (AMBIENT_LUT_SIZE - 1);
+  int index = std::min((int)position, AMBIENT_LUT_SIZE - 2);
+  float fraction = position - index;
+  return (uint8_t)lroundf(_lut[index] +
+                          fraction * (_lut[index + 1] - _lut[index]));
+}
+
+bool AmbientLight::fade_step() {
+  int target = _target.load(std::memory_order_relaxed);
+  int delta = target - _brightness;
+  if (delta == 0) {
+    return false;
+  }
+  // Eases out: big jumps move fast, the last few levels one at a time
+  int step = delta / 8;
+  if (step == 0) {
+    step = delta > 0 ? 1 : -1;
+  }
+  _brightness += step;
+  M5.Lcd.setBrightness(_brightness);
+  _fade_steps.fetch_add(1, std::memory_order_relaxed);
+  return _brightness != target;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "bh1750.h"
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define AMBIENT_RING_SIZE 8
+#define AMBIENT_LUT_SIZE 33
+
+typedef struct AmbientStats {
+  uint32_t samples;
+  uint32_t errors;
+  uint32_t fade_steps;
+} AmbientStats;
+
+// Samples the BH1750 in continuous mode from its own task and drives the
+// backlight. Lux readings go through a median of the last samples and an
+// exponential moving average, then a log/gamma lookup table, and the backlight
+// fades towards that target. Nothing here blocks the renderer.
+class AmbientLight {
+public:
+  explicit AmbientLight(bh1750_handle_t sensor);
+  // Spawns the sampling task, fading from the current backlight level.
+  void start(uint8_t brightness);
+  // The sensor is powered down and the backlight left alone while inactive.
+  void set_active(bool active);
+  uint8_t target() const { return _target.load(std::memory_order_relaxed); }
+  float lux() const { return _lux.load(std::memory_order_relaxed); }
+  AmbientStats stats() const;
+
+private:
+  bh1750_handle_t _sensor;
+  TaskHandle_t _task = nullptr;
+  std::atomic<bool> _active{true};
+  std::atomic<uint8_t> _target{0};
+  std::atomic<float> _lux{0};
+  uint8_t _brightness = 0;
+  float _ring[AMBIENT_RING_SIZE] = {};
+  uint8_t _ring_head = 0;
+  uint8_t _ring_count = 0;
+  float _ema = -1;
+  uint8_t _lut[AMBIENT_LUT_SIZE];
+  std::atomic<uint32_t> _samples{0};
+  std::atomic<uint32_t> _errors{0};
+  std::atomic<uint32_t> _fade_steps{0};
+
+  static void task(void *arg);
+  void run();
+  void wake_sensor();
+  void sample();
+  float median() const;
+  uint8_t lux_to_brightness(float lux) const;
+  bool fade_step();
+};
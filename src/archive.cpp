@@ -0,0 +1,594 @@
+#include "archive.hpp"
+#include <algorithm>
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
+#include <math.h>
+#include <string.h>
+
+#define SEGMENT_MAGIC 0x32435241
+#define ERASED 0xFF
+#define PREFIX_DONE 0
+
+static const char *TAG = "Archive";
+
+typedef struct SegmentHeader {
+  uint32_t magic;
+  uint32_t sequence;
+  // Time of the record that made the segment the head, 0 if none did
+  uint32_t opened;
+  uint32_t crc;
+  // Cleared once the hourly records that open the segment are all written
+  uint32_t prefix;
+} SegmentHeader;
+
+typedef struct RecordHeader {
+  uint8_t type;
+  uint8_t length;
+  uint16_t crc;
+  uint32_t time;
+} RecordHeader;
+
+static_assert(sizeof(RecordHeader) == 8, "Records are 4 byte aligned");
+static_assert(ARCHIVE_SEGMENT_SIZE % ARCHIVE_BLOCK_SIZE == 0 &&
+                  ARCHIVE_BLOCK_SIZE % ARCHIVE_SECTOR_SIZE == 0,
+              "Blocks split segments and sectors split blocks");
+
+static size_t padded(size_t length) { return (length + 3) & ~(size_t)3; }
+
+static uint16_t record_crc(const RecordHeader *header, const void *payload) {
+  uint16_t crc = esp_rom_crc16_le(0, &header->type, 2);
+  crc = esp_rom_crc16_le(crc, reinterpret_cast<const uint8_t *>(&header->time),
+                         sizeof(header->time));
+  return esp_rom_crc16_le(crc, static_cast<const uint8_t *>(payload),
+                          header->length);
+}
+
+static uint32_t segment_crc(const SegmentHeader *header) {
+  return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(header),
+                          offsetof(SegmentHeader, crc));
+}
+
+static bool time_is_set(time_t now) {
+  struct tm timeinfo;
+  localtime_r(&now, &timeinfo);
+  return timeinfo.tm_year >= (2016 - 1900);
+}
+
+Archive::Archive() {
+  _lock = xSemaphoreCreateMutexStatic(&_lock_buffer);
+  _partition = esp_partition_find_first(
+      ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, nullptr);
+  if (_partition == nullptr) {
+    ESP_LOGE(TAG, "No spiffs partition");
+    return;
+  }
+  _segment_count = std::min<size_t>(_partition->size / ARCHIVE_SEGMENT_SIZE,
+                                    ARCHIVE_MAX_SEGMENTS);
+}
+
+// Reads the records of a segment in order, skipping the sectors for which
+// skip returns true, until visit returns false, and widens the ranges of the
+// blocks read. Returns the offset just past the last valid record.
+template <typename Skip, typename Visit>
+size_t Archive::walk(uint16_t segment, Skip skip, Visit visit) {
+  size_t base = (size_t)segment * ARCHIVE_SEGMENT_SIZE;
+  size_t end = base + sizeof(SegmentHeader);
+  bool complete = true;
+  for (size_t sector = base; sector < base + ARCHIVE_SEGMENT_SIZE;
+       sector += ARCHIVE_SECTOR_SIZE) {
+    if (skip(sector)) {
+      complete = false;
+      continue;
+    }
+    _stats.bytes_read += sizeof(_sector);
+    if (esp_partition_read(_partition, sector, _sector, sizeof(_sector)) !=
+        ESP_OK) {
+      _stats.corrupted++;
+      continue;
+    }
+    Block *block = &_blocks[sector / ARCHIVE_BLOCK_SIZE];
+    size_t pos = sector == base ? sizeof(SegmentHeader) : 0;
+    while (pos + sizeof(RecordHeader) <= ARCHIVE_SECTOR_SIZE) {
+      RecordHeader header;
+      memcpy(&header, _sector + pos, sizeof(header));
+      if (header.type == ERASED) {
+        break;
+      }
+      size_t size = sizeof(RecordHeader) + padded(header.length);
+      const uint8_t *payload = _sector + pos + sizeof(RecordHeader);
+      if (pos + size > ARCHIVE_SECTOR_SIZE ||
+          record_crc(&header, payload) != header.crc) {
+        // Torn write, nothing more is appended to this sector
+        _stats.corrupted++;
+        end = sector + ARCHIVE_SECTOR_SIZE;
+        break;
+      }
+      block->first = block->first ? std::min(block->first, header.time)
+                                  : header.time;
+      block->last = std::max(block->last, header.time);
+      if (!visit(header, payload, sector + pos)) {
+        return end;
+      }
+      pos += size;
+      end = sector + pos;
+    }
+  }
+  _indexed[segment] = _indexed[segment] || complete;
+  return end;
+}
+
+// Hour records from before the sample counts weigh a full hour
+#define ARCHIVE_HOUR_POINTS_SIZE offsetof(ArchiveHourRecord, counts)
+#define ARCHIVE_HOUR_SAMPLES (3600 / HISTORY_RAW_PERIOD_S)
+
+typedef struct SampleReplay {
+  HistoryStore *history;
+  // Older samples are in the hourly records already
+  time_t hourly_from;
+} SampleReplay;
+
+static void replay_hour(const ArchiveRecord *record, void *arg) {
+  if (record->length < ARCHIVE_HOUR_POINTS_SIZE) {
+    return;
+  }
+  ArchiveHourRecord hour;
+  memcpy(&hour, record->payload,
+         std::min<size_t>(record->length, sizeof(hour)));
+  if (record->length < sizeof(hour)) {
+    std::fill(hour.counts, hour.counts + HistoryMetricMax,
+              ARCHIVE_HOUR_SAMPLES);
+  }
+  static_cast<HistoryStore *>(arg)->insert_hour(record->time, hour.points,
+                                                hour.counts);
+}
+
+static void replay_sample(const ArchiveRecord *record, void *arg) {
+  if (record->length < sizeof(ArchiveSampleRecord)) {
+    return;
+  }
+  const SampleReplay *replay = static_cast<const SampleReplay *>(arg);
+  const ArchiveSampleRecord *sample =
+      static_cast<const ArchiveSampleRecord *>(record->payload);
+  float values[HistoryMetricMax];
+  for (int m = 0; m < HistoryMetricMax; ++m) {
+    values[m] = sample->values[m] == HISTORY_NO_VALUE
+                    ? NAN
+                    : history_decode((HistoryMetric)m, sample->values[m]);
+  }
+  replay->history->insert(record->time, values,
+                          record->time >= replay->hourly_from);
+}
+
+bool Archive::mount(HistoryStore *history) {
+  if (_segment_count < 2) {
+    return false;
+  }
+  int64_t start_us = esp_timer_get_time();
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  uint32_t newest = 0;
+  bool prefix_done = true;
+  for (uint16_t s = 0; s < _segment_count; ++s) {
+    SegmentHeader header;
+    _stats.bytes_read += sizeof(header);
+    esp_err_t err = esp_partition_read(
+        _partition, (size_t)s * ARCHIVE_SEGMENT_SIZE, &header, sizeof(header));
+    if (err != ESP_OK || header.magic != SEGMENT_MAGIC ||
+        header.crc != segment_crc(&header)) {
+      continue;
+    }
+    _sequence[s] = header.sequence;
+    _opened[s] = header.opened;
+    if (header.sequence > newest) {
+      newest = header.sequence;
+      _head = s;
+      prefix_done = header.prefix == PREFIX_DONE;
+    }
+  }
+  _mounted = true;
+  if (newest == 0) {
+    open_segment(0, 0);
+  } else {
+    // Only the head is walked, the other segments are indexed when scanned
+    _write_offset = walk(
+        _head, [](size_t) { return false; },
+        [](const RecordHeader &, const uint8_t *, size_t) { return true; });
+    _next_sequence = newest + 1;
+    _batch_offset = _write_offset;
+    _batch_length = 0;
+    if (!prefix_done) {
+      // Power cut while the head was being opened
+      finish_prefix(_head);
+    }
+  }
+  _stats.mount_us = esp_timer_get_time() - start_us;
+  ESP_LOGI(TAG, "%u segments, head %u at 0x%x, sequence %lu, %lld us",
+           _segment_count, _head, _write_offset, (unsigned long)newest,
+           _stats.mount_us);
+  if (history) {
+    replay(history);
+  }
+  xSemaphoreGive(_lock);
+  return true;
+}
+
+// Replays what the history tiers can hold, counted back from now or, before
+// the clock is set, from the newest record: the hourly records, then the
+// samples. Every segment but the head is aggregated in hourly records
+// already, only the head's samples go in the hour tier; an hour that began
+// in the previous segment goes on from its record.
+void Archive::replay(HistoryStore *history) {
+  int64_t start_us = esp_timer_get_time();
+  time_t now = time(nullptr);
+  if (!time_is_set(now)) {
+    now = 0;
+    size_t base = (size_t)_head * ARCHIVE_SEGMENT_SIZE;
+    for (size_t b = base / ARCHIVE_BLOCK_SIZE;
+         b < (base + ARCHIVE_SEGMENT_SIZE) / ARCHIVE_BLOCK_SIZE; ++b) {
+      now = std::max(now, (time_t)_blocks[b].last + 1);
+    }
+  }
+  time_t hours_from = now - HISTORY_HOUR_SLOTS * 3600;
+  time_t samples_from = now - HISTORY_MINUTE_SLOTS * 60;
+  samples_from -= samples_from % 3600;
+  if (_opened[_head] != 0) {
+    samples_from = std::min(samples_from, (time_t)_opened[_head]);
+  }
+  uint32_t read = _stats.bytes_read;
+  size_t hours =
+      scan_locked(ArchiveHour, hours_from, INT32_MAX, &replay_hour, history);
+  SampleReplay sample_replay = {history, (time_t)_opened[_head]};
+  size_t samples = scan_locked(ArchiveSample, samples_from, INT32_MAX,
+                               &replay_sample, &sample_replay);
+  ESP_LOGI(TAG, "Replayed %u hours and %u samples from %lu bytes in %lld us",
+           hours, samples, (unsigned long)(_stats.bytes_read - read),
+           esp_timer_get_time() - start_us);
+}
+
+void Archive::append_sample(time_t time, const int16_t *values) {
+  ArchiveSampleRecord record;
+  memcpy(record.values, values, sizeof(record.values));
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  append(ArchiveSample, time, &record, sizeof(record));
+  xSemaphoreGive(_lock);
+}
+
+void Archive::append_forecast(time_t time, const Forecast24 *forecast) {
+  // The snapshot is already in the archive's fixed-point encoding
+  static_assert(sizeof(ArchiveForecastRecord) == sizeof(Forecast24),
+                "forecast record out of sync");
+  ArchiveForecastRecord record;
+  memcpy(record.temperature, forecast->temperature_2m,
+         sizeof(record.temperature));
+  memcpy(record.precipitation_probability,
+         forecast->precipitation_probability,
+         sizeof(record.precipitation_probability));
+  memcpy(record.uv_index, forecast->uv_index, sizeof(record.uv_index));
+  memcpy(record.weather_code, forecast->weather_code,
+         sizeof(record.weather_code));
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  append(ArchiveForecast, time, &record, sizeof(record));
+  xSemaphoreGive(_lock);
+}
+
+void Archive::append(ArchiveRecordType type, time_t time, const void *payload,
+                     uint8_t length) {
+  if (!_mounted) {
+    _stats.dropped++;
+    return;
+  }
+  size_t size = sizeof(RecordHeader) + padded(length);
+  size_t offset = _write_offset;
+  size_t sector_end = (offset / ARCHIVE_SECTOR_SIZE + 1) * ARCHIVE_SECTOR_SIZE;
+  if (offset + size > sector_end) {
+    offset = sector_end;
+  }
+  if (offset + size > ((size_t)_head + 1) * ARCHIVE_SEGMENT_SIZE) {
+    if (_compacting) {
+      _stats.dropped++;
+      return;
+    }
+    flush_locked();
+    if (!open_segment((_head + 1) % _segment_count, time)) {
+      _stats.dropped++;
+      return;
+    }
+    offset = _write_offset;
+  }
+  if (offset + size - _batch_offset > ARCHIVE_BATCH_SIZE) {
+    flush_locked();
+    _batch_offset = offset;
+  }
+  // Whatever the record skips up to its sector stays erased
+  size_t pos = offset - _batch_offset;
+  memset(_batch + _batch_length, ERASED, pos - _batch_length);
+  RecordHeader header = {
+      .type = (uint8_t)type,
+      .length = length,
+      .crc = 0,
+      .time = (uint32_t)time,
+  };
+  header.crc = record_crc(&header, payload);
+  memcpy(_batch + pos, &header, sizeof(header));
+  memcpy(_batch + pos + sizeof(header), payload, length);
+  memset(_batch + pos + sizeof(header) + length, ERASED,
+         padded(length) - length);
+  _batch_length = pos + size;
+  _write_offset = offset + size;
+
+  Block *block = &_blocks[offset / ARCHIVE_BLOCK_SIZE];
+  block->first = block->first ? std::min(block->first, header.time)
+                              : header.time;
+  block->last = std::max(block->last, header.time);
+  _stats.appended++;
+}
+
+esp_err_t Archive::flush() {
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  esp_err_t err = flush_locked();
+  xSemaphoreGive(_lock);
+  return err;
+}
+
+esp_err_t Archive::flush_locked() {
+  if (_batch_length == 0) {
+    return ESP_OK;
+  }
+  esp_err_t err =
+      esp_partition_write(_partition, _batch_offset, _batch, _batch_length);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Write at 0x%x: %s", _batch_offset, esp_err_to_name(err));
+  }
+  _stats.flushes++;
+  _stats.bytes_written += _batch_length;
+  _batch_offset += _batch_length;
+  _batch_length = 0;
+  return err;
+}
+
+// Makes segment the head for a record stamped time, 0 if there is none.
+bool Archive::open_segment(uint16_t segment, time_t time) {
+  if (!_erased[segment]) {
+    erase_segment(segment);
+  }
+  SegmentHeader header = {
+      .magic = SEGMENT_MAGIC,
+      .sequence = _next_sequence++,
+      .opened = (uint32_t)time,
+      .crc = 0,
+      .prefix = UINT32_MAX,
+  };
+  header.crc = segment_crc(&header);
+  size_t base = (size_t)segment * ARCHIVE_SEGMENT_SIZE;
+  esp_err_t err =
+      esp_partition_write(_partition, base, &header, sizeof(header));
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Segment %u: %s", segment, esp_err_to_name(err));
+    return false;
+  }
+  _erased[segment] = false;
+  _indexed[segment] = true;
+  _sequence[segment] = header.sequence;
+  _opened[segment] = header.opened;
+  _head = segment;
+  _write_offset = base + sizeof(header);
+  _batch_offset = _write_offset;
+  _batch_length = 0;
+  finish_prefix(segment);
+  return true;
+}
+
+// Opens the head with the hourly aggregates of the previous segment and the
+// hourly records of the oldest one, then erases the oldest to keep the
+// segment after the head free for the next lap. Redone at mount if power
+// was cut before the header was marked, the hours merge back the same.
+void Archive::finish_prefix(uint16_t segment) {
+  int64_t start_us = esp_timer_get_time();
+  uint16_t previous = (segment + _segment_count - 1) % _segment_count;
+  uint16_t oldest = (segment + 1) % _segment_count;
+  _compacting = true;
+  if (_sequence[previous] != 0) {
+    summarize(previous);
+  }
+  if (_sequence[oldest] != 0) {
+    carry(oldest);
+  }
+  flush_locked();
+  _compacting = false;
+  if (_sequence[oldest] != 0) {
+    erase_segment(oldest);
+    _stats.compactions++;
+  }
+  uint32_t done = PREFIX_DONE;
+  esp_err_t err = esp_partition_write(
+      _partition,
+      (size_t)segment * ARCHIVE_SEGMENT_SIZE + offsetof(SegmentHeader, prefix),
+      &done, sizeof(done));
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Segment %u prefix: %s", segment, esp_err_to_name(err));
+  }
+  ESP_LOGI(TAG, "Opened segment %u in %lld us", segment,
+           esp_timer_get_time() - start_us);
+}
+
+void Archive::erase_segment(uint16_t segment) {
+  size_t base = (size_t)segment * ARCHIVE_SEGMENT_SIZE;
+  esp_err_t err =
+      esp_partition_erase_range(_partition, base, ARCHIVE_SEGMENT_SIZE);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Erase segment %u: %s", segment, esp_err_to_name(err));
+  }
+  _stats.erases++;
+  _erased[segment] = err == ESP_OK;
+  _indexed[segment] = false;
+  _sequence[segment] = 0;
+  _opened[segment] = 0;
+  for (size_t b = base / ARCHIVE_BLOCK_SIZE;
+       b < (base + ARCHIVE_SEGMENT_SIZE) / ARCHIVE_BLOCK_SIZE; ++b) {
+    _blocks[b] = {};
+  }
+}
+
+// Appends one hourly record per hour of samples in the segment.
+void Archive::summarize(uint16_t segment) {
+  typedef struct Hour {
+    uint32_t start;
+    int32_t sum[HistoryMetricMax];
+    int32_t count[HistoryMetricMax];
+    int16_t min[HistoryMetricMax];
+    int16_t max[HistoryMetricMax];
+  } Hour;
+
+  Hour hour = {};
+  auto emit = [&]() {
+    if (hour.start == 0) {
+      return;
+    }
+    ArchiveHourRecord record;
+    for (int m = 0; m < HistoryMetricMax; ++m) {
+      record.counts[m] = (uint16_t)std::min<int32_t>(hour.count[m], UINT16_MAX);
+      if (hour.count[m] == 0) {
+        record.points[m] = {HISTORY_NO_VALUE, HISTORY_NO_VALUE,
+                            HISTORY_NO_VALUE};
+        continue;
+      }
+      int32_t avg = hour.sum[m] / hour.count[m];
+      record.points[m] = {hour.min[m], (int16_t)avg, hour.max[m]};
+    }
+    append(ArchiveHour, hour.start, &record, sizeof(record));
+  };
+  walk(
+      segment, [](size_t) { return false; },
+      [&](const RecordHeader &header, const uint8_t *payload, size_t) {
+        if (header.type != ArchiveSample ||
+            header.length < sizeof(ArchiveSampleRecord)) {
+          return true;
+        }
+        ArchiveSampleRecord sample;
+        memcpy(&sample, payload, sizeof(sample));
+        uint32_t start = header.time - header.time % 3600;
+        if (start != hour.start) {
+          emit();
+          hour = {};
+          hour.start = start;
+          for (int m = 0; m < HistoryMetricMax; ++m) {
+            hour.min[m] = INT16_MAX;
+            hour.max[m] = INT16_MIN;
+          }
+        }
+        for (int m = 0; m < HistoryMetricMax; ++m) {
+          int16_t value = sample.values[m];
+          if (value == HISTORY_NO_VALUE) {
+            continue;
+          }
+          hour.sum[m] += value;
+          hour.count[m]++;
+          hour.min[m] = std::min(hour.min[m], value);
+          hour.max[m] = std::max(hour.max[m], value);
+        }
+        return true;
+      });
+  emit();
+}
+
+// Moves the hourly records of the segment within the retention to the head.
+void Archive::carry(uint16_t segment) {
+  time_t now = time(nullptr);
+  bool expire = time_is_set(now);
+  walk(
+      segment, [](size_t) { return false; },
+      [&](const RecordHeader &header, const uint8_t *payload, size_t) {
+        if (header.type != ArchiveHour) {
+          return false;
+        }
+        if (!expire || header.time + ARCHIVE_HOUR_RETENTION_S > now) {
+          append(ArchiveHour, header.time, payload, header.length);
+        }
+        return true;
+      });
+}
+
+// Whether every sample and forecast of the segment is older than time: they
+// were all stamped before the segment that follows it was opened.
+bool Archive::ends_before(uint16_t segment, time_t time) const {
+  uint16_t next = (segment + 1) % _segment_count;
+  return _sequence[next] == _sequence[segment] + 1 && _opened[next] != 0 &&
+         (time_t)_opened[next] < time;
+}
+
+size_t Archive::scan_segment(uint16_t segment, ArchiveRecordType type,
+                             time_t from, time_t to, ArchiveVisitor visitor,
+                             void *arg) {
+  // Hourly records only open a segment, the rest is live records
+  bool hours = type == ArchiveHour;
+  if (!hours && ends_before(segment, from)) {
+    return 0;
+  }
+  size_t count = 0;
+  walk(
+      segment,
+      [&](size_t sector) {
+        const Block *block = &_blocks[sector / ARCHIVE_BLOCK_SIZE];
+        return _indexed[segment] &&
+               (block->last == 0 || (time_t)block->last < from ||
+                (time_t)block->first >= to);
+      },
+      [&](const RecordHeader &header, const uint8_t *payload, size_t) {
+        if (header.type != type) {
+          return !hours;
+        }
+        if ((time_t)header.time < from || (time_t)header.time >= to) {
+          return true;
+        }
+        ArchiveRecord record = {
+            .type = type,
+            .time = (time_t)header.time,
+            .length = header.length,
+            .payload = payload,
+        };
+        visitor(&record, arg);
+        count++;
+        return true;
+      });
+  return count;
+}
+
+size_t Archive::scan_locked(ArchiveRecordType type, time_t from, time_t to,
+                            ArchiveVisitor visitor, void *arg) {
+  flush_locked();
+  size_t count = 0;
+  uint32_t after = 0;
+  for (;;) {
+    int oldest = -1;
+    for (uint16_t s = 0; s < _segment_count; ++s) {
+      if (_sequence[s] > after &&
+          (oldest < 0 || _sequence[s] < _sequence[oldest])) {
+        oldest = s;
+      }
+    }
+    if (oldest < 0) {
+      break;
+    }
+    after = _sequence[oldest];
+    count += scan_segment(oldest, type, from, to, visitor, arg);
+  }
+  return count;
+}
+
+size_t Archive::scan(ArchiveRecordType type, time_t from, time_t to,
+                     ArchiveVisitor visitor, void *arg) {
+  if (!_mounted) {
+    return 0;
+  }
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  size_t count = scan_locked(type, from, to, visitor, arg);
+  xSemaphoreGive(_lock);
+  return count;
+}
+
+ArchiveStats Archive::stats() const {
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  ArchiveStats stats = _stats;
+  xSemaphoreGive(_lock);
+  return stats;
+}
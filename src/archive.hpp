@@ -0,0 +1,137 @@
+#pragma once
+
+#include "forecast.hpp"
+#include "history.hpp"
+#include <esp_partition.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define ARCHIVE_SECTOR_SIZE 4096
+#define ARCHIVE_SEGMENT_SIZE (64 * 1024)
+#define ARCHIVE_BLOCK_SIZE (16 * 1024)
+#define ARCHIVE_MAX_SEGMENTS 64
+#define ARCHIVE_MAX_BLOCKS \
+  (ARCHIVE_MAX_SEGMENTS * ARCHIVE_SEGMENT_SIZE / ARCHIVE_BLOCK_SIZE)
+#define ARCHIVE_BATCH_SIZE 512
+#define ARCHIVE_HOUR_RETENTION_S (366 * 24 * 3600)
+
+typedef enum ArchiveRecordType {
+  ArchiveSample = 1,
+  ArchiveHour = 2,
+  ArchiveForecast = 3,
+} ArchiveRecordType;
+
+// Record payloads, fixed-point like the history store.
+typedef struct ArchiveSampleRecord {
+  int16_t values[HistoryMetricMax];
+} ArchiveSampleRecord;
+
+typedef struct ArchiveHourRecord {
+  HistoryPoint points[HistoryMetricMax];
+  // Samples behind each point, absent from records of older firmwares
+  uint16_t counts[HistoryMetricMax];
+} ArchiveHourRecord;
+
+typedef struct ArchiveForecastRecord {
+  int16_t temperature[24];
+  uint8_t precipitation_probability[24];
+  uint8_t uv_index[24];
+  uint8_t weather_code[24];
+} ArchiveForecastRecord;
+
+typedef struct ArchiveRecord {
+  ArchiveRecordType type;
+  time_t time;
+  uint8_t length;
+  const void *payload;
+} ArchiveRecord;
+
+typedef struct ArchiveStats {
+  uint32_t appended;
+  uint32_t flushes;
+  uint32_t bytes_written;
+  uint32_t erases;
+  uint32_t compactions;
+  uint32_t corrupted;
+  uint32_t dropped;
+  uint32_t bytes_read;
+  int64_t mount_us;
+} ArchiveStats;
+
+typedef void (*ArchiveVisitor)(const ArchiveRecord *record, void *arg);
+
+// Append-only log of CRC-framed records in the spiffs partition, written as
+// a ring of 64 KB segments so every sector is erased once per lap. Appends
+// are batched in RAM and records never cross a sector, so a power cut loses
+// the pending batch and at most the rest of one sector. A new segment opens
+// with the hourly aggregates of the samples of the previous one and the
+// hours carried over from the oldest one, which is then erased: hourly
+// records only ever sit at the start of a segment. Each 16 KB block keeps
+// the time range of its records in RAM once read, a range scan only reads
+// the segments and blocks that overlap it.
+class Archive {
+public:
+  Archive();
+  // Finds the head from the segment headers and the write position in it,
+  // then replays into history the hourly aggregates of the last
+  // HISTORY_HOUR_SLOTS hours and the samples of the last
+  // HISTORY_MINUTE_SLOTS minutes. The hours before the head come from their
+  // aggregates alone. Call once, before anything is appended.
+  bool mount(HistoryStore *history);
+  void append_sample(time_t time, const int16_t *values);
+  void append_forecast(time_t time, const Forecast24 *forecast);
+  esp_err_t flush();
+  // Visits the records of a type within [from, to), segment by segment from
+  // the oldest. The visitor runs under the archive lock.
+  size_t scan(ArchiveRecordType type, time_t from, time_t to,
+              ArchiveVisitor visitor, void *arg);
+  ArchiveStats stats() const;
+
+private:
+  typedef struct Block {
+    uint32_t first;
+    uint32_t last;
+  } Block;
+
+  const esp_partition_t *_partition = nullptr;
+  uint16_t _segment_count = 0;
+  bool _mounted = false;
+  bool _compacting = false;
+  uint32_t _sequence[ARCHIVE_MAX_SEGMENTS] = {};
+  // Time of the record that made each segment the head, 0 if unknown
+  uint32_t _opened[ARCHIVE_MAX_SEGMENTS] = {};
+  bool _erased[ARCHIVE_MAX_SEGMENTS] = {};
+  // The blocks of the segment hold the range of every record in it
+  bool _indexed[ARCHIVE_MAX_SEGMENTS] = {};
+  uint32_t _next_sequence = 1;
+  uint16_t _head = 0;
+  size_t _write_offset = 0;
+  Block _blocks[ARCHIVE_MAX_BLOCKS] = {};
+  alignas(4) uint8_t _batch[ARCHIVE_BATCH_SIZE];
+  size_t _batch_offset = 0;
+  size_t _batch_length = 0;
+  alignas(4) uint8_t _sector[ARCHIVE_SECTOR_SIZE];
+  StaticSemaphore_t _lock_buffer;
+  SemaphoreHandle_t _lock;
+  ArchiveStats _stats = {};
+
+  void append(ArchiveRecordType type, time_t time, const void *payload,
+              uint8_t length);
+  esp_err_t flush_locked();
+  bool open_segment(uint16_t segment, time_t time);
+  void finish_prefix(uint16_t segment);
+  void erase_segment(uint16_t segment);
+  void summarize(uint16_t segment);
+  void carry(uint16_t segment);
+  bool ends_before(uint16_t segment, time_t time) const;
+  void replay(HistoryStore *history);
+  size_t scan_segment(uint16_t segment, ArchiveRecordType type, time_t from,
+                      time_t to, ArchiveVisitor visitor, void *arg);
+  template <typename Skip, typename Visit>
+  size_t walk(uint16_t segment, Skip skip, Visit visit);
+  size_t scan_locked(ArchiveRecordType type, time_t from, time_t to,
+                     ArchiveVisitor visitor, void *arg);
+};
@@ -0,0 +1,180 @@
+#include "buttons.hpp"
+#include <algorithm>
+#include <esp_log.h>
+
+#define BUTTON_A_GPIO GPIO_NUM_39
+#define BUTTON_B_GPIO GPIO_NUM_38
+#define BUTTON_C_GPIO GPIO_NUM_37
+
+#define DEBOUNCE_US 20 * 1000
+#define DOUBLE_CLICK_US 400 * 1000
+#define LONG_PRESS_US 800 * 1000
+
+static const char *TAG = "Buttons";
+
+Buttons::Buttons(ActionQueue *actions) : _actions(actions) {
+  const gpio_num_t pins[BUTTON_COUNT] = {BUTTON_A_GPIO, BUTTON_B_GPIO,
+                                         BUTTON_C_GPIO};
+  const char names[BUTTON_COUNT] = {'A', 'B', 'C'};
+  _edges = xQueueCreate(16, sizeof(Edge));
+  gpio_install_isr_service(0);
+  for (int i = 0; i < BUTTON_COUNT; ++i) {
+    Button *button = &_buttons[i];
+    *button = {};
+    button->owner = this;
+    button->index = i;
+    button->pin = pins[i];
+    button->name = names[i];
+    const esp_timer_create_args_t settle_args = {
+        .callback = &settle_cb,
+        .arg = button,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "button_settle",
+        .skip_unhandled_events = false};
+    ESP_ERROR_CHECK(esp_timer_create(&settle_args, &button->settle_timer));
+    const esp_timer_create_args_t long_args = {
+        .callback = &long_press_cb,
+        .arg = button,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "button_long",
+        .skip_unhandled_events = false};
+    ESP_ERROR_CHECK(esp_timer_create(&long_args, &button->long_timer));
+    // The buttons are active low with external pull-ups on GPIO 37 to 39
+    gpio_config_t conf = {
+        .pin_bit_mask = 1ULL << pins[i],
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&conf));
+    button->level = gpio_get_level(pins[i]);
+    if (button->level == 0) {
+      // Held since before boot, B is the deep sleep wake pin: the press that
+      // woke the chip must not turn into a click or a long press on release
+      button->pressed_us = esp_timer_get_time();
+      button->long_fired = true;
+    }
+    // Level triggered, waiting for the opposite level, so the same interrupt
+    // can also wake the chip from light sleep
+    ESP_ERROR_CHECK(gpio_wakeup_enable(
+        pins[i], button->level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL));
+    ESP_ERROR_CHECK(gpio_isr_handler_add(pins[i], &isr_handler, button));
+    ESP_ERROR_CHECK(gpio_intr_enable(pins[i]));
+  }
+}
+
+void Buttons::isr_handler(void *arg) {
+  Button *button = static_cast<Button *>(arg);
+  gpio_set_intr_type(button->pin, gpio_get_level(button->pin)
+                                      ? GPIO_INTR_LOW_LEVEL
+                                      : GPIO_INTR_HIGH_LEVEL);
+  Edge edge = {.index = button->index,
+               .type = EventEdge,
+               .time_us = esp_timer_get_time()};
+  BaseType_t woken = pdFALSE;
+  xQueueSendFromISR(button->owner->_edges, &edge, &woken);
+  if (woken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+// Timer callbacks run on the esp_timer task, the state stays with run()
+void Buttons::settle_cb(void *arg) {
+  post(static_cast<Button *>(arg), EventSettled);
+}
+
+void Buttons::long_press_cb(void *arg) {
+  post(static_cast<Button *>(arg), EventHeld);
+}
+
+void Buttons::post(Button *button, EventType type) {
+  Edge edge = {.index = button->index,
+               .type = static_cast<uint8_t>(type),
+               .time_us = esp_timer_get_time()};
+  if (xQueueSend(button->owner->_edges, &edge, 0) != pdTRUE) {
+    ESP_LOGW(TAG, "Button %c event %d dropped", button->name, type);
+  }
+}
+
+static void start_timer(esp_timer_handle_t timer, int64_t timeout_us) {
+  if (esp_timer_is_active(timer)) {
+    esp_timer_stop(timer);
+  }
+  ESP_ERROR_CHECK(
+      esp_timer_start_once(timer, std::max<int64_t>(timeout_us, 0)));
+}
+
+void Buttons::run() {
+  Edge edge;
+  while (1) {
+    if (!xQueueReceive(_edges, &edge, portMAX_DELAY)) {
+      continue;
+    }
+    Button *button = &_buttons[edge.index];
+    int64_t now_us = esp_timer_get_time();
+    switch (edge.type) {
+    case EventEdge:
+      // Every bounce pushes the deadline back, the press keeps its first
+      // edge
+      if (button->settle_us == 0) {
+        button->edge_us = edge.time_us;
+      }
+      button->settle_us = edge.time_us + DEBOUNCE_US;
+      start_timer(button->settle_timer, button->settle_us - now_us);
+      break;
+    case EventSettled:
+      // A bounce queued behind the expiry moved the deadline on
+      if (button->settle_us && now_us >= button->settle_us) {
+        settle(button, now_us);
+      }
+      break;
+    case EventHeld:
+      if (button->level == 0 && !button->long_fired &&
+          now_us >= button->pressed_us + LONG_PRESS_US) {
+        button->long_fired = true;
+        button->last_click_us = 0;
+        emit(ButtonLongPressed, *button, now_us);
+      }
+      break;
+    }
+  }
+}
+
+void Buttons::settle(Button *button, int64_t now_us) {
+  button->settle_us = 0;
+  int level = gpio_get_level(button->pin);
+  if (level == button->level) {
+    return;
+  }
+  button->level = level;
+  if (level == 0) {
+    button->pressed_us = button->edge_us;
+    button->long_fired = false;
+    start_timer(button->long_timer,
+                button->pressed_us + LONG_PRESS_US - now_us);
+    return;
+  }
+  if (esp_timer_is_active(button->long_timer)) {
+    esp_timer_stop(button->long_timer);
+  }
+  if (button->long_fired) {
+    return;
+  }
+  emit(ButtonClicked, *button, button->edge_us);
+  if (button->last_click_us &&
+      button->edge_us - button->last_click_us < DOUBLE_CLICK_US) {
+    emit(ButtonDoubleClicked, *button, button->edge_us);
+    button->last_click_us = 0;
+  } else {
+    button->last_click_us = button->edge_us;
+  }
+}
+
+void Buttons::emit(ActionEnum type, const Button &button, int64_t time_us) {
+  ESP_LOGI(TAG, "Button %c action %d", button.name, type);
+  Action action(type, button.name);
+  // Latency is measured from the edge, not from the post
+  action.set_enqueued_us(time_us);
+  _actions->send(action, 100);
+}
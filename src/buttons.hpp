@@ -0,0 +1,60 @@
+#pragma once
+
+#include "action_queue.hpp"
+#include <driver/gpio.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+#define BUTTON_COUNT 3
+
+// GPIO interrupt driven front panel buttons. Edges are debounced and turned
+// into click, double click and long press actions without polling: the task
+// blocks on its queue with no timeout, the debounce and long press deadlines
+// are esp_timer one-shots posting to the same queue.
+class Buttons {
+public:
+  explicit Buttons(ActionQueue *actions);
+  // Dispatches button actions forever from the calling task.
+  void run();
+
+private:
+  typedef enum EventType {
+    EventEdge,
+    EventSettled,
+    EventHeld,
+    EventTypeMax,
+  } EventType;
+
+  // An edge from the interrupt, or a deadline from a button's timers
+  typedef struct Edge {
+    uint8_t index;
+    uint8_t type;
+    int64_t time_us;
+  } Edge;
+
+  typedef struct Button {
+    Buttons *owner;
+    uint8_t index;
+    gpio_num_t pin;
+    char name;
+    int level;
+    int64_t edge_us;
+    int64_t settle_us;
+    int64_t pressed_us;
+    int64_t last_click_us;
+    bool long_fired;
+    esp_timer_handle_t settle_timer;
+    esp_timer_handle_t long_timer;
+  } Button;
+
+  ActionQueue *_actions;
+  QueueHandle_t _edges;
+  Button _buttons[BUTTON_COUNT];
+  static void isr_handler(void *arg);
+  static void settle_cb(void *arg);
+  static void long_press_cb(void *arg);
+  static void post(Button *button, EventType type);
+  void settle(Button *button, int64_t now_us);
+  void emit(ActionEnum type, const Button &button, int64_t time_us);
+};
@@ -0,0 +1,47 @@
+#include "cores.hpp"
+#include "text_builder.hpp"
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stdlib.h>
+
+#if CONFIG_CLOCK_CORE_LOAD_STATS
+static const char *TAG = "Cores";
+
+typedef decltype(TaskStatus_t::ulRunTimeCounter) RunTime;
+
+static RunTime last_idle[portNUM_PROCESSORS];
+static RunTime last_total;
+
+void cores_log_load(void) {
+  // Some slack for tasks created in between
+  UBaseType_t size = uxTaskGetNumberOfTasks() + 4;
+  TaskStatus_t *tasks =
+      static_cast<TaskStatus_t *>(malloc(size * sizeof(TaskStatus_t)));
+  if (tasks == nullptr) {
+    return;
+  }
+  RunTime total = 0;
+  UBaseType_t count = uxTaskGetSystemState(tasks, size, &total);
+  for (int core = 0; core < portNUM_PROCESSORS; ++core) {
+    TaskHandle_t idle_task = xTaskGetIdleTaskHandleForCPU(core);
+    for (UBaseType_t i = 0; i < count; ++i) {
+      if (tasks[i].xHandle != idle_task) {
+        continue;
+      }
+      RunTime idle = tasks[i].ulRunTimeCounter;
+      RunTime elapsed = total - last_total;
+      if (elapsed) {
+        float busy = 100.0f - 100.0f * (idle - last_idle[core]) / elapsed;
+        ESP_LOGI(TAG, "core %d: %s%% busy", core,
+                 TextBuilder().decimal(busy, 1).c_str());
+      }
+      last_idle[core] = idle;
+    }
+  }
+  last_total = total;
+  free(tasks);
+}
+#else
+void cores_log_load(void) {}
+#endif
@@ -0,0 +1,11 @@
+#pragma once
+
+// Network, sensors and persistence share the core of the Wi-Fi and lwIP
+// tasks. Input handling and rendering get the other one to themselves.
+#define CORE_NETWORK 0
+#define CORE_RENDER 1
+
+// Share of each core spent outside its idle task since the previous call.
+// Only with CONFIG_CLOCK_CORE_LOAD_STATS, which enables the FreeRTOS run
+// time counters.
+void cores_log_load(void);
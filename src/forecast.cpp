@@ -0,0 +1,57 @@
+#include "forecast.hpp"
+#include <algorithm>
+#include <math.h>
+
+int16_t forecast_encode_temperature(float celsius) {
+  if (isnan(celsius)) {
+    return FORECAST_NO_TEMPERATURE;
+  }
+  // Clamped before rounding, lroundf of an out of range value is undefined
+  float tenths = std::min(
+      std::max(celsius * 10, FORECAST_NO_TEMPERATURE + 1.0f), (float)INT16_MAX);
+  return (int16_t)lroundf(tenths);
+}
+
+float forecast_decode_temperature(int16_t tenths) {
+  return tenths == FORECAST_NO_TEMPERATURE ? NAN : tenths / 10.0f;
+}
+
+uint8_t forecast_encode_percent(float percent) {
+  if (isnan(percent)) {
+    return FORECAST_NO_VALUE;
+  }
+  return (uint8_t)lroundf(std::min(std::max(percent, 0.0f), 100.0f));
+}
+
+float forecast_decode_percent(uint8_t percent) {
+  return percent == FORECAST_NO_VALUE ? NAN : percent;
+}
+
+uint8_t forecast_encode_uv(float uv_index) {
+  if (isnan(uv_index)) {
+    return FORECAST_NO_VALUE;
+  }
+  return (uint8_t)lroundf(std::min(std::max(uv_index * 10, 0.0f),
+                                   FORECAST_NO_VALUE - 1.0f));
+}
+
+float forecast_decode_uv(uint8_t tenths) {
+  return tenths == FORECAST_NO_VALUE ? NAN : tenths / 10.0f;
+}
+
+uint8_t forecast_encode_code(float code) {
+  // WMO codes run from 0 to 99
+  if (isnan(code) || code < 0 || code >= FORECAST_NO_VALUE) {
+    return 0;
+  }
+  return (uint8_t)code;
+}
+
+uint16_t forecast_encode_minutes(time_t time) {
+  if (time == 0) {
+    return FORECAST_NO_MINUTES;
+  }
+  struct tm tm;
+  localtime_r(&time, &tm);
+  return tm.tm_hour * 60 + tm.tm_min;
+}
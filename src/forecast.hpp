@@ -0,0 +1,93 @@
+#pragma once
+
+#include "open_meteo.hpp"
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define FORECAST_NO_TEMPERATURE INT16_MIN
+#define FORECAST_NO_VALUE UINT8_MAX
+#define FORECAST_NO_MINUTES UINT16_MAX
+
+// Fixed-point forecast values: temperatures in tenths of a degree, UV index
+// in tenths, precipitation probability in percent and sun times in minutes
+// after local midnight. Missing values (NaN) encode to the FORECAST_NO_*
+// sentinels and decode back to NaN.
+int16_t forecast_encode_temperature(float celsius);
+float forecast_decode_temperature(int16_t tenths);
+uint8_t forecast_encode_percent(float percent);
+float forecast_decode_percent(uint8_t percent);
+uint8_t forecast_encode_uv(float uv_index);
+float forecast_decode_uv(uint8_t tenths);
+uint8_t forecast_encode_code(float code);
+uint16_t forecast_encode_minutes(time_t time);
+
+// Hourly values, N hours from a start the owner knows.
+template <size_t N> struct ForecastHours {
+  int16_t temperature_2m[N] = {};
+  uint8_t precipitation_probability[N] = {};
+  uint8_t uv_index[N] = {};
+  uint8_t weather_code[N] = {};
+
+  float temperature(int i) const {
+    return forecast_decode_temperature(temperature_2m[i]);
+  }
+  float precipitation(int i) const {
+    return forecast_decode_percent(precipitation_probability[i]);
+  }
+  float uv(int i) const { return forecast_decode_uv(uv_index[i]); }
+  OM_SDK::WeatherCode code(int i) const {
+    return static_cast<OM_SDK::WeatherCode>(weather_code[i]);
+  }
+};
+
+typedef ForecastHours<24> Forecast24;
+typedef ForecastHours<2> ForecastTmr;
+
+typedef struct Forecast7 {
+  int16_t temperature_2m_max[7] = {};
+  int16_t temperature_2m_min[7] = {};
+  // No sun times until a forecast brings them, midnight is a valid one
+  uint16_t sunset[7] = {FORECAST_NO_MINUTES, FORECAST_NO_MINUTES,
+                        FORECAST_NO_MINUTES, FORECAST_NO_MINUTES,
+                        FORECAST_NO_MINUTES, FORECAST_NO_MINUTES,
+                        FORECAST_NO_MINUTES};
+  uint16_t sunrise[7] = {FORECAST_NO_MINUTES, FORECAST_NO_MINUTES,
+                         FORECAST_NO_MINUTES, FORECAST_NO_MINUTES,
+                         FORECAST_NO_MINUTES, FORECAST_NO_MINUTES,
+                         FORECAST_NO_MINUTES};
+  uint8_t precipitation_probability_max[7] = {};
+  uint8_t uv_index_max[7] = {};
+  uint8_t weather_code[7] = {};
+  // Explicit padding, persisted snapshots are checksummed byte for byte
+  uint8_t reserved = 0;
+
+  float temperature_max(int day) const {
+    return forecast_decode_temperature(temperature_2m_max[day]);
+  }
+  float temperature_min(int day) const {
+    return forecast_decode_temperature(temperature_2m_min[day]);
+  }
+  float precipitation_max(int day) const {
+    return forecast_decode_percent(precipitation_probability_max[day]);
+  }
+  float uv_max(int day) const { return forecast_decode_uv(uv_index_max[day]); }
+  OM_SDK::WeatherCode code(int day) const {
+    return static_cast<OM_SDK::WeatherCode>(weather_code[day]);
+  }
+} Forecast7;
+
+// Everything a weather refresh keeps, packed: it is what goes to NVS.
+typedef struct WeatherSnapshot {
+  Forecast24 forecast24;
+  Forecast7 forecast7;
+  ForecastTmr forecast_tmr;
+  time_t fetched_at = 0;
+} WeatherSnapshot;
+
+static_assert(sizeof(Forecast24) == 24 * 5 && sizeof(ForecastTmr) == 2 * 5 &&
+                  sizeof(Forecast7) == 7 * 11 + 1 &&
+                  sizeof(WeatherSnapshot) ==
+                      sizeof(Forecast24) + sizeof(Forecast7) +
+                          sizeof(ForecastTmr) + sizeof(time_t),
+              "No implicit padding in a weather snapshot");
@@ -0,0 +1,99 @@
+#include "forecast_view.hpp"
+#include <esp_log.h>
+
+static const char *TAG = "ForecastView";
+
+template <typename T>
+static Span<T> make_span(const flatbuffers::Vector<T> *values) {
+  Span<T> span;
+  if (values) {
+    span.data = values->data();
+    span.size = values->size();
+  }
+  return span;
+}
+
+ForecastView::ForecastView(const openmeteo_sdk::WeatherApiResponse *response) {
+  if (response == nullptr) {
+    return;
+  }
+  resolve_hourly(response->hourly());
+  resolve_daily(response->daily());
+}
+
+int ForecastView::hour_index(time_t timestamp) const {
+  if (_hourly_interval <= 0 || timestamp < _hourly_start ||
+      timestamp >= _hourly_end) {
+    return -1;
+  }
+  return (timestamp - _hourly_start) / _hourly_interval;
+}
+
+void ForecastView::resolve_hourly(
+    const openmeteo_sdk::VariablesWithTime *hourly) {
+  if (hourly == nullptr || hourly->variables() == nullptr) {
+    return;
+  }
+  _hourly_start = hourly->time();
+  _hourly_end = hourly->time_end();
+  _hourly_interval = hourly->interval();
+  for (auto data : *hourly->variables()) {
+    HourlyVariable variable;
+    switch (data->variable()) {
+    case openmeteo_sdk::Variable_temperature:
+      variable = HourlyTemperature;
+      break;
+    case openmeteo_sdk::Variable_precipitation_probability:
+      variable = HourlyPrecipitationProbability;
+      break;
+    case openmeteo_sdk::Variable_weather_code:
+      variable = HourlyWeatherCode;
+      break;
+    case openmeteo_sdk::Variable_uv_index:
+      variable = HourlyUvIndex;
+      break;
+    default:
+      ESP_LOGE(TAG, "Not Treated hourly %s",
+               openmeteo_sdk::EnumNameVariable(data->variable()));
+      continue;
+    }
+    _hourly[variable] = make_span(data->values());
+  }
+}
+
+void ForecastView::resolve_daily(
+    const openmeteo_sdk::VariablesWithTime *daily) {
+  if (daily == nullptr || daily->variables() == nullptr) {
+    return;
+  }
+  for (auto data : *daily->variables()) {
+    switch (data->variable()) {
+    case openmeteo_sdk::Variable_weather_code:
+      _daily[DailyWeatherCode] = make_span(data->values());
+      break;
+    case openmeteo_sdk::Variable_temperature:
+      if (data->aggregation() == openmeteo_sdk::Aggregation_maximum) {
+        _daily[DailyTemperatureMax] = make_span(data->values());
+      } else if (data->aggregation() == openmeteo_sdk::Aggregation_minimum) {
+        _daily[DailyTemperatureMin] = make_span(data->values());
+      }
+      break;
+    case openmeteo_sdk::Variable_precipitation_probability:
+      _daily[DailyPrecipitationProbabilityMax] = make_span(data->values());
+      break;
+    case openmeteo_sdk::Variable_uv_index:
+      _daily[DailyUvIndexMax] = make_span(data->values());
+      break;
+    case openmeteo_sdk::Variable_sunrise:
+      _daily_int64[DailySunrise] = make_span(data->values_int64());
+      break;
+    case openmeteo_sdk::Variable_sunset:
+      _daily_int64[DailySunset] = make_span(data->values_int64());
+      break;
+    default:
+      ESP_LOGE(TAG, "Not Treated daily %s",
+               openmeteo_sdk::EnumNameVariable(data->variable()));
+      break;
+    }
+  }
+}
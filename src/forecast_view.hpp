@@ -0,0 +1,54 @@
+#pragma once
+
+#include "span.hpp"
+#include "weather_api_generated.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+typedef enum HourlyVariable {
+  HourlyTemperature,
+  HourlyPrecipitationProbability,
+  HourlyWeatherCode,
+  HourlyUvIndex,
+  HourlyMax,
+} HourlyVariable;
+
+typedef enum DailyVariable {
+  DailyWeatherCode,
+  DailyTemperatureMax,
+  DailyTemperatureMin,
+  DailyPrecipitationProbabilityMax,
+  DailyUvIndexMax,
+  DailySunrise,
+  DailySunset,
+  DailyMax,
+} DailyVariable;
+
+// Typed read-only spans over a WeatherApiResponse. The variables are looked
+// up once when the view is built, the spans then point straight into the
+// flatbuffer so the response must outlive the view.
+class ForecastView {
+public:
+  explicit ForecastView(const openmeteo_sdk::WeatherApiResponse *response);
+  Span<float> hourly(HourlyVariable variable) const {
+    return _hourly[variable];
+  }
+  Span<float> daily(DailyVariable variable) const { return _daily[variable]; }
+  Span<int64_t> daily_int64(DailyVariable variable) const {
+    return _daily_int64[variable];
+  }
+  time_t hourly_start() const { return _hourly_start; }
+  // Index of the hourly sample covering the timestamp, -1 if out of range.
+  int hour_index(time_t timestamp) const;
+
+private:
+  Span<float> _hourly[HourlyMax];
+  Span<float> _daily[DailyMax];
+  Span<int64_t> _daily_int64[DailyMax];
+  time_t _hourly_start = 0;
+  time_t _hourly_end = 0;
+  int32_t _hourly_interval = 0;
+  void resolve_hourly(const openmeteo_sdk::VariablesWithTime *hourly);
+  void resolve_daily(const openmeteo_sdk::VariablesWithTime *daily);
+};
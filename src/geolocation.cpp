@@ -1,225 +1,159 @@
 #include "geolocation.hpp"
-#include "ipgeolocation_io.hpp"
+#include "http_client.hpp"
+#include "json_extractor.hpp"
+#include "tz_index.h"
 
-#include <esp_crt_bundle.h>
-#include <esp_http_client.h>
 #include <esp_log.h>
-#include <nvs.h>
-#include <string>
+#include <stdlib.h>
+#include <string.h>
 
 #define TAG "geolocation"
 #define ARRAY_LENGTH(array) (sizeof((array)) / sizeof((array)[0]))
-#define MAX_HTTP_OUTPUT_BUFFER_CALLOC 2 * 1024
 
 #define NVS_NAMESPACE "GEO"
-#define NVS_TZ "TZ"
-#define NVS_CITY "CITY"
-#define NVS_COUNTRY "COUNTRY"
-#define NVS_LATITUDE "LAT"
-#define NVS_LONGITUDE "LONG"
-#define NVS_IP "IP"
+#define NVS_VERSION 2
 
-extern const uint8_t zone_json_start[] asm("_binary_zones_json_start");
-extern const uint8_t zone_json_end[] asm("_binary_zones_json_end");
+#define IPGEOLOCATION_URL "https://api.ipgeolocation.io/ipgeo"
+#define IPGEOLOCATION_FIELDS "city,country_name,time_zone,latitude,longitude"
 
-int http_get(esp_http_client_config_t *config, esp_http_client_handle_t client,
-             char *output_buffer);
 int get_public_ip6(esp_ip6_addr_t *ip);
-void load_float(nvs_handle_t handle, const char *key, float *value);
-void load_string(nvs_handle_t handle, const char *key, char *value);
-esp_err_t save_float(nvs_handle_t handle, const char *key, float value);
-esp_err_t save_string(nvs_handle_t handle, const char *key, const char *value);
 
 Geolocation::Geolocation()
-    : _latitude{0.0}, _longitude{0.0}, _city{""}, _country{""}, _tz{""},
-      _posix_tz{""}, _ip_set{false} {
+    : _record(NVS_NAMESPACE, NVS_VERSION), _latitude{0.0}, _longitude{0.0},
+      _city{""}, _country{""}, _tz{""}, _posix_tz{""}, _public_ip{},
+      _ip_set{false} {
   restore_data();
 }
 
+static bool feed_extractor(const uint8_t *data, size_t length, void *arg) {
+  return static_cast<JsonExtractor *>(arg)->feed(
+      reinterpret_cast<const char *>(data), length);
+}
+
 int Geolocation::update_geoloc() {
   ESP_LOGI(TAG, "Updating");
-  esp_ip6_addr_t ip;
-  int response_code = get_public_ip6(&ip);
-  if (response_code == 200) {
-    if (_ip_set && !memcmp(&ip, &_public_ip, sizeof(ip))) {
-      ESP_LOGI(TAG, "Public ip did not change, canceling update");
-      download_posix_tz();
-      return 200;
-    }
+  esp_ip6_addr_t ip = {};
+  bool ip_known = get_public_ip6(&ip) == 200;
+  // Field by field, the padding after the zone is not part of the address
+  if (ip_known && _ip_set &&
+      !memcmp(ip.addr, _public_ip.addr, sizeof(ip.addr)) &&
+      ip.zone == _public_ip.zone) {
+    ESP_LOGI(TAG, "Public ip did not change, canceling update");
+    download_posix_tz();
+    return 200;
+  }
+
+  // Parsed as it arrives into buffers the size of the members, only copied
+  // over once the whole response is in
+  char city[sizeof(_city)];
+  char country[sizeof(_country)];
+  char tz[sizeof(_tz)];
+  char latitude[16];
+  char longitude[16];
+  JsonField fields[] = {
+      {.path = "city", .value = city, .size = sizeof(city)},
+      {.path = "country_name", .value = country, .size = sizeof(country)},
+      {.path = "time_zone.name", .value = tz, .size = sizeof(tz)},
+      {.path = "latitude", .value = latitude, .size = sizeof(latitude)},
+      {.path = "longitude", .value = longitude, .size = sizeof(longitude)},
+  };
+  JsonExtractor extractor(fields, ARRAY_LENGTH(fields));
+  uint8_t chunk[128];
+  HttpResponse response;
+  esp_err_t err = http_client_stream(
+      IPGEOLOCATION_URL "?apiKey=" CONFIG_CLOCK_IPGEOLOCATION_API_KEY
+                        "&fields=" IPGEOLOCATION_FIELDS
+                        "&excludes=country_name_official",
+      chunk, sizeof(chunk), &feed_extractor, &extractor, &response);
+  if (err != ESP_OK) {
+    return -1;
+  }
+  if (response.status != 200) {
+    ESP_LOGE(TAG, "Request failed: status %d", response.status);
+    return response.status;
+  }
+  if (!extractor.done() || !fields[2].found || !fields[3].found ||
+      !fields[4].found) {
+    ESP_LOGE(TAG, "Incomplete response, %u fields found",
+             (unsigned)extractor.found());
+    return -1;
+  }
+  strlcpy(_city, city, sizeof(_city));
+  strlcpy(_country, country, sizeof(_country));
+  strlcpy(_tz, tz, sizeof(_tz));
+  ESP_LOGI(TAG, "timezone: %s", _tz);
+  _latitude = strtof(latitude, nullptr);
+  _longitude = strtof(longitude, nullptr);
+  // Only a located and stored ip may cancel the next update, anything short
+  // of that is retried
+  if (ip_known) {
     memcpy(&_public_ip, &ip, sizeof(ip));
     _ip_set = true;
   }
-  IpGeolocationIoIpGeoParams *geoloc = new IpGeolocationIoIpGeoParams(
-      nullptr, nullptr, "city,country_name,time_zone,latitude,longitude",
-      "country_name_official", nullptr);
-  cJSON *data = NULL;
-  int return_value = IpGeolocationIo::get_location(geoloc, &data);
-
-  if (return_value == 200 && data) {
-    char *tmp_str = cJSON_GetObjectItemCaseSensitive(data, "city")->valuestring;
-    strcpy(_city, tmp_str ? tmp_str : "");
-    tmp_str =
-        cJSON_GetObjectItemCaseSensitive(data, "country_name")->valuestring;
-    strcpy(_country, tmp_str ? tmp_str : "");
-    cJSON *timezone = cJSON_GetObjectItemCaseSensitive(data, "time_zone");
-    tmp_str = cJSON_GetObjectItemCaseSensitive(timezone, "name")->valuestring;
-    strcpy(_tz, tmp_str ? tmp_str : "");
-    ESP_LOGI(TAG, "timezone: %s", _tz);
-    tmp_str = cJSON_GetObjectItemCaseSensitive(data, "latitude")->valuestring;
-    _latitude = tmp_str ? std::stof(tmp_str) : 0.0;
-    tmp_str = cJSON_GetObjectItemCaseSensitive(data, "longitude")->valuestring;
-    _longitude = tmp_str ? std::stof(tmp_str) : 0.0;
-
-    cJSON_Delete(data);
-  }
   download_posix_tz();
-  save_data();
-  return return_value;
+  if (save_data() != ESP_OK) {
+    _ip_set = false;
+    return -1;
+  }
+  return 200;
 }
 
 int Geolocation::download_posix_tz() {
-  cJSON *output = cJSON_ParseWithLength((char *)zone_json_start,
-                                        zone_json_end - zone_json_start);
-  if (output) {
-    auto tz_long_json = cJSON_GetObjectItemCaseSensitive(output, _tz);
-    if (tz_long_json && tz_long_json->valuestring) {
-      strcpy(_posix_tz, tz_long_json->valuestring);
-    } else {
-      strcpy(_posix_tz, _tz);
-    }
-    ESP_LOGI(TAG, "posix timezone: %s", _posix_tz);
-    cJSON_Delete(output);
-  }
+  const char *posix_tz = tz_index_lookup(_tz);
+  strlcpy(_posix_tz, posix_tz ? posix_tz : _tz, sizeof(_posix_tz));
+  ESP_LOGI(TAG, "posix timezone: %s", _posix_tz);
   return 200;
 }
 
-void Geolocation::save_data() {
-  nvs_handle_t handle;
+esp_err_t Geolocation::save_data() {
+  static_assert(sizeof(GeolocationRecord) == 200,
+                "No implicit padding in the geolocation record");
   ESP_LOGI(TAG, "Saving data");
-  auto err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
-  if (err != ESP_OK) {
-    ESP_LOGE(TAG, "Error (%s) opening NVS handle!\n", esp_err_to_name(err));
-  }
-  if (!_ip_set) {
-    nvs_erase_key(handle, NVS_IP);
-  }
-  save_string(handle, NVS_CITY, _city);
-  save_string(handle, NVS_COUNTRY, _country);
-  save_string(handle, NVS_TZ, _tz);
-  save_float(handle, NVS_LONGITUDE, _longitude);
-  save_float(handle, NVS_LATITUDE, _latitude);
-  err = nvs_set_blob(handle, NVS_IP, &_public_ip, sizeof(_public_ip));
-  if (ESP_OK != err) {
-    ESP_LOGE(TAG, NVS_IP ": %s", esp_err_to_name(err));
-  }
-
-  err = nvs_commit(handle);
-  if (ESP_OK != err) {
-    ESP_LOGE(TAG, "commit: %s", esp_err_to_name(err));
-  }
-  nvs_close(handle);
+  GeolocationRecord record = {};
+  record.latitude = _latitude;
+  record.longitude = _longitude;
+  strlcpy(record.city, _city, sizeof(record.city));
+  strlcpy(record.country, _country, sizeof(record.country));
+  strlcpy(record.tz, _tz, sizeof(record.tz));
+  memcpy(record.public_ip, _public_ip.addr, sizeof(record.public_ip));
+  record.public_ip_zone = _public_ip.zone;
+  record.ip_set = _ip_set;
+  return _record.save(&record, sizeof(record));
 }
 
 void Geolocation::restore_data() {
   ESP_LOGI(TAG, "Restore Data");
-  nvs_handle_t handle;
-  auto err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
-  if (err != ESP_OK) {
-    ESP_LOGE(TAG, "Error (%s) opening NVS handle!\n", esp_err_to_name(err));
+  GeolocationRecord record;
+  if (_record.load(&record, sizeof(record))) {
+    _latitude = record.latitude;
+    _longitude = record.longitude;
+    strlcpy(_city, record.city, sizeof(_city));
+    strlcpy(_country, record.country, sizeof(_country));
+    strlcpy(_tz, record.tz, sizeof(_tz));
+    memcpy(_public_ip.addr, record.public_ip, sizeof(_public_ip.addr));
+    _public_ip.zone = record.public_ip_zone;
+    _ip_set = record.ip_set;
   }
-  load_string(handle, NVS_CITY, _city);
-  load_string(handle, NVS_COUNTRY, _country);
-  load_string(handle, NVS_TZ, _tz);
-  load_float(handle, NVS_LONGITUDE, &_longitude);
-  load_float(handle, NVS_LATITUDE, &_latitude);
-  size_t size = sizeof(_public_ip);
-  err = nvs_get_blob(handle, NVS_IP, &_public_ip, &size);
-  if (err == ESP_OK) {
-    _ip_set = true;
-  } else {
-    ESP_LOGE(TAG, "%s: %s", NVS_IP, esp_err_to_name(err));
-  }
-  nvs_close(handle);
   download_posix_tz();
 }
 
-int http_get(esp_http_client_config_t *config, esp_http_client_handle_t client,
-             char *output_buffer) {
-  int data_len = 0;
-  char *data = NULL;
-  esp_err_t err = esp_http_client_open(client, data_len);
-  if (err != ESP_OK) {
-    ESP_LOGE(TAG, "Failed to open HTTP connection: %s", esp_err_to_name(err));
-  } else if (data != NULL &&
-             esp_http_client_write(client, data, data_len) < 0) {
-    ESP_LOGE(TAG, "Write failed");
-  } else if (esp_http_client_fetch_headers(client) < 0) {
-    ESP_LOGE(TAG, "HTTP client fetch headers failed");
-  } else {
-    int total_read = 0;
-    int read = 0;
-    do {
-      read = esp_http_client_read_response(client, output_buffer + total_read,
-                                           MAX_HTTP_OUTPUT_BUFFER_CALLOC -
-                                               total_read);
-      total_read += read;
-    } while (read > 0);
-  }
-  esp_http_client_close(client);
-  const int status_code = esp_http_client_get_status_code(client);
-  esp_http_client_cleanup(client);
-  return status_code;
-}
-
 int get_public_ip6(esp_ip6_addr_t *ip) {
-  esp_http_client_config_t config = {};
   char output_buffer[40] = {0};
-  config.url = "http://myexternalip.com/raw";
-  esp_http_client_handle_t client = esp_http_client_init(&config);
-  esp_http_client_set_method(client, HTTP_METHOD_GET);
-
-  int code = http_get(&config, client, output_buffer);
-  if (code == 200) {
-    esp_netif_str_to_ip6(output_buffer, ip);
-  }
-  return code;
-}
-
-void load_string(nvs_handle_t handle, const char *key, char *value) {
-  size_t size = 0;
-  esp_err_t err = nvs_get_str(handle, key, NULL, &size);
-  if (err == ESP_OK) {
-    err = nvs_get_str(handle, key, value, &size);
-  }
+  HttpResponse response;
+  esp_err_t err =
+      http_client_get("http://myexternalip.com/raw",
+                      reinterpret_cast<uint8_t *>(output_buffer),
+                      sizeof(output_buffer) - 1, &response);
   if (err != ESP_OK) {
-    ESP_LOGE(TAG, "%s: %s", key, esp_err_to_name(err));
+    return -1;
   }
-}
-
-void load_float(nvs_handle_t handle, const char *key, float *value) {
-  int32_t temp_value = 0;
-  esp_err_t err = nvs_get_i32(handle, key, &temp_value);
-  if (err == ESP_OK) {
-    float *tmp_value_float = reinterpret_cast<float *>(&temp_value);
-    *value = *tmp_value_float;
-  } else {
-    ESP_LOGE(TAG, "%s: %s", key, esp_err_to_name(err));
+  if (response.truncated) {
+    return -1;
   }
-}
-
-esp_err_t save_string(nvs_handle_t handle, const char *key, const char *value) {
-  esp_err_t err = nvs_set_str(handle, key, value);
-  if (ESP_OK != err) {
-    ESP_LOGE(TAG, "%s: %s", key, esp_err_to_name(err));
+  if (response.status == 200 &&
+      esp_netif_str_to_ip6(output_buffer, ip) != ESP_OK) {
+    ESP_LOGE(TAG, "Not an ipv6 address: %s", output_buffer);
+    return -1;
   }
-  return err;
+  return response.status;
 }
-
-esp_err_t save_float(nvs_handle_t handle, const char *key, float value) {
-  int32_t *casted_value = reinterpret_cast<int32_t *>(&value);
-  esp_err_t err = nvs_set_i32(handle, key, *casted_value);
-  if (ESP_OK != err) {
-    ESP_LOGE(TAG, "%s: %s", key, esp_err_to_name(err));
-  }
-  return err;
-}
\ No newline at end of file
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <cJSON.h>
+#include "persistence.hpp"
 #include <esp_netif.h>
 
 class Geolocation {
@@ -16,6 +16,19 @@ public:
   int update_geoloc();
 
 private:
+  // Laid out without padding, the record is checksummed byte for byte
+  typedef struct GeolocationRecord {
+    float latitude;
+    float longitude;
+    uint32_t public_ip[4];
+    char city[86];
+    char country[57];
+    char tz[31];
+    uint8_t public_ip_zone;
+    bool ip_set;
+  } GeolocationRecord;
+
+  PersistentRecord _record;
   float _latitude;
   float _longitude;
   char _city[86];
@@ -25,6 +38,6 @@ private:
   esp_ip6_addr_t _public_ip;
   bool _ip_set;
   int download_posix_tz();
-  void save_data();
+  esp_err_t save_data();
   void restore_data();
 };
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include "glyph_atlas.h"
+
+size_t atlas_face_index(int16_t height) {
+  size_t index = 0;
+  for (size_t i = 1; i < atlas_face_count; ++i) {
+    if (atlas_text_faces[i].cell_height <= height) {
+      index = i;
+    }
+  }
+  return index;
+}
+
+const AtlasGlyph *atlas_glyph(const AtlasFace *face, char c) {
+  uint8_t index = (uint8_t)c - face->first;
+  if ((uint8_t)c < face->first || index >= face->count) {
+    return nullptr;
+  }
+  return &face->glyphs[index];
+}
+
+WeatherIcon atlas_weather_icon(uint8_t code) {
+  switch (code) {
+  case 0:
+    return WeatherIconClear;
+  case 1:
+  case 2:
+    return WeatherIconPartlyCloudy;
+  case 3:
+    return WeatherIconOvercast;
+  case 45:
+  case 48:
+    return WeatherIconFog;
+  case 51 ... 57:
+    return WeatherIconDrizzle;
+  case 61 ... 67:
+  case 80 ... 82:
+    return WeatherIconRain;
+  case 71 ... 77:
+  case 85:
+  case 86:
+    return WeatherIconSnow;
+  case 95 ... 99:
+    return WeatherIconThunder;
+  default:
+    return WeatherIconMax;
+  }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A glyph cut to its bounding box within the cell: width * height 4 bit
+// coverage values, two per byte, high nibble first, starting at nibble
+// offset of the face bitmap.
+typedef struct AtlasGlyph {
+  uint16_t offset;
+  uint8_t x;
+  uint8_t y;
+  uint8_t width;
+  uint8_t height;
+} AtlasGlyph;
+
+// Fixed cells, count glyphs from the character first on.
+typedef struct AtlasFace {
+  uint8_t cell_width;
+  uint8_t cell_height;
+  uint8_t first;
+  uint8_t count;
+  const AtlasGlyph *glyphs;
+  const uint8_t *bitmap;
+} AtlasFace;
+
+typedef enum WeatherIcon {
+  WeatherIconClear,
+  WeatherIconPartlyCloudy,
+  WeatherIconOvercast,
+  WeatherIconFog,
+  WeatherIconDrizzle,
+  WeatherIconRain,
+  WeatherIconSnow,
+  WeatherIconThunder,
+  WeatherIconMax,
+} WeatherIcon;
+
+// Generated at build time by tools/gen_glyph_atlas.py. Text faces are
+// printable ASCII by line height, smallest first, the icon faces are square
+// cells of the same heights indexed by WeatherIcon.
+extern const AtlasFace atlas_text_faces[];
+extern const AtlasFace atlas_icon_faces[];
+extern const size_t atlas_face_count;
+// 0 to 9 and the colon in the 48 px clock strip
+extern const AtlasFace atlas_clock_face;
+
+// Index of the tallest face not taller than height, 0 if none is.
+size_t atlas_face_index(int16_t height);
+// The glyph of c, NULL if the face does not have it.
+const AtlasGlyph *atlas_glyph(const AtlasFace *face, char c);
+// Icon of a WMO weather code, WeatherIconMax for an unknown code.
+WeatherIcon atlas_weather_icon(uint8_t code);
+
+#ifdef __cplusplus
+}
+#endif
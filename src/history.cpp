@@ -0,0 +1,314 @@
+#include "history.hpp"
+#include <algorithm>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "History";
+
+static const float scales[HistoryMetricMax] = {1, 10, 10};
+
+int16_t history_encode(HistoryMetric metric, float value) {
+  long encoded = lroundf(value * scales[metric]);
+  return (int16_t)std::min<long>(std::max<long>(encoded, INT16_MIN + 1),
+                                 INT16_MAX);
+}
+
+float history_decode(HistoryMetric metric, int16_t value) {
+  return value / scales[metric];
+}
+
+static int16_t clamp16(int32_t value) {
+  return (int16_t)std::min<int32_t>(std::max<int32_t>(value, INT16_MIN + 1),
+                                    INT16_MAX);
+}
+
+static int16_t rounded_mean(int64_t sum, int32_t count) {
+  return clamp16(sum >= 0 ? (sum + count / 2) / count
+                          : (sum - count / 2) / count);
+}
+
+HistoryStore::HistoryStore() {
+  _lock = xSemaphoreCreateMutexStatic(&_lock_buffer);
+  _tiers[HistoryRaw] = {.period_s = HISTORY_RAW_PERIOD_S,
+                        .slots = HISTORY_RAW_SLOTS};
+  _tiers[HistoryMinute] = {.period_s = HISTORY_MINUTE_PERIOD_S,
+                           .slots = HISTORY_MINUTE_SLOTS};
+  _tiers[HistoryHour] = {.period_s = HISTORY_HOUR_PERIOD_S,
+                         .slots = HISTORY_HOUR_SLOTS};
+  for (int m = 0; m < HistoryMetricMax; ++m) {
+    _tiers[HistoryRaw].avg[m] = _raw[m];
+    _tiers[HistoryRaw].below[m] = nullptr;
+    _tiers[HistoryRaw].above[m] = nullptr;
+    _tiers[HistoryRaw].count[m] = nullptr;
+    _tiers[HistoryMinute].avg[m] = _minute_avg[m];
+    _tiers[HistoryMinute].below[m] = _minute_below[m];
+    _tiers[HistoryMinute].above[m] = _minute_above[m];
+    _tiers[HistoryMinute].count[m] = nullptr;
+    _tiers[HistoryHour].avg[m] = _hour_avg[m];
+    _tiers[HistoryHour].below[m] = _hour_below[m];
+    _tiers[HistoryHour].above[m] = _hour_above[m];
+    _tiers[HistoryHour].count[m] = _hour_count[m];
+    _latest[m] = HISTORY_NO_VALUE;
+  }
+  for (int t = 0; t < HistoryTierMax; ++t) {
+    clear(&_tiers[t]);
+    _accumulators[t].start = 0;
+  }
+  ESP_LOGI(TAG, "%u bytes for %u s of history", sizeof(*this),
+           HISTORY_HOUR_PERIOD_S * HISTORY_HOUR_SLOTS);
+}
+
+void HistoryStore::clear(Tier *tier) {
+  for (int m = 0; m < HistoryMetricMax; ++m) {
+    std::fill(tier->avg[m], tier->avg[m] + tier->slots, HISTORY_NO_VALUE);
+    if (tier->below[m]) {
+      memset(tier->below[m], 0, tier->slots);
+      memset(tier->above[m], 0, tier->slots);
+    }
+    if (tier->count[m]) {
+      std::fill(tier->count[m], tier->count[m] + tier->slots, 0);
+    }
+  }
+  tier->head = 0;
+  tier->head_time = 0;
+}
+
+// Index of the slot starting at slot_time, -1 when it is older than the
+// ring. Moving forward clears the slots skipped on the way, a clock jump
+// larger than the ring starts it over.
+int HistoryStore::slot(Tier *tier, time_t slot_time) {
+  time_t span = (time_t)tier->period_s * tier->slots;
+  if (tier->head_time != 0 && slot_time <= tier->head_time - span) {
+    return -1;
+  }
+  if (tier->head_time == 0 || slot_time >= tier->head_time + span) {
+    if (tier->head_time != 0) {
+      _stats.resets++;
+    }
+    clear(tier);
+    tier->head_time = slot_time;
+    return 0;
+  }
+  if (slot_time <= tier->head_time) {
+    int back = (tier->head_time - slot_time) / tier->period_s;
+    return (tier->head + tier->slots - back) % tier->slots;
+  }
+  while (tier->head_time < slot_time) {
+    tier->head = (tier->head + 1) % tier->slots;
+    tier->head_time += tier->period_s;
+    for (int m = 0; m < HistoryMetricMax; ++m) {
+      tier->avg[m][tier->head] = HISTORY_NO_VALUE;
+      if (tier->below[m]) {
+        tier->below[m][tier->head] = 0;
+        tier->above[m][tier->head] = 0;
+      }
+      if (tier->count[m]) {
+        tier->count[m][tier->head] = 0;
+      }
+    }
+  }
+  return tier->head;
+}
+
+// Starts the sums of the period at slot i over what the slot holds, an hour
+// restored from the archive before the samples that follow it.
+void HistoryStore::seed(Tier *tier, Accumulator *acc, int i) {
+  for (int m = 0; m < HistoryMetricMax; ++m) {
+    uint16_t count = tier->count[m] ? tier->count[m][i] : 0;
+    int16_t avg = tier->avg[m][i];
+    if (count == 0 || avg == HISTORY_NO_VALUE) {
+      acc->sum[m] = 0;
+      acc->count[m] = 0;
+      acc->min[m] = INT16_MAX;
+      acc->max[m] = INT16_MIN;
+      continue;
+    }
+    acc->sum[m] = (int32_t)avg * count;
+    acc->count[m] = count;
+    acc->min[m] = clamp16(avg - tier->below[m][i]);
+    acc->max[m] = clamp16(avg + tier->above[m][i]);
+  }
+}
+
+// Folds a raw sample into the aggregate of the minute or hour it belongs to.
+// The slot is rewritten on every sample so queries see the current period.
+// A sample from before that period is left out, restarting the sums on it
+// would overwrite a finished aggregate.
+void HistoryStore::accumulate(HistoryTier index, time_t time,
+                              const int16_t *values) {
+  Tier *tier = &_tiers[index];
+  Accumulator *acc = &_accumulators[index];
+  time_t slot_time = time - time % tier->period_s;
+  if (slot_time < acc->start) {
+    return;
+  }
+  int i = slot(tier, slot_time);
+  if (i < 0) {
+    return;
+  }
+  if (acc->start != slot_time) {
+    acc->start = slot_time;
+    seed(tier, acc, i);
+  }
+  for (int m = 0; m < HistoryMetricMax; ++m) {
+    if (values[m] == HISTORY_NO_VALUE) {
+      continue;
+    }
+    acc->sum[m] += values[m];
+    acc->count[m] = std::min<int32_t>(acc->count[m] + 1, UINT16_MAX);
+    acc->min[m] = std::min(acc->min[m], values[m]);
+    acc->max[m] = std::max(acc->max[m], values[m]);
+    int16_t avg = rounded_mean(acc->sum[m], acc->count[m]);
+    tier->avg[m][i] = avg;
+    tier->below[m][i] = (uint8_t)std::min<int32_t>(avg - acc->min[m], 255);
+    tier->above[m][i] = (uint8_t)std::min<int32_t>(acc->max[m] - avg, 255);
+    if (tier->count[m]) {
+      tier->count[m][i] = acc->count[m];
+    }
+  }
+}
+
+void HistoryStore::insert(time_t time, const float *values, bool hourly) {
+  int64_t start_us = esp_timer_get_time();
+  int16_t encoded[HistoryMetricMax];
+  for (int m = 0; m < HistoryMetricMax; ++m) {
+    encoded[m] = isnan(values[m])
+                     ? HISTORY_NO_VALUE
+                     : history_encode((HistoryMetric)m, values[m]);
+  }
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  Tier *raw = &_tiers[HistoryRaw];
+  int i = slot(raw, time - time % raw->period_s);
+  for (int m = 0; m < HistoryMetricMax; ++m) {
+    if (i >= 0) {
+      raw->avg[m][i] = encoded[m];
+    }
+    if (time >= _latest_time) {
+      _latest[m] = encoded[m];
+    }
+  }
+  _latest_time = std::max(_latest_time, time);
+  accumulate(HistoryMinute, time, encoded);
+  if (hourly) {
+    accumulate(HistoryHour, time, encoded);
+  }
+  _stats.inserts++;
+  _stats.insert_us += esp_timer_get_time() - start_us;
+  xSemaphoreGive(_lock);
+}
+
+void HistoryStore::insert_hour(time_t time, const HistoryPoint *points,
+                               const uint16_t *counts) {
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  Tier *tier = &_tiers[HistoryHour];
+  Accumulator *acc = &_accumulators[HistoryHour];
+  time_t slot_time = time - time % tier->period_s;
+  int i = slot(tier, slot_time);
+  for (int m = 0; i >= 0 && m < HistoryMetricMax; ++m) {
+    const HistoryPoint *point = &points[m];
+    if (point->avg == HISTORY_NO_VALUE) {
+      continue;
+    }
+    int32_t low = point->min, high = point->max;
+    int32_t count = std::max<int32_t>(counts[m], 1);
+    int64_t sum = (int64_t)point->avg * count;
+    int16_t current = tier->avg[m][i];
+    if (current != HISTORY_NO_VALUE) {
+      // An hour split across two archive segments comes back in two parts,
+      // each weighing what it covers
+      int32_t current_count = std::max<int32_t>(tier->count[m][i], 1);
+      low = std::min<int32_t>(low, current - tier->below[m][i]);
+      high = std::max<int32_t>(high, current + tier->above[m][i]);
+      sum += (int64_t)current * current_count;
+      count += current_count;
+    }
+    int16_t avg = rounded_mean(sum, count);
+    count = std::min<int32_t>(count, UINT16_MAX);
+    tier->avg[m][i] = avg;
+    tier->below[m][i] = (uint8_t)std::min<int32_t>(avg - low, 255);
+    tier->above[m][i] = (uint8_t)std::min<int32_t>(high - avg, 255);
+    tier->count[m][i] = (uint16_t)count;
+  }
+  // The hour being sampled goes on from the merged slot
+  if (i >= 0 && slot_time == acc->start) {
+    seed(tier, acc, i);
+  }
+  xSemaphoreGive(_lock);
+}
+
+bool HistoryStore::latest(HistoryMetric metric, float *value) const {
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  int16_t encoded = _latest[metric];
+  time_t age = time(nullptr) - _latest_time;
+  xSemaphoreGive(_lock);
+  if (encoded == HISTORY_NO_VALUE || age > 3 * HISTORY_RAW_PERIOD_S) {
+    return false;
+  }
+  *value = history_decode(metric, encoded);
+  return true;
+}
+
+size_t HistoryStore::query(HistoryTier index, HistoryMetric metric,
+                           time_t from, time_t to, HistoryPoint *out,
+                           size_t columns) const {
+  for (size_t c = 0; c < columns; ++c) {
+    out[c] = {HISTORY_NO_VALUE, HISTORY_NO_VALUE, HISTORY_NO_VALUE};
+  }
+  if (to <= from || columns == 0) {
+    return 0;
+  }
+  int64_t start_us = esp_timer_get_time();
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  const Tier *tier = &_tiers[index];
+  size_t filled = 0;
+  size_t column = SIZE_MAX;
+  int32_t sum = 0, count = 0, low = 0, high = 0;
+  auto flush = [&]() {
+    if (count) {
+      out[column] = {clamp16(low), rounded_mean(sum, count), clamp16(high)};
+      filled++;
+    }
+  };
+  if (tier->head_time != 0) {
+    time_t period = tier->period_s;
+    time_t oldest = tier->head_time - period * (tier->slots - 1);
+    time_t t = std::max(from + (period - from % period) % period, oldest);
+    time_t end = std::min(to - 1, tier->head_time);
+    int i = (tier->head + tier->slots - (tier->head_time - t) / period) %
+            tier->slots;
+    const int16_t *avg = tier->avg[metric];
+    const uint8_t *below = tier->below[metric];
+    const uint8_t *above = tier->above[metric];
+    for (; t <= end; t += period, i = (i + 1) % tier->slots) {
+      if (avg[i] == HISTORY_NO_VALUE) {
+        continue;
+      }
+      size_t c = (size_t)((int64_t)(t - from) * columns / (to - from));
+      if (c != column) {
+        flush();
+        column = c;
+        sum = count = 0;
+        low = INT32_MAX;
+        high = INT32_MIN;
+      }
+      sum += avg[i];
+      count++;
+      low = std::min<int32_t>(low, avg[i] - (below ? below[i] : 0));
+      high = std::max<int32_t>(high, avg[i] + (above ? above[i] : 0));
+    }
+    flush();
+  }
+  _stats.queries++;
+  _stats.query_us += esp_timer_get_time() - start_us;
+  xSemaphoreGive(_lock);
+  return filled;
+}
+
+HistoryStats HistoryStore::stats() const {
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  HistoryStats stats = _stats;
+  xSemaphoreGive(_lock);
+  return stats;
+}
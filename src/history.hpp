@@ -0,0 +1,117 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define HISTORY_NO_VALUE INT16_MIN
+
+#define HISTORY_RAW_PERIOD_S 10
+#define HISTORY_RAW_SLOTS 360
+#define HISTORY_MINUTE_PERIOD_S 60
+#define HISTORY_MINUTE_SLOTS 1440
+#define HISTORY_HOUR_PERIOD_S 3600
+#define HISTORY_HOUR_SLOTS 720
+
+typedef enum HistoryMetric {
+  HistoryPm25,
+  HistoryTemperature,
+  HistoryHumidity,
+  HistoryMetricMax,
+} HistoryMetric;
+
+typedef enum HistoryTier {
+  HistoryRaw,
+  HistoryMinute,
+  HistoryHour,
+  HistoryTierMax,
+} HistoryTier;
+
+// Fixed-point values: ug/m3 for PM2.5, tenths of a degree or of a percent
+// for temperature and humidity.
+typedef struct HistoryPoint {
+  int16_t min;
+  int16_t avg;
+  int16_t max;
+} HistoryPoint;
+
+typedef struct HistoryStats {
+  uint32_t inserts;
+  uint32_t resets;
+  uint32_t queries;
+  int64_t insert_us;
+  int64_t query_us;
+} HistoryStats;
+
+int16_t history_encode(HistoryMetric metric, float value);
+float history_decode(HistoryMetric metric, int16_t value);
+
+// Sensor history in three ring buffers of fixed size: raw samples every 10 s
+// for an hour, minute aggregates for a day and hourly aggregates for a month.
+// Slots are addressed by time, gaps read as HISTORY_NO_VALUE. Each metric is
+// a contiguous array so a range query walks memory linearly. Aggregates keep
+// the average as int16 and min/max as saturated 8-bit distances from it.
+// Hours also keep how many samples they cover, so the parts of an hour
+// restored at boot and sampled since merge by weight.
+class HistoryStore {
+public:
+  HistoryStore();
+  // values holds HistoryMetricMax readings, NAN when a sensor had none.
+  // Without hourly the hour tier is left out, for samples an archived hour
+  // already covers.
+  void insert(time_t time, const float *values, bool hourly = true);
+  // Restores an hourly aggregate of every metric and the number of samples
+  // behind each, merged with what the slot already holds.
+  void insert_hour(time_t time, const HistoryPoint *points,
+                   const uint16_t *counts);
+  bool latest(HistoryMetric metric, float *value) const;
+  // Buckets [from, to) into columns points, empty ones set to
+  // HISTORY_NO_VALUE. Returns how many columns got data.
+  size_t query(HistoryTier tier, HistoryMetric metric, time_t from, time_t to,
+               HistoryPoint *out, size_t columns) const;
+  HistoryStats stats() const;
+
+private:
+  typedef struct Tier {
+    uint32_t period_s;
+    uint16_t slots;
+    uint16_t head;
+    time_t head_time;
+    int16_t *avg[HistoryMetricMax];
+    uint8_t *below[HistoryMetricMax];
+    uint8_t *above[HistoryMetricMax];
+    // Samples behind each slot, hours only
+    uint16_t *count[HistoryMetricMax];
+  } Tier;
+
+  typedef struct Accumulator {
+    time_t start;
+    int32_t sum[HistoryMetricMax];
+    int16_t min[HistoryMetricMax];
+    int16_t max[HistoryMetricMax];
+    uint16_t count[HistoryMetricMax];
+  } Accumulator;
+
+  int16_t _raw[HistoryMetricMax][HISTORY_RAW_SLOTS];
+  int16_t _minute_avg[HistoryMetricMax][HISTORY_MINUTE_SLOTS];
+  uint8_t _minute_below[HistoryMetricMax][HISTORY_MINUTE_SLOTS];
+  uint8_t _minute_above[HistoryMetricMax][HISTORY_MINUTE_SLOTS];
+  int16_t _hour_avg[HistoryMetricMax][HISTORY_HOUR_SLOTS];
+  uint8_t _hour_below[HistoryMetricMax][HISTORY_HOUR_SLOTS];
+  uint8_t _hour_above[HistoryMetricMax][HISTORY_HOUR_SLOTS];
+  uint16_t _hour_count[HistoryMetricMax][HISTORY_HOUR_SLOTS];
+  Tier _tiers[HistoryTierMax];
+  Accumulator _accumulators[HistoryTierMax];
+  int16_t _latest[HistoryMetricMax];
+  time_t _latest_time = 0;
+  mutable StaticSemaphore_t _lock_buffer;
+  SemaphoreHandle_t _lock;
+  mutable HistoryStats _stats = {};
+
+  void clear(Tier *tier);
+  int slot(Tier *tier, time_t slot_time);
+  void seed(Tier *tier, Accumulator *acc, int i);
+  void accumulate(HistoryTier index, time_t slot_time, const int16_t *values);
+};
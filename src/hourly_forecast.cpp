@@ -0,0 +1,140 @@
+#include "hourly_forecast.hpp"
+#include <algorithm>
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
+#include <math.h>
+#include <stddef.h>
+
+#define SLOT_MAGIC 0x31524f48
+#define CHUNK_SIZE 128
+
+static const char *TAG = "HourlyForecast";
+
+static uint32_t slot_crc(const HourlyForecastSlot *slot) {
+  return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(&slot->hours),
+                          sizeof(slot->hours));
+}
+
+HourlyForecast::HourlyForecast() : _current(nullptr) {
+  int64_t start = esp_timer_get_time();
+  _partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                        HOURLY_FORECAST_SUBTYPE, nullptr);
+  if (_partition == nullptr) {
+    ESP_LOGE(TAG, "No hourly forecast partition");
+    return;
+  }
+  _slot_count = std::min<size_t>(_partition->size / HOURLY_FORECAST_SLOT_SIZE,
+                                 HOURLY_FORECAST_MAX_SLOTS);
+  const void *mapped = nullptr;
+  esp_err_t err =
+      esp_partition_mmap(_partition, 0, _partition->size,
+                         ESP_PARTITION_MMAP_DATA, &mapped, &_mmap);
+  if (err != ESP_OK || _slot_count == 0) {
+    ESP_LOGE(TAG, "Mapping failed: %s", esp_err_to_name(err));
+    _slot_count = 0;
+    return;
+  }
+  _mapped = static_cast<const uint8_t *>(mapped);
+
+  const HourlyForecastSlot *newest = nullptr;
+  for (uint16_t i = 0; i < _slot_count; ++i) {
+    const HourlyForecastSlot *candidate = slot(i);
+    if (valid(candidate) && (newest == nullptr ||
+                             candidate->header.sequence >
+                                 newest->header.sequence)) {
+      newest = candidate;
+      _slot = i;
+    }
+  }
+  if (newest) {
+    _sequence = newest->header.sequence;
+    _current.store(newest, std::memory_order_release);
+  }
+  _stats.mount_us = esp_timer_get_time() - start;
+  ESP_LOGI(TAG, "Mounted %u slots in %lld us, %s", _slot_count,
+           _stats.mount_us, newest ? "forecast found" : "empty");
+}
+
+bool HourlyForecast::valid(const HourlyForecastSlot *slot) const {
+  return slot->header.magic == SLOT_MAGIC &&
+         slot_crc(slot) == slot->header.crc;
+}
+
+// Encodes one column chunk by chunk into flash, hours past the end of the
+// values are written as missing.
+template <typename T>
+esp_err_t HourlyForecast::write_column(size_t base, size_t offset,
+                                       Span<float> values, T (*encoder)(float),
+                                       uint32_t *crc) {
+  T chunk[CHUNK_SIZE / sizeof(T)];
+  const size_t chunk_length = sizeof(chunk) / sizeof(chunk[0]);
+  for (size_t i = 0; i < HOURLY_FORECAST_HOURS; i += chunk_length) {
+    size_t count = std::min(chunk_length, HOURLY_FORECAST_HOURS - i);
+    for (size_t j = 0; j < count; ++j) {
+      chunk[j] = encoder(i + j < values.size ? values[i + j] : NAN);
+    }
+    size_t size = count * sizeof(T);
+    *crc = esp_rom_crc32_le(*crc, reinterpret_cast<const uint8_t *>(chunk),
+                            size);
+    esp_err_t err = esp_partition_write(
+        _partition, base + offset + i * sizeof(T), chunk, size);
+    if (err != ESP_OK) {
+      return err;
+    }
+  }
+  return ESP_OK;
+}
+
+bool HourlyForecast::write(time_t start, const HourlyColumns &columns) {
+  if (_slot_count == 0) {
+    return false;
+  }
+  int64_t begin = esp_timer_get_time();
+  // Never the published slot, readers keep it until the header is written
+  uint16_t next = (_slot + 1) % _slot_count;
+  size_t base = (size_t)next * HOURLY_FORECAST_SLOT_SIZE;
+  uint32_t crc = 0;
+  const size_t hours = offsetof(HourlyForecastSlot, hours);
+  esp_err_t err = esp_partition_erase_range(_partition, base,
+                                            HOURLY_FORECAST_SLOT_SIZE);
+  // In layout order, the CRC runs over the columns as they are written
+  if (err == ESP_OK) {
+    err = write_column(base, hours + offsetof(ForecastHourly, temperature_2m),
+                       columns.temperature_2m, forecast_encode_temperature,
+                       &crc);
+  }
+  if (err == ESP_OK) {
+    err = write_column(
+        base, hours + offsetof(ForecastHourly, precipitation_probability),
+        columns.precipitation_probability, forecast_encode_percent, &crc);
+  }
+  if (err == ESP_OK) {
+    err = write_column(base, hours + offsetof(ForecastHourly, uv_index),
+                       columns.uv_index, forecast_encode_uv, &crc);
+  }
+  if (err == ESP_OK) {
+    err = write_column(base, hours + offsetof(ForecastHourly, weather_code),
+                       columns.weather_code, forecast_encode_code, &crc);
+  }
+  if (err == ESP_OK) {
+    HourlyForecastHeader header = {};
+    header.magic = SLOT_MAGIC;
+    header.sequence = _sequence + 1;
+    header.crc = crc;
+    header.start = (uint32_t)start;
+    err = esp_partition_write(_partition, base, &header, sizeof(header));
+  }
+  if (err != ESP_OK || !valid(slot(next))) {
+    ESP_LOGE(TAG, "Write failed: %s", esp_err_to_name(err));
+    _stats.failures++;
+    return false;
+  }
+  _slot = next;
+  _sequence++;
+  _current.store(slot(next), std::memory_order_release);
+  _stats.writes++;
+  _stats.write_us = esp_timer_get_time() - begin;
+  ESP_LOGI(TAG, "Wrote slot %u in %lld us", next, _stats.write_us);
+  return true;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "forecast.hpp"
+#include "span.hpp"
+#include <atomic>
+#include <esp_partition.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define HOURLY_FORECAST_DAYS 16
+#define HOURLY_FORECAST_HOURS (HOURLY_FORECAST_DAYS * 24)
+#define HOURLY_FORECAST_SLOT_SIZE 4096
+#define HOURLY_FORECAST_MAX_SLOTS 16
+// Data partition subtype, next to the eeprom one
+#define HOURLY_FORECAST_SUBTYPE ((esp_partition_subtype_t)0x9a)
+
+typedef ForecastHours<HOURLY_FORECAST_HOURS> ForecastHourly;
+
+typedef struct HourlyForecastHeader {
+  uint32_t magic;
+  uint32_t sequence;
+  uint32_t crc;
+  // Time of the first hour, local midnight of the refresh day
+  uint32_t start;
+} HourlyForecastHeader;
+
+// One forecast as laid out in flash: a header then one column per variable.
+typedef struct HourlyForecastSlot {
+  HourlyForecastHeader header;
+  ForecastHourly hours;
+
+  // Index of the hour covering the timestamp, -1 if out of range.
+  int hour_index(time_t time) const {
+    time_t start = header.start;
+    if (time < start) {
+      return -1;
+    }
+    time_t index = (time - start) / 3600;
+    return index < HOURLY_FORECAST_HOURS ? (int)index : -1;
+  }
+} HourlyForecastSlot;
+
+static_assert(sizeof(HourlyForecastSlot) <= HOURLY_FORECAST_SLOT_SIZE,
+              "A forecast fits a sector");
+
+// The hourly series of a response from the first hour to keep, one value an
+// hour. Shorter ones are padded with missing values.
+typedef struct HourlyColumns {
+  Span<float> temperature_2m;
+  Span<float> precipitation_probability;
+  Span<float> uv_index;
+  Span<float> weather_code;
+} HourlyColumns;
+
+typedef struct HourlyForecastStats {
+  uint32_t writes;
+  uint32_t failures;
+  int64_t write_us;
+  int64_t mount_us;
+} HourlyForecastStats;
+
+// The hourly forecast for the next 16 days, too big for RAM, kept in its own
+// data partition and read straight from flash through a memory mapping.
+// Each refresh goes to the sector after the current one so the erases are
+// spread over the partition, and the header is written last: a slot that
+// does not check out is skipped and readers keep the previous one.
+class HourlyForecast {
+public:
+  HourlyForecast();
+  // Encodes the columns, whose first hour is start, and publishes them.
+  // Called by the weather refresh, never concurrently.
+  bool write(time_t start, const HourlyColumns &columns);
+  // Newest complete forecast, mapped from flash, nullptr if there is none.
+  // Refreshes are far apart, a reader never holds it across two writes.
+  const HourlyForecastSlot *forecast() const {
+    return _current.load(std::memory_order_acquire);
+  }
+  const HourlyForecastStats &stats() const { return _stats; }
+
+private:
+  const esp_partition_t *_partition = nullptr;
+  esp_partition_mmap_handle_t _mmap = 0;
+  const uint8_t *_mapped = nullptr;
+  uint16_t _slot_count = 0;
+  uint16_t _slot = 0;
+  uint32_t _sequence = 0;
+  std::atomic<const HourlyForecastSlot *> _current;
+  HourlyForecastStats _stats = {};
+
+  const HourlyForecastSlot *slot(uint16_t index) const {
+    return reinterpret_cast<const HourlyForecastSlot *>(
+        _mapped + (size_t)index * HOURLY_FORECAST_SLOT_SIZE);
+  }
+  bool valid(const HourlyForecastSlot *slot) const;
+  template <typename T>
+  esp_err_t write_column(size_t base, size_t offset, Span<float> values,
+                         T (*encoder)(float), uint32_t *crc);
+};
@@ -0,0 +1,266 @@
+#include "http_client.hpp"
+#include <esp_crt_bundle.h>
+#include <esp_http_client.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <lwip/netdb.h>
+#include <string.h>
+
+#define HOST_MAX 64
+
+static const char *TAG = "HttpClient";
+
+typedef struct Slot {
+  char host[HOST_MAX];
+  esp_http_client_handle_t client;
+  StaticSemaphore_t busy_buffer;
+  SemaphoreHandle_t busy;
+  int64_t last_used_us;
+  bool connected;
+  bool connected_now;
+  bool https;
+} Slot;
+
+static Slot slots[HTTP_CLIENT_SLOTS];
+static StaticSemaphore_t lock_buffer;
+static SemaphoreHandle_t lock = xSemaphoreCreateMutexStatic(&lock_buffer);
+static HttpClientStats stats = {};
+
+static void host_of(const char *url, char *host, size_t size) {
+  const char *start = strstr(url, "://");
+  start = start ? start + 3 : url;
+  size_t length = strcspn(start, "/?#");
+  if (length >= size) {
+    length = size - 1;
+  }
+  memcpy(host, start, length);
+  host[length] = '\0';
+}
+
+static esp_err_t event_handler(esp_http_client_event_t *evt) {
+  Slot *slot = static_cast<Slot *>(evt->user_data);
+  switch (evt->event_id) {
+  case HTTP_EVENT_ON_CONNECTED:
+    slot->connected = true;
+    slot->connected_now = true;
+    break;
+  case HTTP_EVENT_DISCONNECTED:
+    slot->connected = false;
+    break;
+  default:
+    break;
+  }
+  return ESP_OK;
+}
+
+// Slot of the host, or the least recently used idle one handed over to it.
+// Returned taken.
+static Slot *acquire(const char *url) {
+  char host[HOST_MAX];
+  host_of(url, host, sizeof(host));
+  xSemaphoreTake(lock, portMAX_DELAY);
+  Slot *slot = nullptr;
+  for (Slot &candidate : slots) {
+    if (candidate.client && strcmp(candidate.host, host) == 0) {
+      slot = &candidate;
+      break;
+    }
+  }
+  if (slot == nullptr) {
+    for (Slot &candidate : slots) {
+      if (candidate.client == nullptr) {
+        slot = &candidate;
+        break;
+      }
+      if (uxSemaphoreGetCount(candidate.busy) &&
+          (slot == nullptr || candidate.last_used_us < slot->last_used_us)) {
+        slot = &candidate;
+      }
+    }
+  }
+  if (slot == nullptr) {
+    // Every slot is busy with another host, wait for the first one
+    slot = &slots[0];
+  }
+  if (slot->busy == nullptr) {
+    slot->busy = xSemaphoreCreateMutexStatic(&slot->busy_buffer);
+  }
+  xSemaphoreGive(lock);
+  xSemaphoreTake(slot->busy, portMAX_DELAY);
+
+  if (slot->client && strcmp(slot->host, host) != 0) {
+    ESP_LOGI(TAG, "Handing %s over to %s", slot->host, host);
+    esp_http_client_cleanup(slot->client);
+    slot->client = nullptr;
+  }
+  if (slot->client == nullptr) {
+    esp_http_client_config_t config = {};
+    config.url = url;
+    config.event_handler = &event_handler;
+    config.user_data = slot;
+    config.crt_bundle_attach = esp_crt_bundle_attach;
+    config.keep_alive_enable = true;
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    config.save_client_session = true;
+#endif
+    slot->client = esp_http_client_init(&config);
+    strlcpy(slot->host, host, sizeof(slot->host));
+    slot->connected = false;
+    slot->https = strncmp(url, "https:", 6) == 0;
+  }
+  return slot;
+}
+
+static void release(Slot *slot) {
+  slot->last_used_us = esp_timer_get_time();
+  xSemaphoreGive(slot->busy);
+}
+
+// One attempt at the request on the slot connection, opening one if needed.
+// Without body_cb the body fills buffer, with it buffer holds one chunk.
+static esp_err_t request(Slot *slot, uint8_t *buffer, size_t size,
+                         HttpBodyCb body_cb, void *arg,
+                         HttpResponse *response) {
+  esp_http_client_handle_t client = slot->client;
+  HttpTiming *timing = &response->timing;
+  response->length = 0;
+  response->truncated = false;
+  int64_t phase_us = esp_timer_get_time();
+  bool was_connected = slot->connected;
+  slot->connected_now = false;
+  esp_err_t err = esp_http_client_open(client, 0);
+  timing->connect_us = esp_timer_get_time() - phase_us;
+  timing->reused = was_connected && !slot->connected_now;
+  if (err != ESP_OK) {
+    return err;
+  }
+  phase_us = esp_timer_get_time();
+  if (esp_http_client_fetch_headers(client) < 0) {
+    esp_http_client_close(client);
+    return ESP_FAIL;
+  }
+  timing->ttfb_us = esp_timer_get_time() - phase_us;
+
+  phase_us = esp_timer_get_time();
+  for (;;) {
+    size_t offset = body_cb ? 0 : response->length;
+    if (offset == size) {
+      break;
+    }
+    int read = esp_http_client_read_response(
+        client, reinterpret_cast<char *>(buffer) + offset, size - offset);
+    if (read <= 0) {
+      break;
+    }
+    response->length += read;
+    if (body_cb && !body_cb(buffer, read, arg)) {
+      break;
+    }
+  }
+  if (!esp_http_client_is_complete_data_received(client)) {
+    // Drain what did not fit so the connection stays usable
+    response->truncated = true;
+    int drained = 0;
+    esp_http_client_flush_response(client, &drained);
+  }
+  timing->body_us = esp_timer_get_time() - phase_us;
+  response->status = esp_http_client_get_status_code(client);
+  if (!esp_http_client_is_complete_data_received(client)) {
+    esp_http_client_close(client);
+  }
+  return ESP_OK;
+}
+
+static esp_err_t get(const char *url, uint8_t *buffer, size_t size,
+                     HttpBodyCb body_cb, void *arg, HttpResponse *response) {
+  *response = {};
+  HttpTiming *timing = &response->timing;
+  Slot *slot = acquire(url);
+  if (slot->client == nullptr) {
+    release(slot);
+    return ESP_ERR_NO_MEM;
+  }
+  esp_http_client_set_url(slot->client, url);
+  esp_http_client_set_method(slot->client, HTTP_METHOD_GET);
+
+  int64_t start_us = esp_timer_get_time();
+  if (!slot->connected) {
+    // Resolved here only to be measured, the client then hits the lwIP cache
+    struct addrinfo hints = {};
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *result = nullptr;
+    if (getaddrinfo(slot->host, nullptr, &hints, &result) == 0) {
+      freeaddrinfo(result);
+    }
+    timing->dns_us = esp_timer_get_time() - start_us;
+  }
+  esp_err_t err = request(slot, buffer, size, body_cb, arg, response);
+  if (err != ESP_OK && timing->reused) {
+    // The server closed the idle connection, once more on a new one. Nothing
+    // reached body_cb yet, that only starts once the headers are in.
+    esp_http_client_close(slot->client);
+    err = request(slot, buffer, size, body_cb, arg, response);
+  }
+  timing->total_us = esp_timer_get_time() - start_us;
+
+  xSemaphoreTake(lock, portMAX_DELAY);
+  stats.requests++;
+  stats.errors += err != ESP_OK;
+  stats.truncated += response->truncated;
+  if (timing->reused) {
+    stats.reuses++;
+  } else {
+    stats.connections++;
+    stats.handshakes += slot->https;
+  }
+  stats.dns_us += timing->dns_us;
+  stats.connect_us += timing->connect_us;
+  stats.ttfb_us += timing->ttfb_us;
+  stats.body_us += timing->body_us;
+  xSemaphoreGive(lock);
+
+  ESP_LOGI(TAG,
+           "GET %s %d, %u bytes%s, %s: dns %lld connect %lld ttfb %lld "
+           "body %lld total %lld ms",
+           slot->host, response->status, (unsigned)response->length,
+           response->truncated ? " (truncated)" : "",
+           timing->reused ? "reused" : "new connection",
+           timing->dns_us / 1000, timing->connect_us / 1000,
+           timing->ttfb_us / 1000, timing->body_us / 1000,
+           timing->total_us / 1000);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "GET %s failed: %s", slot->host, esp_err_to_name(err));
+  }
+  release(slot);
+  return err;
+}
+
+esp_err_t http_client_get(const char *url, uint8_t *buffer, size_t size,
+                          HttpResponse *response) {
+  return get(url, buffer, size, nullptr, nullptr, response);
+}
+
+esp_err_t http_client_stream(const char *url, uint8_t *buffer, size_t size,
+                             HttpBodyCb body_cb, void *arg,
+                             HttpResponse *response) {
+  return get(url, buffer, size, body_cb, arg, response);
+}
+
+HttpClientStats http_client_stats(void) {
+  xSemaphoreTake(lock, portMAX_DELAY);
+  HttpClientStats copy = stats;
+  xSemaphoreGive(lock);
+  return copy;
+}
+
+void http_client_log_stats(void) {
+  HttpClientStats copy = http_client_stats();
+  ESP_LOGI(TAG,
+           "%lu requests, %lu errors, %lu truncated, %lu connections "
+           "(%lu TLS handshakes), %lu reused",
+           (unsigned long)copy.requests, (unsigned long)copy.errors,
+           (unsigned long)copy.truncated, (unsigned long)copy.connections,
+           (unsigned long)copy.handshakes, (unsigned long)copy.reuses);
+}
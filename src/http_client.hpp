@@ -0,0 +1,57 @@
+#pragma once
+
+#include <esp_err.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HTTP_CLIENT_SLOTS 3
+
+typedef struct HttpTiming {
+  int64_t dns_us;
+  int64_t connect_us;
+  int64_t ttfb_us;
+  int64_t body_us;
+  int64_t total_us;
+  bool reused;
+} HttpTiming;
+
+typedef struct HttpResponse {
+  int status;
+  size_t length;
+  bool truncated;
+  HttpTiming timing;
+} HttpResponse;
+
+typedef struct HttpClientStats {
+  uint32_t requests;
+  uint32_t errors;
+  uint32_t truncated;
+  uint32_t connections;
+  uint32_t handshakes;
+  uint32_t reuses;
+  int64_t dns_us;
+  int64_t connect_us;
+  int64_t ttfb_us;
+  int64_t body_us;
+} HttpClientStats;
+
+// Takes the body of http_client_stream chunk by chunk, false stops reading.
+typedef bool (*HttpBodyCb)(const uint8_t *data, size_t length, void *arg);
+
+// Shared esp_http_client handles, one per host, kept open between requests
+// so the connection is reused while the server keeps it alive. The handle
+// also keeps the TLS session ticket, so a new connection after the server or
+// light sleep dropped the old one resumes the session instead of a full
+// handshake.
+//
+// Streams the body of a GET into buffer, never more than size bytes. A
+// longer body is drained and reported as truncated.
+esp_err_t http_client_get(const char *url, uint8_t *buffer, size_t size,
+                          HttpResponse *response);
+// Hands the body to body_cb as it arrives, read through buffer. A body the
+// callback stopped is drained and reported as truncated.
+esp_err_t http_client_stream(const char *url, uint8_t *buffer, size_t size,
+                             HttpBodyCb body_cb, void *arg,
+                             HttpResponse *response);
+HttpClientStats http_client_stats(void);
+void http_client_log_stats(void);
@@ -10,22 +10,28 @@ typedef enum ActionEnum {
   WifiDisconnected,
   ApStarted,
   ButtonClicked,
+  ButtonDoubleClicked,
+  ButtonLongPressed,
+  ActionMax,
 } ActionEnum;
 
+// Plain value event, copied into the action queue so posting never allocates.
 class Action {
 
 public:
-  Action(ActionEnum action) : _action(action) {}
-  Action(ActionEnum action, const char *value) : _action(action) {
-    if (value)
-      _value = strdup(value);
-  }
+  Action() : _action(UpdateScreen) {}
+  Action(ActionEnum action, char value = '\0')
+      : _action(action), _value(value) {}
+
+  ActionEnum action() const { return _action; }
+
+  char value() const { return _value; }
 
-  ActionEnum action() { return _action; }
+  int64_t enqueued_us() const { return _enqueued_us; }
 
-  char *value() { return _value; }
+  void set_enqueued_us(int64_t time_us) { _enqueued_us = time_us; }
 
-  bool is_configuration() {
+  bool is_configuration() const {
     switch (_action) {
     case WifiConnected:
     case ApStarted:
@@ -35,14 +41,10 @@ public:
     }
   }
 
-  ~Action() {
-    if (_value != nullptr)
-      free(_value);
-  }
-
 private:
-  char *_value = nullptr;
-  const ActionEnum _action;
+  ActionEnum _action;
+  char _value = '\0';
+  int64_t _enqueued_us = 0;
 };
 
 class HttpManagerBase {
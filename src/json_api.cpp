@@ -0,0 +1,305 @@
+#include "json_api.hpp"
+#include "text_builder.hpp"
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "JsonApi";
+
+static const char *const paths[ApiEndpointMax] = {
+    "/api/now",
+    "/api/forecast",
+    "/api/history",
+};
+static const size_t sizes[ApiEndpointMax] = {
+    JSON_API_NOW_SIZE,
+    JSON_API_FORECAST_SIZE,
+    JSON_API_HISTORY_SIZE,
+};
+static const char *const metric_names[HistoryMetricMax] = {
+    "pm25",
+    "temperature",
+    "humidity",
+};
+
+// Appends JSON to a fixed buffer, numbers go through TextBuilder so no float
+// printf is needed. Past the end everything is dropped and overflow() says
+// so.
+class BodyWriter {
+public:
+  BodyWriter(char *data, size_t size) : _data(data), _size(size) {
+    _data[0] = '\0';
+  }
+  BodyWriter &raw(const char *text) {
+    size_t length = strlen(text);
+    if (_length + length >= _size) {
+      _overflow = true;
+      return *this;
+    }
+    memcpy(_data + _length, text, length + 1);
+    _length += length;
+    return *this;
+  }
+  BodyWriter &key(const char *name) {
+    return separator().raw("\"").raw(name).raw("\":");
+  }
+  BodyWriter &integer(long long value) {
+    char text[24];
+    snprintf(text, sizeof(text), "%lld", value);
+    return raw(text);
+  }
+  // NaN is written as null
+  BodyWriter &decimal(float value, int decimals) {
+    if (isnan(value)) {
+      return raw("null");
+    }
+    return raw(TextBuilder().decimal(value, decimals).c_str());
+  }
+  BodyWriter &minutes(uint16_t minutes) {
+    if (minutes == FORECAST_NO_MINUTES) {
+      return raw("null");
+    }
+    return raw(TextBuilder()
+                   .str("\"")
+                   .integer(minutes / 60, 2, '0')
+                   .str(":")
+                   .integer(minutes % 60, 2, '0')
+                   .str("\"")
+                   .c_str());
+  }
+  // Members go after key() and array values after item(), which put the
+  // commas in
+  BodyWriter &open(const char *bracket) {
+    raw(bracket);
+    _first = true;
+    return *this;
+  }
+  BodyWriter &close(const char *bracket) {
+    raw(bracket);
+    _first = false;
+    return *this;
+  }
+  BodyWriter &item() { return separator(); }
+  size_t length() const { return _length; }
+  bool overflow() const { return _overflow; }
+
+private:
+  char *_data;
+  size_t _size;
+  size_t _length = 0;
+  bool _first = true;
+  bool _overflow = false;
+
+  BodyWriter &separator() {
+    if (!_first) {
+      raw(",");
+    }
+    _first = false;
+    return *this;
+  }
+};
+
+template <typename Value>
+static void array(BodyWriter *writer, const char *name, int count,
+                  Value value) {
+  writer->key(name).open("[");
+  for (int i = 0; i < count; ++i) {
+    writer->item();
+    value(i);
+  }
+  writer->close("]");
+}
+
+static time_t local_midnight(time_t time) {
+  struct tm tm;
+  localtime_r(&time, &tm);
+  tm.tm_hour = 0;
+  tm.tm_min = 0;
+  tm.tm_sec = 0;
+  tm.tm_isdst = -1;
+  return mktime(&tm);
+}
+
+static void write_now(BodyWriter *writer, const HistoryStore *history) {
+  writer->open("{").key("time").integer(time(nullptr));
+  for (int m = 0; m < HistoryMetricMax; ++m) {
+    float value = NAN;
+    history->latest((HistoryMetric)m, &value);
+    writer->key(metric_names[m]).decimal(value, m == HistoryPm25 ? 0 : 1);
+  }
+  writer->close("}");
+}
+
+static void write_forecast(BodyWriter *writer,
+                           const WeatherSnapshot *snapshot) {
+  const Forecast24 *f24 = &snapshot->forecast24;
+  const Forecast7 *f_7 = &snapshot->forecast7;
+  writer->open("{").key("fetched_at").integer(snapshot->fetched_at);
+  // Same columnar layout as Open-Meteo, hourly from local midnight
+  writer->key("hourly").open("{");
+  writer->key("time").integer(local_midnight(snapshot->fetched_at));
+  writer->key("interval").integer(3600);
+  array(writer, "temperature_2m", 24,
+        [&](int h) { writer->decimal(f24->temperature(h), 1); });
+  array(writer, "precipitation_probability", 24,
+        [&](int h) { writer->decimal(f24->precipitation(h), 0); });
+  array(writer, "uv_index", 24,
+        [&](int h) { writer->decimal(f24->uv(h), 1); });
+  array(writer, "weather_code", 24,
+        [&](int h) { writer->integer(f24->weather_code[h]); });
+  writer->close("}");
+  writer->key("daily").open("{");
+  array(writer, "temperature_2m_max", 7,
+        [&](int d) { writer->decimal(f_7->temperature_max(d), 1); });
+  array(writer, "temperature_2m_min", 7,
+        [&](int d) { writer->decimal(f_7->temperature_min(d), 1); });
+  array(writer, "precipitation_probability_max", 7,
+        [&](int d) { writer->decimal(f_7->precipitation_max(d), 0); });
+  array(writer, "uv_index_max", 7,
+        [&](int d) { writer->decimal(f_7->uv_max(d), 1); });
+  array(writer, "weather_code", 7,
+        [&](int d) { writer->integer(f_7->weather_code[d]); });
+  array(writer, "sunrise", 7,
+        [&](int d) { writer->minutes(f_7->sunrise[d]); });
+  array(writer, "sunset", 7, [&](int d) { writer->minutes(f_7->sunset[d]); });
+  writer->close("}").close("}");
+}
+
+static void write_history(BodyWriter *writer, const HistoryStore *history) {
+  const time_t step = 24 * 3600 / JSON_API_HISTORY_COLUMNS;
+  time_t to = time(nullptr);
+  time_t from = to - 24 * 3600;
+  HistoryPoint points[JSON_API_HISTORY_COLUMNS];
+  writer->open("{").key("from").integer(from).key("step").integer(step);
+  for (int m = 0; m < HistoryMetricMax; ++m) {
+    HistoryMetric metric = (HistoryMetric)m;
+    int decimals = metric == HistoryPm25 ? 0 : 1;
+    history->query(HistoryMinute, metric, from, to, points,
+                   JSON_API_HISTORY_COLUMNS);
+    // [min, avg, max] per column, null for a gap
+    array(writer, metric_names[m], JSON_API_HISTORY_COLUMNS, [&](int c) {
+      const HistoryPoint &point = points[c];
+      if (point.avg == HISTORY_NO_VALUE) {
+        writer->raw("null");
+        return;
+      }
+      writer->open("[");
+      writer->item().decimal(history_decode(metric, point.min), decimals);
+      writer->item().decimal(history_decode(metric, point.avg), decimals);
+      writer->item().decimal(history_decode(metric, point.max), decimals);
+      writer->close("]");
+    });
+  }
+  writer->close("}");
+}
+
+JsonApi::JsonApi(HistoryStore *history, const Weather *weather)
+    : _history(history), _weather(weather) {
+  _lock = xSemaphoreCreateMutexStatic(&_lock_buffer);
+  for (int e = 0; e < ApiEndpointMax; ++e) {
+    _bodies[e].data = static_cast<char *>(malloc(sizes[e]));
+    _bodies[e].size = _bodies[e].data ? sizes[e] : 0;
+  }
+}
+
+// What a body is built from: a new sample for the readings and the history,
+// a new fetch for the forecast
+uint32_t JsonApi::version(ApiEndpoint endpoint) const {
+  switch (endpoint) {
+  case ApiForecast:
+    return (uint32_t)_weather->snapshot()->fetched_at;
+  case ApiNow:
+  case ApiHistory:
+  default:
+    return _history->stats().inserts;
+  }
+}
+
+bool JsonApi::build(ApiEndpoint endpoint, Body *body) {
+  if (body->size == 0) {
+    return false;
+  }
+  BodyWriter writer(body->data, body->size);
+  switch (endpoint) {
+  case ApiNow:
+    write_now(&writer, _history);
+    break;
+  case ApiForecast:
+    write_forecast(&writer, _weather->snapshot());
+    break;
+  case ApiHistory:
+  default:
+    write_history(&writer, _history);
+    break;
+  }
+  _stats.builds++;
+  if (writer.overflow()) {
+    ESP_LOGE(TAG, "%s does not fit %u bytes", paths[endpoint],
+             (unsigned)body->size);
+    _stats.overflows++;
+    body->built = false;
+    return false;
+  }
+  body->length = writer.length();
+  // Content hash, so a rebuild of the same data keeps its tag
+  uint32_t crc = esp_rom_crc32_le(
+      0, reinterpret_cast<const uint8_t *>(body->data), body->length);
+  snprintf(body->etag, sizeof(body->etag), "\"%08lx\"", (unsigned long)crc);
+  body->built = true;
+  return true;
+}
+
+esp_err_t JsonApi::send(httpd_req_t *req, const Body *body) {
+  httpd_resp_set_hdr(req, "ETag", body->etag);
+  httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  char match[sizeof(body->etag)];
+  if (httpd_req_get_hdr_value_str(req, "If-None-Match", match,
+                                  sizeof(match)) == ESP_OK &&
+      strcmp(match, body->etag) == 0) {
+    _stats.not_modified++;
+    httpd_resp_set_status(req, "304 Not Modified");
+    return httpd_resp_send(req, nullptr, 0);
+  }
+  httpd_resp_set_type(req, "application/json");
+  return httpd_resp_send(req, body->data, body->length);
+}
+
+esp_err_t JsonApi::handle(httpd_req_t *req) {
+  // Ignore a query string
+  size_t length = strcspn(req->uri, "?");
+  int endpoint = 0;
+  while (endpoint < ApiEndpointMax &&
+         (strlen(paths[endpoint]) != length ||
+          strncmp(req->uri, paths[endpoint], length) != 0)) {
+    endpoint++;
+  }
+  if (endpoint == ApiEndpointMax) {
+    return httpd_resp_send_404(req);
+  }
+
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  _stats.requests++;
+  Body *body = &_bodies[endpoint];
+  uint32_t current = version((ApiEndpoint)endpoint);
+  if (!body->built || body->version != current) {
+    body->version = current;
+    build((ApiEndpoint)endpoint, body);
+  }
+  esp_err_t err =
+      body->built ? send(req, body)
+                  : httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
+                                        "Body too large");
+  xSemaphoreGive(_lock);
+  return err;
+}
+
+ApiStats JsonApi::stats() const {
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  ApiStats stats = _stats;
+  xSemaphoreGive(_lock);
+  return stats;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "history.hpp"
+#include "weather.hpp"
+#include <esp_http_server.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_API_NOW_SIZE 160
+#define JSON_API_FORECAST_SIZE 2048
+#define JSON_API_HISTORY_SIZE 3584
+#define JSON_API_HISTORY_COLUMNS 48
+
+typedef enum ApiEndpoint {
+  ApiNow,
+  ApiForecast,
+  ApiHistory,
+  ApiEndpointMax,
+} ApiEndpoint;
+
+typedef struct ApiStats {
+  uint32_t requests;
+  uint32_t not_modified;
+  uint32_t builds;
+  uint32_t overflows;
+} ApiStats;
+
+// Read-only JSON for dashboards: the latest sensor readings, the forecast
+// snapshot and the last day of history. Each body is serialized into its
+// own buffer only when the data behind it changed and served as is until
+// then, with an ETag so pollers get a 304. Requests never reach the action
+// queue or the display.
+class JsonApi {
+public:
+  JsonApi(HistoryStore *history, const Weather *weather);
+  // Serves the /api/ URIs, 404 for the ones it does not know.
+  esp_err_t handle(httpd_req_t *req);
+  ApiStats stats() const;
+
+private:
+  typedef struct Body {
+    char *data;
+    size_t size;
+    size_t length;
+    // Version of the data the body was built from
+    uint32_t version;
+    bool built;
+    char etag[12];
+  } Body;
+
+  HistoryStore *_history;
+  const Weather *_weather;
+  Body _bodies[ApiEndpointMax] = {};
+  StaticSemaphore_t _lock_buffer;
+  SemaphoreHandle_t _lock;
+  ApiStats _stats = {};
+
+  uint32_t version(ApiEndpoint endpoint) const;
+  bool build(ApiEndpoint endpoint, Body *body);
+  esp_err_t send(httpd_req_t *req, const Body *body);
+};
@@ -0,0 +1,248 @@
+#include "json_extractor.hpp"
+#include <string.h>
+
+JsonExtractor::JsonExtractor(JsonField *fields, size_t count)
+    : _fields(fields), _count(count) {
+  for (size_t i = 0; i < count; ++i) {
+    fields[i].found = false;
+    if (fields[i].size) {
+      fields[i].value[0] = '\0';
+    }
+  }
+}
+
+bool JsonExtractor::feed(const char *data, size_t length) {
+  for (size_t i = 0; i < length && _state != Error; ++i) {
+    // A literal ends on the first byte that is not part of it, which then
+    // belongs to the next token
+    if (!step(data[i]) && _state != Error) {
+      step(data[i]);
+    }
+  }
+  return _state != Error;
+}
+
+static bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool is_literal(char c) {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' ||
+         c == '+' || c == '.' || c == 'E';
+}
+
+static int hex_value(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// Consumes c, false when c ended a literal without being part of it.
+bool JsonExtractor::step(char c) {
+  switch (_state) {
+  case Value:
+    if (!is_space(c) && !begin_value(c)) {
+      _state = Error;
+    }
+    return true;
+  case AfterValue:
+    if (is_space(c)) {
+      return true;
+    }
+    if (c == ',') {
+      _state = _object[_depth] ? Key : Value;
+    } else if (c == (_object[_depth] ? '}' : ']')) {
+      close();
+    } else {
+      _state = Error;
+    }
+    return true;
+  case Key:
+    if (c == '}') {
+      close();
+    } else if (c == '"') {
+      _path_length = _prefix[_depth];
+      if (_path_length) {
+        push_path('.');
+      }
+      _in_key = true;
+      _state = String;
+    } else if (!is_space(c)) {
+      _state = Error;
+    }
+    return true;
+  case Colon:
+    if (c == ':') {
+      _state = Value;
+    } else if (!is_space(c)) {
+      _state = Error;
+    }
+    return true;
+  case String:
+    if (c == '"') {
+      if (_in_key) {
+        _in_key = false;
+        _state = Colon;
+      } else {
+        end_value();
+      }
+    } else if (c == '\\') {
+      _state = Escape;
+    } else if ((unsigned char)c < 0x20) {
+      _state = Error;
+    } else {
+      append(c);
+    }
+    return true;
+  case Escape: {
+    const char *escapes = "\"\"\\\\//b\bf\fn\nr\rt\t";
+    const char *escape = nullptr;
+    for (const char *e = escapes; *e; e += 2) {
+      if (*e == c) {
+        escape = e;
+        break;
+      }
+    }
+    if (c == 'u') {
+      _code_point = 0;
+      _hex_digits = 0;
+      _state = Unicode;
+    } else if (escape) {
+      append(escape[1]);
+      _state = String;
+    } else {
+      _state = Error;
+    }
+    return true;
+  }
+  case Unicode: {
+    int value = hex_value(c);
+    if (value < 0) {
+      _state = Error;
+      return true;
+    }
+    _code_point = (_code_point << 4) | value;
+    if (++_hex_digits == 4) {
+      // Surrogate pairs are not worth the state, they come out as '?'
+      append_utf8(_code_point >= 0xd800 && _code_point <= 0xdfff
+                      ? '?'
+                      : _code_point);
+      _state = String;
+    }
+    return true;
+  }
+  case Literal:
+    if (is_literal(c)) {
+      append(c);
+      return true;
+    }
+    end_value();
+    return false;
+  case Done:
+  case Error:
+    return true;
+  }
+  return true;
+}
+
+bool JsonExtractor::begin_value(char c) {
+  if (c == '{' || c == '[') {
+    if (_depth == JSON_MAX_DEPTH) {
+      return false;
+    }
+    _depth++;
+    _object[_depth] = c == '{';
+    if (c == '[') {
+      // Nothing matches below an array
+      _path_length = JSON_MAX_PATH;
+    }
+    _prefix[_depth] = _path_length;
+    _state = c == '{' ? Key : Value;
+    return true;
+  }
+  if (c == ']' && _depth && !_object[_depth]) {
+    close();
+    return true;
+  }
+  _target = match();
+  _target_length = 0;
+  if (c == '"') {
+    _state = String;
+    return true;
+  }
+  if (is_literal(c)) {
+    append(c);
+    _state = Literal;
+    return true;
+  }
+  return false;
+}
+
+void JsonExtractor::close() {
+  _path_length = _prefix[_depth];
+  _depth--;
+  end_value();
+}
+
+void JsonExtractor::end_value() {
+  if (_target) {
+    _target->found = true;
+    _found++;
+    _target = nullptr;
+  }
+  _state = _depth ? AfterValue : Done;
+}
+
+void JsonExtractor::push_path(char c) {
+  if (_path_length < JSON_MAX_PATH) {
+    _path[_path_length] = c;
+  }
+  if (_path_length < UINT16_MAX) {
+    _path_length++;
+  }
+}
+
+void JsonExtractor::append(char c) {
+  if (_in_key) {
+    push_path(c);
+    return;
+  }
+  if (_target && _target_length + 1 < _target->size) {
+    _target->value[_target_length++] = c;
+    _target->value[_target_length] = '\0';
+  }
+}
+
+void JsonExtractor::append_utf8(uint32_t code_point) {
+  if (code_point < 0x80) {
+    append(code_point);
+  } else if (code_point < 0x800) {
+    append(0xc0 | (code_point >> 6));
+    append(0x80 | (code_point & 0x3f));
+  } else {
+    append(0xe0 | (code_point >> 12));
+    append(0x80 | ((code_point >> 6) & 0x3f));
+    append(0x80 | (code_point & 0x3f));
+  }
+}
+
+JsonField *JsonExtractor::match() {
+  if (_path_length >= JSON_MAX_PATH) {
+    return nullptr;
+  }
+  for (size_t i = 0; i < _count; ++i) {
+    JsonField *field = &_fields[i];
+    if (!field->found && strlen(field->path) == _path_length &&
+        memcmp(field->path, _path, _path_length) == 0) {
+      return field;
+    }
+  }
+  return nullptr;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_MAX_DEPTH 8
+#define JSON_MAX_PATH 64
+
+// A value to pull out of a document. path is the dotted chain of object
+// keys, "time_zone.name"; values inside arrays never match. Strings are
+// unescaped, numbers and literals copied as written, both cut to size - 1.
+typedef struct JsonField {
+  const char *path;
+  char *value;
+  size_t size;
+  bool found;
+} JsonField;
+
+// Streaming JSON scanner that fills the fields as bytes come in, without
+// building a tree or allocating: memory is the current key path and the
+// container stack. The first occurrence of a path wins.
+class JsonExtractor {
+public:
+  JsonExtractor(JsonField *fields, size_t count);
+  // Feeds the next bytes of the document, false once it is malformed.
+  bool feed(const char *data, size_t length);
+  // The top level value is complete.
+  bool done() const { return _state == Done; }
+  size_t found() const { return _found; }
+
+private:
+  typedef enum State {
+    Value,
+    AfterValue,
+    Key,
+    Colon,
+    String,
+    Escape,
+    Unicode,
+    Literal,
+    Done,
+    Error,
+  } State;
+
+  JsonField *_fields;
+  size_t _count;
+  size_t _found = 0;
+  State _state = Value;
+  int _depth = 0;
+  bool _object[JSON_MAX_DEPTH + 1] = {};
+  // Key path the children of each open container start from, JSON_MAX_PATH
+  // and above never match
+  uint16_t _prefix[JSON_MAX_DEPTH + 1] = {};
+  char _path[JSON_MAX_PATH];
+  uint16_t _path_length = 0;
+  bool _in_key = false;
+  JsonField *_target = nullptr;
+  size_t _target_length = 0;
+  uint32_t _code_point = 0;
+  int _hex_digits = 0;
+
+  bool step(char c);
+  bool begin_value(char c);
+  void close();
+  void end_value();
+  void push_path(char c);
+  void append(char c);
+  void append_utf8(uint32_t code_point);
+  JsonField *match();
+};
@@ -0,0 +1,226 @@
+#include "locations.hpp"
+#include "forecast_view.hpp"
+#include "http_client.hpp"
+#include "text_builder.hpp"
+#include "weather_api_generated.h"
+#include <algorithm>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <flatbuffers/flatbuffers.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NVS_NAMESPACE "Places"
+#define NVS_VERSION 3
+#define NVS_FORECAST_NAMESPACE "PlacesWx"
+#define NVS_FORECAST_VERSION 3
+
+#define OPEN_METEO_URL "https://api.open-meteo.com/v1/forecast"
+#define OPEN_METEO_HOURLY "temperature_2m,weather_code"
+#define OPEN_METEO_DAILY                                                       \
+  "temperature_2m_max,temperature_2m_min,precipitation_probability_max"
+// One coordinate pair is at most 20 characters
+#define URL_SIZE (256 + LOCATIONS_MAX * 2 * 10)
+#define RESPONSE_SIZE (1024 * LOCATIONS_MAX)
+#define PREFIX_SIZE sizeof(flatbuffers::uoffset_t)
+
+static const char *TAG = "Locations";
+
+// Saved with the fetch time as the record stamp, outside its CRC
+static_assert(sizeof(LocationForecast) == 8 &&
+                  offsetof(LocationsSnapshot, fetched_at) ==
+                      sizeof(LocationForecast) * LOCATIONS_MAX + 8 &&
+                  sizeof(LocationsSnapshot) ==
+                      offsetof(LocationsSnapshot, fetched_at) + sizeof(time_t),
+              "No implicit padding in a snapshot, fetched_at ends it");
+
+// FNV-1a, enough to tell a list or a config string from another
+static uint32_t hash(const void *data, size_t size) {
+  uint32_t value = 2166136261u;
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; ++i) {
+    value = (value ^ bytes[i]) * 16777619u;
+  }
+  return value;
+}
+
+Locations::Locations()
+    : _record(NVS_NAMESPACE, NVS_VERSION),
+      _forecast_record(NVS_FORECAST_NAMESPACE, NVS_FORECAST_VERSION,
+                       sizeof(time_t)),
+      _current(&_snapshots[0]) {
+  _seed = hash(CONFIG_CLOCK_LOCATIONS, sizeof(CONFIG_CLOCK_LOCATIONS) - 1);
+  LocationsRecord record;
+  if (_record.load(&record, sizeof(record)) &&
+      record.count <= LOCATIONS_MAX && record.seed == _seed) {
+    _count = record.count;
+    memcpy(_locations, record.locations, sizeof(_locations));
+    _places = hash(_locations, _count * sizeof(Location));
+  } else {
+    seed();
+  }
+  if (!_forecast_record.load(&_snapshots[0], sizeof(_snapshots[0])) ||
+      _snapshots[0].places != _places) {
+    _snapshots[0] = LocationsSnapshot();
+  }
+  ESP_LOGI(TAG, "%u places", (unsigned)_count);
+}
+
+// Parses "name:latitude,longitude;..." from the config into NVS
+void Locations::seed() {
+  char config[] = CONFIG_CLOCK_LOCATIONS;
+  char *rest = nullptr;
+  _count = 0;
+  for (char *entry = strtok_r(config, ";", &rest);
+       entry && _count < LOCATIONS_MAX; entry = strtok_r(nullptr, ";", &rest)) {
+    char *colon = strchr(entry, ':');
+    char *comma = colon ? strchr(colon, ',') : nullptr;
+    if (comma == nullptr) {
+      ESP_LOGE(TAG, "Ignoring \"%s\", not name:latitude,longitude", entry);
+      continue;
+    }
+    *colon = '\0';
+    Location *location = &_locations[_count++];
+    strlcpy(location->name, entry, sizeof(location->name));
+    location->latitude = strtof(colon + 1, nullptr);
+    location->longitude = strtof(comma + 1, nullptr);
+  }
+  ESP_LOGI(TAG, "Seeded %u places from the config", (unsigned)_count);
+  save();
+}
+
+bool Locations::set(const Location *locations, size_t count) {
+  if (count > LOCATIONS_MAX) {
+    return false;
+  }
+  memset(_locations, 0, sizeof(_locations));
+  memcpy(_locations, locations, count * sizeof(Location));
+  _count = count;
+  save();
+  // Published like a refresh, the pages may be reading the current one
+  const LocationsSnapshot *current = snapshot();
+  LocationsSnapshot *next =
+      current == &_snapshots[0] ? &_snapshots[1] : &_snapshots[0];
+  *next = LocationsSnapshot();
+  _current.store(next, std::memory_order_release);
+  return true;
+}
+
+// The list with the seed it came from, forecasts saved from now on are
+// matched to it
+void Locations::save() {
+  static_assert(sizeof(LocationsRecord) ==
+                    sizeof(Location) * LOCATIONS_MAX + 8,
+                "No implicit padding in the locations record");
+  LocationsRecord record = {};
+  record.seed = _seed;
+  record.count = _count;
+  memcpy(record.locations, _locations, sizeof(record.locations));
+  _record.save(&record, sizeof(record));
+  _places = hash(_locations, _count * sizeof(Location));
+}
+
+void Locations::start() {
+  if (_count) {
+    _response = static_cast<uint8_t *>(malloc(RESPONSE_SIZE));
+  }
+}
+
+// The response holds one size prefixed buffer per place, in request order
+bool Locations::decode(size_t length, LocationsSnapshot *snapshot) {
+  size_t offset = 0;
+  for (size_t i = 0; i < _count; ++i) {
+    if (offset + PREFIX_SIZE > length) {
+      ESP_LOGE(TAG, "Missing place %u", (unsigned)i);
+      return false;
+    }
+    const uint8_t *buffer = _response + offset;
+    size_t size = PREFIX_SIZE + flatbuffers::ReadScalar<flatbuffers::uoffset_t>(
+                                    buffer);
+    flatbuffers::Verifier verifier(buffer, std::min(size, length - offset));
+    if (size > length - offset ||
+        !openmeteo_sdk::VerifySizePrefixedWeatherApiResponseBuffer(verifier)) {
+      ESP_LOGE(TAG, "Invalid response for place %u", (unsigned)i);
+      return false;
+    }
+    ForecastView view(openmeteo_sdk::GetSizePrefixedWeatherApiResponse(buffer));
+    Span<float> temperature = view.hourly(HourlyTemperature);
+    Span<float> code = view.hourly(HourlyWeatherCode);
+    Span<float> max = view.daily(DailyTemperatureMax);
+    Span<float> min = view.daily(DailyTemperatureMin);
+    Span<float> rain = view.daily(DailyPrecipitationProbabilityMax);
+    LocationForecast *forecast = &snapshot->forecasts[i];
+    forecast->temperature_2m =
+        forecast_encode_temperature(temperature.empty() ? NAN : temperature[0]);
+    forecast->weather_code = forecast_encode_code(code.empty() ? NAN : code[0]);
+    forecast->temperature_2m_max =
+        forecast_encode_temperature(max.empty() ? NAN : max[0]);
+    forecast->temperature_2m_min =
+        forecast_encode_temperature(min.empty() ? NAN : min[0]);
+    forecast->precipitation_probability_max =
+        forecast_encode_percent(rain.empty() ? NAN : rain[0]);
+    offset += size;
+  }
+  return true;
+}
+
+bool Locations::refresh() {
+  if (_count == 0) {
+    return true;
+  }
+  if (_response == nullptr) {
+    return false;
+  }
+  char latitudes[LOCATIONS_MAX * 10 + 1] = "";
+  char longitudes[LOCATIONS_MAX * 10 + 1] = "";
+  for (size_t i = 0; i < _count; ++i) {
+    const char *separator = i ? "," : "";
+    size_t length = strlen(latitudes);
+    snprintf(latitudes + length, sizeof(latitudes) - length, "%s%s",
+             separator,
+             TextBuilder().decimal(_locations[i].latitude, 4).c_str());
+    length = strlen(longitudes);
+    snprintf(longitudes + length, sizeof(longitudes) - length, "%s%s",
+             separator,
+             TextBuilder().decimal(_locations[i].longitude, 4).c_str());
+  }
+  char url[URL_SIZE];
+  snprintf(url, sizeof(url),
+           OPEN_METEO_URL "?latitude=%s&longitude=%s"
+                          "&hourly=" OPEN_METEO_HOURLY
+                          "&daily=" OPEN_METEO_DAILY
+                          "&forecast_hours=1&forecast_days=1"
+                          "&timezone=auto&format=flatbuffers",
+           latitudes, longitudes);
+
+  int64_t start = esp_timer_get_time();
+  HttpResponse response;
+  esp_err_t err = http_client_get(url, _response, RESPONSE_SIZE, &response);
+  _stats.requests++;
+  _stats.last_fetch_us = esp_timer_get_time() - start;
+  _stats.last_response_bytes = response.length;
+  if (err != ESP_OK || response.status != 200 || response.truncated) {
+    ESP_LOGE(TAG, "Request failed: %s, status %d%s", esp_err_to_name(err),
+             response.status, response.truncated ? ", truncated" : "");
+    _stats.failures++;
+    return false;
+  }
+
+  const LocationsSnapshot *current = snapshot();
+  LocationsSnapshot *next =
+      current == &_snapshots[0] ? &_snapshots[1] : &_snapshots[0];
+  if (!decode(response.length, next)) {
+    _stats.failures++;
+    return false;
+  }
+  next->places = _places;
+  next->fetched_at = time(nullptr);
+  _current.store(next, std::memory_order_release);
+  ESP_LOGI(TAG, "%u places in one request: %lld ms, %u bytes, %u per place",
+           (unsigned)_count, _stats.last_fetch_us / 1000,
+           (unsigned)response.length, (unsigned)(response.length / _count));
+  _forecast_record.save(next, sizeof(*next));
+  return true;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "forecast.hpp"
+#include "persistence.hpp"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define LOCATIONS_MAX 4
+#define LOCATION_NAME_MAX 16
+
+typedef struct Location {
+  char name[LOCATION_NAME_MAX];
+  float latitude;
+  float longitude;
+} Location;
+
+// Current hour and today of one place, in the fixed point of forecast.hpp.
+typedef struct LocationForecast {
+  int16_t temperature_2m;
+  int16_t temperature_2m_max;
+  int16_t temperature_2m_min;
+  uint8_t precipitation_probability_max;
+  uint8_t weather_code;
+
+  float temperature() const {
+    return forecast_decode_temperature(temperature_2m);
+  }
+  float temperature_max() const {
+    return forecast_decode_temperature(temperature_2m_max);
+  }
+  float temperature_min() const {
+    return forecast_decode_temperature(temperature_2m_min);
+  }
+  float precipitation_max() const {
+    return forecast_decode_percent(precipitation_probability_max);
+  }
+  OM_SDK::WeatherCode code() const {
+    return static_cast<OM_SDK::WeatherCode>(weather_code);
+  }
+} LocationForecast;
+
+typedef struct LocationsSnapshot {
+  LocationForecast forecasts[LOCATIONS_MAX];
+  // Hash of the list the forecasts were fetched for
+  uint32_t places;
+  uint32_t reserved;
+  time_t fetched_at;
+} LocationsSnapshot;
+
+typedef struct LocationsStats {
+  unsigned requests;
+  unsigned failures;
+  int64_t last_fetch_us;
+  size_t last_response_bytes;
+} LocationsStats;
+
+// The weather of a few named places besides the one the clock is at. The
+// list is kept in NVS, seeded from CONFIG_CLOCK_LOCATIONS again whenever
+// the config changes, and all places are fetched with a single Open-Meteo
+// request listing their coordinates, which answers with one size prefixed
+// flatbuffer per place. Forecasts of another list are dropped.
+class Locations {
+public:
+  Locations();
+  void start();
+  // Fetches and publishes the table, blocking. Called by the refresh
+  // scheduler.
+  bool refresh();
+  // Replaces the list kept in NVS until the config changes, and drops the
+  // forecasts of the previous one. Before start(), false if count is over
+  // LOCATIONS_MAX.
+  bool set(const Location *locations, size_t count);
+  size_t count() const { return _count; }
+  const Location &location(size_t index) const { return _locations[index]; }
+  // Published with a pointer swap like the weather snapshot.
+  const LocationsSnapshot *snapshot() const {
+    return _current.load(std::memory_order_acquire);
+  }
+  const LocationsStats &stats() const { return _stats; }
+
+private:
+  // Laid out without padding, the record is checksummed byte for byte
+  typedef struct LocationsRecord {
+    Location locations[LOCATIONS_MAX];
+    // Hash of the CONFIG_CLOCK_LOCATIONS the list was seeded from
+    uint32_t seed;
+    uint8_t count;
+    uint8_t reserved[3];
+  } LocationsRecord;
+
+  PersistentRecord _record;
+  PersistentRecord _forecast_record;
+  Location _locations[LOCATIONS_MAX] = {};
+  size_t _count = 0;
+  uint32_t _seed = 0;
+  uint32_t _places = 0;
+  LocationsSnapshot _snapshots[2] = {};
+  std::atomic<const LocationsSnapshot *> _current;
+  uint8_t *_response = nullptr;
+  LocationsStats _stats = {};
+
+  void seed();
+  void save();
+  bool decode(size_t length, LocationsSnapshot *snapshot);
+};
@@ -1,7 +1,24 @@
+#include "action_queue.hpp"
+#include "ambient_light.hpp"
+#include "archive.hpp"
 #include "bh1750.h"
+#include "buttons.hpp"
+#include "cores.hpp"
 #include "geolocation.hpp"
+#include "history.hpp"
+#include "hourly_forecast.hpp"
+#include "http_client.hpp"
 #include "http_manager.h"
-#include "pm25.hpp"
+#include "json_api.hpp"
+#include "locations.hpp"
+#include "metrics.hpp"
+#include "pages.hpp"
+#include "power.hpp"
+#include "refresh_scheduler.hpp"
+#include "renderer.hpp"
+#include "rtc_state.hpp"
+#include "screen.hpp"
+#include "sensor_sampler.hpp"
 #include "sntp.h"
 #include "weather.hpp"
 #include "weather_api_generated.h"
@@ -26,7 +43,8 @@
 
 #define U_TO_SEC 1000000
 #define U_TO_MIN U_TO_SEC * 60
-#define ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+#define HOUR_S 3600
+#define DAY_S (24 * HOUR_S)
 
 const char TAG[] = "main";
 
@@ -39,44 +57,42 @@ typedef struct Timers {
 
 typedef struct UserContext {
   char str_ip[16];
-  QueueHandle_t actionQueue;
+  ActionQueue *actions;
   Geolocation *geo;
   Timers timers;
-  bh1750_handle_t light_sensor;
-  PM25 *pm25;
-  sht3x_handle_t sht3x;
+  AmbientLight *ambient;
+  HistoryStore *history;
+  Archive *archive;
+  HourlyForecast *hourly;
+  RefreshScheduler *scheduler;
   Weather *w;
+  Locations *locations;
+  JsonApi *api;
+  Screen *screen;
+  Renderer *renderer;
 
   int _page;
   bool screen_on;
 } UserContext;
 
-typedef void (*ScreenUpdateFunc)(UserContext *user_ctx);
-
-void page_main(UserContext *user_ctx);
-void page_today(UserContext *user_ctx);
-void page_tomorrow(UserContext *user_ctx);
-void page_d2(UserContext *user_ctx);
-void page_d3(UserContext *user_ctx);
-void page_d4(UserContext *user_ctx);
-bool bh1750_get(bh1750_handle_t bh1750, float *output);
-
-ScreenUpdateFunc screen_update_func[] = {
-    page_main, page_today, page_tomorrow, page_d2, page_d3, page_d4,
-};
-
 void change_page(int page, UserContext *user_ctx) {
   user_ctx->_page += page;
   if (user_ctx->_page < 0) {
-    user_ctx->_page = (int)(ARRAY_SIZE(screen_update_func)) - 1;
+    user_ctx->_page = page_count() - 1;
   }
-  if (user_ctx->_page >= ARRAY_SIZE(screen_update_func)) {
+  if (user_ctx->_page >= page_count()) {
     user_ctx->_page = 0;
   }
 }
 
 void sleep_action(void *pvParameter) {
   ESP_LOGI(TAG, "Entering sleep mode");
+  UserContext *user_ctx = static_cast<UserContext *>(pvParameter);
+  rtc_state_save(user_ctx->w->snapshot(), user_ctx->geo->posix_tz(),
+                 user_ctx->_page, M5.Lcd.getBrightness());
+  user_ctx->archive->flush();
+  power_set_state(PowerDeepSleep);
+  power_wake_at(user_ctx->scheduler->next_deadline());
   gpio_pullup_en(GPIO_NUM_38);
   gpio_pulldown_dis(GPIO_NUM_38);
   esp_sleep_enable_ext0_wakeup(GPIO_NUM_38, false);
@@ -85,12 +101,25 @@ void sleep_action(void *pvParameter) {
 
 void screen_update_cb(void *pvParameter) {
   UserContext *user_ctx = static_cast<UserContext *>(pvParameter);
-  Action *new_action = new Action(UpdateScreen);
-  xQueueSend(user_ctx->actionQueue, (void *)&new_action, 100);
+  user_ctx->actions->send(Action(UpdateScreen));
+}
+
+void weather_updated_cb(void *pvParameter) {
+  UserContext *user_ctx = static_cast<UserContext *>(pvParameter);
+  user_ctx->archive->append_forecast(time(nullptr),
+                                     &user_ctx->w->snapshot()->forecast24);
+  if (user_ctx->screen_on) {
+    screen_update_cb(pvParameter);
+  }
+}
+
+void stop_timer(esp_timer_handle_t timer) {
+  if (esp_timer_is_active(timer))
+    ESP_ERROR_CHECK(esp_timer_stop(timer));
 }
+
 void stop_sleep_timer(UserContext *user_ctx) {
-  if (esp_timer_is_active(user_ctx->timers.sleep))
-    ESP_ERROR_CHECK(esp_timer_stop(user_ctx->timers.sleep));
+  stop_timer(user_ctx->timers.sleep);
 }
 
 void start_or_restart_timer(esp_timer_handle_t timer, uint64_t timeout_us) {
@@ -111,233 +140,141 @@ void screen_off(void *pvParameter) {
   if (esp_timer_is_active(user_ctx->timers.screen_update)) {
     esp_timer_stop(user_ctx->timers.screen_update);
   }
-  Action *new_action = new Action(ScreenOff);
-  xQueueSend(user_ctx->actionQueue, (void *)&new_action, (TickType_t)0);
-  start_or_restart_timer(user_ctx->timers.sleep, 1 * U_TO_MIN);
+  user_ctx->actions->send(Action(ScreenOff));
+  power_set_state(PowerIdle);
+#if CONFIG_CLOCK_BRIGHTNESS_AUTO
+  user_ctx->ambient->set_active(false);
+#endif
+  if (power_deep_sleep_enabled()) {
+    start_or_restart_timer(user_ctx->timers.sleep, 1 * U_TO_MIN);
+  }
 }
 
-void update_screen(UserContext *user_ctx) {
+// input_us is the time of the button edge that asked for it, if any.
+void update_screen(UserContext *user_ctx, int64_t input_us = 0) {
+  int64_t start_us = esp_timer_get_time();
   stop_sleep_timer(user_ctx);
+  bool was_on = user_ctx->screen_on;
   user_ctx->screen_on = true;
-  M5.Lcd.wakeup();
+  power_set_state(PowerActive);
+  // Without deep sleep nothing reboots, so resume the periodic refresh here
+  if (user_ctx->timers.screen_update &&
+      !esp_timer_is_active(user_ctx->timers.screen_update)) {
+    esp_timer_start_periodic(user_ctx->timers.screen_update, U_TO_SEC * 30);
+  }
 #if CONFIG_CLOCK_BRIGHTNESS_AUTO
-  float lux = 0;
-  bh1750_get(user_ctx->light_sensor, &lux);
-  if (lux > 5000)
-    lux = 5000;
-  lux = lux * 255 / 5000;
-  if (lux < 1)
-    lux = 1;
-  M5.Lcd.setBrightness(lux);
+  user_ctx->ambient->set_active(true);
 #endif
-  screen_update_func[user_ctx->_page](user_ctx);
+  PageContext page = {
+      .screen = user_ctx->screen,
+      .weather = user_ctx->w->snapshot(),
+      .history = user_ctx->history,
+      .hourly = user_ctx->hourly,
+      .locations = user_ctx->locations,
+      .now = time(nullptr),
+      .online = *user_ctx->str_ip != '\0',
+      .page = user_ctx->_page,
+  };
+  user_ctx->renderer->render(page, input_us);
+  if (!was_on) {
+    // Stale data refreshes right away while someone is looking
+    user_ctx->scheduler->wake();
+  }
+  metrics_observe(MetricUpdateScreen, esp_timer_get_time() - start_us);
 }
 
-void page_main(UserContext *user_ctx) {
-  ESP_LOGI(TAG, "Show Main page");
-  M5.Lcd.setTextSize(3);
-  float tem_val, hum_val;
-  M5.Lcd.fillScreen(BLACK);
-  M5.Lcd.setCursor(0, 0);
-  char time_buf[20] = {0};
-  char format[] = "%a %D\n%H:%M";
-  get_time(format, time_buf, sizeof(time_buf), 0);
-  ESP_LOGI(TAG, "%s", time_buf);
-  M5.Lcd.printf("%s\n\n", time_buf);
-  PMSAQIdata data;
-  M5.Lcd.setTextSize(2);
-  if (user_ctx->pm25->get(&data)) {
-    M5.Lcd.printf("pm25: %d\n", data.pm25_standard);
-  }
-  if (sht3x_get_humiture(user_ctx->sht3x, &tem_val, &hum_val) == 0) {
-    M5.Lcd.printf("temp: %02.0fC\n"
-                  "hum:  %02.0f%%\n",
-                  tem_val, hum_val);
+bool refresh_ntp(void *arg) {
+  UserContext *user_ctx = static_cast<UserContext *>(arg);
+  int64_t start_us = esp_timer_get_time();
+  bool ok = sync_ntp_time();
+  metrics_observe(MetricNtpSync, esp_timer_get_time() - start_us);
+  if (!ok) {
+    metrics_count(MetricNtpErrors);
+    return false;
   }
+  user_ctx->scheduler->set_ttl(RefreshNtp, ntp_next_interval_s());
+  return true;
+}
 
-  if (*user_ctx->str_ip) {
-    time_t now;
-    time(&now);
-    struct tm tm;
-    localtime_r(&now, &tm);
-    user_ctx->w->update_weather(user_ctx->geo->latitude(),
-                                user_ctx->geo->longitude());
-    M5.Lcd.printf("\n%s\n"
-                  "UV:   %.1f\n"
-                  "rain: %.0f%%\n"
-                  "temp: %.0fC\n",
-                  OM_SDK::EnumNamesWeatherCode(
-                      user_ctx->w->forecast24.weather_code[tm.tm_hour]),
-                  user_ctx->w->forecast24.uv_index[tm.tm_hour],
-                  user_ctx->w->forecast24.precipitation_probability[tm.tm_hour],
-                  user_ctx->w->forecast24.temperature_2m[tm.tm_hour]);
+bool refresh_geolocation(void *arg) {
+  UserContext *user_ctx = static_cast<UserContext *>(arg);
+  int64_t start_us = esp_timer_get_time();
+  bool ok = user_ctx->geo->update_geoloc() == 200;
+  metrics_observe(MetricGeolocationRefresh, esp_timer_get_time() - start_us);
+  if (!ok) {
+    metrics_count(MetricGeolocationErrors);
   }
+  settimezone(user_ctx->geo->posix_tz());
+  return ok;
 }
 
-void page_today(UserContext *user_ctx) {
-  ESP_LOGI(TAG, "Show Today page");
-  M5.Lcd.fillScreen(BLACK);
-  M5.Lcd.setTextSize(2.5);
-  M5.Lcd.setCursor(0, 0);
-  char time_buf[16] = {0};
-  char format[] = "%D";
-  get_time(format, time_buf, sizeof(time_buf), 0);
-  M5.Lcd.printf(
-      "Today:\n%s\n%s\n\n", time_buf,
-      OM_SDK::EnumNamesWeatherCode(user_ctx->w->forecast7.weather_code[0]));
-  if (*user_ctx->str_ip) {
-    time_t now;
-    time(&now);
-    struct tm tm;
-    localtime_r(&now, &tm);
-    user_ctx->w->update_weather(user_ctx->geo->latitude(),
-                                user_ctx->geo->longitude());
-    Forecast24 *f24 = &(user_ctx->w->forecast24);
-    char time_buf_sunset[6] = {0};
-    char time_buf_sunrise[6] = {0};
-    char format_h[] = "%H:%M";
-    struct tm timeinfo;
-    localtime_r(&(user_ctx->w->forecast7.sunrise[0]), &timeinfo);
-    strftime(time_buf_sunrise, ARRAY_SIZE(time_buf_sunrise), format_h,
-             &timeinfo);
-    localtime_r(&(user_ctx->w->forecast7.sunset[0]), &timeinfo);
-    strftime(time_buf_sunset, ARRAY_SIZE(time_buf_sunset), format_h, &timeinfo);
-    if (tm.tm_hour == 23) {
-
-      M5.Lcd.printf("      23h\n"
-                    "      %s"
-                    "rain: %02.0f%%\n"
-                    "temp: %02.0fC\n"
-                    "UV:   %02.1f\n\n"
-                    "sunrise: %s\n"
-                    "sunset:  %s\n",
-                    OM_SDK::EnumNamesWeatherCode(f24->weather_code[tm.tm_hour]),
-                    f24->temperature_2m[tm.tm_hour],
-                    f24->precipitation_probability[tm.tm_hour],
-                    f24->uv_index[tm.tm_hour], time_buf_sunrise,
-                    time_buf_sunset);
-    } else {
-      int t1 = 8;
-      int t2 = 16;
-      if (tm.tm_hour == 21 || tm.tm_hour == 22) {
-        t1 = 22;
-        t2 = 23;
-      } else if (tm.tm_hour == 20 || tm.tm_hour == 19) {
-        t1 = 21;
-        t2 = 23;
-      } else if (tm.tm_hour == 18 || tm.tm_hour == 17) {
-        t1 = 19;
-        t2 = 22;
-      } else if (tm.tm_hour == 16) {
-        t1 = 18;
-        t2 = 21;
-      } else if (tm.tm_hour == 15 || tm.tm_hour == 14) {
-        t1 = 17;
-        t2 = 20;
-      } else if (tm.tm_hour == 13 || tm.tm_hour == 12) {
-        t1 = 16;
-        t2 = 20;
-      } else if (tm.tm_hour == 11) {
-        t1 = 14;
-        t2 = 19;
-      } else if (tm.tm_hour == 10 || tm.tm_hour == 9) {
-        t1 = 13;
-        t2 = 18;
-      } else if (tm.tm_hour > 6) {
-        t1 = 12;
-        t2 = 19;
-      }
-
-      M5.Lcd.printf("     %dh     %dh\n"
-                    "UV:  %02.1f    %.1f\n"
-                    "rain:%02.0f%%    %02.0f%%\n"
-                    "temp:%02.0fC    %02.0fC\n\n"
-                    "sunrise: %s\n"
-                    "sunset:  %s\n",
-                    t1,
-                    t2, /*OM_SDK::EnumNamesWeatherCode(f24->weather_code[t1]),
-                OM_SDK::EnumNamesWeatherCode(f24->weather_code[t2]),*/
-                    f24->uv_index[t1], f24->uv_index[t2],
-                    f24->precipitation_probability[t1],
-                    f24->precipitation_probability[t2], f24->temperature_2m[t1],
-                    f24->temperature_2m[t2], time_buf_sunrise, time_buf_sunset);
-    }
+bool refresh_weather(void *arg) {
+  UserContext *user_ctx = static_cast<UserContext *>(arg);
+  int64_t start_us = esp_timer_get_time();
+  bool ok = user_ctx->w->refresh(user_ctx->geo->latitude(),
+                                 user_ctx->geo->longitude());
+  metrics_observe(MetricWeatherRefresh, esp_timer_get_time() - start_us);
+  if (!ok) {
+    metrics_count(MetricWeatherErrors);
   }
+  return ok;
 }
 
-void page_tomorrow(UserContext *user_ctx) {
-  ESP_LOGI(TAG, "Show Tomorrow page");
-  ForecastTmr *f_tmr = &(user_ctx->w->forecast_tmr);
-  M5.Lcd.fillScreen(BLACK);
-  M5.Lcd.setTextSize(2.5);
-  M5.Lcd.setCursor(0, 0);
-  char time_buf[16] = {0};
-  char format[] = "%a %D";
-  char time_buf_sunset[6] = {0};
-  char time_buf_sunrise[6] = {0};
-  char format_h[] = "%H:%M";
-  struct tm timeinfo;
-  localtime_r(&(user_ctx->w->forecast7.sunrise[1]), &timeinfo);
-  strftime(time_buf_sunrise, ARRAY_SIZE(time_buf_sunrise), format_h, &timeinfo);
-  localtime_r(&(user_ctx->w->forecast7.sunset[1]), &timeinfo);
-  strftime(time_buf_sunset, ARRAY_SIZE(time_buf_sunset), format_h, &timeinfo);
-  get_time(format, time_buf, sizeof(time_buf), 1);
-  M5.Lcd.printf("Tomorrow\n%s\n", time_buf);
-  M5.Lcd.printf("%s\n\n", OM_SDK::EnumNamesWeatherCode(
-                              user_ctx->w->forecast7.weather_code[1]));
-  M5.Lcd.printf("     9h     15h\n"
-                "UV:  %02.1f    %02.1f\n"
-                "rain:%02.0f%%    %02.0f%%\n"
-                "temp:%02.0fC    %02.0fC\n\n"
-                "sunrise: %s\n"
-                "sunset:  %s\n",
-                /*OM_SDK::EnumNamesWeatherCode(f24->weather_code[t1]),
-               OM_SDK::EnumNamesWeatherCode(f24->weather_code[t2]),*/
-                f_tmr->uv_index[0], f_tmr->uv_index[1],
-                f_tmr->precipitation_probability[0],
-                f_tmr->precipitation_probability[1], f_tmr->temperature_2m[0],
-                f_tmr->temperature_2m[1], time_buf_sunrise, time_buf_sunset);
+bool refresh_locations(void *arg) {
+  UserContext *user_ctx = static_cast<UserContext *>(arg);
+  int64_t start_us = esp_timer_get_time();
+  bool ok = user_ctx->locations->refresh();
+  metrics_observe(MetricLocationsRefresh, esp_timer_get_time() - start_us);
+  if (!ok) {
+    metrics_count(MetricLocationsErrors);
+  }
+  return ok;
 }
 
-void page_week(UserContext *user_ctx, int day) {
-  ESP_LOGI(TAG, "Show Day %d page", day);
-  Forecast7 *f_7 = &(user_ctx->w->forecast7);
-  M5.Lcd.fillScreen(BLACK);
-  M5.Lcd.setTextSize(2.6);
-  M5.Lcd.setCursor(0, 0);
-  char time_buf[16] = {0};
-  char format[] = "%a %D";
-  get_time(format, time_buf, sizeof(time_buf), day);
-  M5.Lcd.printf("%s\n", time_buf);
-  M5.Lcd.printf("%s\n\n", OM_SDK::EnumNamesWeatherCode(f_7->weather_code[day]));
-  char time_buf_sunset[6] = {0};
-  char time_buf_sunrise[6] = {0};
-  char format_h[] = "%H:%M";
-  struct tm timeinfo;
-  localtime_r(&(f_7->sunrise[day]), &timeinfo);
-  strftime(time_buf_sunrise, ARRAY_SIZE(time_buf_sunrise), format_h, &timeinfo);
-  localtime_r(&(f_7->sunset[day]), &timeinfo);
-  strftime(time_buf_sunset, ARRAY_SIZE(time_buf_sunset), format_h, &timeinfo);
-  M5.Lcd.printf("UV:      %02.1f \n"
-                "rain:    %02.0f%%\n"
-                "max:     %02.0fC \n"
-                "min:     %02.0fC\n\n"
-                "sunrise: %s\n"
-                "sunset:  %s\n",
-                f_7->uv_index_max[day], f_7->precipitation_probability_max[day],
-                f_7->temperature_2m_max[day], f_7->temperature_2m_min[day],
-                time_buf_sunrise, time_buf_sunset
-
-  );
+void refresh_idle_cb(void *arg) {
+  UserContext *user_ctx = static_cast<UserContext *>(arg);
+  // Woken by the timer only to refresh, go back to sleep
+  if (!user_ctx->screen_on && power_deep_sleep_enabled() &&
+      user_ctx->timers.sleep) {
+    start_or_restart_timer(user_ctx->timers.sleep, 5 * U_TO_SEC);
+  }
 }
 
-void page_d2(UserContext *user_ctx) { page_week(user_ctx, 2); }
-void page_d3(UserContext *user_ctx) { page_week(user_ctx, 3); }
-void page_d4(UserContext *user_ctx) { page_week(user_ctx, 4); }
-
-void wake_up(UserContext *user_ctx) {
-  check_and_update_ntp_time();
-  settimezone(user_ctx->geo->posix_tz());
+void init_scheduler(UserContext *user_ctx) {
+  RefreshScheduler *scheduler = user_ctx->scheduler;
+  scheduler->add(RefreshNtp,
+                 {.name = "ntp",
+                  .ttl_s = ntp_next_interval_s(),
+                  .stale_s = 18 * HOUR_S,
+                  .backoff_min_s = 30,
+                  .backoff_max_s = HOUR_S,
+                  .priority = 0},
+                 &refresh_ntp, user_ctx);
+  scheduler->add(RefreshGeolocation,
+                 {.name = "geolocation",
+                  .ttl_s = DAY_S,
+                  .stale_s = 6 * DAY_S,
+                  .backoff_min_s = 60,
+                  .backoff_max_s = 6 * HOUR_S,
+                  .priority = 1},
+                 &refresh_geolocation, user_ctx);
+  scheduler->add(RefreshWeather,
+                 {.name = "weather",
+                  .ttl_s = HOUR_S,
+                  .stale_s = 23 * HOUR_S,
+                  .backoff_min_s = 60,
+                  .backoff_max_s = HOUR_S,
+                  .priority = 2},
+                 &refresh_weather, user_ctx);
+  scheduler->add(RefreshLocations,
+                 {.name = "locations",
+                  .ttl_s = HOUR_S,
+                  .stale_s = 23 * HOUR_S,
+                  .backoff_min_s = 60,
+                  .backoff_max_s = HOUR_S,
+                  .priority = 3},
+                 &refresh_locations, user_ctx);
+  scheduler->start(&refresh_idle_cb, user_ctx);
 }
 
 void init_timers(UserContext *user_ctx) {
@@ -364,87 +301,114 @@ void init_timers(UserContext *user_ctx) {
       .arg = user_ctx,
       .dispatch_method = ESP_TIMER_TASK,
       .name = "screen_update",
-      .skip_unhandled_events = false};
+      .skip_unhandled_events = true};
   ESP_ERROR_CHECK(esp_timer_create(&time_timer_args, &timers->screen_update));
-  esp_timer_start_periodic(timers->screen_update, U_TO_SEC * 30);
+  if (user_ctx->screen_on) {
+    esp_timer_start_periodic(timers->screen_update, U_TO_SEC * 30);
+  } else if (power_deep_sleep_enabled()) {
+    // Timer wake: give up if Wi-Fi does not come up
+    start_or_restart_timer(timers->sleep, 1 * U_TO_MIN);
+  }
 }
 
 void action_task(void *pvParameter) {
   UserContext *user_ctx = static_cast<UserContext *>(pvParameter);
   bool connected = false;
-  Action *action = nullptr;
+  Action action;
   init_timers(user_ctx);
   while (1) {
-    if (xQueueReceive(user_ctx->actionQueue, &action, (TickType_t)1000)) {
-      if (!connected && action->action() != WifiConnected &&
-          action->action() != ApStarted) {
-        free(action);
-        action = nullptr;
+    if (user_ctx->actions->receive(&action, (TickType_t)1000)) {
+      if (!connected && action.action() != WifiConnected &&
+          action.action() != ApStarted) {
         continue;
       }
-      switch (action->action()) {
+      switch (action.action()) {
       case UpdateScreen: {
         update_screen(user_ctx);
         break;
       }
       case WifiConnected: {
         connected = true;
-        auto wakeup_cause = esp_sleep_get_wakeup_cause();
-        if (wakeup_cause != ESP_SLEEP_WAKEUP_EXT1 &&
-            wakeup_cause != ESP_SLEEP_WAKEUP_EXT0) {
-          user_ctx->geo->update_geoloc();
+        user_ctx->scheduler->set_connected(true);
+        if (user_ctx->screen_on) {
+          update_screen(user_ctx);
+          update_screen_off_timer(user_ctx);
         }
-        wake_up(user_ctx);
-        update_screen(user_ctx);
-        update_screen_off_timer(user_ctx);
         break;
       }
       case WifiDisconnected:
         connected = false;
-        M5.Lcd.wakeup();
-        M5.Lcd.fillScreen(BLACK);
-        M5.Lcd.setCursor(0, 0);
-        M5.Lcd.printf("Wifi Disconnected");
+        user_ctx->scheduler->set_connected(false);
         ESP_LOGI(TAG, "Wifi Disconnected");
-        M5.Lcd.fillScreen(BLACK);
+        user_ctx->renderer->clear();
         update_screen_off_timer(user_ctx);
         stop_sleep_timer(user_ctx);
         break;
       case ApStarted:
-        M5.Lcd.wakeup();
-        M5.Lcd.fillScreen(BLACK);
-        M5.Lcd.setCursor(0, 0);
-        M5.Lcd.printf(
+        user_ctx->renderer->message(
             "Ap Started\nSSID:\n %s\nPassword:\n %s\nurl:\n http://%s",
             DEFAULT_AP_SSID, DEFAULT_AP_PASSWORD, DEFAULT_AP_IP);
         ESP_LOGI(TAG, "Ap Started");
         break;
       case ScreenOff:
-        M5.Lcd.fillScreen(BLACK);
-        M5.Display.sleep();
+        user_ctx->renderer->off();
+        user_ctx->actions->log_stats();
+        user_ctx->renderer->log_stats();
+        cores_log_load();
+        power_log_stats();
+        http_client_log_stats();
+        user_ctx->scheduler->log_stats();
+        ntp_log_status();
         break;
       case ButtonClicked:
         ESP_LOGI(TAG, "Button");
-        if (*action->value() == 'A' && user_ctx->screen_on) {
+        if (action.value() == 'A' && user_ctx->screen_on) {
           change_page(-1, user_ctx);
-        } else if (*action->value() == 'B') {
+        } else if (action.value() == 'B') {
           user_ctx->_page = 0;
-        } else if (*action->value() == 'C' && user_ctx->screen_on) {
+        } else if (action.value() == 'C' && user_ctx->screen_on) {
           change_page(1, user_ctx);
         }
-        update_screen(user_ctx);
+        update_screen(user_ctx, action.enqueued_us());
         update_screen_off_timer(user_ctx);
         break;
+      case ButtonDoubleClicked:
+        if (action.value() == 'B') {
+          ESP_LOGI(TAG, "Forcing weather update");
+          user_ctx->scheduler->request(RefreshWeather);
+        }
+        break;
+      case ButtonLongPressed:
+        if (action.value() == 'B' && user_ctx->screen_on) {
+          stop_timer(user_ctx->timers.screen_off);
+          screen_off(user_ctx);
+        }
+        break;
+      default:
+        break;
       }
-      free(action);
-      action = nullptr;
     }
   }
 }
 
+static bool send_chunk(const char *text, size_t length, void *arg) {
+  return httpd_resp_send_chunk(static_cast<httpd_req_t *>(arg), text,
+                               length) == ESP_OK;
+}
+
 static esp_err_t wifi_handler(httpd_req_t *req) {
-  Action *action = new Action(ScreenOff);
   esp_err_t result = ESP_OK;
+  if (strcmp(req->uri, "/metrics") == 0) {
+    // Scrapes leave the screen alone
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    metrics_write(&send_chunk, req);
+    return httpd_resp_send_chunk(req, NULL, 0);
+  }
+  UserContext *userContext = static_cast<UserContext *>(req->user_ctx);
+  if (strncmp(req->uri, "/api/", 5) == 0) {
+    // Polled by dashboards, served without waking anything up
+    return userContext->api->handle(req);
+  }
   if (strcmp(req->uri, "/") == 0) {
     httpd_resp_set_status(req, "302");
     httpd_resp_set_hdr(req, "Location", "wifi/");
@@ -453,16 +417,14 @@ static esp_err_t wifi_handler(httpd_req_t *req) {
     ESP_LOGI(TAG, "%s", req->uri);
     httpd_resp_send_404(req);
   }
-  UserContext *userContext = static_cast<UserContext *>(req->user_ctx);
-  xQueueSend(userContext->actionQueue, (void *)&action, (TickType_t)0);
+  userContext->actions->send(Action(ScreenOff));
   return result;
 }
 
 void cb_connection_stopped(void *pvParameter, void *user_ctx) {
   UserContext *userContext = static_cast<UserContext *>(user_ctx);
   userContext->str_ip[0] = '\0';
-  Action *new_action = new Action(WifiDisconnected);
-  xQueueSend(userContext->actionQueue, (void *)&new_action, (TickType_t)100);
+  userContext->actions->send(Action(WifiDisconnected), 100);
 }
 
 void cb_connection_ok(void *pvParameter, void *user_ctx) {
@@ -470,16 +432,16 @@ void cb_connection_ok(void *pvParameter, void *user_ctx) {
   UserContext *userContext = static_cast<UserContext *>(user_ctx);
   esp_ip4addr_ntoa(&param->ip_info.ip, userContext->str_ip, IP4ADDR_STRLEN_MAX);
   ESP_LOGI(TAG, "IP: %s", userContext->str_ip);
-  Action *new_action = new Action(WifiConnected);
-  xQueueSend(userContext->actionQueue, (void *)&new_action, 100);
+  power_wifi_connected();
+  userContext->actions->send(Action(WifiConnected), 100);
 }
 
 void cb_connection_AP_started(void *pvParameter, void *user_ctx) {
   UserContext *userContext = static_cast<UserContext *>(user_ctx);
-  Action *new_action = new Action(ApStarted);
-  xQueueSend(userContext->actionQueue, (void *)&new_action, 100);
+  userContext->actions->send(Action(ApStarted), 100);
 }
 
+// The SHT3x feeds the history, the BH1750 only the automatic brightness
 static void i2c_init(i2c_bus_handle_t *i2c_bus, bh1750_handle_t *bh1750,
                      sht3x_handle_t *sht3x) {
   i2c_config_t conf = {
@@ -492,64 +454,100 @@ static void i2c_init(i2c_bus_handle_t *i2c_bus, bh1750_handle_t *bh1750,
       .clk_flags = 0,
   };
   *i2c_bus = i2c_bus_create(I2C_MASTER_NUM, &conf);
+#if CONFIG_CLOCK_BRIGHTNESS_AUTO
   *bh1750 = bh1750_create(*i2c_bus, BH1750_I2C_ADDRESS_DEFAULT);
+#endif
   *sht3x = sht3x_create(*i2c_bus, SHT3x_ADDR_PIN_SELECT_VSS);
   sht3x_heater(*sht3x, SHT3x_HEATER_DISABLED);
   sht3x_set_measure_mode(*sht3x, SHT3x_PER_2_MEDIUM);
 }
 
-bool bh1750_get(bh1750_handle_t bh1750, float *output) {
-  bh1750_power_on(bh1750);
-  bh1750_set_measure_mode(bh1750, BH1750_ONETIME_4LX_RES);
-  vTaskDelay(30 / portTICK_RATE_MS);
-  auto ret = bh1750_get_data(bh1750, output);
-  bh1750_power_down(bh1750);
-  if (ret != ESP_OK) {
-    ESP_LOGE(TAG, "No ack, sensor not connected...\n");
-  }
-  return ret == ESP_OK;
-}
-
 extern "C" void app_main(void) {
   i2c_bus_handle_t i2c_bus = nullptr;
   bh1750_handle_t bh1750 = nullptr;
   sht3x_handle_t sht3x = nullptr;
-#if CONFIG_CLOCK_BRIGHTNESS_AUTO
   i2c_init(&i2c_bus, &bh1750, &sht3x);
-#endif
-
-  esp_err_t err = nvs_flash_init();
 
-  if (err == ESP_ERR_NVS_NO_FREE_PAGES ||
-      err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-    // NVS partition was truncated and needs to be erased
-    // Retry nvs_flash_init
-    ESP_ERROR_CHECK(nvs_flash_erase());
-    err = nvs_flash_init();
-  }
+  power_init();
   M5.begin();
-  M5.Lcd.setBrightness(CONFIG_CLOCK_BRIGHTNESS_DEFAULT_VALUE);
-  M5.Lcd.setTextSize(1.5);
-  Geolocation geo;
   UserContext userContext = {
       .str_ip = "",
-      .actionQueue = xQueueCreate(10, sizeof(struct Action *)),
-      .geo = &geo,
+      .actions = new ActionQueue(),
+      .geo = nullptr,
       .timers = {0, 0, 0},
-      .light_sensor = bh1750,
-      .pm25 = new PM25(UART_NUM_2),
-      .sht3x = sht3x,
-      .w = new Weather(),
+      .ambient = nullptr,
+      .history = new HistoryStore(),
+      .archive = new Archive(),
+      .hourly = new HourlyForecast(),
+      .scheduler = new RefreshScheduler(),
+      .w = nullptr,
+      .locations = nullptr,
+      .api = nullptr,
+      .screen = new Screen(&M5.Lcd),
+      .renderer = nullptr,
       ._page = 0,
       .screen_on = true,
   };
+#if CONFIG_CLOCK_BRIGHTNESS_AUTO
+  userContext.ambient = new AmbientLight(bh1750);
+#endif
+  userContext.renderer = new Renderer(userContext.screen, &M5.Lcd);
+  userContext.renderer->start();
   auto wakeup_cause = esp_sleep_get_wakeup_cause();
+  const RtcState *rtc_state = nullptr;
   if (wakeup_cause == ESP_SLEEP_WAKEUP_EXT1 ||
       wakeup_cause == ESP_SLEEP_WAKEUP_EXT0) {
-    settimezone(userContext.geo->posix_tz());
+    rtc_state = rtc_state_load();
+  }
+  if (rtc_state) {
+    // Fast resume: first frame from RTC memory, NVS and Wi-Fi come after
+    M5.Lcd.setBrightness(rtc_state->brightness);
+    settimezone(rtc_state->posix_tz);
+    userContext._page = rtc_state->page;
+    userContext.w = new Weather(&rtc_state->weather);
     update_screen(&userContext);
   } else {
-    M5.Lcd.print("Power On");
+    M5.Lcd.setBrightness(CONFIG_CLOCK_BRIGHTNESS_DEFAULT_VALUE);
+  }
+  bool background = wakeup_cause == ESP_SLEEP_WAKEUP_TIMER;
+  if (background) {
+    // Woken by the refresh scheduler, the screen stays off
+    userContext.screen_on = false;
+    userContext.renderer->off();
+    power_set_state(PowerIdle);
+  }
+#if CONFIG_CLOCK_BRIGHTNESS_AUTO
+  userContext.ambient->start(M5.Lcd.getBrightness());
+  userContext.ambient->set_active(userContext.screen_on);
+#endif
+  SensorSampler *sampler =
+      new SensorSampler(userContext.history, userContext.archive,
+                        new PM25(UART_NUM_2), sht3x);
+  sampler->start();
+
+  esp_err_t err = nvs_flash_init();
+
+  if (err == ESP_ERR_NVS_NO_FREE_PAGES ||
+      err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+    // NVS partition was truncated and needs to be erased
+    // Retry nvs_flash_init
+    ESP_ERROR_CHECK(nvs_flash_erase());
+    err = nvs_flash_init();
+  }
+  userContext.geo = new Geolocation();
+  if (userContext.w == nullptr) {
+    userContext.w = new Weather();
+  }
+  userContext.locations = new Locations();
+  userContext.api = new JsonApi(userContext.history, userContext.w);
+  if (rtc_state == nullptr) {
+    settimezone(userContext.geo->posix_tz());
+    if (wakeup_cause == ESP_SLEEP_WAKEUP_EXT1 ||
+        wakeup_cause == ESP_SLEEP_WAKEUP_EXT0) {
+      update_screen(&userContext);
+    } else if (!background) {
+      userContext.renderer->message("Power On");
+    }
   }
 
   ESP_LOGI(TAG, "POWERON");
@@ -572,25 +570,16 @@ extern "C" void app_main(void) {
   wifi_manager_set_callback(WM_MESSAGE_CODE_COUNT, NULL);
   http_app_set_handler_hook(HTTP_GET, &wifi_handler);
 
-  xTaskCreate(&action_task, "action_task", 8192, &userContext, 5, nullptr);
-
-  while (1) {
-    M5.update();
-    if (M5.BtnA.wasClicked()) {
-      Action *new_action = new Action(ButtonClicked, "A");
-      xQueueSend(userContext.actionQueue, (void *)&new_action, 100);
-    }
-    if (M5.BtnB.wasClicked()) {
-      Action *new_action = new Action(ButtonClicked, "B");
-      xQueueSend(userContext.actionQueue, (void *)&new_action, 100);
-    }
-    if (M5.BtnC.wasClicked()) {
-      Action *new_action = new Action(ButtonClicked, "C");
-      xQueueSend(userContext.actionQueue, (void *)&new_action, 100);
-    }
+  userContext.w->start(&weather_updated_cb, &userContext,
+                       userContext.hourly);
+  userContext.locations->start();
+  init_scheduler(&userContext);
+  // From here on action_task is the only one feeding the renderer
+  xTaskCreatePinnedToCore(&action_task, "action_task", 8192, &userContext, 5,
+                          nullptr, CORE_RENDER);
 
-    M5.delay(100);
-  }
+  Buttons buttons(userContext.actions);
+  buttons.run();
   bh1750_delete(&bh1750);
   i2c_bus_delete(&i2c_bus);
 }
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include "metrics.hpp"
+#include <algorithm>
+#include <atomic>
+#include <esp_heap_caps.h>
+#include <esp_system.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+#define ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+#define METRICS_LINE_MAX 160
+
+// Upper bounds in microseconds, the last bucket is +Inf
+static const int64_t bucket_bounds_us[] = {
+    250, 1000, 2500, 10000, 25000, 100000, 250000, 1000000, 2500000, 10000000,
+};
+static const char *const bucket_labels[] = {
+    "0.00025", "0.001", "0.0025", "0.01", "0.025", "0.1",
+    "0.25",    "1",     "2.5",    "10",   "+Inf",
+};
+#define METRICS_BUCKETS (ARRAY_SIZE(bucket_bounds_us) + 1)
+static_assert(ARRAY_SIZE(bucket_labels) == METRICS_BUCKETS,
+              "One label per bucket");
+
+typedef struct MetricInfo {
+  const char *name;
+  const char *help;
+} MetricInfo;
+
+static const MetricInfo histogram_info[MetricHistogramMax] = {
+    {"clock_update_screen_seconds", "Time to build and queue a frame"},
+    {"clock_weather_refresh_seconds", "Open-Meteo fetch and decode"},
+    {"clock_geolocation_refresh_seconds", "IP geolocation lookup"},
+    {"clock_ntp_sync_seconds", "SNTP request to clock update"},
+    {"clock_nvs_save_seconds", "NVS record write and commit"},
+    {"clock_nvs_restore_seconds", "NVS record read"},
+    {"clock_sensor_read_seconds", "Particle and humidity sensor reads"},
+    {"clock_action_wait_seconds", "Time actions wait in the queue"},
+    {"clock_input_to_render_seconds", "Button edge to its frame drawn"},
+    {"clock_locations_refresh_seconds", "Open-Meteo fetch of all places"},
+};
+
+static const MetricInfo counter_info[MetricCounterMax] = {
+    {"clock_weather_errors_total", "Failed weather refreshes"},
+    {"clock_geolocation_errors_total", "Failed geolocation refreshes"},
+    {"clock_ntp_errors_total", "SNTP syncs without a reply"},
+    {"clock_nvs_errors_total", "NVS records that failed to save"},
+    {"clock_sensor_errors_total", "Sensor reads that returned nothing"},
+    {"clock_locations_errors_total", "Failed refreshes of the places"},
+};
+
+// Tasks whose stack high water mark is reported
+static const char *const task_names[] = {
+    "main",        "action_task",  "render_task", "refresh_task",
+    "sampler_task", "ambient_task", "httpd",
+};
+
+// Bucket counts are not cumulative here, the sum is split in two words so
+// it stays lock-free on a 32 bit core: low wraps into high.
+typedef struct Histogram {
+  std::atomic<uint32_t> buckets[METRICS_BUCKETS];
+  std::atomic<uint32_t> sum_low_us;
+  std::atomic<uint32_t> sum_high_us;
+} Histogram;
+
+typedef struct CoreMetrics {
+  Histogram histograms[MetricHistogramMax];
+  Histogram pages[METRICS_MAX_PAGES];
+  std::atomic<uint32_t> counters[MetricCounterMax];
+} CoreMetrics;
+
+static CoreMetrics cores[portNUM_PROCESSORS];
+
+static void observe(Histogram *histogram, int64_t duration_us) {
+  if (duration_us < 0) {
+    duration_us = 0;
+  }
+  size_t bucket = 0;
+  while (bucket < ARRAY_SIZE(bucket_bounds_us) &&
+         duration_us > bucket_bounds_us[bucket]) {
+    bucket++;
+  }
+  histogram->buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  uint32_t value = (uint32_t)duration_us;
+  uint32_t low =
+      histogram->sum_low_us.fetch_add(value, std::memory_order_relaxed);
+  if (low + value < low) {
+    histogram->sum_high_us.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void metrics_observe(MetricHistogram metric, int64_t duration_us) {
+  observe(&cores[xPortGetCoreID()].histograms[metric], duration_us);
+}
+
+void metrics_observe_page(int page, int64_t duration_us) {
+  if (page < 0 || page >= METRICS_MAX_PAGES) {
+    return;
+  }
+  observe(&cores[xPortGetCoreID()].pages[page], duration_us);
+}
+
+void metrics_count(MetricCounter counter) {
+  cores[xPortGetCoreID()].counters[counter].fetch_add(
+      1, std::memory_order_relaxed);
+}
+
+typedef struct Writer {
+  MetricsWriteCb write;
+  void *arg;
+  bool ok;
+} Writer;
+
+static void put(Writer *writer, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void put(Writer *writer, const char *format, ...) {
+  if (!writer->ok) {
+    return;
+  }
+  char line[METRICS_LINE_MAX];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  if (length < 0) {
+    return;
+  }
+  writer->ok = writer->write(line, std::min<size_t>(length, sizeof(line) - 1),
+                             writer->arg);
+}
+
+static void header(Writer *writer, const MetricInfo *info, const char *type) {
+  put(writer, "# HELP %s %s\n# TYPE %s %s\n", info->name, info->help,
+      info->name, type);
+}
+
+// Adds up the copies of the cores. labels is empty or like page="1".
+static void write_histogram(Writer *writer, const char *name,
+                            const char *labels, Histogram *const *copies) {
+  const char *comma = *labels ? "," : "";
+  uint64_t cumulative = 0;
+  for (size_t b = 0; b < METRICS_BUCKETS; ++b) {
+    for (int core = 0; core < portNUM_PROCESSORS; ++core) {
+      cumulative += copies[core]->buckets[b].load(std::memory_order_relaxed);
+    }
+    put(writer, "%s_bucket{%s%sle=\"%s\"} %llu\n", name, labels, comma,
+        bucket_labels[b], (unsigned long long)cumulative);
+  }
+  uint64_t sum_us = 0;
+  for (int core = 0; core < portNUM_PROCESSORS; ++core) {
+    sum_us += ((uint64_t)copies[core]->sum_high_us.load() << 32) |
+              copies[core]->sum_low_us.load();
+  }
+  const char *open_brace = *labels ? "{" : "";
+  const char *close_brace = *labels ? "}" : "";
+  put(writer, "%s_sum%s%s%s %llu.%06llu\n", name, open_brace, labels,
+      close_brace, (unsigned long long)(sum_us / 1000000),
+      (unsigned long long)(sum_us % 1000000));
+  put(writer, "%s_count%s%s%s %llu\n", name, open_brace, labels,
+      close_brace, (unsigned long long)cumulative);
+}
+
+void metrics_write(MetricsWriteCb write, void *arg) {
+  Writer writer = {.write = write, .arg = arg, .ok = true};
+  Histogram *copies[portNUM_PROCESSORS];
+
+  for (int m = 0; m < MetricHistogramMax; ++m) {
+    header(&writer, &histogram_info[m], "histogram");
+    for (int core = 0; core < portNUM_PROCESSORS; ++core) {
+      copies[core] = &cores[core].histograms[m];
+    }
+    write_histogram(&writer, histogram_info[m].name, "", copies);
+  }
+
+  const MetricInfo page_info = {"clock_page_render_seconds",
+                                "Time to draw and push a page"};
+  header(&writer, &page_info, "histogram");
+  for (int page = 0; page < METRICS_MAX_PAGES; ++page) {
+    char labels[16];
+    snprintf(labels, sizeof(labels), "page=\"%d\"", page);
+    for (int core = 0; core < portNUM_PROCESSORS; ++core) {
+      copies[core] = &cores[core].pages[page];
+    }
+    write_histogram(&writer, page_info.name, labels, copies);
+  }
+
+  for (int c = 0; c < MetricCounterMax; ++c) {
+    uint64_t total = 0;
+    for (int core = 0; core < portNUM_PROCESSORS; ++core) {
+      total += cores[core].counters[c].load(std::memory_order_relaxed);
+    }
+    header(&writer, &counter_info[c], "counter");
+    put(&writer, "%s %llu\n", counter_info[c].name,
+        (unsigned long long)total);
+  }
+
+  const MetricInfo heap_free = {"clock_heap_free_bytes", "Free heap"};
+  const MetricInfo heap_minimum = {"clock_heap_minimum_free_bytes",
+                                   "Lowest free heap since boot"};
+  const MetricInfo heap_largest = {"clock_heap_largest_free_block_bytes",
+                                   "Largest allocatable block"};
+  header(&writer, &heap_free, "gauge");
+  put(&writer, "%s %lu\n", heap_free.name,
+      (unsigned long)esp_get_free_heap_size());
+  header(&writer, &heap_minimum, "gauge");
+  put(&writer, "%s %lu\n", heap_minimum.name,
+      (unsigned long)esp_get_minimum_free_heap_size());
+  header(&writer, &heap_largest, "gauge");
+  put(&writer, "%s %u\n", heap_largest.name,
+      (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+
+  const MetricInfo stack = {"clock_task_stack_free_bytes",
+                            "Stack high water mark of a task"};
+  header(&writer, &stack, "gauge");
+  for (const char *name : task_names) {
+    TaskHandle_t task = xTaskGetHandle(name);
+    if (task == nullptr) {
+      continue;
+    }
+    put(&writer, "%s{task=\"%s\"} %u\n", stack.name, name,
+        (unsigned)uxTaskGetStackHighWaterMark(task));
+  }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define METRICS_MAX_PAGES 8
+
+typedef enum MetricHistogram {
+  MetricUpdateScreen,
+  MetricWeatherRefresh,
+  MetricGeolocationRefresh,
+  MetricNtpSync,
+  MetricNvsSave,
+  MetricNvsRestore,
+  MetricSensorRead,
+  MetricActionWait,
+  MetricInputToRender,
+  MetricLocationsRefresh,
+  MetricHistogramMax,
+} MetricHistogram;
+
+typedef enum MetricCounter {
+  MetricWeatherErrors,
+  MetricGeolocationErrors,
+  MetricNtpErrors,
+  MetricNvsErrors,
+  MetricSensorErrors,
+  MetricLocationsErrors,
+  MetricCounterMax,
+} MetricCounter;
+
+// Writes a piece of the exposition, returns false to stop.
+typedef bool (*MetricsWriteCb)(const char *text, size_t length, void *arg);
+
+// Fixed-bucket latency histograms and counters for the main paths. Each core
+// updates its own copy with relaxed atomics, so recording never blocks and
+// never contends; a scrape adds the copies up. Durations are microseconds.
+void metrics_observe(MetricHistogram metric, int64_t duration_us);
+// Render time of a page, one series per page.
+void metrics_observe_page(int page, int64_t duration_us);
+void metrics_count(MetricCounter counter);
+
+// The metrics in Prometheus text format, with the heap and the stack high
+// water marks of the app tasks as gauges.
+void metrics_write(MetricsWriteCb write, void *arg);
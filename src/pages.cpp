@@ -0,0 +1,423 @@
+#include "pages.hpp"
+#include "text_builder.hpp"
+#include <algorithm>
+#include <esp_log.h>
+#include <math.h>
+#include <stdint.h>
+
+#define ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+#define HISTORY_GRAPH_COLUMNS 160
+#define HISTORY_GRAPH_HEIGHT 24
+#define DAY_GRAPH_HEIGHT 20
+// One place per periodic screen update
+#define PLACE_PERIOD_S 30
+
+static const char *TAG = "Pages";
+
+typedef void (*PageFunc)(const PageContext *ctx);
+
+static void format_time(time_t now, const char *format, char *buffer,
+                        size_t size, int add_day) {
+  struct tm timeinfo;
+  localtime_r(&now, &timeinfo);
+  timeinfo.tm_mday += add_day;
+  timeinfo.tm_wday += add_day;
+  strftime(buffer, size, format, &timeinfo);
+}
+
+// Sun times are stored as minutes after local midnight
+static void sun_line(Screen *screen, float size, const char *label,
+                     uint16_t minutes) {
+  TextBuilder text;
+  text.str(label);
+  if (minutes == FORECAST_NO_MINUTES) {
+    text.str("--:--");
+  } else {
+    text.integer(minutes / 60, 2, '0').str(":").integer(minutes % 60, 2, '0');
+  }
+  screen->text(size, text.c_str());
+}
+
+// The code name with its icon from the atlas
+static void weather_line(Screen *screen, float size, OM_SDK::WeatherCode code) {
+  screen->weather(size, code, OM_SDK::EnumNamesWeatherCode(code));
+}
+
+static void sun_lines(Screen *screen, float size, const Forecast7 *f_7,
+                      int day) {
+  sun_line(screen, size, "sunrise: ", f_7->sunrise[day]);
+  sun_line(screen, size, "sunset:  ", f_7->sunset[day]);
+}
+
+static void page_main(const PageContext *ctx) {
+  ESP_LOGI(TAG, "Show Main page");
+  Screen *screen = ctx->screen;
+  float value;
+  screen->begin_frame(ctx->page);
+  char time_buf[20] = {0};
+  format_time(ctx->now, "%a %D", time_buf, sizeof(time_buf), 0);
+  screen->text(3, time_buf);
+  format_time(ctx->now, "%H:%M", time_buf, sizeof(time_buf), 0);
+  ESP_LOGI(TAG, "%s", time_buf);
+  screen->clock(time_buf);
+  screen->skip(2);
+  HistoryStore *history = ctx->history;
+  if (history->latest(HistoryPm25, &value)) {
+    screen->text(2, TextBuilder().str("pm25: ").decimal(value, 0).c_str());
+  }
+  if (history->latest(HistoryTemperature, &value)) {
+    TextBuilder text;
+    text.str("temp: ").decimal(value, 0, 2, '0').str("C");
+    screen->text(2, text.c_str());
+  }
+  if (history->latest(HistoryHumidity, &value)) {
+    TextBuilder text;
+    text.str("hum:  ").decimal(value, 0, 2, '0').str("%");
+    screen->text(2, text.c_str());
+  }
+
+  if (ctx->online) {
+    time_t now = ctx->now;
+    struct tm tm;
+    localtime_r(&now, &tm);
+    const Forecast24 *f24 = &(ctx->weather->forecast24);
+    int h = tm.tm_hour;
+    screen->skip(2);
+    weather_line(screen, 2, f24->code(h));
+    screen->text(2, TextBuilder().str("UV:   ").decimal(f24->uv(h), 1).c_str());
+    screen->text(2, TextBuilder()
+                        .str("rain: ")
+                        .decimal(f24->precipitation(h), 0)
+                        .str("%")
+                        .c_str());
+    screen->text(2, TextBuilder()
+                        .str("temp: ")
+                        .decimal(f24->temperature(h), 0)
+                        .str("C")
+                        .c_str());
+  }
+  screen->end_frame();
+}
+
+static void page_today(const PageContext *ctx) {
+  ESP_LOGI(TAG, "Show Today page");
+  const WeatherSnapshot *snapshot = ctx->weather;
+  Screen *screen = ctx->screen;
+  const float size = 2.5;
+  screen->begin_frame(ctx->page);
+  char time_buf[16] = {0};
+  char format[] = "%D";
+  format_time(ctx->now, format, time_buf, sizeof(time_buf), 0);
+  screen->text(size, "Today:");
+  screen->text(size, time_buf);
+  const Forecast7 *f_7 = &(snapshot->forecast7);
+  weather_line(screen, size, f_7->code(0));
+  screen->skip(size);
+  if (ctx->online) {
+    time_t now = ctx->now;
+    struct tm tm;
+    localtime_r(&now, &tm);
+    const Forecast24 *f24 = &(snapshot->forecast24);
+    if (tm.tm_hour == 23) {
+      int h = tm.tm_hour;
+      screen->text(size, "      23h");
+      weather_line(screen, size, f24->code(h));
+      screen->text(size, TextBuilder()
+                             .str("rain: ")
+                             .decimal(f24->precipitation(h), 0, 2, '0')
+                             .str("%")
+                             .c_str());
+      screen->text(size, TextBuilder()
+                             .str("temp: ")
+                             .decimal(f24->temperature(h), 0, 2, '0')
+                             .str("C")
+                             .c_str());
+      screen->text(size, TextBuilder()
+                             .str("UV:   ")
+                             .decimal(f24->uv(h), 1, 2, '0')
+                             .c_str());
+    } else {
+      int t1 = 8;
+      int t2 = 16;
+      if (tm.tm_hour == 21 || tm.tm_hour == 22) {
+        t1 = 22;
+        t2 = 23;
+      } else if (tm.tm_hour == 20 || tm.tm_hour == 19) {
+        t1 = 21;
+        t2 = 23;
+      } else if (tm.tm_hour == 18 || tm.tm_hour == 17) {
+        t1 = 19;
+        t2 = 22;
+      } else if (tm.tm_hour == 16) {
+        t1 = 18;
+        t2 = 21;
+      } else if (tm.tm_hour == 15 || tm.tm_hour == 14) {
+        t1 = 17;
+        t2 = 20;
+      } else if (tm.tm_hour == 13 || tm.tm_hour == 12) {
+        t1 = 16;
+        t2 = 20;
+      } else if (tm.tm_hour == 11) {
+        t1 = 14;
+        t2 = 19;
+      } else if (tm.tm_hour == 10 || tm.tm_hour == 9) {
+        t1 = 13;
+        t2 = 18;
+      } else if (tm.tm_hour > 6) {
+        t1 = 12;
+        t2 = 19;
+      }
+
+      screen->text(size, TextBuilder()
+                             .str("     ")
+                             .integer(t1)
+                             .str("h     ")
+                             .integer(t2)
+                             .str("h")
+                             .c_str());
+      screen->text(size, TextBuilder()
+                             .str("UV:  ")
+                             .decimal(f24->uv(t1), 1, 2, '0')
+                             .str("    ")
+                             .decimal(f24->uv(t2), 1)
+                             .c_str());
+      screen->text(size, TextBuilder()
+                             .str("rain:")
+                             .decimal(f24->precipitation(t1), 0, 2, '0')
+                             .str("%    ")
+                             .decimal(f24->precipitation(t2), 0, 2, '0')
+                             .str("%")
+                             .c_str());
+      screen->text(size, TextBuilder()
+                             .str("temp:")
+                             .decimal(f24->temperature(t1), 0, 2, '0')
+                             .str("C    ")
+                             .decimal(f24->temperature(t2), 0, 2, '0')
+                             .str("C")
+                             .c_str());
+    }
+    screen->skip(size);
+    sun_lines(screen, size, f_7, 0);
+  }
+  screen->end_frame();
+}
+
+static void page_tomorrow(const PageContext *ctx) {
+  ESP_LOGI(TAG, "Show Tomorrow page");
+  const WeatherSnapshot *snapshot = ctx->weather;
+  const ForecastTmr *f_tmr = &(snapshot->forecast_tmr);
+  Screen *screen = ctx->screen;
+  const float size = 2.5;
+  screen->begin_frame(ctx->page);
+  char time_buf[16] = {0};
+  char format[] = "%a %D";
+  format_time(ctx->now, format, time_buf, sizeof(time_buf), 1);
+  screen->text(size, "Tomorrow");
+  screen->text(size, time_buf);
+  const Forecast7 *f_7 = &(snapshot->forecast7);
+  weather_line(screen, size, f_7->code(1));
+  screen->skip(size);
+  screen->text(size, "     9h     15h");
+  screen->text(size, TextBuilder()
+                         .str("UV:  ")
+                         .decimal(f_tmr->uv(0), 1, 2, '0')
+                         .str("    ")
+                         .decimal(f_tmr->uv(1), 1, 2, '0')
+                         .c_str());
+  screen->text(size, TextBuilder()
+                         .str("rain:")
+                         .decimal(f_tmr->precipitation(0), 0, 2, '0')
+                         .str("%    ")
+                         .decimal(f_tmr->precipitation(1), 0, 2, '0')
+                         .str("%")
+                         .c_str());
+  screen->text(size, TextBuilder()
+                         .str("temp:")
+                         .decimal(f_tmr->temperature(0), 0, 2, '0')
+                         .str("C    ")
+                         .decimal(f_tmr->temperature(1), 0, 2, '0')
+                         .str("C")
+                         .c_str());
+  screen->skip(size);
+  sun_lines(screen, size, f_7, 1);
+  screen->end_frame();
+}
+
+// Hour by hour temperature of a day from the mapped hourly forecast, in the
+// history graph format. Returns false if the forecast does not cover it.
+static bool day_temperatures(const PageContext *ctx, int day,
+                             HistoryPoint (&points)[24]) {
+  const HourlyForecastSlot *hourly =
+      ctx->hourly ? ctx->hourly->forecast() : nullptr;
+  if (hourly == nullptr) {
+    return false;
+  }
+  struct tm tm;
+  localtime_r(&ctx->now, &tm);
+  tm.tm_mday += day;
+  tm.tm_hour = 0;
+  tm.tm_min = 0;
+  tm.tm_sec = 0;
+  tm.tm_isdst = -1;
+  int first = hourly->hour_index(mktime(&tm));
+  if (first < 0 || first + 24 > HOURLY_FORECAST_HOURS) {
+    return false;
+  }
+  const int16_t *temperature = &hourly->hours.temperature_2m[first];
+  bool found = false;
+  for (int h = 0; h < 24; ++h) {
+    // Both use INT16_MIN for a missing value
+    int16_t value = temperature[h];
+    points[h] = {.min = value, .avg = value, .max = value};
+    found |= value != FORECAST_NO_TEMPERATURE;
+  }
+  return found;
+}
+
+static void page_week(const PageContext *ctx, int day) {
+  ESP_LOGI(TAG, "Show Day %d page", day);
+  const Forecast7 *f_7 = &(ctx->weather->forecast7);
+  Screen *screen = ctx->screen;
+  const float size = 2.6;
+  screen->begin_frame(ctx->page);
+  char time_buf[16] = {0};
+  char format[] = "%a %D";
+  format_time(ctx->now, format, time_buf, sizeof(time_buf), day);
+  screen->text(size, time_buf);
+  weather_line(screen, size, f_7->code(day));
+  screen->skip(size);
+  screen->text(size, TextBuilder()
+                         .str("UV:      ")
+                         .decimal(f_7->uv_max(day), 1, 2, '0')
+                         .c_str());
+  screen->text(size, TextBuilder()
+                         .str("rain:    ")
+                         .decimal(f_7->precipitation_max(day), 0, 2, '0')
+                         .str("%")
+                         .c_str());
+  screen->text(size, TextBuilder()
+                         .str("max:     ")
+                         .decimal(f_7->temperature_max(day), 0, 2, '0')
+                         .str("C")
+                         .c_str());
+  screen->text(size, TextBuilder()
+                         .str("min:     ")
+                         .decimal(f_7->temperature_min(day), 0, 2, '0')
+                         .str("C")
+                         .c_str());
+  HistoryPoint points[24];
+  if (day_temperatures(ctx, day, points)) {
+    screen->sparkline(DAY_GRAPH_HEIGHT, points, ARRAY_SIZE(points));
+  } else {
+    screen->skip(size);
+  }
+  sun_lines(screen, size, f_7, day);
+  screen->end_frame();
+}
+
+static void page_d2(const PageContext *ctx) { page_week(ctx, 2); }
+static void page_d3(const PageContext *ctx) { page_week(ctx, 3); }
+static void page_d4(const PageContext *ctx) { page_week(ctx, 4); }
+
+static void page_history(const PageContext *ctx) {
+  ESP_LOGI(TAG, "Show History page");
+  static const char *const names[HistoryMetricMax] = {"pm25", "temp", "hum"};
+  static const char *const units[HistoryMetricMax] = {"", "C", "%"};
+  Screen *screen = ctx->screen;
+  HistoryPoint points[HISTORY_GRAPH_COLUMNS];
+  time_t now = ctx->now;
+  screen->begin_frame(ctx->page);
+  screen->text(2, "Last 24h");
+  for (int m = 0; m < HistoryMetricMax; ++m) {
+    HistoryMetric metric = (HistoryMetric)m;
+    screen->skip(1);
+    if (ctx->history->query(HistoryMinute, metric, now - 24 * 3600, now,
+                            points, ARRAY_SIZE(points)) == 0) {
+      screen->text(2, TextBuilder().str(names[m]).str(": -").c_str());
+      screen->skip(3);
+      continue;
+    }
+    int16_t low = INT16_MAX, high = INT16_MIN;
+    for (const HistoryPoint &point : points) {
+      if (point.avg != HISTORY_NO_VALUE) {
+        low = std::min(low, point.min);
+        high = std::max(high, point.max);
+      }
+    }
+    float value = NAN;
+    ctx->history->latest(metric, &value);
+    TextBuilder text;
+    text.str(names[m]).str(": ").decimal(value, 0);
+    if (!isnan(value)) {
+      text.str(units[m]);
+    }
+    text.str("  ")
+        .decimal(history_decode(metric, low), 0)
+        .str("-")
+        .decimal(history_decode(metric, high), 0);
+    screen->text(2, text.c_str());
+    screen->sparkline(HISTORY_GRAPH_HEIGHT, points, ARRAY_SIZE(points));
+  }
+  screen->end_frame();
+}
+
+static void page_places(const PageContext *ctx) {
+  ESP_LOGI(TAG, "Show Places page");
+  Screen *screen = ctx->screen;
+  const Locations *locations = ctx->locations;
+  const float size = 2.6;
+  screen->begin_frame(ctx->page);
+  if (locations == nullptr || locations->count() == 0) {
+    screen->text(size, "No places set");
+    screen->end_frame();
+    return;
+  }
+  size_t count = locations->count();
+  size_t index = (size_t)(ctx->now / PLACE_PERIOD_S) % count;
+  const LocationForecast *forecast =
+      &locations->snapshot()->forecasts[index];
+  screen->text(size, locations->location(index).name);
+  screen->text(size, TextBuilder()
+                         .str("place ")
+                         .integer(index + 1)
+                         .str("/")
+                         .integer(count)
+                         .c_str());
+  screen->skip(size);
+  if (locations->snapshot()->fetched_at == 0) {
+    screen->text(size, "No forecast yet");
+    screen->end_frame();
+    return;
+  }
+  weather_line(screen, size, forecast->code());
+  screen->text(size, TextBuilder()
+                         .str("temp:    ")
+                         .decimal(forecast->temperature(), 0, 2, '0')
+                         .str("C")
+                         .c_str());
+  screen->text(size, TextBuilder()
+                         .str("rain:    ")
+                         .decimal(forecast->precipitation_max(), 0, 2, '0')
+                         .str("%")
+                         .c_str());
+  screen->text(size, TextBuilder()
+                         .str("max:     ")
+                         .decimal(forecast->temperature_max(), 0, 2, '0')
+                         .str("C")
+                         .c_str());
+  screen->text(size, TextBuilder()
+                         .str("min:     ")
+                         .decimal(forecast->temperature_min(), 0, 2, '0')
+                         .str("C")
+                         .c_str());
+  screen->end_frame();
+}
+
+static const PageFunc pages[] = {
+    page_main, page_today,   page_tomorrow, page_d2,
+    page_d3,   page_d4,      page_history,  page_places,
+};
+
+int page_count(void) { return ARRAY_SIZE(pages); }
+
+void page_render(const PageContext *ctx) { pages[ctx->page](ctx); }
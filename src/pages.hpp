@@ -0,0 +1,25 @@
+#pragma once
+
+#include "forecast.hpp"
+#include "history.hpp"
+#include "hourly_forecast.hpp"
+#include "locations.hpp"
+#include "screen.hpp"
+#include <time.h>
+
+// Everything a page draws from. Pages read nothing else, no clock, no
+// globals, so the same inputs always give the same frame.
+typedef struct PageContext {
+  Screen *screen;
+  const WeatherSnapshot *weather;
+  HistoryStore *history;
+  const HourlyForecast *hourly;
+  const Locations *locations;
+  time_t now;
+  // Weather lines are left out until the station is online
+  bool online;
+  int page;
+} PageContext;
+
+int page_count(void);
+void page_render(const PageContext *ctx);
@@ -0,0 +1,254 @@
+#include "persistence.hpp"
+#include "metrics.hpp"
+#include <atomic>
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <nvs.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NVS_RECORD "record"
+#define NVS_STAMP "stamp"
+#define BATCH_MAX 4
+#define BATCH_RECORDS_MAX 8
+
+static const char *TAG = "Persistence";
+
+typedef struct RecordHeader {
+  uint16_t version;
+  uint16_t size;
+  uint32_t crc;
+} RecordHeader;
+
+typedef struct BatchEntry {
+  const char *name_space;
+  nvs_handle_t handle;
+} BatchEntry;
+
+static PersistenceStats stats = {};
+static std::atomic<TaskHandle_t> batch_task{nullptr};
+static int batch_depth = 0;
+static BatchEntry batch[BATCH_MAX];
+static size_t batch_count = 0;
+// Saved in the batch, stored once their namespace commits
+static PersistentRecord *batch_records[BATCH_RECORDS_MAX];
+static size_t batch_record_count = 0;
+
+const PersistenceStats &persistence_stats() { return stats; }
+
+static bool in_batch() {
+  return batch_task.load() == xTaskGetCurrentTaskHandle();
+}
+
+PersistenceBatch::PersistenceBatch() {
+  TaskHandle_t none = nullptr;
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  _owner = batch_task.compare_exchange_strong(none, self) || none == self;
+  if (_owner) {
+    batch_depth++;
+  }
+}
+
+PersistenceBatch::~PersistenceBatch() {
+  if (!_owner || --batch_depth > 0) {
+    return;
+  }
+  for (size_t i = 0; i < batch_count; ++i) {
+    esp_err_t err = nvs_commit(batch[i].handle);
+    if (err != ESP_OK) {
+      ESP_LOGE(TAG, "%s: %s", batch[i].name_space, esp_err_to_name(err));
+      stats.errors++;
+      metrics_count(MetricNvsErrors);
+      for (size_t r = 0; r < batch_record_count; ++r) {
+        if (strcmp(batch_records[r]->_namespace, batch[i].name_space) == 0) {
+          batch_records[r]->_stored = false;
+        }
+      }
+    }
+    stats.commits++;
+    nvs_close(batch[i].handle);
+  }
+  batch_count = 0;
+  batch_record_count = 0;
+  batch_task.store(nullptr);
+}
+
+// A handle for writing, the one of the batch when the task holds one.
+// Returns whether the caller still has to commit and close it.
+static bool open_for_write(const char *name_space, nvs_handle_t *handle,
+                           esp_err_t *err) {
+  bool batched = in_batch();
+  if (batched) {
+    for (size_t i = 0; i < batch_count; ++i) {
+      if (strcmp(batch[i].name_space, name_space) == 0) {
+        *handle = batch[i].handle;
+        *err = ESP_OK;
+        return false;
+      }
+    }
+  }
+  *err = nvs_open(name_space, NVS_READWRITE, handle);
+  if (*err != ESP_OK || !batched || batch_count == BATCH_MAX) {
+    return true;
+  }
+  batch[batch_count++] = {name_space, *handle};
+  return false;
+}
+
+// Whether the batch answers for the record, false when it holds too many
+static bool batch_track(PersistentRecord *record) {
+  for (size_t i = 0; i < batch_record_count; ++i) {
+    if (batch_records[i] == record) {
+      return true;
+    }
+  }
+  if (batch_record_count == BATCH_RECORDS_MAX) {
+    return false;
+  }
+  batch_records[batch_record_count++] = record;
+  return true;
+}
+
+bool PersistentRecord::load(void *data, size_t size) {
+  int64_t start = esp_timer_get_time();
+  nvs_handle_t handle;
+  auto err = nvs_open(_namespace, NVS_READONLY, &handle);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "%s: %s", _namespace, esp_err_to_name(err));
+    return false;
+  }
+  size_t payload_size = size - _stamp_size;
+  size_t blob_size = sizeof(RecordHeader) + payload_size;
+  uint8_t *blob = static_cast<uint8_t *>(malloc(blob_size));
+  err = blob ? nvs_get_blob(handle, NVS_RECORD, blob, &blob_size)
+             : ESP_ERR_NO_MEM;
+  stats.reads++;
+
+  bool valid = false;
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "%s: %s", _namespace, esp_err_to_name(err));
+    // No record in an existing namespace or a longer one: an older layout
+    _stale = err == ESP_ERR_NVS_NOT_FOUND || err == ESP_ERR_NVS_INVALID_LENGTH;
+  } else {
+    RecordHeader header;
+    memcpy(&header, blob, sizeof(header));
+    const uint8_t *payload = blob + sizeof(header);
+    if (header.version != _version || header.size != size ||
+        blob_size != sizeof(header) + payload_size) {
+      ESP_LOGW(TAG, "%s: schema %u/%u size %u/%u, ignoring", _namespace,
+               header.version, _version, header.size, (unsigned)size);
+      _stale = true;
+    } else if (esp_rom_crc32_le(0, payload, payload_size) != header.crc) {
+      ESP_LOGE(TAG, "%s: bad crc", _namespace);
+    } else {
+      uint8_t *stamp = static_cast<uint8_t *>(data) + payload_size;
+      size_t stamp_size = _stamp_size;
+      memcpy(data, payload, payload_size);
+      if (_stamp_size && (nvs_get_blob(handle, NVS_STAMP, stamp,
+                                       &stamp_size) != ESP_OK ||
+                          stamp_size != _stamp_size)) {
+        memset(stamp, 0, _stamp_size);
+      }
+      memcpy(&_stamp, stamp, _stamp_size);
+      _crc = header.crc;
+      _stored = true;
+      valid = true;
+    }
+  }
+  nvs_close(handle);
+  free(blob);
+  stats.read_us = esp_timer_get_time() - start;
+  metrics_observe(MetricNvsRestore, stats.read_us);
+  ESP_LOGI(TAG, "%s: loaded in %lld us", _namespace, stats.read_us);
+  return valid;
+}
+
+esp_err_t PersistentRecord::save(const void *data, size_t size) {
+  size_t payload_size = size - _stamp_size;
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  RecordHeader header = {
+      .version = _version,
+      .size = (uint16_t)size,
+      .crc = esp_rom_crc32_le(0, bytes, payload_size),
+  };
+  bool record = !_stored || header.crc != _crc;
+  bool stamp = _stamp_size &&
+               (record || memcmp(&_stamp, bytes + payload_size,
+                                 _stamp_size) != 0);
+  if (!record) {
+    stats.skipped_writes++;
+    ESP_LOGI(TAG, "%s: unchanged, skipping write", _namespace);
+    if (!stamp) {
+      return ESP_OK;
+    }
+  }
+
+  int64_t start = esp_timer_get_time();
+  nvs_handle_t handle;
+  esp_err_t err;
+  bool commit = open_for_write(_namespace, &handle, &err);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Error (%s) opening NVS handle!", esp_err_to_name(err));
+    stats.errors++;
+    return err;
+  }
+  size_t written = 0;
+  if (_stale) {
+    // Drop whatever an older firmware left in the namespace
+    nvs_erase_all(handle);
+    _stale = false;
+  }
+  if (record) {
+    size_t blob_size = sizeof(header) + payload_size;
+    uint8_t *blob = static_cast<uint8_t *>(malloc(blob_size));
+    if (blob == nullptr) {
+      err = ESP_ERR_NO_MEM;
+    } else {
+      memcpy(blob, &header, sizeof(header));
+      memcpy(blob + sizeof(header), bytes, payload_size);
+      err = nvs_set_blob(handle, NVS_RECORD, blob, blob_size);
+      written += blob_size;
+      free(blob);
+    }
+  }
+  if (err == ESP_OK && stamp) {
+    err = nvs_set_blob(handle, NVS_STAMP, bytes + payload_size, _stamp_size);
+    written += _stamp_size;
+  }
+  if (commit) {
+    if (err == ESP_OK) {
+      err = nvs_commit(handle);
+      stats.commits++;
+    }
+    nvs_close(handle);
+  } else if (err == ESP_OK && !batch_track(this)) {
+    // Committed now then, the batch could not undo it
+    err = nvs_commit(handle);
+    stats.commits++;
+  }
+  metrics_observe(MetricNvsSave, esp_timer_get_time() - start);
+
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "%s: %s", _namespace, esp_err_to_name(err));
+    stats.errors++;
+    metrics_count(MetricNvsErrors);
+    // Written again next time
+    _stored = false;
+    return err;
+  }
+  _crc = header.crc;
+  memcpy(&_stamp, bytes + payload_size, _stamp_size);
+  _stored = true;
+  if (record) {
+    stats.writes++;
+  } else {
+    stats.stamp_writes++;
+  }
+  stats.bytes_written += written;
+  ESP_LOGI(TAG, "%s: wrote %u bytes, %u writes %u bytes in total", _namespace,
+           (unsigned)written, stats.writes, (unsigned)stats.bytes_written);
+  return ESP_OK;
+}
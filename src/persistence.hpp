@@ -0,0 +1,62 @@
+#pragma once
+
+#include <esp_err.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct PersistenceStats {
+  unsigned reads;
+  unsigned writes;
+  unsigned skipped_writes;
+  unsigned stamp_writes;
+  unsigned commits;
+  unsigned errors;
+  size_t bytes_written;
+  int64_t read_us;
+} PersistenceStats;
+
+// One NVS blob holding a whole component state behind a header with a schema
+// version and a CRC, so a layout change or a torn write loads nothing instead
+// of garbage. Bump the version whenever the persisted struct changes; the
+// struct must not have implicit padding since the CRC covers every byte.
+// The last stamp_size bytes, at most 8 like the time of a fetch, live in
+// their own entry outside the CRC: a refresh that brings nothing new only
+// rewrites them.
+class PersistentRecord {
+public:
+  PersistentRecord(const char *name_space, uint16_t version,
+                   size_t stamp_size = 0)
+      : _namespace(name_space), _version(version), _stamp_size(stamp_size) {}
+  bool load(void *data, size_t size);
+  // Writes and commits what changed, the record, the stamp or nothing.
+  esp_err_t save(const void *data, size_t size);
+
+private:
+  // Forgets what a failed batch commit did not store
+  friend class PersistenceBatch;
+  const char *_namespace;
+  const uint16_t _version;
+  const size_t _stamp_size;
+  uint32_t _crc = 0;
+  uint64_t _stamp = 0;
+  bool _stored = false;
+  // load() found another layout or an older firmware's keys
+  bool _stale = false;
+};
+
+// While the task that created it holds one, the records it saves are
+// committed once per namespace when the outermost batch ends, instead of
+// once per save. A namespace that fails to commit has its records written
+// again on their next save.
+class PersistenceBatch {
+public:
+  PersistenceBatch();
+  ~PersistenceBatch();
+  PersistenceBatch(const PersistenceBatch &) = delete;
+  PersistenceBatch &operator=(const PersistenceBatch &) = delete;
+
+private:
+  bool _owner;
+};
+
+const PersistenceStats &persistence_stats();
@@ -0,0 +1,119 @@
+#include "power.hpp"
+#include <esp_attr.h>
+#include <esp_log.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+static const char *TAG = "Power";
+
+static const char *state_names[PowerStateMax] = {"active", "idle",
+                                                 "deep_sleep"};
+
+// Survive deep sleep so the counters cover the whole time on battery
+static RTC_DATA_ATTR uint64_t time_in_state_us[PowerStateMax];
+static RTC_DATA_ATTR int64_t deep_sleep_start_us;
+
+static PowerState state = PowerActive;
+static int64_t state_since_us = 0;
+
+static int64_t wall_time_us() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+void power_init(void) {
+  if (deep_sleep_start_us &&
+      esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_UNDEFINED) {
+    int64_t slept_us = wall_time_us() - deep_sleep_start_us;
+    if (slept_us > 0) {
+      time_in_state_us[PowerDeepSleep] += slept_us;
+    }
+  }
+  deep_sleep_start_us = 0;
+  state = PowerActive;
+  state_since_us = esp_timer_get_time();
+
+#if CONFIG_CLOCK_POWER_LIGHT_SLEEP
+  esp_pm_config_t pm_config = {
+      .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+      .min_freq_mhz = 40,
+      .light_sleep_enable = true,
+  };
+  esp_err_t err = esp_pm_configure(&pm_config);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Light sleep not available: %s", esp_err_to_name(err));
+  }
+  esp_sleep_enable_gpio_wakeup();
+#endif
+}
+
+void power_set_state(PowerState new_state) {
+  int64_t now_us = esp_timer_get_time();
+  time_in_state_us[state] += now_us - state_since_us;
+  state_since_us = now_us;
+  if (new_state == PowerDeepSleep) {
+    deep_sleep_start_us = wall_time_us();
+  }
+  if (new_state != state) {
+    ESP_LOGI(TAG, "%s -> %s", state_names[state], state_names[new_state]);
+  }
+  state = new_state;
+}
+
+PowerState power_state(void) { return state; }
+
+void power_wake_at(time_t deadline) {
+  if (deadline <= 0) {
+    return;
+  }
+  int64_t delay_s = deadline - time(nullptr);
+  if (delay_s < POWER_MIN_SLEEP_S) {
+    delay_s = POWER_MIN_SLEEP_S;
+  }
+  esp_sleep_enable_timer_wakeup(delay_s * 1000000ULL);
+  ESP_LOGI(TAG, "Timer wake in %lld s", delay_s);
+}
+
+void power_wifi_connected(void) {
+#if CONFIG_CLOCK_POWER_LIGHT_SLEEP
+  wifi_config_t config;
+  if (esp_wifi_get_config(WIFI_IF_STA, &config) == ESP_OK &&
+      config.sta.listen_interval != CONFIG_CLOCK_WIFI_LISTEN_INTERVAL) {
+    // Used by the access point from the next association on
+    config.sta.listen_interval = CONFIG_CLOCK_WIFI_LISTEN_INTERVAL;
+    esp_wifi_set_config(WIFI_IF_STA, &config);
+  }
+  esp_wifi_set_ps(WIFI_PS_MAX_MODEM);
+#endif
+}
+
+bool power_deep_sleep_enabled(void) {
+#if CONFIG_CLOCK_POWER_DEEP_SLEEP
+  return true;
+#else
+  return false;
+#endif
+}
+
+uint64_t power_time_in_state_us(PowerState of_state) {
+  uint64_t time_us = time_in_state_us[of_state];
+  if (of_state == state) {
+    time_us += esp_timer_get_time() - state_since_us;
+  }
+  return time_us;
+}
+
+void power_log_stats(void) {
+  for (int i = 0; i < PowerStateMax; ++i) {
+    ESP_LOGI(TAG, "%s: %llu s", state_names[i],
+             power_time_in_state_us((PowerState)i) / 1000000);
+  }
+#if CONFIG_PM_PROFILING
+  esp_pm_dump_locks(stdout);
+#endif
+}
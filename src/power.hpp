@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#define POWER_MIN_SLEEP_S 60
+
+typedef enum PowerState {
+  PowerActive,
+  PowerIdle,
+  PowerDeepSleep,
+  PowerStateMax,
+} PowerState;
+
+// Applies the CONFIG_CLOCK_POWER_* policy and accounts the time spent in each
+// state, deep sleep included, across wakes.
+void power_init(void);
+void power_set_state(PowerState state);
+PowerState power_state(void);
+// Arms the timer wake of the next deep sleep, so refreshes due by deadline
+// happen in one wake. Never sooner than POWER_MIN_SLEEP_S.
+void power_wake_at(time_t deadline);
+// Modem sleep and listen interval, once the station is associated.
+void power_wifi_connected(void);
+bool power_deep_sleep_enabled(void);
+uint64_t power_time_in_state_us(PowerState state);
+void power_log_stats(void);
@@ -0,0 +1,220 @@
+#include "refresh_scheduler.hpp"
+#include "cores.hpp"
+#include "persistence.hpp"
+#include "power.hpp"
+#include <algorithm>
+#include <esp_attr.h>
+#include <esp_log.h>
+#include <esp_random.h>
+#include <esp_timer.h>
+
+#define MAX_WAIT_S 600
+#define MAX_BACKOFF_SHIFT 16
+
+static const char *TAG = "Refresh";
+
+typedef struct RefreshState {
+  time_t fresh_until;
+  time_t retry_at;
+  uint16_t failures;
+} RefreshState;
+
+// Survives deep sleep, zeroed on power on so every source refreshes
+static RTC_DATA_ATTR RefreshState states[RefreshSourceMax];
+
+void RefreshScheduler::add(RefreshSource source, const RefreshPolicy &policy,
+                           RefreshFn fn, void *arg) {
+  Source *entry = &_sources[source];
+  entry->policy = policy;
+  entry->fn = fn;
+  entry->arg = arg;
+}
+
+void RefreshScheduler::set_ttl(RefreshSource source, uint32_t ttl_s) {
+  portENTER_CRITICAL(&_lock);
+  _sources[source].policy.ttl_s = ttl_s;
+  portEXIT_CRITICAL(&_lock);
+}
+
+void RefreshScheduler::start(RefreshIdleCb idle_cb, void *arg) {
+  _idle_cb = idle_cb;
+  _idle_arg = arg;
+  xTaskCreatePinnedToCore(&task, "refresh_task", 8192, this, 4, &_task,
+                          CORE_NETWORK);
+}
+
+void RefreshScheduler::set_connected(bool connected) {
+  _connected.store(connected);
+  wake();
+}
+
+void RefreshScheduler::request(RefreshSource source) {
+  _sources[source].forced.store(true);
+  wake();
+}
+
+void RefreshScheduler::wake() {
+  if (_task) {
+    xTaskNotifyGive(_task);
+  }
+}
+
+time_t RefreshScheduler::soft_deadline(RefreshSource source) const {
+  const RefreshState *state = &states[source];
+  return std::max(state->fresh_until, state->retry_at);
+}
+
+time_t RefreshScheduler::hard_deadline(RefreshSource source) const {
+  const RefreshState *state = &states[source];
+  return std::max(state->fresh_until + _sources[source].policy.stale_s,
+                  state->retry_at);
+}
+
+time_t RefreshScheduler::next_deadline() const {
+  time_t deadline = 0;
+  portENTER_CRITICAL(&_lock);
+  for (int s = 0; s < RefreshSourceMax; ++s) {
+    if (_sources[s].fn) {
+      time_t source_deadline = hard_deadline((RefreshSource)s);
+      if (deadline == 0 || source_deadline < deadline) {
+        deadline = source_deadline;
+      }
+    }
+  }
+  portEXIT_CRITICAL(&_lock);
+  return deadline;
+}
+
+RefreshStats RefreshScheduler::stats(RefreshSource source) const {
+  portENTER_CRITICAL(&_lock);
+  RefreshStats stats = _sources[source].stats;
+  portEXIT_CRITICAL(&_lock);
+  return stats;
+}
+
+void RefreshScheduler::log_stats() const {
+  time_t now = time(nullptr);
+  for (int s = 0; s < RefreshSourceMax; ++s) {
+    const Source *source = &_sources[s];
+    if (source->fn == nullptr) {
+      continue;
+    }
+    RefreshStats stats = this->stats((RefreshSource)s);
+    portENTER_CRITICAL(&_lock);
+    time_t fresh_for = states[s].fresh_until - now;
+    uint16_t failures = states[s].failures;
+    portEXIT_CRITICAL(&_lock);
+    ESP_LOGI(TAG,
+             "%s: %lu ok, %lu failed (%u in a row), avg %lld ms, max %lld ms, "
+             "fresh for %lld s",
+             source->policy.name, (unsigned long)stats.successes,
+             (unsigned long)stats.failures, failures,
+             stats.attempts ? stats.total_us / stats.attempts / 1000 : 0,
+             stats.max_us / 1000, fresh_for > 0 ? (long long)fresh_for : 0);
+  }
+}
+
+void RefreshScheduler::task(void *arg) {
+  static_cast<RefreshScheduler *>(arg)->run();
+}
+
+void RefreshScheduler::run() {
+  for (;;) {
+    TickType_t wait = portMAX_DELAY;
+    if (_connected.load()) {
+      if (run_due(time(nullptr)) && _idle_cb) {
+        _idle_cb(_idle_arg);
+      }
+      time_t now = time(nullptr);
+      bool active = power_state() == PowerActive;
+      time_t next = 0;
+      portENTER_CRITICAL(&_lock);
+      for (int s = 0; s < RefreshSourceMax; ++s) {
+        if (_sources[s].fn) {
+          time_t deadline = active ? soft_deadline((RefreshSource)s)
+                                   : hard_deadline((RefreshSource)s);
+          if (next == 0 || deadline < next) {
+            next = deadline;
+          }
+        }
+      }
+      portEXIT_CRITICAL(&_lock);
+      // Bounded so a clock step is noticed
+      time_t wait_s = std::min<time_t>(std::max<time_t>(next - now, 1),
+                                       MAX_WAIT_S);
+      wait = pdMS_TO_TICKS(wait_s * 1000);
+    }
+    ulTaskNotifyTake(pdTRUE, wait);
+  }
+}
+
+// Refreshes every stale or forced source by priority. Returns whether any
+// was due.
+bool RefreshScheduler::run_due(time_t now) {
+  RefreshSource due[RefreshSourceMax];
+  int count = 0;
+  portENTER_CRITICAL(&_lock);
+  for (int s = 0; s < RefreshSourceMax; ++s) {
+    const Source *source = &_sources[s];
+    if (source->fn &&
+        (source->forced.load() || now >= soft_deadline((RefreshSource)s))) {
+      due[count++] = (RefreshSource)s;
+    }
+  }
+  portEXIT_CRITICAL(&_lock);
+  std::sort(due, due + count, [this](RefreshSource a, RefreshSource b) {
+    return _sources[a].policy.priority < _sources[b].policy.priority;
+  });
+  // One NVS commit per namespace for the whole batch
+  PersistenceBatch batch;
+  for (int i = 0; i < count && _connected.load(); ++i) {
+    refresh(due[i]);
+  }
+  return count > 0;
+}
+
+void RefreshScheduler::refresh(RefreshSource source) {
+  Source *entry = &_sources[source];
+  const RefreshPolicy *policy = &entry->policy;
+  entry->forced.store(false);
+  int64_t start_us = esp_timer_get_time();
+  bool ok = entry->fn(entry->arg);
+  int64_t elapsed_us = esp_timer_get_time() - start_us;
+  uint32_t random = esp_random();
+  // Read after the refresh, NTP may just have stepped the clock
+  time_t now = time(nullptr);
+
+  portENTER_CRITICAL(&_lock);
+  RefreshState *state = &states[source];
+  RefreshStats *stats = &entry->stats;
+  stats->attempts++;
+  stats->last_us = elapsed_us;
+  stats->total_us += elapsed_us;
+  stats->max_us = std::max(stats->max_us, elapsed_us);
+  uint32_t delay_s = 0;
+  if (ok) {
+    stats->successes++;
+    state->failures = 0;
+    state->fresh_until = now + policy->ttl_s;
+    state->retry_at = 0;
+  } else {
+    stats->failures++;
+    if (state->failures < UINT16_MAX) {
+      state->failures++;
+    }
+    int shift = std::min<int>(state->failures - 1, MAX_BACKOFF_SHIFT);
+    uint64_t backoff_s = std::min<uint64_t>(
+        (uint64_t)policy->backoff_min_s << shift, policy->backoff_max_s);
+    // Equal jitter: sources failing together do not retry together
+    delay_s = backoff_s / 2 + random % (backoff_s / 2 + 1);
+    state->retry_at = now + delay_s;
+  }
+  portEXIT_CRITICAL(&_lock);
+
+  if (ok) {
+    ESP_LOGI(TAG, "%s refreshed in %lld ms", policy->name, elapsed_us / 1000);
+  } else {
+    ESP_LOGW(TAG, "%s failed in %lld ms, retry in %lu s", policy->name,
+             elapsed_us / 1000, (unsigned long)delay_s);
+  }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stdint.h>
+#include <time.h>
+
+typedef enum RefreshSource {
+  RefreshNtp,
+  RefreshGeolocation,
+  RefreshWeather,
+  RefreshLocations,
+  RefreshSourceMax,
+} RefreshSource;
+
+typedef struct RefreshPolicy {
+  const char *name;
+  // Data is fresh for ttl_s, then served stale for up to stale_s while it is
+  // revalidated.
+  uint32_t ttl_s;
+  uint32_t stale_s;
+  uint32_t backoff_min_s;
+  uint32_t backoff_max_s;
+  // Lower runs first within a batch.
+  uint8_t priority;
+} RefreshPolicy;
+
+typedef struct RefreshStats {
+  uint32_t attempts;
+  uint32_t successes;
+  uint32_t failures;
+  int64_t total_us;
+  int64_t max_us;
+  int64_t last_us;
+} RefreshStats;
+
+typedef bool (*RefreshFn)(void *arg);
+typedef void (*RefreshIdleCb)(void *arg);
+
+// Owns the refresh of every remote data source from one task. A source is
+// refreshed once its TTL ran out, failures retry after an exponential
+// backoff with jitter. While the screen is on, sources refresh as soon as
+// they go stale; otherwise the task waits for the end of a stale window and
+// then refreshes everything stale in the same batch. That same deadline
+// arms the timer wake before deep sleep. The freshness and backoff state
+// lives in RTC memory, so a wake does not refetch what is still fresh.
+class RefreshScheduler {
+public:
+  void add(RefreshSource source, const RefreshPolicy &policy, RefreshFn fn,
+           void *arg);
+  // For a source that learns how long its data keeps, applies from its next
+  // refresh.
+  void set_ttl(RefreshSource source, uint32_t ttl_s);
+  // idle_cb runs after each batch, once nothing is left to refresh.
+  void start(RefreshIdleCb idle_cb, void *arg);
+  void set_connected(bool connected);
+  // Refreshes the source in the next batch, ignoring its TTL and backoff.
+  void request(RefreshSource source);
+  // Re-evaluates the deadlines, for when the screen turned on.
+  void wake();
+  // Wall time by which a source must be refreshed, 0 without sources.
+  time_t next_deadline() const;
+  RefreshStats stats(RefreshSource source) const;
+  void log_stats() const;
+
+private:
+  typedef struct Source {
+    RefreshPolicy policy;
+    RefreshFn fn;
+    void *arg;
+    std::atomic<bool> forced;
+    RefreshStats stats;
+  } Source;
+
+  Source _sources[RefreshSourceMax] = {};
+  TaskHandle_t _task = nullptr;
+  RefreshIdleCb _idle_cb = nullptr;
+  void *_idle_arg = nullptr;
+  std::atomic<bool> _connected{false};
+  mutable portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+
+  static void task(void *arg);
+  void run();
+  bool run_due(time_t now);
+  void refresh(RefreshSource source);
+  time_t soft_deadline(RefreshSource source) const;
+  time_t hard_deadline(RefreshSource source) const;
+};
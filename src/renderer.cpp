@@ -0,0 +1,184 @@
+#include "renderer.hpp"
+#include "cores.hpp"
+#include "metrics.hpp"
+#include "text_builder.hpp"
+#include <algorithm>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+static const char *TAG = "Renderer";
+
+Renderer::Renderer(Screen *screen, lgfx::LovyanGFX *display)
+    : _screen(screen), _display(display) {}
+
+void Renderer::start() {
+  xTaskCreatePinnedToCore(&task, "render_task", 6144, this, 4, &_task,
+                          CORE_RENDER);
+}
+
+void Renderer::render(const PageContext &page, int64_t input_us) {
+  RenderRequest request = {};
+  request.kind = RenderPage;
+  request.page = page;
+  request.input_us = input_us;
+  submit(&request);
+}
+
+void Renderer::message(const char *format, ...) {
+  RenderRequest request = {};
+  request.kind = RenderMessage;
+  va_list args;
+  va_start(args, format);
+  vsnprintf(request.message, sizeof(request.message), format, args);
+  va_end(args);
+  submit(&request);
+}
+
+void Renderer::clear() {
+  RenderRequest request = {};
+  request.kind = RenderClear;
+  submit(&request);
+}
+
+void Renderer::off() {
+  RenderRequest request = {};
+  request.kind = RenderOff;
+  submit(&request);
+}
+
+void Renderer::submit(RenderRequest *request) {
+  request->enqueued_us = esp_timer_get_time();
+  if (!_requests.push(*request)) {
+    portENTER_CRITICAL(&_lock);
+    _stats.dropped++;
+    portEXIT_CRITICAL(&_lock);
+    ESP_LOGW(TAG, "Queue full, dropping request %d", request->kind);
+    return;
+  }
+  if (_task) {
+    xTaskNotifyGive(_task);
+  }
+}
+
+void Renderer::task(void *arg) { static_cast<Renderer *>(arg)->run(); }
+
+void Renderer::run() {
+  RenderRequest request = {};
+  RenderRequest next;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (!_requests.pop(&request)) {
+      continue;
+    }
+    while (_requests.pop(&next)) {
+      if (request.kind == RenderPage && next.kind == RenderPage) {
+        // The newest page answers the oldest input it replaces
+        if (request.input_us &&
+            (next.input_us == 0 || request.input_us < next.input_us)) {
+          next.input_us = request.input_us;
+        }
+        portENTER_CRITICAL(&_lock);
+        _stats.coalesced++;
+        portEXIT_CRITICAL(&_lock);
+      } else {
+        handle(&request);
+      }
+      request = next;
+    }
+    handle(&request);
+  }
+}
+
+void Renderer::handle(const RenderRequest *request) {
+  int64_t start_us = esp_timer_get_time();
+  int64_t dma_wait_us = _screen->stats().dma_wait_us;
+  if (request->kind != RenderOff && _asleep) {
+    _display->wakeup();
+    _asleep = false;
+  }
+  switch (request->kind) {
+  case RenderPage:
+    page_render(&request->page);
+    break;
+  case RenderMessage:
+    _screen->message(request->message);
+    break;
+  case RenderClear:
+  case RenderOff:
+    _display->fillScreen(BLACK);
+    _screen->invalidate();
+    if (request->kind == RenderOff) {
+      _display->sleep();
+      _asleep = true;
+    }
+    break;
+  }
+  int64_t end_us = esp_timer_get_time();
+  if (request->kind == RenderPage) {
+    metrics_observe_page(request->page.page, end_us - start_us);
+  }
+  dma_wait_us = _screen->stats().dma_wait_us - dma_wait_us;
+  int64_t latency_us = end_us - request->enqueued_us;
+  int64_t input_us = request->input_us ? end_us - request->input_us : 0;
+  if (input_us) {
+    metrics_observe(MetricInputToRender, input_us);
+  }
+
+  portENTER_CRITICAL(&_lock);
+  bool first = _stats.frames == 0;
+  _stats.frames++;
+  _stats.queue_us += start_us - request->enqueued_us;
+  _stats.compose_us += end_us - start_us - dma_wait_us;
+  _stats.dma_wait_us += dma_wait_us;
+  _stats.busy_us += end_us - start_us;
+  _stats.last_latency_us = latency_us;
+  _stats.max_latency_us = std::max(_stats.max_latency_us, latency_us);
+  if (input_us) {
+    _stats.inputs++;
+    _stats.input_us += input_us;
+    _stats.max_input_us = std::max(_stats.max_input_us, input_us);
+  }
+  portEXIT_CRITICAL(&_lock);
+  if (first) {
+    ESP_LOGI(TAG, "First frame %lld us after boot", end_us);
+  }
+  if (input_us) {
+    ESP_LOGD(TAG, "Input to render: %lld us", input_us);
+  }
+}
+
+RenderStats Renderer::stats() const {
+  portENTER_CRITICAL(&_lock);
+  RenderStats copy = _stats;
+  portEXIT_CRITICAL(&_lock);
+  return copy;
+}
+
+void Renderer::log_stats() const {
+  RenderStats copy = stats();
+  if (copy.frames == 0) {
+    return;
+  }
+  ESP_LOGI(TAG,
+           "%lu frames, %lu coalesced, %lu dropped, avg queue %lld us, "
+           "compose %lld us, dma wait %lld us, latency max %lld us",
+           (unsigned long)copy.frames, (unsigned long)copy.coalesced,
+           (unsigned long)copy.dropped, copy.queue_us / copy.frames,
+           copy.compose_us / copy.frames, copy.dma_wait_us / copy.frames,
+           copy.max_latency_us);
+  if (copy.inputs) {
+    ESP_LOGI(TAG, "input to render avg %lld us, max %lld us",
+             copy.input_us / copy.inputs, copy.max_input_us);
+  }
+  // Read off the render task, the counters may be a frame apart
+  const ScreenStats &screen = _screen->stats();
+  ESP_LOGI(TAG, "screen: %u fields drawn, %llu pixels, %llu bytes pushed",
+           screen.fields_drawn, (unsigned long long)screen.pixels_pushed,
+           (unsigned long long)screen.bytes_pushed);
+  ESP_LOGI(TAG, "render core %s%% busy with frames since boot",
+           TextBuilder()
+               .decimal(100.0f * copy.busy_us / esp_timer_get_time(), 1)
+               .c_str());
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "pages.hpp"
+#include "screen.hpp"
+#include "spsc_ring.hpp"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stdint.h>
+
+#define RENDER_QUEUE_SIZE 8
+#define RENDER_MESSAGE_MAX 96
+
+typedef enum RenderKind {
+  RenderPage,
+  RenderMessage,
+  RenderClear,
+  RenderOff,
+} RenderKind;
+
+typedef struct RenderRequest {
+  RenderKind kind;
+  PageContext page;
+  int64_t enqueued_us;
+  // Edge of the button that asked for the page, 0 for any other reason
+  int64_t input_us;
+  char message[RENDER_MESSAGE_MAX];
+} RenderRequest;
+
+// Per stage totals, divide by frames for averages.
+typedef struct RenderStats {
+  uint32_t frames;
+  uint32_t coalesced;
+  uint32_t dropped;
+  // Request queued to render task picking it up
+  int64_t queue_us;
+  // Composing fields on the canvases
+  int64_t compose_us;
+  // Waiting on the SPI DMA of the previous field
+  int64_t dma_wait_us;
+  int64_t max_latency_us;
+  int64_t last_latency_us;
+  // Button edge to the end of its frame
+  uint32_t inputs;
+  int64_t input_us;
+  int64_t max_input_us;
+  int64_t busy_us;
+} RenderStats;
+
+// Owns the display from a task of its own on the render core. Requests come
+// in over a lock-free ring from one producer at a time: app_main until it
+// starts action_task, then action_task. Pages queued back to back collapse
+// into the newest one.
+class Renderer {
+public:
+  Renderer(Screen *screen, lgfx::LovyanGFX *display);
+  void start();
+  // input_us is the time of the button edge the page answers, if any.
+  void render(const PageContext &page, int64_t input_us = 0);
+  void message(const char *format, ...) __attribute__((format(printf, 2, 3)));
+  void clear();
+  // Clears and puts the display to sleep, the next page wakes it up.
+  void off();
+  RenderStats stats() const;
+  void log_stats() const;
+
+private:
+  Screen *_screen;
+  lgfx::LovyanGFX *_display;
+  SpscRing<RenderRequest, RENDER_QUEUE_SIZE> _requests;
+  TaskHandle_t _task = nullptr;
+  bool _asleep = false;
+  RenderStats _stats = {};
+  mutable portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+
+  void submit(RenderRequest *request);
+  static void task(void *arg);
+  void run();
+  void handle(const RenderRequest *request);
+};
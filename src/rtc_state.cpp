@@ -0,0 +1,46 @@
+#include "rtc_state.hpp"
+#include <esp_attr.h>
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <string.h>
+
+#define RTC_STATE_MAGIC 0x434c4b32
+
+static const char *TAG = "RtcState";
+
+// Raw storage: a static with a constructor would be rebuilt on every boot
+typedef struct RtcBlock {
+  uint32_t magic;
+  uint32_t size;
+  uint32_t crc;
+  alignas(RtcState) uint8_t data[sizeof(RtcState)];
+} RtcBlock;
+
+static RTC_DATA_ATTR RtcBlock rtc_block;
+
+static RtcState *rtc_state() {
+  return reinterpret_cast<RtcState *>(rtc_block.data);
+}
+
+void rtc_state_save(const WeatherSnapshot *weather, const char *posix_tz,
+                    int page, uint8_t brightness) {
+  RtcState *state = rtc_state();
+  memcpy(&state->weather, weather, sizeof(*weather));
+  strlcpy(state->posix_tz, posix_tz, sizeof(state->posix_tz));
+  state->page = page;
+  state->brightness = brightness;
+  rtc_block.size = sizeof(RtcState);
+  rtc_block.crc = esp_rom_crc32_le(0, rtc_block.data, sizeof(rtc_block.data));
+  rtc_block.magic = RTC_STATE_MAGIC;
+}
+
+const RtcState *rtc_state_load() {
+  if (rtc_block.magic != RTC_STATE_MAGIC ||
+      rtc_block.size != sizeof(RtcState) ||
+      rtc_block.crc !=
+          esp_rom_crc32_le(0, rtc_block.data, sizeof(rtc_block.data))) {
+    ESP_LOGI(TAG, "No valid state in RTC memory");
+    return nullptr;
+  }
+  return rtc_state();
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "weather.hpp"
+#include <stdint.h>
+
+// UI state kept in RTC slow memory across deep sleep so a button wake can draw
+// its first frame before NVS, Wi-Fi or the sensors are brought up.
+typedef struct RtcState {
+  WeatherSnapshot weather;
+  char posix_tz[45];
+  int page;
+  uint8_t brightness;
+} RtcState;
+
+void rtc_state_save(const WeatherSnapshot *weather, const char *posix_tz,
+                    int page, uint8_t brightness);
+// Returns nullptr on power on or when the checksum does not match.
+const RtcState *rtc_state_load();
@@ -0,0 +1,275 @@
+#include "screen.hpp"
+#include <algorithm>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <string.h>
+
+#define FONT_HEIGHT 8
+#define CLOCK_HEIGHT 48
+// The tallest text line and sparkline, the clock goes out in two strips
+#define STRIP_HEIGHT 24
+// Page number of message frames, apart from the pages
+#define MESSAGE_PAGE -2
+#define MESSAGE_TEXT_SIZE 1.5
+
+static const char *TAG = "Screen";
+
+Screen::Screen(lgfx::LovyanGFX *display)
+    : _display(display), _canvases{M5Canvas(display), M5Canvas(display)},
+      _canvas(&_canvases[0]) {
+  for (M5Canvas &canvas : _canvases) {
+    canvas.setColorDepth(16);
+    canvas.createSprite(display->width(), STRIP_HEIGHT);
+  }
+  // RGB565 with the bytes swapped, as in the canvas buffer
+  for (int level = 0; level < 16; ++level) {
+    uint16_t color = (level * 31 / 15) << 11 | (level * 63 / 15) << 5 |
+                     (level * 31 / 15);
+    _palette[level] = (uint16_t)(color << 8 | color >> 8);
+  }
+}
+
+void Screen::begin_frame(int page) {
+  // Held until end_frame, DMA transfers only run asynchronously within it
+  _display->startWrite();
+  if (page != _page) {
+    _display->fillScreen(BLACK);
+    _frame_pixels = _display->width() * _display->height();
+    _previous_count = 0;
+    _page = page;
+  } else {
+    _frame_pixels = 0;
+  }
+  _count = 0;
+  _cursor_y = 0;
+}
+
+void Screen::text(float text_size, const char *text) {
+  int16_t height = FONT_HEIGHT * text_size;
+  draw(&atlas_text_faces[atlas_face_index(height)], height, WeatherIconMax,
+       text);
+}
+
+void Screen::weather(float text_size, uint8_t code, const char *name) {
+  int16_t height = FONT_HEIGHT * text_size;
+  draw(&atlas_text_faces[atlas_face_index(height)], height,
+       atlas_weather_icon(code), name);
+}
+
+void Screen::clock(const char *text) {
+  draw(&atlas_clock_face, CLOCK_HEIGHT, WeatherIconMax, text);
+}
+
+void Screen::draw(const AtlasFace *face, int16_t height, WeatherIcon icon,
+                  const char *text) {
+  int16_t y = _cursor_y;
+  _cursor_y += height;
+  if (_count >= SCREEN_MAX_FIELDS) {
+    ESP_LOGE(TAG, "Too many fields, dropping \"%s\"", text);
+    return;
+  }
+  Field *field = &_fields[_count];
+  bool known = _count < _previous_count;
+  _count++;
+  if (known && field->y == y && field->height == height &&
+      field->face == face && field->icon == icon && field->hash == 0 &&
+      strcmp(field->text, text) == 0) {
+    return;
+  }
+
+  int16_t canvas_width = _canvas->width();
+  int16_t width = canvas_width;
+  const AtlasFace *icons = &atlas_icon_faces[face - atlas_text_faces];
+  if (icon != WeatherIconMax) {
+    width -= icons->cell_width + face->cell_width;
+  }
+  // Shrink what would not fit on one line, like long weather code names,
+  // to the smaller faces, centered in the line
+  const AtlasFace *fit = face;
+  size_t length = strlen(text);
+  while (fit != &atlas_clock_face && fit != atlas_text_faces &&
+         length * fit->cell_width > (size_t)width) {
+    fit--;
+  }
+  int16_t top = (height - fit->cell_height) / 2;
+  // The strip covers the whole width, and so what is left of a longer
+  // previous text at the same place
+  if (known && (field->y != y || field->height != height)) {
+    clear(field);
+  }
+  // A field taller than the canvas is composed and pushed a strip at a time
+  for (int16_t band = 0; band < height; band += _canvas->height()) {
+    int16_t rows = std::min<int16_t>(height - band, _canvas->height());
+    _canvas->fillSprite(BLACK);
+    if (icon != WeatherIconMax) {
+      blit(icons, &icons->glyphs[icon], canvas_width - icons->cell_width,
+           -band, rows);
+    }
+    for (size_t i = 0; i < length; ++i) {
+      const AtlasGlyph *glyph = atlas_glyph(fit, text[i]);
+      int16_t x = i * fit->cell_width;
+      if (x + fit->cell_width > width) {
+        break;
+      }
+      if (glyph) {
+        blit(fit, glyph, x, top - band, rows);
+      }
+    }
+    push(y + band, rows);
+  }
+  _stats.fields_drawn++;
+
+  field->y = y;
+  field->height = height;
+  field->face = face;
+  field->icon = icon;
+  field->hash = 0;
+  strlcpy(field->text, text, sizeof(field->text));
+}
+
+// Copies the coverage of a glyph in a cell at x, y of the canvas, clipped
+// to the canvas width and to the rows from 0 to bottom; y is negative for
+// the strips below the first one of a field.
+void Screen::blit(const AtlasFace *face, const AtlasGlyph *glyph, int16_t x,
+                  int16_t y, int16_t bottom) {
+  uint16_t *pixels = static_cast<uint16_t *>(_canvas->getBuffer());
+  int16_t width = _canvas->width();
+  int16_t columns = std::min<int16_t>(glyph->width, width - x - glyph->x);
+  int16_t rows = std::min<int16_t>(glyph->height, bottom - y - glyph->y);
+  for (int16_t row = std::max(0, -(y + glyph->y)); row < rows; ++row) {
+    uint16_t *out = &pixels[(y + glyph->y + row) * width + x + glyph->x];
+    uint32_t nibble = glyph->offset + row * glyph->width;
+    for (int16_t col = 0; col < columns; ++col, ++nibble) {
+      uint8_t level = face->bitmap[nibble >> 1] >> (nibble & 1 ? 0 : 4) & 0xf;
+      if (level) {
+        out[col] = _palette[level];
+      }
+    }
+  }
+}
+
+void Screen::sparkline(int16_t height, const HistoryPoint *points, int count) {
+  int16_t y = _cursor_y;
+  _cursor_y += height;
+  if (height > _canvas->height()) {
+    height = _canvas->height();
+  }
+  if (_count >= SCREEN_MAX_FIELDS) {
+    ESP_LOGE(TAG, "Too many fields, dropping a sparkline");
+    return;
+  }
+  // FNV-1a of the points stands for the text of a line, never 0
+  uint32_t hash = 2166136261u;
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(points);
+  for (size_t i = 0; i < count * sizeof(HistoryPoint); ++i) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  hash |= 1;
+  Field *field = &_fields[_count];
+  bool known = _count < _previous_count;
+  _count++;
+  if (known && field->y == y && field->height == height &&
+      field->hash == hash) {
+    return;
+  }
+  if (known && (field->y != y || field->height != height)) {
+    clear(field);
+  }
+
+  int32_t low = INT32_MAX, high = INT32_MIN;
+  for (int i = 0; i < count; ++i) {
+    if (points[i].avg != HISTORY_NO_VALUE) {
+      low = std::min<int32_t>(low, points[i].min);
+      high = std::max<int32_t>(high, points[i].max);
+    }
+  }
+  int16_t width = _canvas->width();
+  int32_t range = std::max<int32_t>(high - low, 1);
+  auto to_y = [&](int32_t value) {
+    return (int16_t)(height - 1 - (value - low) * (height - 1) / range);
+  };
+  _canvas->fillSprite(BLACK);
+  for (int i = 0; i < count; ++i) {
+    const HistoryPoint *point = &points[i];
+    if (point->avg == HISTORY_NO_VALUE) {
+      continue;
+    }
+    int16_t x = i * width / count;
+    int16_t column_width = std::max((i + 1) * width / count - x, 1);
+    int16_t top = to_y(point->max);
+    _canvas->fillRect(x, top, column_width, to_y(point->min) - top + 1,
+                     DARKGREY);
+    _canvas->fillRect(x, to_y(point->avg), column_width, 1, WHITE);
+  }
+  push(y, height);
+  _stats.fields_drawn++;
+
+  field->y = y;
+  field->height = height;
+  field->face = nullptr;
+  field->icon = WeatherIconMax;
+  field->hash = hash;
+  field->text[0] = '\0';
+}
+
+void Screen::skip(float text_size) { _cursor_y += FONT_HEIGHT * text_size; }
+
+void Screen::end_frame() {
+  for (int i = _count; i < _previous_count; ++i) {
+    clear(&_fields[i]);
+  }
+  wait_dma();
+  _display->endWrite();
+  _previous_count = _count;
+  _stats.frames++;
+  _stats.last_frame_pixels = _frame_pixels;
+  _stats.pixels_pushed += _frame_pixels;
+  _stats.bytes_pushed += _frame_pixels * sizeof(uint16_t);
+}
+
+void Screen::message(const char *text) {
+  begin_frame(MESSAGE_PAGE);
+  while (*text) {
+    char line[SCREEN_MAX_TEXT];
+    size_t length = std::min(strcspn(text, "\n"), sizeof(line) - 1);
+    memcpy(line, text, length);
+    line[length] = '\0';
+    this->text(MESSAGE_TEXT_SIZE, line);
+    text += strcspn(text, "\n");
+    text += *text == '\n';
+  }
+  end_frame();
+}
+
+void Screen::clear(const Field *field) {
+  wait_dma();
+  _display->fillRect(0, field->y, _display->width(), field->height, BLACK);
+  _frame_pixels += _display->width() * field->height;
+}
+
+// Sends the strip from the composed canvas and swaps, the next strip is
+// composed while this one is on the bus.
+void Screen::push(int16_t y, int16_t height) {
+  int16_t width = _canvas->width();
+  if (height <= 0) {
+    return;
+  }
+  if (height > _canvas->height()) {
+    // Would read past the sprite buffer
+    ESP_LOGE(TAG, "Strip of %d rows on a canvas of %d", height,
+             _canvas->height());
+    return;
+  }
+  wait_dma();
+  _display->pushImageDMA(
+      0, y, width, height,
+      static_cast<const lgfx::swap565_t *>(_canvas->getBuffer()));
+  _canvas = _canvas == &_canvases[0] ? &_canvases[1] : &_canvases[0];
+  _frame_pixels += width * height;
+}
+
+void Screen::wait_dma() {
+  int64_t start_us = esp_timer_get_time();
+  _display->waitDMA();
+  _stats.dma_wait_us += esp_timer_get_time() - start_us;
+}
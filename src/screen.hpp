@@ -0,0 +1,81 @@
+#pragma once
+
+#include "glyph_atlas.h"
+#include "history.hpp"
+#include <M5Unified.h>
+#include <stdint.h>
+
+#define SCREEN_MAX_FIELDS 16
+#define SCREEN_MAX_TEXT 48
+
+typedef struct ScreenStats {
+  unsigned frames;
+  unsigned fields_drawn;
+  uint32_t last_frame_pixels;
+  uint64_t pixels_pushed;
+  uint64_t bytes_pushed;
+  // Spent waiting for the previous DMA transfer before starting the next
+  int64_t dma_wait_us;
+} ScreenStats;
+
+// Retained text layout: a page is a column of text lines, each one a field
+// spanning the width of the display. A field is composed off-screen and
+// pushed only when its text or position changed since the previous frame.
+// Text is copied from the prerendered glyph atlas in flash, a line of text
+// size s is 8 * s pixels high in the atlas face of that height.
+// There are two canvases, strips as high as a line of size 3: one strip
+// goes out over SPI DMA while the next is composed in the other, the clock
+// takes two. Draws on any LovyanGFX target: the LCD, or an off-screen
+// canvas as a framebuffer.
+class Screen {
+public:
+  explicit Screen(lgfx::LovyanGFX *display);
+  void begin_frame(int page);
+  // One line of text, built beforehand without printf, see TextBuilder.
+  void text(float text_size, const char *text);
+  // Same as text() with the icon of a WMO weather code at the right end.
+  void weather(float text_size, uint8_t code, const char *name);
+  // Digits and colons in the 48 px clock face.
+  void clock(const char *text);
+  void skip(float text_size);
+  // Min/max band with the average on top, one column per point, scaled to
+  // the points range. Redrawn only when the points change.
+  void sparkline(int16_t height, const HistoryPoint *points, int count);
+  void end_frame();
+  // A whole frame of its own with the lines of text in the smallest face.
+  void message(const char *text);
+  // Forces a full redraw, for when something else drew on the display.
+  void invalidate() { _page = -1; }
+  const ScreenStats &stats() const { return _stats; }
+
+private:
+  typedef struct Field {
+    int16_t y;
+    int16_t height;
+    const AtlasFace *face;
+    uint8_t icon;
+    uint32_t hash;
+    char text[SCREEN_MAX_TEXT];
+  } Field;
+
+  lgfx::LovyanGFX *_display;
+  M5Canvas _canvases[2];
+  // The canvas being composed, the other one may still be on the bus
+  M5Canvas *_canvas;
+  Field _fields[SCREEN_MAX_FIELDS];
+  int _count = 0;
+  int _previous_count = 0;
+  int _page = -1;
+  int16_t _cursor_y = 0;
+  uint32_t _frame_pixels = 0;
+  ScreenStats _stats = {};
+  // Canvas colors of the 16 coverage levels, white on black
+  uint16_t _palette[16];
+  void draw(const AtlasFace *face, int16_t height, WeatherIcon icon,
+            const char *text);
+  void blit(const AtlasFace *face, const AtlasGlyph *glyph, int16_t x,
+            int16_t y, int16_t bottom);
+  void clear(const Field *field);
+  void push(int16_t y, int16_t height);
+  void wait_dma();
+};
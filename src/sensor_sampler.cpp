@@ -0,0 +1,72 @@
+#include "sensor_sampler.hpp"
+#include "cores.hpp"
+#include "metrics.hpp"
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <math.h>
+
+#define STATS_EVERY_SAMPLES 360
+
+static const char *TAG = "SensorSampler";
+
+void SensorSampler::start() {
+  xTaskCreatePinnedToCore(&task, "sampler_task", 4096, this, 3, nullptr,
+                          CORE_NETWORK);
+}
+
+void SensorSampler::task(void *arg) {
+  static_cast<SensorSampler *>(arg)->run();
+}
+
+void SensorSampler::run() {
+  _archive->mount(_history);
+  TickType_t last_wake = xTaskGetTickCount();
+  for (;;) {
+    sample(time(nullptr));
+    vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(HISTORY_RAW_PERIOD_S * 1000));
+  }
+}
+
+void SensorSampler::sample(time_t now) {
+  struct tm timeinfo;
+  localtime_r(&now, &timeinfo);
+  if (timeinfo.tm_year < (2016 - 1900)) {
+    // History is indexed by wall time, wait for NTP
+    return;
+  }
+  float values[HistoryMetricMax] = {NAN, NAN, NAN};
+  int64_t start_us = esp_timer_get_time();
+  PMSAQIdata data;
+  if (_pm25->get(&data)) {
+    values[HistoryPm25] = data.pm25_standard;
+  } else {
+    metrics_count(MetricSensorErrors);
+  }
+  float temperature, humidity;
+  if (_sht3x &&
+      sht3x_get_humiture(_sht3x, &temperature, &humidity) == ESP_OK) {
+    values[HistoryTemperature] = temperature;
+    values[HistoryHumidity] = humidity;
+  } else if (_sht3x) {
+    metrics_count(MetricSensorErrors);
+  }
+  metrics_observe(MetricSensorRead, esp_timer_get_time() - start_us);
+  _history->insert(now, values);
+  int16_t encoded[HistoryMetricMax];
+  for (int m = 0; m < HistoryMetricMax; ++m) {
+    encoded[m] = isnan(values[m])
+                     ? HISTORY_NO_VALUE
+                     : history_encode((HistoryMetric)m, values[m]);
+  }
+  _archive->append_sample(now, encoded);
+
+  HistoryStats stats = _history->stats();
+  if (stats.inserts % STATS_EVERY_SAMPLES == 0) {
+    ESP_LOGI(TAG, "%lu inserts %lld us avg, %lu queries %lld us avg",
+             (unsigned long)stats.inserts, stats.insert_us / stats.inserts,
+             (unsigned long)stats.queries,
+             stats.queries ? stats.query_us / stats.queries : 0);
+  }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "archive.hpp"
+#include "history.hpp"
+#include "pm25.hpp"
+#include <sht3x.h>
+
+// Reads the PM2.5 and SHT30 sensors every HISTORY_RAW_PERIOD_S from its own
+// task into the history store and the flash archive, so no page waits on a
+// sensor. The task first mounts the archive and replays it into history.
+class SensorSampler {
+public:
+  SensorSampler(HistoryStore *history, Archive *archive, PM25 *pm25,
+                sht3x_handle_t sht3x)
+      : _history(history), _archive(archive), _pm25(pm25), _sht3x(sht3x) {}
+  void start();
+  // One round of reads stamped now, what the task does every period.
+  void sample(time_t now);
+
+private:
+  HistoryStore *_history;
+  Archive *_archive;
+  PM25 *_pm25;
+  sht3x_handle_t _sht3x;
+  static void task(void *arg);
+  void run();
+};
@@ -2,59 +2,161 @@
 #include "esp_log.h"
 #include "esp_netif_sntp.h"
 #include "esp_sntp.h"
+#include "text_builder.hpp"
+#include <esp_attr.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <math.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 
 #define CONFIG_SNTP_TIME_SERVER "pool.ntp.org"
+#define NTP_TIMEOUT_MS 15000
+// Offsets above this are stepped, below slewed
+#define NTP_STEP_US 1000000LL
+// The minute on the screen may be off by this much before the next sync
+#define NTP_TOLERANCE_US 1000000.0f
+#define NTP_MIN_INTERVAL_S (1 * 3600)
+#define NTP_MAX_INTERVAL_S (48 * 3600)
+// Shorter windows measure network jitter rather than drift
+#define NTP_MIN_DRIFT_WINDOW_S (30 * 60)
+#define NTP_MAX_DRIFT_PPM 50000.0f
+#define NTP_DRIFT_ALPHA 0.5f
 
 static const char *TAG = "SNTP";
 
-static void update_sntp_time(void);
+typedef struct NtpState {
+  int64_t synced_us;
+  int64_t offset_us;
+  float drift_ppm;
+  bool drift_valid;
+  uint32_t syncs;
+  uint32_t steps;
+} NtpState;
+
+// The RTC keeps counting through deep sleep, so does the drift estimate
+static RTC_DATA_ATTR NtpState state;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static StaticSemaphore_t sync_done_buffer;
+static SemaphoreHandle_t sync_done;
 
 void settimezone(const char *timezone) {
   setenv("TZ", timezone, 1);
   tzset();
 }
 
-void get_time(const char *format, char *strftime_buf, size_t maxsize,
-              int add_day) {
-  time_t now;
-  struct tm timeinfo;
-  time(&now);
-  localtime_r(&now, &timeinfo);
-  timeinfo.tm_mday += add_day;
-  timeinfo.tm_wday += add_day;
-  strftime(strftime_buf, maxsize, format, &timeinfo);
-}
-
-void check_and_update_ntp_time(void) {
-  time_t now;
-  struct tm timeinfo;
-  time(&now);
-  localtime_r(&now, &timeinfo);
-  if (timeinfo.tm_year < (2016 - 1900)) {
-    ESP_LOGI(TAG, "Time is not set yet. Getting time over NTP.");
-    update_sntp_time();
+static int64_t timeval_us(const struct timeval *tv) {
+  return (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
+static void record_sync(int64_t ntp_us, int64_t offset_us, bool step) {
+  portENTER_CRITICAL(&lock);
+  // Each sync corrects the clock, so the next offset is the drift since
+  if (state.synced_us != 0) {
+    int64_t elapsed_us = ntp_us - state.synced_us;
+    if (elapsed_us >= NTP_MIN_DRIFT_WINDOW_S * 1000000LL) {
+      float drift_ppm = offset_us * 1e6f / elapsed_us;
+      if (fabsf(drift_ppm) < NTP_MAX_DRIFT_PPM) {
+        state.drift_ppm =
+            state.drift_valid
+                ? state.drift_ppm + NTP_DRIFT_ALPHA * (drift_ppm -
+                                                       state.drift_ppm)
+                : drift_ppm;
+        state.drift_valid = true;
+      }
+    }
   }
+  state.synced_us = ntp_us;
+  state.offset_us = offset_us;
+  state.syncs++;
+  state.steps += step;
+  portEXIT_CRITICAL(&lock);
 }
 
-static void update_sntp_time(void) {
-  ESP_LOGI(TAG, "Initializing and starting SNTP");
+// Replaces the weak default of lwIP, which steps or slews the clock without
+// telling by how much. Runs on the tcpip task.
+extern "C" void sntp_sync_time(struct timeval *tv) {
+  struct timeval local;
+  gettimeofday(&local, nullptr);
+  int64_t ntp_us = timeval_us(tv);
+  int64_t offset_us = ntp_us - timeval_us(&local);
+  bool step = llabs(offset_us) > NTP_STEP_US;
+  if (!step) {
+    struct timeval delta = {
+        .tv_sec = (time_t)(offset_us / 1000000),
+        .tv_usec = (suseconds_t)(offset_us % 1000000),
+    };
+    step = adjtime(&delta, nullptr) != 0;
+  }
+  if (step) {
+    settimeofday(tv, nullptr);
+  }
+  record_sync(ntp_us, offset_us, step);
+  sntp_set_sync_status(SNTP_SYNC_STATUS_COMPLETED);
+  if (sync_done) {
+    xSemaphoreGive(sync_done);
+  }
+}
+
+bool sync_ntp_time(void) {
+  if (sync_done == nullptr) {
+    sync_done = xSemaphoreCreateBinaryStatic(&sync_done_buffer);
+  }
+  xSemaphoreTake(sync_done, 0);
   esp_sntp_config_t config =
       ESP_NETIF_SNTP_DEFAULT_CONFIG(CONFIG_SNTP_TIME_SERVER);
   esp_netif_sntp_init(&config);
-  time_t now = 0;
-  struct tm timeinfo;
-  memset(&timeinfo, 0, sizeof(tm));
-  int retry = 0;
-  const int retry_count = 15;
-  while (esp_netif_sntp_sync_wait(2000 / portTICK_PERIOD_MS) ==
-             ESP_ERR_TIMEOUT &&
-         ++retry < retry_count) {
-    ESP_LOGI(TAG, "Waiting for system time to be set... (%d/%d)", retry,
-             retry_count);
+  bool ok = xSemaphoreTake(sync_done, pdMS_TO_TICKS(NTP_TIMEOUT_MS));
+  esp_netif_sntp_deinit();
+  if (ok) {
+    ntp_log_status();
+  } else {
+    ESP_LOGW(TAG, "No reply in %d ms", NTP_TIMEOUT_MS);
   }
-  time(&now);
-  localtime_r(&now, &timeinfo);
+  return ok;
+}
 
-  esp_netif_sntp_deinit();
-}
\ No newline at end of file
+uint32_t ntp_next_interval_s(void) {
+  portENTER_CRITICAL(&lock);
+  bool drift_valid = state.drift_valid;
+  float drift_ppm = fabsf(state.drift_ppm);
+  portEXIT_CRITICAL(&lock);
+  // Sync again soon until there is a drift to go by
+  if (!drift_valid) {
+    return NTP_MIN_INTERVAL_S;
+  }
+  float interval_s = NTP_TOLERANCE_US / fmaxf(drift_ppm, 1.0f);
+  return (uint32_t)fminf(fmaxf(interval_s, NTP_MIN_INTERVAL_S),
+                         NTP_MAX_INTERVAL_S);
+}
+
+NtpStatus ntp_status(void) {
+  struct timeval now;
+  gettimeofday(&now, nullptr);
+  portENTER_CRITICAL(&lock);
+  NtpStatus status = {
+      .offset_us = state.offset_us,
+      .drift_ppm = state.drift_ppm,
+      .drift_valid = state.drift_valid,
+      .age_s = state.synced_us
+                   ? (timeval_us(&now) - state.synced_us) / 1000000
+                   : -1,
+      .syncs = state.syncs,
+      .steps = state.steps,
+  };
+  portEXIT_CRITICAL(&lock);
+  return status;
+}
+
+void ntp_log_status(void) {
+  NtpStatus status = ntp_status();
+  ESP_LOGI(TAG,
+           "offset %lld ms, drift %s ppm%s, synced %lld s ago, "
+           "%lu syncs, %lu steps, next in %lu s",
+           status.offset_us / 1000,
+           TextBuilder().decimal(status.drift_ppm, 1).c_str(),
+           status.drift_valid ? "" : " (unknown)", status.age_s,
+           (unsigned long)status.syncs, (unsigned long)status.steps,
+           (unsigned long)ntp_next_interval_s());
+}
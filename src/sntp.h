@@ -1,10 +1,31 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
+
+typedef struct NtpStatus {
+  // NTP minus local clock at the last sync, before it was corrected.
+  int64_t offset_us;
+  // Local clock drift estimated across syncs, positive when it runs slow.
+  float drift_ppm;
+  bool drift_valid;
+  // Seconds since the last sync, -1 before the first one.
+  int64_t age_s;
+  uint32_t syncs;
+  uint32_t steps;
+} NtpStatus;
 
 void settimezone(const char *timezone);
 
-void get_time(const char *format, char *strftime_buf, size_t maxsize,
-              int add_day);
+// Queries NTP once and waits for the reply. Small offsets are slewed with
+// adjtime, large ones stepped; either way the offset feeds the drift
+// estimate.
+bool sync_ntp_time(void);
+
+// Seconds until the clock may have drifted by the tolerance, from the drift
+// estimate.
+uint32_t ntp_next_interval_s(void);
+
+NtpStatus ntp_status(void);
 
-void check_and_update_ntp_time(void);
\ No newline at end of file
+void ntp_log_status(void);
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stddef.h>
+
+// Read-only view of size values owned by someone else.
+template <typename T> struct Span {
+  const T *data = nullptr;
+  size_t size = 0;
+  const T &operator[](size_t i) const { return data[i]; }
+  bool empty() const { return size == 0; }
+  Span from(size_t offset) const {
+    return offset < size ? Span{data + offset, size - offset} : Span{};
+  }
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+
+// Lock-free ring between one producer task and one consumer task. The
+// indexes run freely and are masked on access, N is a power of two.
+template <typename T, size_t N> class SpscRing {
+  static_assert((N & (N - 1)) == 0, "N must be a power of two");
+
+public:
+  // Producer side, false when the ring is full.
+  bool push(const T &item) {
+    size_t head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) == N) {
+      return false;
+    }
+    _items[head & (N - 1)] = item;
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+  // Consumer side, false when the ring is empty.
+  bool pop(T *item) {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    *item = _items[tail & (N - 1)];
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  std::atomic<size_t> _head{0};
+  std::atomic<size_t> _tail{0};
+  T _items[N];
+};
@@ -0,0 +1,60 @@
+#include "text_builder.hpp"
+#include <math.h>
+
+static const int32_t powers_of_ten[] = {1, 10, 100, 1000, 10000};
+
+void TextBuilder::put(char c) {
+  if (_length + 1 < sizeof(_text)) {
+    _text[_length++] = c;
+    _text[_length] = '\0';
+  }
+}
+
+TextBuilder &TextBuilder::str(const char *text) {
+  while (*text) {
+    put(*text++);
+  }
+  return *this;
+}
+
+TextBuilder &TextBuilder::fixed(int32_t value, int decimals, int width,
+                                char pad) {
+  // Digits come out backwards, least significant first
+  char digits[12];
+  int count = 0;
+  uint32_t magnitude = value < 0 ? -(uint32_t)value : value;
+  do {
+    digits[count++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude || count <= decimals);
+  int length = count + (value < 0) + (decimals > 0);
+  if (pad != '0') {
+    for (int i = length; i < width; ++i) {
+      put(pad);
+    }
+  }
+  if (value < 0) {
+    put('-');
+  }
+  if (pad == '0') {
+    for (int i = length; i < width; ++i) {
+      put('0');
+    }
+  }
+  while (count) {
+    if (count == decimals) {
+      put('.');
+    }
+    put(digits[--count]);
+  }
+  return *this;
+}
+
+TextBuilder &TextBuilder::decimal(float value, int decimals, int width,
+                                  char pad) {
+  if (isnan(value)) {
+    return str("-");
+  }
+  return fixed(lroundf(value * powers_of_ten[decimals]), decimals, width,
+               pad);
+}
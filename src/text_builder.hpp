@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TEXT_BUILDER_MAX 48
+
+// Builds a line of text in place without printf, so the pages do not need
+// the float conversions of vfprintf. Numbers are fixed-point: 215 with one
+// decimal reads 21.5. width and pad work like printf's %0*d; text that
+// does not fit is cut.
+class TextBuilder {
+public:
+  TextBuilder &str(const char *text);
+  TextBuilder &fixed(int32_t value, int decimals, int width = 0,
+                     char pad = ' ');
+  TextBuilder &integer(int32_t value, int width = 0, char pad = ' ') {
+    return fixed(value, 0, width, pad);
+  }
+  // Rounds to the given decimals first, NaN shows as "-".
+  TextBuilder &decimal(float value, int decimals, int width = 0,
+                       char pad = ' ');
+  const char *c_str() const { return _text; }
+
+private:
+  char _text[TEXT_BUILDER_MAX] = "";
+  size_t _length = 0;
+  void put(char c);
+};
@@ -0,0 +1,24 @@
+#include "tz_index.h"
+#include <string.h>
+
+const char *tz_index_lookup(const char *name) {
+  if (name == nullptr || *name == '\0') {
+    return nullptr;
+  }
+  size_t low = 0;
+  size_t high = tz_index_count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    const TzIndexEntry *entry = &tz_index_entries[mid];
+    int cmp = strcmp(name, tz_index_pool + entry->name);
+    if (cmp == 0) {
+      return tz_index_pool + entry->posix;
+    }
+    if (cmp < 0) {
+      high = mid;
+    } else {
+      low = mid + 1;
+    }
+  }
+  return nullptr;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct TzIndexEntry {
+  uint16_t name;
+  uint16_t posix;
+} TzIndexEntry;
+
+// Generated at build time from posix_tz_db/zones.json, entries sorted by name.
+extern const char tz_index_pool[];
+extern const TzIndexEntry tz_index_entries[];
+extern const size_t tz_index_count;
+
+// Returns the POSIX TZ string for an IANA zone name, or NULL if unknown.
+const char *tz_index_lookup(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,202 +1,234 @@
 #include "weather.hpp"
-#include <nvs.h>
+#include "http_client.hpp"
+#include "text_builder.hpp"
+#include "weather_api_generated.h"
+#include <esp_timer.h>
+#include <flatbuffers/flatbuffers.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define NVS_NAMESPACE "Weather"
-#define NVS_TIME "time"
+#define NVS_VERSION 3
 
-#define NVS_FORECAST_24 "24"
-#define NVS_FORECAST_7 "7"
-#define NVS_FORECAST_TMR "tmr"
+#define OPEN_METEO_URL "https://api.open-meteo.com/v1/forecast"
+#define OPEN_METEO_HOURLY                                                      \
+  "temperature_2m,precipitation_probability,weather_code,uv_index"
+#define OPEN_METEO_DAILY                                                       \
+  "weather_code,temperature_2m_max,temperature_2m_min,sunrise,sunset,"         \
+  "uv_index_max,precipitation_probability_max"
+// Hourly data starts at the current hour, the past hours bring it back to
+// local midnight where the pages index it from
+#define FORECAST_PAST_HOURS 24
+#define FORECAST_DAYS HOURLY_FORECAST_DAYS
+// 16 days of hourly floats are about 6.5 KB of the response
+#define MAX_HTTP_OUTPUT_BUFFER 12 * 1024
 
 #define ARRAY_SIZE(_arr) (sizeof(_arr) / sizeof(_arr[0]))
 
 const char TAG[] = "Weather";
 
-Weather::Weather() { restore(); }
-
-void Weather::copy_hourly(const openmeteo_sdk::WeatherApiResponse *output) {
-  auto hourly_out = output->hourly()->variables();
-  for (unsigned int i = 0; i < hourly_out->size(); i++) {
-    auto data = hourly_out->Get(i);
-    if (data->variable() == openmeteo_sdk::Variable_precipitation_probability) {
-      for (int i = 0; i < ARRAY_SIZE(forecast24.precipitation_probability);
-           ++i) {
-        forecast24.precipitation_probability[i] = data->values()->Get(i);
-      }
-      forecast_tmr.precipitation_probability[0] = data->values()->Get(24 + 9);
-      forecast_tmr.precipitation_probability[1] = data->values()->Get(24 + 16);
-    } else if (data->variable() == openmeteo_sdk::Variable_temperature) {
-      for (int i = 0; i < ARRAY_SIZE(forecast24.temperature_2m); ++i) {
-        ESP_LOGI(TAG, "Temp: %f", data->values()->Get(i));
-        forecast24.temperature_2m[i] = data->values()->Get(i);
-      }
-      forecast_tmr.temperature_2m[0] = data->values()->Get(24 + 9);
-      forecast_tmr.temperature_2m[1] = data->values()->Get(24 + 16);
-    } else if (data->variable() == openmeteo_sdk::Variable_weather_code) {
-      for (int i = 0; i < ARRAY_SIZE(forecast24.weather_code); ++i) {
-        forecast24.weather_code[i] =
-            static_cast<OM_SDK::WeatherCode>(data->values()->Get(i));
-      }
-      forecast_tmr.weather_code[0] =
-          static_cast<OM_SDK::WeatherCode>(data->values()->Get(24 + 9));
-      forecast_tmr.weather_code[1] =
-          static_cast<OM_SDK::WeatherCode>(data->values()->Get(24 + 16));
-    } else if (data->variable() == openmeteo_sdk::Variable_uv_index) {
-      for (int i = 0; i < ARRAY_SIZE(forecast24.uv_index); ++i) {
-        forecast24.uv_index[i] = data->values()->Get(i);
-      }
-      forecast_tmr.uv_index[0] = data->values()->Get(24 + 9);
-      forecast_tmr.uv_index[1] = data->values()->Get(24 + 16);
-    } else {
-      ESP_LOGE(TAG, "Not Treated hourly %s",
-               openmeteo_sdk::EnumNameVariable(data->variable()));
-    }
-  }
+// Saved with the fetch time as the record stamp, outside its CRC
+static_assert(offsetof(WeatherSnapshot, fetched_at) + sizeof(time_t) ==
+                  sizeof(WeatherSnapshot),
+              "fetched_at ends the snapshot");
+
+Weather::Weather()
+    : _current(&_snapshots[0]),
+      _record(NVS_NAMESPACE, NVS_VERSION, sizeof(time_t)) {
+  restore();
+}
+
+Weather::Weather(const WeatherSnapshot *seed)
+    : _current(&_snapshots[0]),
+      _record(NVS_NAMESPACE, NVS_VERSION, sizeof(time_t)) {
+  _snapshots[0] = *seed;
+}
+
+void Weather::start(WeatherUpdatedCb cb, void *arg, HourlyForecast *hourly) {
+  _hourly = hourly;
+  _updated_cb = cb;
+  _updated_arg = arg;
+  _response = static_cast<uint8_t *>(malloc(MAX_HTTP_OUTPUT_BUFFER));
 }
 
-void Weather::copy_daily(const openmeteo_sdk::WeatherApiResponse *output) {
-  auto daily = output->daily()->variables();
-  bool has_scan_one = false;
-  for (unsigned int i = 0; i < daily->size(); i++) {
-    auto data = daily->Get(i);
-    if (data->variable() == openmeteo_sdk::Variable_weather_code) {
-      for (int i = 0; i < data->values()->size(); ++i) {
-        forecast7.weather_code[i] =
-            static_cast<OM_SDK::WeatherCode>(data->values()->Get(i));
-      }
-    } else if (data->variable() == openmeteo_sdk::Variable_temperature) {
-      if (has_scan_one) {
-        for (int i = 0; i < data->values()->size(); ++i) {
-          forecast7.temperature_2m_max[i] = data->values()->Get(i);
-        }
-      } else {
-        for (int i = 0; i < data->values()->size(); ++i) {
-          forecast7.temperature_2m_min[i] = data->values()->Get(i);
-        }
-        has_scan_one = true;
-      }
-    } else if (data->variable() ==
-               openmeteo_sdk::Variable_precipitation_probability) {
-      for (int i = 0; i < data->values()->size(); ++i) {
-        forecast7.precipitation_probability_max[i] = data->values()->Get(i);
-      }
-    } else if (data->variable() == openmeteo_sdk::Variable_uv_index) {
-      for (int i = 0; i < data->values()->size(); ++i) {
-        forecast7.uv_index_max[i] = data->values()->Get(i);
-      }
-    } else if (data->variable() == openmeteo_sdk::Variable_sunrise) {
-      for (int i = 0; i < data->values_int64()->size(); ++i) {
-        forecast7.sunrise[i] = data->values_int64()->Get(i);
-      }
-    } else if (data->variable() == openmeteo_sdk::Variable_sunset) {
-      for (int i = 0; i < data->values_int64()->size(); ++i) {
-        forecast7.sunset[i] = data->values_int64()->Get(i);
-      }
-    } else {
-      ESP_LOGE(TAG, "Not Treated daily %s",
-               openmeteo_sdk::EnumNameVariable(data->variable()));
-    }
+template <typename T, size_t N, typename V>
+static void encode(T (&output)[N], Span<V> values, T (*encoder)(V)) {
+  for (size_t i = 0; i < N && i < values.size; ++i) {
+    output[i] = encoder(values[i]);
   }
-  if (forecast7.temperature_2m_min[0] > forecast7.temperature_2m_max[0]) {
-    for (int i = 0; i < ARRAY_SIZE(forecast7.temperature_2m_min); ++i) {
-      float tmp = forecast7.temperature_2m_min[i];
-      forecast7.temperature_2m_min[i] = forecast7.temperature_2m_max[i];
-      forecast7.temperature_2m_max[i] = tmp;
-    }
+}
+
+template <typename T>
+static void pick(T &output, Span<float> values, int index,
+                 T (*encoder)(float)) {
+  if (index >= 0 && (size_t)index < values.size) {
+    output = encoder(values[index]);
   }
 }
 
-void Weather::update_weather(float latitude, float longitude) {
-  ESP_LOGI(TAG, "Updating Weather");
-  time_t now;
-  time(&now);
-  if (now < expiry_time) {
-    return;
+static uint16_t encode_minutes(int64_t time) {
+  return forecast_encode_minutes((time_t)time);
+}
+
+static time_t local_midnight(time_t now) {
+  struct tm tm;
+  localtime_r(&now, &tm);
+  tm.tm_hour = 0;
+  tm.tm_min = 0;
+  tm.tm_sec = 0;
+  return mktime(&tm);
+}
+
+void Weather::copy_hourly(const ForecastView &view, WeatherSnapshot *snapshot) {
+  Forecast24 &forecast24 = snapshot->forecast24;
+  ForecastTmr &forecast_tmr = snapshot->forecast_tmr;
+  // The pages index forecast24 by the local hour of today
+  time_t midnight = local_midnight(time(nullptr));
+  int today = view.hour_index(midnight);
+  if (today < 0) {
+    today = 0;
   }
-  struct tm *tm = localtime(&now);
-  tm->tm_mday += 1;
-  tm->tm_hour = 0;
-  tm->tm_min = 0;
-  expiry_time = mktime(tm);
-
-  OM_SDK::TimeParam hourly[] = {
-      OM_SDK::temperature_2m, OM_SDK::precipitation_probability,
-      OM_SDK::weather_code,   OM_SDK::uv_index,
-      OM_SDK::max_params,
-  };
+  encode(forecast24.temperature_2m, view.hourly(HourlyTemperature).from(today),
+         forecast_encode_temperature);
+  encode(forecast24.precipitation_probability,
+         view.hourly(HourlyPrecipitationProbability).from(today),
+         forecast_encode_percent);
+  encode(forecast24.uv_index, view.hourly(HourlyUvIndex).from(today),
+         forecast_encode_uv);
+  encode(forecast24.weather_code, view.hourly(HourlyWeatherCode).from(today),
+         forecast_encode_code);
 
-  OM_SDK::TimeParam daily[] = {
-      OM_SDK::weather_code,
-      OM_SDK::temperature_2m_max,
-      OM_SDK::temperature_2m_min,
-      OM_SDK::sunrise,
-      OM_SDK::sunset,
-      OM_SDK::uv_index_max,
-      OM_SDK::precipitation_probability_max,
-      OM_SDK::max_params,
-  };
-  OM_SDK::OpenMeteoParams p{
-      .latitude = latitude,
-      .longitude = longitude,
-      .hourly = hourly,
-      .forecast_days = 2,
+  const int tomorrow_hours[] = {24 + 9, 24 + 16};
+  for (int i = 0; i < ARRAY_SIZE(tomorrow_hours); ++i) {
+    int index = view.hour_index(midnight + tomorrow_hours[i] * 3600);
+    pick(forecast_tmr.temperature_2m[i], view.hourly(HourlyTemperature),
+         index, forecast_encode_temperature);
+    pick(forecast_tmr.precipitation_probability[i],
+         view.hourly(HourlyPrecipitationProbability), index,
+         forecast_encode_percent);
+    pick(forecast_tmr.uv_index[i], view.hourly(HourlyUvIndex), index,
+         forecast_encode_uv);
+    pick(forecast_tmr.weather_code[i], view.hourly(HourlyWeatherCode), index,
+         forecast_encode_code);
+  }
+}
 
-  };
-  OM_SDK::OpenMeteoParams p2{
-      .latitude = latitude,
-      .longitude = longitude,
-      .daily = daily,
-      .forecast_days = 7,
+void Weather::copy_daily(const ForecastView &view, WeatherSnapshot *snapshot) {
+  Forecast7 &forecast7 = snapshot->forecast7;
+  encode(forecast7.weather_code, view.daily(DailyWeatherCode),
+         forecast_encode_code);
+  encode(forecast7.temperature_2m_max, view.daily(DailyTemperatureMax),
+         forecast_encode_temperature);
+  encode(forecast7.temperature_2m_min, view.daily(DailyTemperatureMin),
+         forecast_encode_temperature);
+  encode(forecast7.precipitation_probability_max,
+         view.daily(DailyPrecipitationProbabilityMax), forecast_encode_percent);
+  encode(forecast7.uv_index_max, view.daily(DailyUvIndexMax),
+         forecast_encode_uv);
+  // Sun times as minutes after local midnight, needs the timezone set
+  encode(forecast7.sunrise, view.daily_int64(DailySunrise), encode_minutes);
+  encode(forecast7.sunset, view.daily_int64(DailySunset), encode_minutes);
+}
 
-  };
-  openmeteo_sdk::WeatherApiResponse *output;
-  OM_SDK::get_weather(&p, &output);
-  copy_hourly(output);
-  OM_SDK::get_weather(&p2, &output);
-  copy_daily(output);
-  save();
-  ESP_LOGI(TAG, "Done Updating Weather");
+const openmeteo_sdk::WeatherApiResponse *Weather::fetch(float latitude,
+                                                         float longitude) {
+  char url[320];
+  snprintf(url, sizeof(url),
+           OPEN_METEO_URL "?latitude=%s&longitude=%s"
+                          "&hourly=" OPEN_METEO_HOURLY
+                          "&daily=" OPEN_METEO_DAILY
+                          "&past_hours=%d&forecast_days=%d"
+                          "&timezone=auto&format=flatbuffers",
+           TextBuilder().decimal(latitude, 4).c_str(),
+           TextBuilder().decimal(longitude, 4).c_str(), FORECAST_PAST_HOURS,
+           FORECAST_DAYS);
+  if (_response == nullptr) {
+    return nullptr;
+  }
+  HttpResponse response;
+  esp_err_t err =
+      http_client_get(url, _response, MAX_HTTP_OUTPUT_BUFFER, &response);
+  _response_len = response.length;
+  _stats.requests++;
+  _stats.connections += !response.timing.reused;
+  _stats.connect_us = response.timing.connect_us;
+  _stats.last_fetch_us = response.timing.total_us;
+  if (err != ESP_OK || response.status != 200 || response.truncated) {
+    ESP_LOGE(TAG, "Request failed: %s, status %d%s", esp_err_to_name(err),
+             response.status, response.truncated ? ", truncated" : "");
+    return nullptr;
+  }
+
+  // Open-Meteo sends one size prefixed flatbuffer per location
+  flatbuffers::Verifier verifier(_response, _response_len);
+  if (!openmeteo_sdk::VerifySizePrefixedWeatherApiResponseBuffer(verifier)) {
+    ESP_LOGE(TAG, "Invalid response");
+    return nullptr;
+  }
+  return openmeteo_sdk::GetSizePrefixedWeatherApiResponse(_response);
 }
 
-void Weather::save() {
-  if (expiry_time == 0) {
+// The long forecast from start on, start being local midnight of today
+void Weather::write_hourly(const ForecastView &view, time_t start) {
+  int first = view.hour_index(start);
+  if (first < 0) {
+    ESP_LOGE(TAG, "Forecast does not cover the start");
     return;
   }
-  nvs_handle_t handle;
-  ESP_LOGI(TAG, "Saving data");
-  auto err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
-  if (err != ESP_OK) {
-    ESP_LOGE(TAG, "Error (%s) opening NVS handle!\n", esp_err_to_name(err));
+  HourlyColumns columns = {
+      .temperature_2m = view.hourly(HourlyTemperature).from(first),
+      .precipitation_probability =
+          view.hourly(HourlyPrecipitationProbability).from(first),
+      .uv_index = view.hourly(HourlyUvIndex).from(first),
+      .weather_code = view.hourly(HourlyWeatherCode).from(first),
+  };
+  _hourly->write(start, columns);
+}
+
+bool Weather::refresh(float latitude, float longitude) {
+  ESP_LOGI(TAG, "Updating Weather");
+  const WeatherSnapshot *current = snapshot();
+  time_t now;
+  time(&now);
+
+  int64_t start = esp_timer_get_time();
+  const openmeteo_sdk::WeatherApiResponse *output = fetch(latitude, longitude);
+  if (output == nullptr || output->hourly() == nullptr ||
+      output->daily() == nullptr) {
+    ESP_LOGE(TAG, "Forecast failed, keeping last forecast");
+    return false;
+  }
+  WeatherSnapshot *next =
+      current == &_snapshots[0] ? &_snapshots[1] : &_snapshots[0];
+  *next = *current;
+  ForecastView view(output);
+  copy_hourly(view, next);
+  copy_daily(view, next);
+  next->fetched_at = now;
+  if (_hourly) {
+    write_hourly(view, local_midnight(now));
+  }
+  _current.store(next, std::memory_order_release);
+  ESP_LOGI(TAG, "Done Updating Weather in %lld ms, %u connections",
+           (esp_timer_get_time() - start) / 1000, _stats.connections);
+  save(next);
+  if (_updated_cb) {
+    _updated_cb(_updated_arg);
   }
-  err = nvs_set_i64(handle, NVS_TIME, expiry_time);
-  err = nvs_set_blob(handle, NVS_FORECAST_24, &forecast24, sizeof(forecast24));
-  err = nvs_set_blob(handle, NVS_FORECAST_7, &forecast7, sizeof(forecast7));
-  err = nvs_set_blob(handle, NVS_FORECAST_TMR, &forecast_tmr,
-                     sizeof(forecast_tmr));
-
-  err = nvs_commit(handle);
-  if (ESP_OK != err) {
-    ESP_LOGE(TAG, "commit: %s", esp_err_to_name(err));
+  return true;
+}
+
+void Weather::save(const WeatherSnapshot *snapshot) {
+  if (snapshot->fetched_at == 0) {
+    return;
   }
-  nvs_close(handle);
+  _record.save(snapshot, sizeof(*snapshot));
 }
 
 void Weather::restore() {
   ESP_LOGI(TAG, "Restore Data");
-  nvs_handle_t handle;
-  auto err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
-  if (err != ESP_OK) {
-    ESP_LOGE(TAG, "Error (%s) opening NVS handle!\n", esp_err_to_name(err));
+  if (!_record.load(&_snapshots[0], sizeof(_snapshots[0]))) {
+    _snapshots[0] = WeatherSnapshot();
   }
-  err = nvs_get_i64(handle, NVS_TIME, &expiry_time);
-  size_t size = sizeof(forecast24);
-  err = nvs_get_blob(handle, NVS_FORECAST_24, &forecast24, &size);
-  if (err != ESP_OK) {
-    ESP_LOGE(TAG, "%s", esp_err_to_name(err));
-  }
-  size = sizeof(forecast7);
-  err = nvs_get_blob(handle, NVS_FORECAST_7, &forecast7, &size);
-  size = sizeof(forecast_tmr);
-  err = nvs_get_blob(handle, NVS_FORECAST_TMR, &forecast_tmr, &size);
-  nvs_close(handle);
-}
\ No newline at end of file
+}
@@ -1,45 +1,60 @@
 #pragma once
 
 #include "esp_log.h"
+#include "forecast.hpp"
+#include "forecast_view.hpp"
+#include "hourly_forecast.hpp"
 #include "open_meteo.hpp"
+#include "persistence.hpp"
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
 #include <time.h>
 
-typedef struct Forecast24 {
-  OM_SDK::WeatherCode weather_code[24];
-  float uv_index[24] = {0};
-  float precipitation_probability[24] = {0};
-  float temperature_2m[24] = {0};
-} Forecast24;
+typedef struct WeatherStats {
+  unsigned requests;
+  unsigned connections;
+  int64_t connect_us;
+  int64_t last_fetch_us;
+} WeatherStats;
 
-typedef struct ForecastTmr {
-  OM_SDK::WeatherCode weather_code[2];
-  float uv_index[2] = {0};
-  float precipitation_probability[2] = {0};
-  float temperature_2m[2] = {0};
-} ForecastTmr;
-
-typedef struct Forecast7 {
-  float temperature_2m_max[7] = {0.0};
-  float temperature_2m_min[7] = {0.0};
-  float precipitation_probability_max[7] = {0};
-  float uv_index_max[7] = {0};
-  time_t sunset[7];
-  time_t sunrise[7];
-  OM_SDK::WeatherCode weather_code[7];
-} Forecast7;
+typedef void (*WeatherUpdatedCb)(void *arg);
 
 class Weather {
 public:
-  Forecast24 forecast24;
-  Forecast7 forecast7;
-  ForecastTmr forecast_tmr;
   Weather();
-  void update_weather(float latitude, float longitude);
+  // Starts from a known snapshot instead of reading NVS
+  explicit Weather(const WeatherSnapshot *seed);
+  // The hourly forecast, if any, gets the 16 days on every refresh.
+  void start(WeatherUpdatedCb cb, void *arg, HourlyForecast *hourly);
+  // Fetches and publishes a new forecast, blocking. Called by the refresh
+  // scheduler, which owns the refresh policy.
+  bool refresh(float latitude, float longitude);
+  // Last good forecast, published by refresh() with a pointer swap.
+  const WeatherSnapshot *snapshot() const {
+    return _current.load(std::memory_order_acquire);
+  }
+  const WeatherStats &stats() const { return _stats; }
 
 private:
-  time_t expiry_time = {0};
-  void copy_hourly(const openmeteo_sdk::WeatherApiResponse *output);
-  void copy_daily(const openmeteo_sdk::WeatherApiResponse *output);
-  void save();
+  // Double buffer: refresh() only writes the one not published. Refreshes
+  // are seconds apart at the very least so a renderer never holds a snapshot
+  // across two publications.
+  WeatherSnapshot _snapshots[2];
+  std::atomic<const WeatherSnapshot *> _current;
+  HourlyForecast *_hourly = nullptr;
+  WeatherUpdatedCb _updated_cb = nullptr;
+  void *_updated_arg = nullptr;
+  uint8_t *_response = nullptr;
+  size_t _response_len = 0;
+  WeatherStats _stats = {};
+  PersistentRecord _record;
+  const openmeteo_sdk::WeatherApiResponse *fetch(float latitude,
+                                                 float longitude);
+  void copy_hourly(const ForecastView &view, WeatherSnapshot *snapshot);
+  void copy_daily(const ForecastView &view, WeatherSnapshot *snapshot);
+  void write_hourly(const ForecastView &view, time_t start);
+  void save(const WeatherSnapshot *snapshot);
   void restore();
-};
\ No newline at end of file
+};
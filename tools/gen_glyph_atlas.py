@@ -0,0 +1,485 @@
+#!/usr/bin/env python3
+"""Generate the flash-resident glyph atlas the pages draw their text with.
+
+Renders, from a TrueType font, every printable ASCII character at the line
+heights the pages use, the clock digits at 48 px, and the weather-code icons
+at the line heights, all as 4 bit anti-aliased coverage. Each glyph is cut to
+its bounding box. The output is a C file of const tables, so the firmware
+draws text by copying coverage into the line canvas instead of scaling the
+8 px font at runtime.
+
+Pure Python on purpose, the build has no imaging library: the font is read
+from its glyf outlines and filled with exact horizontal coverage over 16
+sub-scanlines per pixel, icons are sampled 8 x 8 per pixel.
+"""
+
+import math
+import struct
+import sys
+
+# Line heights of the text sizes the pages use, FONT_HEIGHT * size, and the
+# cell width keeps the 6:8 proportion of the 8 px font the layout was made
+# for. Long lines shrink to the next smaller face.
+TEXT_HEIGHTS = (12, 16, 20, 24)
+CLOCK_HEIGHT = 48
+CLOCK_CHARS = "0123456789:"
+FIRST_CHAR = 0x20
+LAST_CHAR = 0x7E
+SUB_SCANLINES = 16
+ICON_SAMPLES = 8
+
+# Order of WeatherIcon in glyph_atlas.h
+ICONS = ("clear", "partly_cloudy", "overcast", "fog", "drizzle", "rain",
+         "snow", "thunder")
+
+
+class Font:
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        count = struct.unpack_from(">H", self.data, 4)[0]
+        self.tables = {}
+        for i in range(count):
+            tag, _, offset, length = struct.unpack_from(
+                ">4sIII", self.data, 12 + 16 * i)
+            self.tables[tag.decode("latin-1")] = offset
+        head = self.tables["head"]
+        self.units = struct.unpack_from(">H", self.data, head + 18)[0]
+        self.long_loca = struct.unpack_from(">h", self.data, head + 50)[0]
+        self.glyph_count = struct.unpack_from(
+            ">H", self.data, self.tables["maxp"] + 4)[0]
+        self.metrics = struct.unpack_from(
+            ">H", self.data, self.tables["hhea"] + 34)[0]
+        self.cmap = self.read_cmap()
+
+    def u16(self, offset):
+        return struct.unpack_from(">H", self.data, offset)[0]
+
+    def read_cmap(self):
+        cmap = self.tables["cmap"]
+        for i in range(self.u16(cmap + 2)):
+            platform, encoding, offset = struct.unpack_from(
+                ">HHI", self.data, cmap + 4 + 8 * i)
+            sub = cmap + offset
+            if platform in (0, 3) and encoding in (1, 3) and \
+                    self.u16(sub) == 4:
+                break
+        else:
+            sys.exit("no unicode cmap in the font")
+        segments = self.u16(sub + 6) // 2
+        ends = sub + 14
+        starts = ends + 2 * segments + 2
+        deltas = starts + 2 * segments
+        ranges = deltas + 2 * segments
+        mapping = {}
+        for s in range(segments):
+            end = self.u16(ends + 2 * s)
+            start = self.u16(starts + 2 * s)
+            delta = self.u16(deltas + 2 * s)
+            range_offset = self.u16(ranges + 2 * s)
+            for code in range(start, min(end, LAST_CHAR) + 1):
+                if range_offset == 0:
+                    glyph = (code + delta) & 0xFFFF
+                else:
+                    glyph = self.u16(ranges + 2 * s + range_offset +
+                                     2 * (code - start))
+                    if glyph:
+                        glyph = (glyph + delta) & 0xFFFF
+                mapping[code] = glyph
+        return mapping
+
+    def advance(self, glyph):
+        index = min(glyph, self.metrics - 1)
+        return self.u16(self.tables["hmtx"] + 4 * index)
+
+    def glyph_offset(self, glyph):
+        loca = self.tables["loca"]
+        if self.long_loca:
+            start, end = struct.unpack_from(">II", self.data, loca + 4 * glyph)
+        else:
+            start, end = (2 * v for v in struct.unpack_from(
+                ">HH", self.data, loca + 2 * glyph))
+        return self.tables["glyf"] + start, end - start
+
+    def contours(self, glyph):
+        """Contours in font units, lists of (x, y, on_curve)."""
+        offset, length = self.glyph_offset(glyph)
+        if length == 0:
+            return []
+        count = struct.unpack_from(">h", self.data, offset)[0]
+        if count < 0:
+            return self.composite(offset + 10)
+        ends = struct.unpack_from(">%dH" % count, self.data, offset + 10)
+        points = ends[-1] + 1 if count else 0
+        pos = offset + 10 + 2 * count
+        pos += 2 + self.u16(pos)
+        flags = []
+        while len(flags) < points:
+            flag = self.data[pos]
+            pos += 1
+            repeat = 0
+            if flag & 8:
+                repeat = self.data[pos]
+                pos += 1
+            flags.extend([flag] * (repeat + 1))
+
+        def coordinates(short, same):
+            nonlocal pos
+            values, value = [], 0
+            for flag in flags[:points]:
+                if flag & short:
+                    delta = self.data[pos]
+                    pos += 1
+                    value += delta if flag & same else -delta
+                elif not flag & same:
+                    value += struct.unpack_from(">h", self.data, pos)[0]
+                    pos += 2
+                values.append(value)
+            return values
+
+        xs = coordinates(2, 16)
+        ys = coordinates(4, 32)
+        result, start = [], 0
+        for end in ends:
+            result.append([(xs[i], ys[i], flags[i] & 1)
+                           for i in range(start, end + 1)])
+            start = end + 1
+        return result
+
+    def composite(self, pos):
+        result = []
+        while True:
+            flags, glyph = struct.unpack_from(">HH", self.data, pos)
+            pos += 4
+            if flags & 1:
+                dx, dy = struct.unpack_from(">hh", self.data, pos)
+                pos += 4
+            else:
+                dx, dy = struct.unpack_from(">bb", self.data, pos)
+                pos += 2
+            if not flags & 2:
+                sys.exit("point matched composites are not supported")
+            a, b, c, d = 1.0, 0.0, 0.0, 1.0
+            if flags & 8:
+                a = d = struct.unpack_from(">h", self.data, pos)[0] / 16384
+                pos += 2
+            elif flags & 0x40:
+                a, d = (v / 16384 for v in struct.unpack_from(
+                    ">hh", self.data, pos))
+                pos += 4
+            elif flags & 0x80:
+                a, b, c, d = (v / 16384 for v in struct.unpack_from(
+                    ">hhhh", self.data, pos))
+                pos += 8
+            for contour in self.contours(glyph):
+                result.append([(a * x + c * y + dx, b * x + d * y + dy, on)
+                               for x, y, on in contour])
+            if not flags & 0x20:
+                return result
+
+    def bounds(self, glyph):
+        offset, length = self.glyph_offset(glyph)
+        if length == 0:
+            return None
+        return struct.unpack_from(">hhhh", self.data, offset + 2)
+
+
+def flatten(contour, scale, dx, dy):
+    """Line segments in pixels, y down, quadratic curves cut in 8."""
+    points = [(x * scale + dx, dy - y * scale, on) for x, y, on in contour]
+    # Start on a curve point, between two off-curve points there is an
+    # implied one halfway
+    if not points[0][2]:
+        last = points[-1]
+        if last[2]:
+            points = [last] + points[:-1]
+        else:
+            mid = ((last[0] + points[0][0]) / 2,
+                   (last[1] + points[0][1]) / 2, 1)
+            points = [mid] + points
+    edges = []
+    current = points[0]
+    control = None
+    for point in points[1:] + points[:1]:
+        if point[2]:
+            if control is None:
+                edges.append((current[0], current[1], point[0], point[1]))
+            else:
+                edges.extend(quadratic(current, control, point))
+            current, control = point, None
+        elif control is None:
+            control = point
+        else:
+            mid = ((control[0] + point[0]) / 2,
+                   (control[1] + point[1]) / 2, 1)
+            edges.extend(quadratic(current, control, mid))
+            current, control = mid, point
+    return edges
+
+
+def quadratic(start, control, end, steps=8):
+    edges, previous = [], start
+    for i in range(1, steps + 1):
+        t = i / steps
+        u = 1 - t
+        point = (u * u * start[0] + 2 * u * t * control[0] + t * t * end[0],
+                 u * u * start[1] + 2 * u * t * control[1] + t * t * end[1])
+        edges.append((previous[0], previous[1], point[0], point[1]))
+        previous = point
+    return edges
+
+
+def fill(edges, width, height):
+    """Coverage 0..1 per pixel of the nonzero fill of the edges."""
+    coverage = [[0.0] * width for _ in range(height)]
+    for row in range(height):
+        for sub in range(SUB_SCANLINES):
+            y = row + (sub + 0.5) / SUB_SCANLINES
+            crossings = []
+            for x0, y0, x1, y1 in edges:
+                if (y0 <= y < y1) or (y1 <= y < y0):
+                    x = x0 + (y - y0) * (x1 - x0) / (y1 - y0)
+                    crossings.append((x, 1 if y1 > y0 else -1))
+            crossings.sort()
+            winding = 0
+            for i, (x, direction) in enumerate(crossings):
+                was = winding
+                winding += direction
+                if was == 0 and winding != 0:
+                    span_start = x
+                elif was != 0 and winding == 0:
+                    span(coverage[row], span_start, x, 1 / SUB_SCANLINES)
+    return coverage
+
+
+def span(line, start, end, weight):
+    start = max(start, 0.0)
+    end = min(end, float(len(line)))
+    if end <= start:
+        return
+    first, last = int(start), min(int(end), len(line) - 1)
+    if first == last:
+        line[first] += (end - start) * weight
+        return
+    line[first] += (first + 1 - start) * weight
+    for x in range(first + 1, last):
+        line[x] += weight
+    line[last] += (end - last) * weight
+
+
+def sample(inside, width, height):
+    """Coverage 0..1 per pixel of a shape given as a point test in 0..1."""
+    coverage = []
+    size = max(width, height)
+    for row in range(height):
+        line = []
+        for col in range(width):
+            hits = 0
+            for sy in range(ICON_SAMPLES):
+                for sx in range(ICON_SAMPLES):
+                    hits += inside((col + (sx + 0.5) / ICON_SAMPLES) / size,
+                                   (row + (sy + 0.5) / ICON_SAMPLES) / size)
+            line.append(hits / ICON_SAMPLES ** 2)
+        coverage.append(line)
+    return coverage
+
+
+def disk(cx, cy, r):
+    return lambda x, y: (x - cx) ** 2 + (y - cy) ** 2 <= r * r
+
+
+def capsule(x0, y0, x1, y1, r):
+    def inside(x, y):
+        dx, dy = x1 - x0, y1 - y0
+        t = max(0.0, min(1.0, ((x - x0) * dx + (y - y0) * dy) /
+                         (dx * dx + dy * dy)))
+        return (x - x0 - t * dx) ** 2 + (y - y0 - t * dy) ** 2 <= r * r
+    return inside
+
+
+def polygon(points):
+    def inside(x, y):
+        result = False
+        for (x0, y0), (x1, y1) in zip(points, points[1:] + points[:1]):
+            if (y0 > y) != (y1 > y) and \
+                    x < x0 + (y - y0) * (x1 - x0) / (y1 - y0):
+                result = not result
+        return result
+    return inside
+
+
+def union(*shapes):
+    return lambda x, y: any(shape(x, y) for shape in shapes)
+
+
+def sun(cx, cy, r):
+    rays = [capsule(cx + r * 1.45 * math.cos(a), cy + r * 1.45 * math.sin(a),
+                    cx + r * 2.0 * math.cos(a), cy + r * 2.0 * math.sin(a),
+                    r * 0.22)
+            for a in (i * math.pi / 4 for i in range(8))]
+    return union(disk(cx, cy, r), *rays)
+
+
+def cloud(dy=0.0, scale=1.0):
+    def at(x, y):
+        return 0.5 + (x - 0.5) * scale, 0.6 + dy + (y - 0.6) * scale
+    parts = [disk(*at(0.32, 0.58), 0.17 * scale),
+             disk(*at(0.55, 0.45), 0.24 * scale),
+             disk(*at(0.76, 0.6), 0.15 * scale),
+             capsule(*at(0.3, 0.66), *at(0.78, 0.66), 0.09 * scale)]
+    return union(*parts)
+
+
+def icon_shape(name):
+    if name == "clear":
+        return sun(0.5, 0.5, 0.2)
+    if name == "partly_cloudy":
+        return union(sun(0.34, 0.34, 0.14), cloud(0.08, 0.8))
+    if name == "overcast":
+        return cloud(-0.05, 1.1)
+    if name == "fog":
+        return union(*[capsule(0.14 + s, y, 0.86 - s, y, 0.045)
+                       for y, s in ((0.3, 0.06), (0.5, 0.0), (0.7, 0.1))])
+    drops = {
+        "drizzle": [capsule(x, 0.82, x - 0.03, 0.9, 0.04)
+                    for x in (0.36, 0.6)],
+        "rain": [capsule(x, 0.74, x - 0.08, 0.94, 0.045)
+                 for x in (0.32, 0.52, 0.72)],
+        "snow": [disk(x, y, 0.06) for x, y in
+                 ((0.3, 0.8), (0.5, 0.92), (0.7, 0.8))],
+        "thunder": [polygon([(0.56, 0.6), (0.38, 0.8), (0.5, 0.8),
+                             (0.42, 0.98), (0.64, 0.74), (0.52, 0.74),
+                             (0.62, 0.6)])],
+    }[name]
+    return union(cloud(-0.18, 0.9), *drops)
+
+
+def quantize(coverage):
+    """4 bit glyph cut to its bounding box: (x, y, width, height, nibbles)."""
+    levels = [[min(15, int(v * 15 + 0.5)) for v in row] for row in coverage]
+    rows = [y for y, row in enumerate(levels) if any(row)]
+    cols = [x for x in range(len(levels[0]) if levels else 0)
+            if any(row[x] for row in levels)]
+    if not rows:
+        return 0, 0, 0, 0, []
+    top, left = rows[0], cols[0]
+    height, width = rows[-1] - top + 1, cols[-1] - left + 1
+    nibbles = [levels[top + y][left + x]
+               for y in range(height) for x in range(width)]
+    return left, top, width, height, nibbles
+
+
+def render_text(font, chars, cell_width, cell_height, pixels, baseline):
+    scale = pixels / font.units
+    glyphs = []
+    for char in chars:
+        glyph = font.cmap.get(ord(char), 0)
+        # Centered in the cell, the monospace advance is narrower than it
+        dx = (cell_width - font.advance(glyph) * scale) / 2
+        edges = []
+        for contour in font.contours(glyph):
+            edges.extend(flatten(contour, scale, dx, baseline))
+        glyphs.append(quantize(fill(edges, cell_width, cell_height)))
+    return glyphs
+
+
+def text_face(font, height):
+    width = height * 3 // 4
+    # Letters and digits fill the line, the few taller signs like brackets
+    # are cut at the cell
+    bounds = [font.bounds(font.cmap[ord(c)]) for c in
+              "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"]
+    top = max(b[3] for b in bounds if b)
+    bottom = min(b[1] for b in bounds if b)
+    pixels = min((height - 1) * font.units / (top - bottom),
+                 width * font.units / font.advance(font.cmap[ord("0")]))
+    baseline = 0.5 + top * pixels / font.units
+    chars = "".join(chr(c) for c in range(FIRST_CHAR, LAST_CHAR + 1))
+    return width, render_text(font, chars, width, height, pixels, baseline)
+
+
+def clock_face(font):
+    digit = font.cmap[ord("0")]
+    top = max(font.bounds(font.cmap[ord(c)])[3] for c in "0123456789")
+    # Digits 44 px tall, centered in the 48 px strip
+    pixels = 44 * font.units / top
+    width = int(math.ceil(font.advance(digit) * pixels / font.units))
+    baseline = (CLOCK_HEIGHT + 44) / 2
+    return width, render_text(font, CLOCK_CHARS, width, CLOCK_HEIGHT, pixels,
+                              baseline)
+
+
+def icon_face(height):
+    # A margin of a pixel at each side keeps the icon apart from the text
+    size = height - 2
+    glyphs = []
+    for name in ICONS:
+        x, y, w, h, nibbles = quantize(sample(icon_shape(name), size, size))
+        glyphs.append((x + 1, y + 1, w, h, nibbles))
+    return height, glyphs
+
+
+def write_face(out, name, glyphs):
+    bitmap, table = [], []
+    for x, y, w, h, nibbles in glyphs:
+        table.append((len(bitmap) * 2, x, y, w, h))
+        if len(nibbles) % 2:
+            nibbles = nibbles + [0]
+        bitmap.extend((nibbles[i] << 4) | nibbles[i + 1]
+                      for i in range(0, len(nibbles), 2))
+    if len(bitmap) * 2 > 0xFFFF:
+        sys.exit("%s too large for 16-bit offsets" % name)
+    out.write("static const uint8_t %s_bitmap[] = {\n" % name)
+    for i in range(0, len(bitmap), 16):
+        out.write("    %s,\n" % ", ".join("0x%02x" % b
+                                          for b in bitmap[i:i + 16]))
+    out.write("};\n\n")
+    out.write("static const AtlasGlyph %s_glyphs[] = {\n" % name)
+    for entry in table:
+        out.write("    {%d, %d, %d, %d, %d},\n" % entry)
+    out.write("};\n\n")
+    return len(bitmap) + len(table) * 6
+
+
+def main(font_path, dst):
+    font = Font(font_path)
+    with open(dst, "w", encoding="ascii") as out:
+        out.write("/* Generated by tools/gen_glyph_atlas.py, do not edit. */\n")
+        out.write('#include "glyph_atlas.h"\n\n')
+        size = 0
+        faces = []
+        for height in TEXT_HEIGHTS:
+            width, glyphs = text_face(font, height)
+            size += write_face(out, "text_%d" % height, glyphs)
+            faces.append((width, height, FIRST_CHAR, len(glyphs),
+                          "text_%d" % height))
+        icons = []
+        for height in TEXT_HEIGHTS:
+            width, glyphs = icon_face(height)
+            size += write_face(out, "icon_%d" % height, glyphs)
+            icons.append((width, height, 0, len(glyphs), "icon_%d" % height))
+        width, glyphs = clock_face(font)
+        size += write_face(out, "clock", glyphs)
+
+        def face(entry):
+            return "{%d, %d, %d, %d, %s_glyphs, %s_bitmap}" % (
+                entry + (entry[-1],))
+
+        out.write("const AtlasFace atlas_text_faces[] = {\n")
+        out.writelines("    %s,\n" % face(entry) for entry in faces)
+        out.write("};\n\n")
+        out.write("const AtlasFace atlas_icon_faces[] = {\n")
+        out.writelines("    %s,\n" % face(entry) for entry in icons)
+        out.write("};\n\n")
+        out.write("const size_t atlas_face_count = %d;\n\n" % len(faces))
+        out.write("const AtlasFace atlas_clock_face = %s;\n" % face(
+            (width, CLOCK_HEIGHT, ord(CLOCK_CHARS[0]), len(glyphs), "clock")))
+
+    print("glyph atlas: %d text faces, %d icons, %d bytes"
+          % (len(faces), len(ICONS), size))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3:
+        sys.exit("usage: gen_glyph_atlas.py FONT.ttf OUTPUT.c")
+    main(sys.argv[1], sys.argv[2])
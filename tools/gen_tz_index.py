@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+"""Generate the flash-resident timezone index from posix_tz_db/zones.json.
+
+zones.json maps an IANA name to a POSIX TZ string. The output is a C file with
+one string pool holding every name and every distinct POSIX string once, and
+an array of (name, posix) offsets sorted by name so the firmware can binary
+search it without parsing JSON or touching the heap.
+"""
+
+import json
+import sys
+
+
+def c_string(value):
+    out = []
+    for ch in value.encode("ascii"):
+        if ch in (ord('"'), ord("\\")):
+            out.append("\\" + chr(ch))
+        elif 0x20 <= ch < 0x7F:
+            out.append(chr(ch))
+        else:
+            out.append("\\%03o" % ch)
+    return "".join(out)
+
+
+def main(src, dst):
+    with open(src, encoding="utf-8") as f:
+        zones = json.load(f)
+
+    names = sorted(zones)
+    pool = []
+    offsets = {}
+    size = 0
+
+    def intern(value):
+        nonlocal size
+        if value not in offsets:
+            offsets[value] = size
+            pool.append(value)
+            size += len(value) + 1
+        return offsets[value]
+
+    entries = [(intern(name), intern(zones[name])) for name in names]
+    if size > 0xFFFF:
+        sys.exit("tz index pool too large for 16-bit offsets: %d" % size)
+
+    with open(dst, "w", encoding="ascii") as f:
+        f.write("/* Generated by tools/gen_tz_index.py, do not edit. */\n")
+        f.write('#include "tz_index.h"\n\n')
+        f.write("const char tz_index_pool[] =\n")
+        for value in pool:
+            f.write('    "%s\\0"\n' % c_string(value))
+        f.write("    ;\n\n")
+        f.write("const TzIndexEntry tz_index_entries[] = {\n")
+        for name, posix in entries:
+            f.write("    {%d, %d},\n" % (name, posix))
+        f.write("};\n\n")
+        f.write("const size_t tz_index_count = %d;\n" % len(entries))
+
+    print("tz index: %d zones, %d bytes pool, %d bytes table"
+          % (len(entries), size, len(entries) * 4))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3:
+        sys.exit("usage: gen_tz_index.py zones.json tz_index_data.c")
+    main(sys.argv[1], sys.argv[2])